@@ -0,0 +1,733 @@
+// ApiLoadTest.cpp
+//
+// Drives every route registered by WiFiManager::setupWebServer() and
+// setupConfigRoutes() through the host AsyncWebServer, plus the WebSocket
+// command set, and reports throughput, latency percentiles and heap use per
+// endpoint. Results are written as JSON and can be compared with a previous
+// run to catch regressions.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include "HostClock.h"
+#include "HostHeap.h"
+#include "WiFiManager.h"
+#include "ConfigManager.h"
+#include "KeyHandler.h"
+#include "HIDHandler.h"
+#include "LEDHandler.h"
+#include "MacroHandler.h"
+#include "WebSocketSendQueue.h"
+#include "SHA256Hasher.h"
+#include "PersistenceService.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+extern USBCDC USBSerial;
+extern KeyHandler* keyHandler;
+extern HIDHandler* hidHandler;
+
+namespace {
+
+// Regression thresholds against --baseline
+const double P99_REGRESSION = 1.25;   // p99 latency up by more than 25%
+const double PEAK_REGRESSION = 1.10;  // Peak heap per request up by more than 10%
+const double RPS_REGRESSION = 0.80;   // Throughput down by more than 20%
+
+struct Options {
+    std::string dataDir = "data";
+    std::string outFile = "host_loadtest_results.json";
+    std::string baselineFile;
+    uint32_t iterations = 200;
+    size_t chunkSize = 1436;          // One TCP segment, as AsyncTCP delivers bodies
+    size_t largeThreshold = 16 * 1024;
+    bool echoLog = false;
+    bool realDelays = false;
+    std::string uploadFile;           // Image pushed to /api/firmware/upload
+};
+
+struct Scenario {
+    String name;
+    WebRequestMethodComposite method;
+    String url;
+    String handlerUri;
+    std::string body;
+};
+
+struct Result {
+    String name;
+    String kind;                      // "http" or "ws"
+    String handlerUri;                // Handler that actually served the request
+    int code = 0;
+    uint32_t iterations = 0;
+    double rps = 0;
+    double p50Us = 0, p90Us = 0, p99Us = 0, maxUs = 0;
+    double delayMsPerRequest = 0;     // Time spent in delay()/vTaskDelay(), not included above
+    int64_t peakHeap = 0;             // Worst heap high-water mark above the pre-request level
+    size_t largestAlloc = 0;
+    double largeAllocsPerRequest = 0;
+    double allocsPerRequest = 0;
+    double logBytesPerRequest = 0;
+    size_t responseBytes = 0;
+    std::set<std::string> flags;
+};
+
+const char* methodName(WebRequestMethodComposite method) {
+    switch (method) {
+        case HTTP_GET: return "GET";
+        case HTTP_POST: return "POST";
+        case HTTP_DELETE: return "DELETE";
+        case HTTP_PUT: return "PUT";
+        case HTTP_PATCH: return "PATCH";
+        case HTTP_HEAD: return "HEAD";
+        case HTTP_OPTIONS: return "OPTIONS";
+        default: return "ANY";
+    }
+}
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "%s needs a value\n", name);
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--data") {
+            const char* v = next("--data");
+            if (v == nullptr) return false;
+            options.dataDir = v;
+        } else if (arg == "--out") {
+            const char* v = next("--out");
+            if (v == nullptr) return false;
+            options.outFile = v;
+        } else if (arg == "--baseline") {
+            const char* v = next("--baseline");
+            if (v == nullptr) return false;
+            options.baselineFile = v;
+        } else if (arg == "--iterations") {
+            const char* v = next("--iterations");
+            if (v == nullptr) return false;
+            options.iterations = std::max(1, atoi(v));
+        } else if (arg == "--chunk") {
+            const char* v = next("--chunk");
+            if (v == nullptr) return false;
+            options.chunkSize = std::max(1, atoi(v));
+        } else if (arg == "--large") {
+            const char* v = next("--large");
+            if (v == nullptr) return false;
+            options.largeThreshold = std::max(1, atoi(v));
+        } else if (arg == "--upload") {
+            const char* v = next("--upload");
+            if (v == nullptr) return false;
+            options.uploadFile = v;
+        } else if (arg == "--log") {
+            options.echoLog = true;
+        } else if (arg == "--real-delay") {
+            options.realDelays = true;
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--data DIR] [--iterations N] [--chunk BYTES] [--large BYTES]\n"
+                    "          [--baseline FILE] [--out FILE] [--upload IMAGE] [--log] [--real-delay]\n",
+                    argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string readHostFile(const stdfs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+std::string readFsFile(const char* path) {
+    return readHostFile(LittleFS.hostPath(path));
+}
+
+// Concrete URL for a registered URI: path captures get a sample id and
+// wildcards a file that exists in data/web
+String concreteUrl(const String& uri) {
+    String url = uri;
+    if (url.startsWith("^")) url = url.substring(1);
+    if (url.endsWith("$")) url = url.substring(0, url.length() - 1);
+    url.replace("^", "");
+    url.replace("$", "");
+    url.replace("\\/", "/");
+    url.replace("\\.", ".");
+
+    String sample = url.indexOf("/components/") >= 0 ? "button-1" : "test_macro";
+    int open;
+    while ((open = url.indexOf('(')) >= 0) {
+        int close = url.indexOf(')', open);
+        if (close < 0) break;
+        url = url.substring(0, open) + sample + url.substring(close + 1);
+    }
+
+    url.replace(".*.js", "app.js");
+    url.replace(".*.css", "app.css");
+    if (url.endsWith("*")) url = url.substring(0, url.length() - 1) + "index.html";
+    return url;
+}
+
+// Representative request body for a POST/PUT route
+std::string bodyFor(const String& url) {
+    if (url.startsWith("/api/config/led")) return readFsFile("/config/LEDs.json");
+    if (url == "/api/config/actions") return readFsFile("/config/actions.json");
+    if (url == "/api/config/components") return readFsFile("/config/components.json");
+    if (url.indexOf("/encoder-actions") >= 0) {
+        return "{\"clockwise\":{\"type\":\"hid\",\"report\":[\"0x00\",\"0x00\",\"0x52\",\"0x00\",\"0x00\",\"0x00\",\"0x00\",\"0x00\"]},"
+               "\"counterclockwise\":{\"type\":\"hid\",\"report\":[\"0x00\",\"0x00\",\"0x51\",\"0x00\",\"0x00\",\"0x00\",\"0x00\",\"0x00\"]}}";
+    }
+    if (url.indexOf("/components/") >= 0) {
+        return "{\"type\":\"hid\",\"report\":[\"0x00\",\"0x00\",\"0x04\",\"0x00\",\"0x00\",\"0x00\",\"0x00\",\"0x00\"]}";
+    }
+    if (url.indexOf("macros") >= 0) return readFsFile("/macros/test_macro.json");
+    if (url == "/api/config/wifi") return "{\"ssid\":\"MacroPad\",\"password\":\"macropad123\",\"ap_mode\":true}";
+    if (url == "/api/layers/switch") return "{\"layer\":\"default-actions-layer\"}";
+    return "{}";
+}
+
+// Routes that rewrite or delete shared state run after everything else
+int scenarioOrder(const Scenario& s) {
+    if (s.method == HTTP_DELETE) return 2;
+    if (s.url.indexOf("reset") >= 0 || s.url.indexOf("restore") >= 0) return 1;
+    return 0;
+}
+
+std::vector<Scenario> buildScenarios(AsyncWebServer& server) {
+    static const WebRequestMethod METHODS[] = { HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+    std::vector<Scenario> scenarios;
+    std::set<std::string> seen;
+    for (AsyncWebHandler* handler : server.hostHandlers()) {
+        String kind = handler->hostKind();
+        if (kind == "websocket" || kind == "handler") continue;
+
+        WebRequestMethodComposite methods = handler->hostMethods();
+        if (methods == HTTP_ANY) methods = HTTP_GET;
+
+        for (WebRequestMethod method : METHODS) {
+            if (!(methods & method)) continue;
+
+            Scenario s;
+            s.method = method;
+            s.url = concreteUrl(handler->hostUri());
+            s.handlerUri = handler->hostUri();
+            s.name = String(methodName(method)) + " " + s.url;
+            if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH) {
+                s.body = bodyFor(s.url);
+            }
+            if (s.url == "/api/config/restore") s.url += "?config=actions";
+
+            // The first registration wins on the device too; later duplicates are shadowed
+            if (!seen.insert(s.name.c_str()).second) continue;
+            scenarios.push_back(s);
+        }
+    }
+
+    std::stable_sort(scenarios.begin(), scenarios.end(), [](const Scenario& a, const Scenario& b) {
+        return scenarioOrder(a) < scenarioOrder(b);
+    });
+    return scenarios;
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+// Accumulates per-request measurements for one scenario
+class Sampler {
+public:
+    explicit Sampler(Result& result) : _result(result) {}
+
+    void begin() {
+        HostClock::resetDelayed();
+        _logStart = USBSerial.bytesWritten();
+        HostHeap::resetWindow();
+        _heapStart = HostHeap::snapshot().current;
+        _start = std::chrono::steady_clock::now();
+    }
+
+    void end() {
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        HostHeap::Snapshot heap = HostHeap::snapshot();
+
+        double us = std::chrono::duration<double, std::micro>(elapsed).count();
+        _latencies.push_back(us);
+        _totalUs += us;
+        _delayedUs += HostClock::delayedUs();
+        _logBytes += USBSerial.bytesWritten() - _logStart;
+        _allocs += heap.allocations;
+        _largeAllocs += heap.largeAllocations;
+        _result.peakHeap = std::max<int64_t>(_result.peakHeap, heap.peak - _heapStart);
+        _result.largestAlloc = std::max(_result.largestAlloc, heap.largest);
+    }
+
+    void finish() {
+        uint32_t n = (uint32_t)_latencies.size();
+        _result.iterations = n;
+        if (n == 0) return;
+
+        std::sort(_latencies.begin(), _latencies.end());
+        _result.p50Us = percentile(_latencies, 0.50);
+        _result.p90Us = percentile(_latencies, 0.90);
+        _result.p99Us = percentile(_latencies, 0.99);
+        _result.maxUs = _latencies.back();
+        _result.rps = _totalUs > 0 ? n * 1e6 / _totalUs : 0;
+        _result.delayMsPerRequest = _delayedUs / 1000.0 / n;
+        _result.logBytesPerRequest = (double)_logBytes / n;
+        _result.allocsPerRequest = (double)_allocs / n;
+        _result.largeAllocsPerRequest = (double)_largeAllocs / n;
+        if (_largeAllocs > 0) _result.flags.insert("large_alloc");
+    }
+
+private:
+    Result& _result;
+    std::vector<double> _latencies;
+    std::chrono::steady_clock::time_point _start;
+    int64_t _heapStart = 0;
+    uint64_t _logStart = 0;
+    double _totalUs = 0;
+    uint64_t _delayedUs = 0;
+    uint64_t _logBytes = 0;
+    uint64_t _allocs = 0;
+    uint64_t _largeAllocs = 0;
+};
+
+Result runHttpScenario(AsyncWebServer& server, const Scenario& s, const Options& options) {
+    Result result;
+    result.name = s.name;
+    result.kind = "http";
+
+    Sampler sampler(result);
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        sampler.begin();
+        HostRequestResult r = server.hostRequest(s.method, s.url, (const uint8_t*)s.body.data(), s.body.size(),
+                                                 options.chunkSize);
+        sampler.end();
+
+        result.handlerUri = r.handlerUri;
+        result.code = r.code;
+        result.responseBytes = r.responseBytes;
+        if (!r.matched) result.flags.insert("unmatched");
+        if (r.code == 0) result.flags.insert("no_response");
+        if (r.code >= 500) result.flags.insert("server_error");
+        if (r.sendCount > 1) result.flags.insert("double_send");
+        if (r.unsentResponses > 0) result.flags.insert("leaked_response");
+    }
+    if (result.handlerUri.length() > 0 && result.handlerUri != s.handlerUri) result.flags.insert("shadowed");
+    sampler.finish();
+    return result;
+}
+
+// Let WiFiManager flush queues and the stand-in TCP layer acknowledge everything
+void pumpWebSocket(AsyncWebSocket& ws) {
+    WiFiManager::update();
+    ws.hostDrain();
+}
+
+std::vector<Result> runWebSocketScenarios(AsyncWebSocket& ws, const Options& options) {
+    static const char* COMMANDS[] = {
+        "{\"command\":\"get_all_configs\"}",
+        "{\"command\":\"update_led\",\"index\":0,\"r\":255,\"g\":0,\"b\":0}",
+        "{\"command\":\"save_config\"}",
+        "{\"command\":\"assign_macro\",\"buttonId\":\"button-1\",\"macroId\":\"test_macro\"}",
+        "{\"command\":\"subscribe_metrics\"}",
+        "{\"command\":\"unsubscribe_metrics\"}",
+        "{\"command\":\"subscribe_input\"}",
+        "{\"command\":\"unsubscribe_input\"}",
+    };
+    const int CLIENTS = 4;
+
+    std::vector<Result> results;
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < CLIENTS; i++) ids.push_back(ws.hostConnect()->id());
+    pumpWebSocket(ws);
+
+    for (const char* command : COMMANDS) {
+        Result result;
+        result.kind = "ws";
+        result.handlerUri = "/ws";
+
+        DynamicJsonDocument doc(256);
+        deserializeJson(doc, command);
+        result.name = String("WS ") + doc["command"].as<const char*>();
+
+        String message = command;
+        Sampler sampler(result);
+        for (uint32_t i = 0; i < options.iterations; i++) {
+            uint32_t id = ids[i % ids.size()];
+            sampler.begin();
+            ws.hostReceive(id, message);
+            WebSocketSendQueue::process(ws);
+            sampler.end();
+            ws.hostDrain();
+        }
+        sampler.finish();
+        results.push_back(result);
+    }
+
+    // One status + metrics broadcast round with every client subscribed
+    {
+        Result result;
+        result.kind = "ws";
+        result.handlerUri = "/ws";
+        result.name = "WS broadcast";
+        for (uint32_t id : ids) WebSocketSendQueue::subscribe(id, WS_TOPIC_METRICS);
+
+        Sampler sampler(result);
+        for (uint32_t i = 0; i < options.iterations; i++) {
+            HostClock::advance(5001);
+            sampler.begin();
+            WiFiManager::update();
+            sampler.end();
+            ws.hostDrain();
+        }
+        sampler.finish();
+        for (uint32_t id : ids) WebSocketSendQueue::unsubscribe(id, WS_TOPIC_METRICS);
+        results.push_back(result);
+    }
+
+    for (uint32_t id : ids) ws.hostDisconnect(id);
+    return results;
+}
+
+// Push an image to /api/firmware/upload as a raw body and as a multipart
+// form, plus the rejections. The image must stream through: a request whose
+// heap peak approaches the image size is flagged as buffering it.
+std::vector<Result> runUploadScenarios(AsyncWebServer& server, AsyncWebSocket& ws, const Options& options) {
+    std::vector<Result> results;
+    std::ifstream in(options.uploadFile, std::ios::binary);
+    std::string image((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (image.empty()) {
+        fprintf(stderr, "Cannot read %s\n", options.uploadFile.c_str());
+        return results;
+    }
+
+    SHA256Hasher hasher;
+    hasher.begin();
+    hasher.add((const uint8_t*)image.data(), image.size());
+    hasher.calculate();
+    String digest = hasher.toString();
+
+    const std::string boundary = "----macropad-upload";
+    std::string form = "--" + boundary + "\r\n"
+                       "Content-Disposition: form-data; name=\"firmware\"; filename=\"firmware.bin\"\r\n"
+                       "Content-Type: application/octet-stream\r\n\r\n" +
+                       image + "\r\n--" + boundary + "--\r\n";
+
+    struct UploadCase {
+        const char* name;
+        String query;
+        const std::string* body;
+        String contentType;
+        int expected;
+    };
+    const UploadCase CASES[] = {
+        { "UPLOAD raw", "?sha256=" + digest, &image, "application/octet-stream", 200 },
+        { "UPLOAD multipart", "?sha256=" + digest, &form, "multipart/form-data; boundary=" + String(boundary.c_str()), 200 },
+        { "UPLOAD wrong digest", "?sha256=" + String(std::string(64, '0').c_str()), &image, "application/octet-stream", 400 },
+        { "UPLOAD no digest", "", &image, "application/octet-stream", 400 },
+    };
+
+    // Progress goes to clients subscribed to the firmware topic
+    uint32_t watcher = ws.hostConnect()->id();
+    ws.hostReceive(watcher, "{\"command\":\"subscribe_firmware\"}");
+    pumpWebSocket(ws);
+
+    uint32_t iterations = std::min<uint32_t>(options.iterations, 10);
+    for (const UploadCase& c : CASES) {
+        Result result;
+        result.name = c.name;
+        result.kind = "upload";
+        uint32_t messagesBefore = ws.client(watcher)->hostMessages();
+
+        Sampler sampler(result);
+        for (uint32_t i = 0; i < iterations; i++) {
+            sampler.begin();
+            HostRequestResult r = server.hostRequest(HTTP_POST, "/api/firmware/upload" + c.query,
+                                                     (const uint8_t*)c.body->data(), c.body->size(),
+                                                     options.chunkSize, c.contentType);
+            sampler.end();
+            WebSocketSendQueue::process(ws);
+            ws.hostDrain();
+
+            result.handlerUri = r.handlerUri;
+            result.code = r.code;
+            result.responseBytes = r.responseBytes;
+            if (r.code != c.expected) result.flags.insert("unexpected_code");
+            if (r.sendCount > 1) result.flags.insert("double_send");
+        }
+        sampler.finish();
+
+        if (result.peakHeap >= (int64_t)image.size() / 2) result.flags.insert("buffered_image");
+        if (c.expected == 200 && ws.client(watcher)->hostMessages() == messagesBefore) {
+            result.flags.insert("no_progress");
+        }
+        results.push_back(result);
+    }
+
+    ws.hostDisconnect(watcher);
+    return results;
+}
+
+// A client that stops acknowledging must be bounded, degraded, then dropped
+// without holding up a healthy client
+Result runStalledClientScenario(AsyncWebSocket& ws) {
+    Result result;
+    result.kind = "ws";
+    result.handlerUri = "/ws";
+    result.name = "WS stalled client";
+
+    uint32_t healthy = ws.hostConnect()->id();
+    AsyncWebSocketClient* stalledClient = ws.hostConnect();
+    uint32_t stalled = stalledClient->id();
+    stalledClient->hostSetStalled(true);
+    pumpWebSocket(ws);
+
+    uint32_t dropsBefore = WebSocketSendQueue::getTotalDrops();
+    uint32_t healthyBefore = ws.client(healthy)->hostMessages();
+    size_t peakDepth = 0;
+
+    Sampler sampler(result);
+    for (int step = 0; step < 60; step++) {
+        sampler.begin();
+        WebSocketSendQueue::broadcast("{\"type\":\"status\",\"step\":" + String(step) + "}", nullptr);
+        WebSocketSendQueue::broadcast("{\"type\":\"status\"}", "status");
+        pumpWebSocket(ws);
+        sampler.end();
+        peakDepth = std::max(peakDepth, WebSocketSendQueue::getTotalQueueDepth());
+        HostClock::advance(250);
+    }
+    sampler.finish();
+
+    bool droppedStalled = ws.client(stalled) == nullptr;
+    AsyncWebSocketClient* healthyClient = ws.client(healthy);
+    bool healthyServed = healthyClient != nullptr && healthyClient->hostMessages() - healthyBefore >= 60;
+
+    result.code = droppedStalled ? 200 : 0;
+    result.responseBytes = peakDepth;
+    if (!droppedStalled) result.flags.insert("stalled_not_dropped");
+    if (!healthyServed) result.flags.insert("healthy_starved");
+    if (WebSocketSendQueue::getTotalDrops() == dropsBefore) result.flags.insert("no_drops_counted");
+
+    printf("  stalled client: peak queue depth %zu, dropped=%s, healthy served=%s\n",
+           peakDepth, droppedStalled ? "yes" : "no", healthyServed ? "yes" : "no");
+
+    ws.hostDisconnect(healthy);
+    if (!droppedStalled) ws.hostDisconnect(stalled);
+    return result;
+}
+
+void addResult(JsonArray array, const Result& r) {
+    JsonObject obj = array.createNestedObject();
+    obj["name"] = r.name;
+    obj["kind"] = r.kind;
+    obj["handler"] = r.handlerUri;
+    obj["code"] = r.code;
+    obj["iterations"] = r.iterations;
+    obj["rps"] = r.rps;
+    obj["p50_us"] = r.p50Us;
+    obj["p90_us"] = r.p90Us;
+    obj["p99_us"] = r.p99Us;
+    obj["max_us"] = r.maxUs;
+    obj["delay_ms"] = r.delayMsPerRequest;
+    obj["peak_heap"] = r.peakHeap;
+    obj["largest_alloc"] = r.largestAlloc;
+    obj["allocs_per_request"] = r.allocsPerRequest;
+    obj["large_allocs_per_request"] = r.largeAllocsPerRequest;
+    obj["log_bytes_per_request"] = r.logBytesPerRequest;
+    obj["response_bytes"] = r.responseBytes;
+    JsonArray flags = obj.createNestedArray("flags");
+    for (const std::string& flag : r.flags) flags.add(flag);
+}
+
+bool writeResults(const Options& options, const std::vector<Result>& results) {
+    DynamicJsonDocument doc(64 * 1024 + results.size() * 1024);
+    doc["iterations"] = options.iterations;
+    doc["chunk_size"] = options.chunkSize;
+    doc["large_threshold"] = options.largeThreshold;
+    doc["heap_tracking"] = HostHeap::available();
+    JsonArray array = doc.createNestedArray("results");
+    for (const Result& r : results) addResult(array, r);
+
+    std::string json;
+    serializeJsonPretty(doc, json);
+    std::ofstream out(options.outFile, std::ios::binary);
+    out << json;
+    return (bool)out;
+}
+
+// Compare with a previous results file; returns the number of regressions
+int compareWithBaseline(const Options& options, const std::vector<Result>& results) {
+    std::string json = readHostFile(options.baselineFile);
+    if (json.empty()) {
+        fprintf(stderr, "Baseline %s not found\n", options.baselineFile.c_str());
+        return 0;
+    }
+
+    DynamicJsonDocument doc(json.size() * 2 + 16 * 1024);
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        fprintf(stderr, "Baseline %s: %s\n", options.baselineFile.c_str(), error.c_str());
+        return 0;
+    }
+
+    int regressions = 0;
+    for (JsonObject base : doc["results"].as<JsonArray>()) {
+        String name = base["name"].as<String>();
+        auto current = std::find_if(results.begin(), results.end(), [&](const Result& r) { return r.name == name; });
+        if (current == results.end()) continue;
+
+        double baseP99 = base["p99_us"] | 0.0;
+        double baseRps = base["rps"] | 0.0;
+        int64_t basePeak = base["peak_heap"] | (int64_t)0;
+        double baseLarge = base["large_allocs_per_request"] | 0.0;
+
+        std::vector<std::string> reasons;
+        if (baseP99 > 0 && current->p99Us > baseP99 * P99_REGRESSION) reasons.push_back("p99");
+        if (baseRps > 0 && current->rps < baseRps * RPS_REGRESSION) reasons.push_back("rps");
+        if (basePeak > 0 && current->peakHeap > basePeak * PEAK_REGRESSION) reasons.push_back("peak_heap");
+        if (current->largeAllocsPerRequest > baseLarge) reasons.push_back("large_alloc");
+
+        if (!reasons.empty()) {
+            regressions++;
+            printf("REGRESSION %-50s", name.c_str());
+            for (const std::string& reason : reasons) printf(" %s", reason.c_str());
+            printf("  (p99 %.0f -> %.0f us, peak %lld -> %lld B, rps %.0f -> %.0f)\n",
+                   baseP99, current->p99Us, (long long)basePeak, (long long)current->peakHeap,
+                   baseRps, current->rps);
+        }
+    }
+    return regressions;
+}
+
+void printTable(const std::vector<Result>& results) {
+    printf("\n%-52s %5s %9s %9s %9s %9s %9s %8s %5s  %s\n",
+           "endpoint", "code", "req/s", "p50 us", "p99 us", "delay ms", "peak B", "largest", "log", "flags");
+    for (const Result& r : results) {
+        std::string flags;
+        for (const std::string& flag : r.flags) flags += flag + " ";
+        printf("%-52.52s %5d %9.0f %9.1f %9.1f %9.1f %9lld %8zu %5.0f  %s\n",
+               r.name.c_str(), r.code, r.rps, r.p50Us, r.p99Us, r.delayMsPerRequest,
+               (long long)r.peakHeap, r.largestAlloc, r.logBytesPerRequest, flags.c_str());
+    }
+}
+
+// Work on a scratch copy so POST/DELETE routes cannot modify the source tree
+std::string prepareFilesystem(const std::string& dataDir) {
+    char tmpl[] = "/tmp/macropad-fs-XXXXXX";
+    const char* dir = mkdtemp(tmpl);
+    if (dir == nullptr) return std::string();
+
+    std::error_code ec;
+    stdfs::copy(dataDir, dir, stdfs::copy_options::recursive, ec);
+    if (ec) {
+        fprintf(stderr, "Copying %s failed: %s\n", dataDir.c_str(), ec.message().c_str());
+        return std::string();
+    }
+    return dir;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 2;
+
+    std::string root = prepareFilesystem(options.dataDir);
+    if (root.empty()) return 2;
+
+    USBSerial.setEcho(options.echoLog);
+    HostClock::setRealDelays(options.realDelays);
+    HostHeap::setLargeThreshold(options.largeThreshold);
+
+    LittleFS.setRoot(root.c_str());
+    if (!LittleFS.begin(true)) {
+        fprintf(stderr, "No filesystem at %s\n", root.c_str());
+        return 2;
+    }
+
+    // Bring up the handlers the routes depend on, as setup() does on the device
+    PersistenceService::begin();
+    std::vector<Component> components = ConfigManager::loadComponents("/config/components.json");
+    uint8_t rowPins[5] = { 0 };
+    uint8_t colPins[5] = { 0 };
+    keyHandler = new KeyHandler(5, 5, components, rowPins, colPins);
+    keyHandler->loadKeyConfiguration(ConfigManager::loadActions("/config/actions.json"));
+    hidHandler = new HIDHandler();
+    initializeLED();
+    initializeMacroHandler();
+
+    WiFiManager::begin();
+
+    if (AsyncWebServer::hostInstances().empty() || AsyncWebSocket::hostInstances().empty()) {
+        fprintf(stderr, "WiFiManager did not create a server\n");
+        return 2;
+    }
+    AsyncWebServer& server = *AsyncWebServer::hostInstances().front();
+    AsyncWebSocket& ws = *AsyncWebSocket::hostInstances().front();
+
+    if (!HostHeap::available()) {
+        printf("Heap tracking unavailable on this platform; memory columns are zero\n");
+    }
+
+    std::vector<Scenario> scenarios = buildScenarios(server);
+    printf("Running %zu HTTP scenarios x %u iterations (fs: %s)\n", scenarios.size(), options.iterations,
+           root.c_str());
+
+    std::vector<Result> results;
+    for (const Scenario& s : scenarios) {
+        results.push_back(runHttpScenario(server, s, options));
+    }
+    for (const Result& r : runWebSocketScenarios(ws, options)) {
+        results.push_back(r);
+    }
+    results.push_back(runStalledClientScenario(ws));
+    if (!options.uploadFile.empty()) {
+        for (const Result& r : runUploadScenarios(server, ws, options)) {
+            results.push_back(r);
+        }
+    }
+
+    printTable(results);
+
+    if (ESP.restartCount() > 0) {
+        printf("\n%u restart request(s) were recorded and ignored\n", ESP.restartCount());
+    }
+
+    if (!writeResults(options, results)) {
+        fprintf(stderr, "Writing %s failed\n", options.outFile.c_str());
+    } else {
+        printf("Results written to %s\n", options.outFile.c_str());
+    }
+
+    int regressions = 0;
+    if (!options.baselineFile.empty()) {
+        regressions = compareWithBaseline(options, results);
+        printf("%d regression(s) against %s\n", regressions, options.baselineFile.c_str());
+    }
+
+    std::error_code ec;
+    stdfs::remove_all(root, ec);
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,716 @@
+// ConfigBench.cpp
+//
+// Times the config pipeline on the host: ConfigManager::loadActions,
+// loadComponents and loadDisplayModes, MacroHandler::loadMacros (one file
+// read, deserializeJson and parseMacroFromJson per macro) and
+// updateLEDConfigFromJson. Each parser runs on the shipped data/config and
+// data/macros files and on a generated corpus built from them: many action
+// layers, a long component list, many display modes, several LED layers and
+// hundreds of macros. Every scenario checks what was parsed against the input
+// and records parse time, throughput, peak heap and allocations. Results are
+// written as JSON and can be compared with a previous run; the exit code is 1
+// on a failed check or a regression.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include <USBHIDMouse.h>
+#include "HostHeap.h"
+#include "ConfigManager.h"
+#include "HIDHandler.h"
+#include "MacroHandler.h"
+#include "LEDHandler.h"
+#include "PersistenceService.h"
+#include "MetricsRegistry.h"
+#include "TaskManager.h"
+#include "BinaryLog.h"
+#include <stdarg.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+// Globals normally defined in main.cpp
+USBCDC USBSerial;
+USBHIDMouse Mouse;
+
+void createWorkingActionsFile() {
+    File src = LittleFS.open("/config/defaults/actions.json", "r");
+    if (!src) return;
+    File dst = LittleFS.open("/config/actions.json", "w");
+    if (dst) {
+        uint8_t buf[512];
+        size_t n;
+        while ((n = src.read(buf, sizeof(buf))) > 0) {
+            dst.write(buf, n);
+        }
+        dst.close();
+    }
+    src.close();
+}
+
+namespace {
+
+// Regression thresholds against --baseline
+const double P99_REGRESSION = 1.25;    // p99 latency up by more than 25%
+const double PEAK_REGRESSION = 1.10;   // Peak heap up by more than 10%
+const double ALLOC_REGRESSION = 1.10;  // Allocations per iteration up by more than 10%
+
+// A full LED layer repeats every LED, so a few layers already make an
+// upload several times the shipped file
+const uint32_t GENERATED_LED_LAYERS = 4;
+
+// Where the generated corpus is written, inside the scratch filesystem
+const char* const GENERATED_DIR = "/bench";
+
+// Failure messages kept per scenario
+const size_t MAX_MESSAGES = 5;
+
+struct Options {
+    std::string dataDir = "data";
+    std::string outFile = "host_config_results.json";
+    std::string baselineFile;
+    uint32_t iterations = 50;
+    uint32_t scale = 16;         // Copies of each layer, component and display mode
+    uint32_t macros = 300;       // Generated macros on top of the shipped ones
+    bool echoLog = false;
+};
+
+struct Result {
+    std::string name;
+    size_t inputBytes = 0;
+    size_t entries = 0;          // What the parser produced per iteration
+    uint32_t iterations = 0;
+    double p50Us = 0, p90Us = 0, p99Us = 0, maxUs = 0;
+    double mbPerSecond = 0;      // inputBytes at the p50 time
+    double peakBytes = 0;        // Highest heap above the level before a call
+    double allocsPerIteration = 0;
+    double retainedPerIteration = 0;  // Heap still held after a call returns
+    uint32_t failures = 0;
+    std::vector<std::string> messages;
+};
+
+// One input of a scenario and what parsing it must produce
+struct Corpus {
+    std::string path;            // LittleFS path, or the macros directory
+    size_t bytes = 0;
+    size_t expected = 0;
+};
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "%s needs a value\n", name);
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--data") {
+            const char* v = next("--data");
+            if (v == nullptr) return false;
+            options.dataDir = v;
+        } else if (arg == "--out") {
+            const char* v = next("--out");
+            if (v == nullptr) return false;
+            options.outFile = v;
+        } else if (arg == "--baseline") {
+            const char* v = next("--baseline");
+            if (v == nullptr) return false;
+            options.baselineFile = v;
+        } else if (arg == "--iterations") {
+            const char* v = next("--iterations");
+            if (v == nullptr) return false;
+            options.iterations = std::max(1, atoi(v));
+        } else if (arg == "--scale") {
+            const char* v = next("--scale");
+            if (v == nullptr) return false;
+            options.scale = std::max(1, atoi(v));
+        } else if (arg == "--macros") {
+            const char* v = next("--macros");
+            if (v == nullptr) return false;
+            options.macros = std::max(0, atoi(v));
+        } else if (arg == "--log") {
+            options.echoLog = true;
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--data DIR] [--iterations N] [--scale N] [--macros N]\n"
+                    "       [--baseline FILE] [--out FILE] [--log]\n",
+                    argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string readHostFile(const stdfs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Write a document into the scratch filesystem; returns its size, 0 on error
+size_t writeScratchFile(const char* path, const JsonDocument& doc) {
+    std::string json;
+    serializeJson(doc, json);
+    std::ofstream out(LittleFS.hostPath(path), std::ios::binary);
+    out << json;
+    return out ? json.size() : 0;
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void fail(Result& result, const char* format, ...) {
+    result.failures++;
+    if (result.messages.size() >= MAX_MESSAGES) return;
+
+    char message[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    result.messages.push_back(message);
+}
+
+// Run parse() for every iteration, timing each call and watching the heap
+// around it. parse() returns the number of entries it produced, which must
+// be corpus.expected every time.
+Result measure(const Options& options, const std::string& name, const Corpus& corpus,
+               const std::function<size_t()>& parse) {
+    Result result;
+    result.name = name;
+    result.inputBytes = corpus.bytes;
+
+    std::vector<double> latencies;
+    int64_t peak = 0;
+    uint64_t allocs = 0;
+    int64_t retained = 0;
+
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        int64_t before = HostHeap::snapshot().current;
+        HostHeap::resetWindow();
+        auto start = std::chrono::steady_clock::now();
+        size_t entries = parse();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        HostHeap::Snapshot heap = HostHeap::snapshot();
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+        peak = std::max(peak, heap.peak - before);
+        allocs += heap.allocations;
+        // The first call may fill caches that later calls reuse
+        if (i > 0) retained += heap.current - before;
+
+        result.entries = entries;
+        if (entries != corpus.expected) {
+            fail(result, "iteration %u: %zu entries, expected %zu", i, entries, corpus.expected);
+        }
+        BinaryLog::drain();
+    }
+
+    uint32_t n = (uint32_t)latencies.size();
+    result.iterations = n;
+    std::sort(latencies.begin(), latencies.end());
+    result.p50Us = percentile(latencies, 0.50);
+    result.p90Us = percentile(latencies, 0.90);
+    result.p99Us = percentile(latencies, 0.99);
+    result.maxUs = latencies.back();
+    result.mbPerSecond = result.p50Us > 0 ? corpus.bytes / result.p50Us : 0;
+    result.peakBytes = (double)peak;
+    result.allocsPerIteration = (double)allocs / n;
+    result.retainedPerIteration = n > 1 ? (double)retained / (n - 1) : 0;
+    return result;
+}
+
+// Expected counts, read independently of the parsers under test
+
+// Action map entries loadActions makes from the layers array: one
+// "<layer>:<component>" entry per configured action with a type
+size_t countLayerActions(JsonDocument& doc) {
+    size_t count = 0;
+    for (JsonObjectConst layer : doc["actions"]["layers"].as<JsonArrayConst>()) {
+        for (JsonPairConst entry : layer["layer-config"].as<JsonObjectConst>()) {
+            if (entry.value().containsKey("type")) count++;
+        }
+    }
+    return count;
+}
+
+size_t countLayerEntries(const std::map<String, ActionConfig>& actions) {
+    size_t count = 0;
+    for (const auto& entry : actions) {
+        if (entry.first.indexOf(':') >= 0) count++;
+    }
+    return count;
+}
+
+bool loadHostJson(const char* path, DynamicJsonDocument& doc) {
+    std::string json = readHostFile(LittleFS.hostPath(path));
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t hostFileSize(const char* path) {
+    std::error_code ec;
+    uintmax_t size = stdfs::file_size(LittleFS.hostPath(path), ec);
+    return ec ? 0 : (size_t)size;
+}
+
+// Corpora
+
+bool shippedActions(Corpus& corpus) {
+    corpus.path = "/config/actions.json";
+    DynamicJsonDocument doc(65536);
+    if (!loadHostJson(corpus.path.c_str(), doc)) return false;
+    corpus.bytes = hostFileSize(corpus.path.c_str());
+    corpus.expected = countLayerActions(doc);
+    return true;
+}
+
+// The shipped layers repeated `scale` times under new names; only the
+// first copy keeps its active flag, as a real file has one active layer
+bool generateActions(const Options& options, Corpus& corpus) {
+    DynamicJsonDocument shipped(65536);
+    if (!loadHostJson("/config/actions.json", shipped)) return false;
+
+    DynamicJsonDocument doc(shipped.memoryUsage() * (options.scale + 1) + 65536);
+    JsonArray layers = doc.createNestedObject("actions").createNestedArray("layers");
+    for (uint32_t copy = 0; copy < options.scale; copy++) {
+        for (JsonObjectConst layer : shipped["actions"]["layers"].as<JsonArrayConst>()) {
+            JsonObject out = layers.createNestedObject();
+            out.set(layer);
+            if (copy > 0) {
+                out["layer-name"] = String(layer["layer-name"] | "layer") + "-" + String(copy);
+                out["active"] = false;
+            }
+        }
+    }
+    if (doc.overflowed()) return false;
+
+    corpus.path = std::string(GENERATED_DIR) + "/actions.json";
+    corpus.bytes = writeScratchFile(corpus.path.c_str(), doc);
+    corpus.expected = countLayerActions(doc);
+    return corpus.bytes > 0;
+}
+
+bool shippedComponents(Corpus& corpus) {
+    corpus.path = "/config/components.json";
+    DynamicJsonDocument doc(65536);
+    if (!loadHostJson(corpus.path.c_str(), doc)) return false;
+    corpus.bytes = hostFileSize(corpus.path.c_str());
+    corpus.expected = doc["components"].size();
+    return true;
+}
+
+bool generateComponents(const Options& options, Corpus& corpus) {
+    DynamicJsonDocument shipped(65536);
+    if (!loadHostJson("/config/components.json", shipped)) return false;
+
+    DynamicJsonDocument doc(shipped.memoryUsage() * (options.scale + 1) + 65536);
+    JsonArray components = doc.createNestedArray("components");
+    for (uint32_t copy = 0; copy < options.scale; copy++) {
+        for (JsonObjectConst component : shipped["components"].as<JsonArrayConst>()) {
+            JsonObject out = components.createNestedObject();
+            out.set(component);
+            if (copy > 0) {
+                out["id"] = String(component["id"] | "component") + "-" + String(copy);
+            }
+        }
+    }
+    if (doc.overflowed()) return false;
+
+    corpus.path = std::string(GENERATED_DIR) + "/components.json";
+    corpus.bytes = writeScratchFile(corpus.path.c_str(), doc);
+    corpus.expected = components.size();
+    return corpus.bytes > 0;
+}
+
+bool shippedDisplayModes(Corpus& corpus) {
+    corpus.path = "/config/display.json";
+    DynamicJsonDocument doc(65536);
+    if (!loadHostJson(corpus.path.c_str(), doc)) return false;
+    corpus.bytes = hostFileSize(corpus.path.c_str());
+    corpus.expected = doc["modes"].size();
+    return true;
+}
+
+bool generateDisplayModes(const Options& options, Corpus& corpus) {
+    DynamicJsonDocument shipped(65536);
+    if (!loadHostJson("/config/display.json", shipped)) return false;
+
+    DynamicJsonDocument doc(shipped.memoryUsage() * (options.scale + 1) + 65536);
+    doc["active_mode"] = shipped["active_mode"];
+    JsonObject modes = doc.createNestedObject("modes");
+    for (uint32_t copy = 0; copy < options.scale; copy++) {
+        for (JsonPairConst mode : shipped["modes"].as<JsonObjectConst>()) {
+            String key = mode.key().c_str();
+            if (copy > 0) key += "-" + String(copy);
+            modes[key].set(mode.value());
+        }
+    }
+    if (doc.overflowed()) return false;
+
+    corpus.path = std::string(GENERATED_DIR) + "/display.json";
+    corpus.bytes = writeScratchFile(corpus.path.c_str(), doc);
+    corpus.expected = modes.size();
+    return corpus.bytes > 0;
+}
+
+bool shippedLeds(Corpus& corpus) {
+    corpus.path = "/config/LEDs.json";
+    corpus.bytes = hostFileSize(corpus.path.c_str());
+    corpus.expected = 1;
+    return corpus.bytes > 0;
+}
+
+// The shipped LED config as the layers format the web UI uploads, with the
+// last layer active so the parser walks every layer to find it
+bool generateLeds(Corpus& corpus) {
+    DynamicJsonDocument shipped(65536);
+    if (!loadHostJson("/config/LEDs.json", shipped)) return false;
+
+    JsonObjectConst leds = shipped["leds"];
+    DynamicJsonDocument doc(shipped.memoryUsage() * (GENERATED_LED_LAYERS + 1) + 65536);
+    JsonObject out = doc.createNestedObject("leds");
+    out["brightness"] = leds["brightness"];
+    JsonArray layers = out.createNestedArray("layers");
+    for (uint32_t i = 0; i < GENERATED_LED_LAYERS; i++) {
+        JsonObject layer = layers.createNestedObject();
+        layer["layer-name"] = String("led-layer-") + String(i);
+        layer["active"] = i == GENERATED_LED_LAYERS - 1;
+        layer["layer-config"].set(leds["config"]);
+    }
+    if (doc.overflowed()) return false;
+
+    corpus.path = std::string(GENERATED_DIR) + "/leds.json";
+    corpus.bytes = writeScratchFile(corpus.path.c_str(), doc);
+    corpus.expected = 1;
+    return corpus.bytes > 0;
+}
+
+// Bytes and count of the macro files loadMacros would read
+void describeMacros(Corpus& corpus) {
+    corpus.path = MACRO_DIRECTORY;
+    corpus.bytes = 0;
+    corpus.expected = 0;
+    std::error_code ec;
+    for (const auto& entry : stdfs::directory_iterator(LittleFS.hostPath(MACRO_DIRECTORY), ec)) {
+        std::string file = entry.path().filename().string();
+        if (entry.path().extension() != ".json" || file == "index.json") continue;
+        corpus.bytes += (size_t)entry.file_size(ec);
+    }
+    corpus.expected = macroHandler ? macroHandler->getAvailableMacros().size() : 0;
+}
+
+// Clone the shipped macros into the macros directory until `count` new
+// ones exist, each with its own id
+bool generateMacros(const Options& options) {
+    std::vector<std::string> sources;
+    std::error_code ec;
+    for (const auto& entry : stdfs::directory_iterator(LittleFS.hostPath(MACRO_DIRECTORY), ec)) {
+        std::string file = entry.path().filename().string();
+        if (entry.path().extension() == ".json" && file != "index.json") {
+            sources.push_back(entry.path().string());
+        }
+    }
+    if (sources.empty()) return options.macros == 0;
+    std::sort(sources.begin(), sources.end());
+
+    for (uint32_t i = 0; i < options.macros; i++) {
+        std::string json = readHostFile(sources[i % sources.size()]);
+        DynamicJsonDocument doc(json.size() * 4 + 4096);
+        if (deserializeJson(doc, json)) return false;
+
+        doc["id"] = String(doc["id"] | "macro") + "_" + String(i);
+        char path[64];
+        snprintf(path, sizeof(path), "%s/gen_%04u.json", MACRO_DIRECTORY, i);
+        if (writeScratchFile(path, doc) == 0) return false;
+    }
+    return true;
+}
+
+// Scenarios
+
+Result runActions(const Options& options, const std::string& name, const Corpus& corpus) {
+    return measure(options, name, corpus, [&]() {
+        std::map<String, ActionConfig> actions = ConfigManager::loadActions(corpus.path.c_str());
+        return countLayerEntries(actions);
+    });
+}
+
+Result runComponents(const Options& options, const std::string& name, const Corpus& corpus) {
+    return measure(options, name, corpus, [&]() {
+        return ConfigManager::loadComponents(corpus.path.c_str()).size();
+    });
+}
+
+Result runDisplayModes(const Options& options, const std::string& name, const Corpus& corpus) {
+    return measure(options, name, corpus, [&]() {
+        return ConfigManager::loadDisplayModes(corpus.path.c_str()).size();
+    });
+}
+
+// The upload body is read before the measurement, as the web server hands
+// the handler a complete body
+Result runLeds(const Options& options, const std::string& name, const Corpus& corpus) {
+    std::string body = readHostFile(LittleFS.hostPath(corpus.path.c_str()));
+    String json(body.c_str());
+    return measure(options, name, corpus, [&]() {
+        return (size_t)(updateLEDConfigFromJson(json) ? 1 : 0);
+    });
+}
+
+Result runMacros(const Options& options, const std::string& name, const Corpus& corpus) {
+    return measure(options, name, corpus, [&]() {
+        macroHandler->loadMacros();
+        return macroHandler->getAvailableMacros().size();
+    });
+}
+
+bool runScenarios(const Options& options, std::vector<Result>& results) {
+    std::error_code ec;
+    stdfs::create_directories(LittleFS.hostPath(GENERATED_DIR), ec);
+
+    Corpus actions, bigActions, components, bigComponents, display, bigDisplay, leds, bigLeds;
+    if (!shippedActions(actions) || !generateActions(options, bigActions) ||
+        !shippedComponents(components) || !generateComponents(options, bigComponents) ||
+        !shippedDisplayModes(display) || !generateDisplayModes(options, bigDisplay) ||
+        !shippedLeds(leds) || !generateLeds(bigLeds)) {
+        fprintf(stderr, "Building the corpus failed\n");
+        return false;
+    }
+    if (macroHandler == nullptr) {
+        fprintf(stderr, "No macro handler\n");
+        return false;
+    }
+
+    printf("Running config parsers x %u iterations, generated corpus at scale %u with %u macros\n",
+           options.iterations, options.scale, options.macros);
+
+    results.push_back(runActions(options, "actions/shipped", actions));
+    results.push_back(runActions(options, "actions/generated", bigActions));
+    results.push_back(runComponents(options, "components/shipped", components));
+    results.push_back(runComponents(options, "components/generated", bigComponents));
+    results.push_back(runDisplayModes(options, "display/shipped", display));
+    results.push_back(runDisplayModes(options, "display/generated", bigDisplay));
+    results.push_back(runLeds(options, "leds/shipped", leds));
+    results.push_back(runLeds(options, "leds/generated", bigLeds));
+
+    // The generated macros join the shipped ones in the macros directory,
+    // so the shipped set is measured first
+    Corpus macros;
+    describeMacros(macros);
+    results.push_back(runMacros(options, "macros/shipped", macros));
+
+    size_t shippedCount = macros.expected;
+    if (!generateMacros(options)) {
+        fprintf(stderr, "Generating macros failed\n");
+        return false;
+    }
+    Corpus bigMacros;
+    describeMacros(bigMacros);
+    bigMacros.expected = shippedCount + options.macros;
+    results.push_back(runMacros(options, "macros/generated", bigMacros));
+    return true;
+}
+
+void addResult(JsonArray array, const Result& r) {
+    JsonObject obj = array.createNestedObject();
+    obj["name"] = r.name;
+    obj["input_bytes"] = r.inputBytes;
+    obj["entries"] = r.entries;
+    obj["iterations"] = r.iterations;
+    obj["p50_us"] = r.p50Us;
+    obj["p90_us"] = r.p90Us;
+    obj["p99_us"] = r.p99Us;
+    obj["max_us"] = r.maxUs;
+    obj["mb_per_s"] = r.mbPerSecond;
+    obj["peak_bytes"] = r.peakBytes;
+    obj["allocs_per_iteration"] = r.allocsPerIteration;
+    obj["retained_per_iteration"] = r.retainedPerIteration;
+    obj["failures"] = r.failures;
+    JsonArray messages = obj.createNestedArray("messages");
+    for (const std::string& message : r.messages) messages.add(message);
+}
+
+bool writeResults(const Options& options, const std::vector<Result>& results) {
+    DynamicJsonDocument doc(8 * 1024 + results.size() * 1024);
+    doc["iterations"] = options.iterations;
+    doc["scale"] = options.scale;
+    doc["macros"] = options.macros;
+    doc["heap_tracking"] = HostHeap::available();
+    JsonArray array = doc.createNestedArray("results");
+    for (const Result& r : results) addResult(array, r);
+
+    std::string json;
+    serializeJsonPretty(doc, json);
+    std::ofstream out(options.outFile, std::ios::binary);
+    out << json;
+    return (bool)out;
+}
+
+// Compare with a previous results file; returns the number of regressions.
+// Scenarios whose input size changed (another --scale, edited data) are
+// not comparable and are skipped.
+int compareWithBaseline(const Options& options, const std::vector<Result>& results) {
+    std::string json = readHostFile(options.baselineFile);
+    if (json.empty()) {
+        fprintf(stderr, "Baseline %s not found\n", options.baselineFile.c_str());
+        return 0;
+    }
+
+    DynamicJsonDocument doc(json.size() * 2 + 4096);
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        fprintf(stderr, "Baseline %s: %s\n", options.baselineFile.c_str(), error.c_str());
+        return 0;
+    }
+
+    int regressions = 0;
+    for (JsonObject base : doc["results"].as<JsonArray>()) {
+        std::string name = base["name"].as<std::string>();
+        auto current = std::find_if(results.begin(), results.end(), [&](const Result& r) { return r.name == name; });
+        if (current == results.end()) continue;
+        if ((base["input_bytes"] | (size_t)0) != current->inputBytes) {
+            printf("SKIPPED    %-32s input changed (%zu -> %zu bytes)\n",
+                   name.c_str(), base["input_bytes"] | (size_t)0, current->inputBytes);
+            continue;
+        }
+
+        double baseP99 = base["p99_us"] | 0.0;
+        double basePeak = base["peak_bytes"] | 0.0;
+        double baseAllocs = base["allocs_per_iteration"] | 0.0;
+
+        std::vector<std::string> reasons;
+        if (baseP99 > 0 && current->p99Us > baseP99 * P99_REGRESSION) reasons.push_back("p99");
+        if (basePeak > 0 && current->peakBytes > basePeak * PEAK_REGRESSION) reasons.push_back("peak");
+        if (current->allocsPerIteration > baseAllocs * ALLOC_REGRESSION &&
+            current->allocsPerIteration - baseAllocs >= 1) {
+            reasons.push_back("allocs");
+        }
+
+        if (!reasons.empty()) {
+            regressions++;
+            printf("REGRESSION %-32s", name.c_str());
+            for (const std::string& reason : reasons) printf(" %s", reason.c_str());
+            printf("  (p99 %.1f -> %.1f us, peak %.0f -> %.0f B, allocs %.1f -> %.1f)\n",
+                   baseP99, current->p99Us, basePeak, current->peakBytes,
+                   baseAllocs, current->allocsPerIteration);
+        }
+    }
+    return regressions;
+}
+
+void printTable(const std::vector<Result>& results) {
+    printf("\n%-22s %8s %6s %9s %9s %9s %7s %9s %8s %8s  %s\n",
+           "scenario", "bytes", "count", "p50 us", "p99 us", "max us", "MB/s", "peak KB", "allocs",
+           "kept B", "checks");
+    for (const Result& r : results) {
+        char checks[32];
+        if (r.failures == 0) {
+            snprintf(checks, sizeof(checks), "ok");
+        } else {
+            snprintf(checks, sizeof(checks), "FAILED %u", r.failures);
+        }
+        printf("%-22.22s %8zu %6zu %9.1f %9.1f %9.1f %7.2f %9.1f %8.1f %8.1f  %s\n",
+               r.name.c_str(), r.inputBytes, r.entries, r.p50Us, r.p99Us, r.maxUs, r.mbPerSecond,
+               r.peakBytes / 1024.0, r.allocsPerIteration, r.retainedPerIteration, checks);
+        for (const std::string& message : r.messages) {
+            printf("    %s\n", message.c_str());
+        }
+    }
+}
+
+// Work on a scratch copy so the generated corpus never lands in the tree
+std::string prepareFilesystem(const std::string& dataDir) {
+    char tmpl[] = "/tmp/macropad-fs-XXXXXX";
+    const char* dir = mkdtemp(tmpl);
+    if (dir == nullptr) return std::string();
+
+    std::error_code ec;
+    stdfs::copy(dataDir, dir, stdfs::copy_options::recursive, ec);
+    if (ec) {
+        fprintf(stderr, "Copying %s failed: %s\n", dataDir.c_str(), ec.message().c_str());
+        return std::string();
+    }
+    return dir;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 2;
+
+    std::string root = prepareFilesystem(options.dataDir);
+    if (root.empty()) return 2;
+
+    USBSerial.setEcho(options.echoLog);
+    LittleFS.setRoot(root.c_str());
+    if (!LittleFS.begin(true)) {
+        fprintf(stderr, "No filesystem at %s\n", root.c_str());
+        return 2;
+    }
+
+    // The parsers' dependencies, in the order setup() brings them up
+    BinaryLog::begin();
+    MetricsRegistry::begin();
+    PersistenceService::begin();
+    TaskManager::begin();
+    initializeHIDHandler();
+    initializeLED();
+    initializeMacroHandler();
+
+    if (!HostHeap::available()) {
+        printf("Heap tracking unavailable on this platform; memory columns are zero\n");
+    }
+
+    std::vector<Result> results;
+    if (!runScenarios(options, results)) {
+        std::error_code ec;
+        stdfs::remove_all(root, ec);
+        return 2;
+    }
+
+    printTable(results);
+
+    int failures = 0;
+    for (const Result& r : results) {
+        if (r.failures > 0) failures++;
+    }
+
+    if (!writeResults(options, results)) {
+        fprintf(stderr, "Writing %s failed\n", options.outFile.c_str());
+    } else {
+        printf("Results written to %s\n", options.outFile.c_str());
+    }
+
+    int regressions = 0;
+    if (!options.baselineFile.empty()) {
+        regressions = compareWithBaseline(options, results);
+        printf("%d regression(s) against %s\n", regressions, options.baselineFile.c_str());
+    }
+    printf("%d scenario(s) failed their checks\n", failures);
+
+    std::error_code ec;
+    stdfs::remove_all(root, ec);
+    return (failures > 0 || regressions > 0) ? 1 : 0;
+}
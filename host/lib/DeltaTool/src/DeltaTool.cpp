@@ -0,0 +1,99 @@
+// DeltaTool.cpp
+//
+// Applies a firmware delta patch on the host with the same OTAPatcher and
+// OTAInflater code the device runs. The source is a partition image file
+// standing in for the running slot; the output is what would be flashed.
+// Use it to check a patch from scripts/make_delta.py before publishing it.
+//
+//   delta_apply <source.bin> <patch[.gz]> <out.bin> [expected sha256]
+
+#include <Arduino.h>
+#include "OTAInflater.h"
+#include "OTAPatcher.h"
+#include "SHA256Hasher.h"
+#include <stdio.h>
+
+static FILE* sourceFile = nullptr;
+static FILE* outputFile = nullptr;
+static SHA256Hasher outputHash;
+
+static bool readSource(size_t offset, uint8_t* buffer, size_t length) {
+    return fseek(sourceFile, (long)offset, SEEK_SET) == 0 && fread(buffer, 1, length, sourceFile) == length;
+}
+
+static bool writeOutput(const uint8_t* data, size_t length) {
+    outputHash.add(data, length);
+    return fwrite(data, 1, length, outputFile) == length;
+}
+
+static long fileSize(FILE* file) {
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    return size;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <source.bin> <patch[.gz]> <out.bin> [expected sha256]\n", argv[0]);
+        return 2;
+    }
+
+    String patchPath = argv[2];
+    bool compressed = patchPath.endsWith(".gz");
+    sourceFile = fopen(argv[1], "rb");
+    FILE* patchFile = fopen(argv[2], "rb");
+    outputFile = fopen(argv[3], "wb");
+    if (sourceFile == nullptr || patchFile == nullptr || outputFile == nullptr) {
+        fprintf(stderr, "cannot open input or output file\n");
+        return 2;
+    }
+
+    outputHash.begin();
+    bool ok = OTAPatcher::begin(readSource, (size_t)fileSize(sourceFile), writeOutput);
+    if (ok && compressed) {
+        ok = OTAInflater::begin(OTAPatcher::write);
+    }
+    OTAStreamSink sink = compressed ? OTAInflater::write : OTAPatcher::write;
+
+    // Feed the patch in TCP-segment-sized pieces, as the download loop does
+    uint8_t chunk[1436];
+    size_t patchSize = 0;
+    size_t n;
+    while (ok && (n = fread(chunk, 1, sizeof(chunk), patchFile)) > 0) {
+        patchSize += n;
+        ok = sink(chunk, n);
+    }
+    if (ok && compressed) ok = OTAInflater::finish();
+    if (ok) ok = OTAPatcher::finish();
+
+    String error = OTAPatcher::getLastError();
+    if (compressed && error.isEmpty()) error = OTAInflater::getLastError();
+    size_t outputSize = OTAPatcher::getOutputSize();
+    OTAInflater::end();
+    OTAPatcher::end();
+    fclose(patchFile);
+    fclose(sourceFile);
+    fclose(outputFile);
+
+    if (!ok) {
+        fprintf(stderr, "patch failed: %s%s\n", error.c_str(),
+                OTAPatcher::isSourceMismatch() ? " (device would fall back to the full image)" : "");
+        return 1;
+    }
+
+    outputHash.calculate();
+    printf("%u byte patch -> %u byte image, sha256 %s\n", (unsigned)patchSize, (unsigned)outputSize,
+           outputHash.toString().c_str());
+
+    if (argc > 4) {
+        uint8_t expected[SHA256Hasher::DIGEST_SIZE];
+        if (!SHA256Hasher::parseHex(argv[4], expected) ||
+            memcmp(expected, outputHash.getBytes(), SHA256Hasher::DIGEST_SIZE) != 0) {
+            fprintf(stderr, "SHA-256 mismatch\n");
+            return 1;
+        }
+        printf("SHA-256 verified\n");
+    }
+    return 0;
+}
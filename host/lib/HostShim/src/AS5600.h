@@ -0,0 +1,36 @@
+#ifndef HOST_AS5600_H
+#define HOST_AS5600_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+// Magnetic angle sensor. Every AS5600 answers at the same I2C address, so the
+// host keeps one magnet for all instances; the harness turns it with
+// hostSetRawAngle().
+class AS5600 {
+public:
+    AS5600(TwoWire* wire = &Wire) {}
+
+    bool begin(uint8_t directionPin = 255) { return true; }
+    bool isConnected() { return state().connected; }
+    bool detectMagnet() { return state().connected; }
+    uint16_t rawAngle() { return state().angle; }
+    uint16_t readAngle() { return state().angle; }
+
+    // Host controls
+    static void hostSetRawAngle(uint16_t angle) { state().angle = angle & 0x0FFF; }
+    static void hostSetConnected(bool connected) { state().connected = connected; }
+
+private:
+    struct State {
+        uint16_t angle = 0;
+        bool connected = true;
+    };
+
+    static State& state() {
+        static State s;
+        return s;
+    }
+};
+
+#endif // HOST_AS5600_H
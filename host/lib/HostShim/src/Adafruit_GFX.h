@@ -0,0 +1,8 @@
+#ifndef HOST_ADAFRUIT_GFX_H
+#define HOST_ADAFRUIT_GFX_H
+
+#include "Arduino.h"
+
+class Adafruit_GFX;
+
+#endif // HOST_ADAFRUIT_GFX_H
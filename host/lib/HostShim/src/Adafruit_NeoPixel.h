@@ -0,0 +1,43 @@
+#ifndef HOST_ADAFRUIT_NEOPIXEL_H
+#define HOST_ADAFRUIT_NEOPIXEL_H
+
+#include "Arduino.h"
+#include <vector>
+
+#define NEO_GRB    0x52
+#define NEO_RGB    0x06
+#define NEO_KHZ800 0x0000
+
+// Pixel buffer without a strip behind it; show() only counts frames
+class Adafruit_NeoPixel {
+public:
+    Adafruit_NeoPixel(uint16_t n = 0, int16_t pin = -1, uint16_t type = NEO_GRB + NEO_KHZ800) : _pixels(n, 0) {}
+
+    void begin() {}
+    void show() { _shows++; }
+    void clear() { std::fill(_pixels.begin(), _pixels.end(), 0); }
+    void updateLength(uint16_t n) { _pixels.assign(n, 0); }
+    void setBrightness(uint8_t brightness) { _brightness = brightness; }
+    uint8_t getBrightness() const { return _brightness; }
+    uint16_t numPixels() const { return (uint16_t)_pixels.size(); }
+
+    void setPixelColor(uint16_t n, uint32_t c) {
+        if (n < _pixels.size()) _pixels[n] = c;
+    }
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b) { setPixelColor(n, Color(r, g, b)); }
+    uint32_t getPixelColor(uint16_t n) const { return n < _pixels.size() ? _pixels[n] : 0; }
+
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+        return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+    }
+
+    // Host controls
+    uint32_t shows() const { return _shows; }
+
+private:
+    std::vector<uint32_t> _pixels;
+    uint8_t _brightness = 255;
+    uint32_t _shows = 0;
+};
+
+#endif // HOST_ADAFRUIT_NEOPIXEL_H
@@ -0,0 +1,9 @@
+#ifndef HOST_ADAFRUIT_ST7789_H
+#define HOST_ADAFRUIT_ST7789_H
+
+#include "Adafruit_GFX.h"
+
+// Display code is stubbed on the host; only pointers to the driver appear in headers
+class Adafruit_ST7789;
+
+#endif // HOST_ADAFRUIT_ST7789_H
@@ -0,0 +1,395 @@
+#include "Arduino.h"
+#include "HostClock.h"
+#include "HostHeap.h"
+#include "HostGpio.h"
+#include "Wire.h"
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+// Print
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+        if (write(*buffer++)) {
+            n++;
+        } else {
+            break;
+        }
+    }
+    return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char stackBuf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(stackBuf, sizeof(stackBuf), format, args);
+    va_end(args);
+    if (len < 0) return 0;
+    if ((size_t)len < sizeof(stackBuf)) {
+        return write((const uint8_t*)stackBuf, len);
+    }
+
+    char* heapBuf = (char*)malloc(len + 1);
+    if (heapBuf == nullptr) return 0;
+    va_start(args, format);
+    vsnprintf(heapBuf, len + 1, format, args);
+    va_end(args);
+    size_t n = write((const uint8_t*)heapBuf, len);
+    free(heapBuf);
+    return n;
+}
+
+size_t Print::print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+size_t Print::print(const char* s) { return write(s); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char n, int base) { return print(String(n, (unsigned char)base)); }
+size_t Print::print(int n, int base) { return print(String(n, (unsigned char)base)); }
+size_t Print::print(unsigned int n, int base) { return print(String(n, (unsigned char)base)); }
+size_t Print::print(long n, int base) { return print(String(n, (unsigned char)base)); }
+size_t Print::print(unsigned long n, int base) { return print(String(n, (unsigned char)base)); }
+size_t Print::print(long long n, int base) { return print(String(n, (unsigned char)base)); }
+size_t Print::print(unsigned long long n, int base) { return print(String(n, (unsigned char)base)); }
+size_t Print::print(double n, int digits) { return print(String(n, (unsigned int)digits)); }
+size_t Print::print(const Printable& p) { return p.printTo(*this); }
+
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const String& s) { return print(s) + println(); }
+size_t Print::println(const char* s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char n, int base) { return print(n, base) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(long long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+size_t Print::println(const Printable& p) { return print(p) + println(); }
+
+// Stream
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = read();
+        if (c < 0) break;
+        *buffer++ = (char)c;
+        count++;
+    }
+    return count;
+}
+
+String Stream::readString() {
+    String ret;
+    char buf[128];
+    size_t n;
+    while ((n = readBytes(buf, sizeof(buf))) > 0) {
+        ret.concat(buf, (unsigned int)n);
+    }
+    return ret;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String ret;
+    int c = read();
+    while (c >= 0 && (char)c != terminator) {
+        ret += (char)c;
+        c = read();
+    }
+    return ret;
+}
+
+// IPAddress
+
+bool IPAddress::operator==(const IPAddress& other) const {
+    return memcmp(_bytes, other._bytes, sizeof(_bytes)) == 0;
+}
+
+String IPAddress::toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+    return String(buf);
+}
+
+size_t IPAddress::printTo(Print& p) const {
+    return p.print(toString());
+}
+
+// Time
+
+namespace {
+
+typedef std::chrono::steady_clock HostSteadyClock;
+
+const HostSteadyClock::time_point g_start = HostSteadyClock::now();
+std::atomic<uint64_t> g_offsetUs(0);
+std::atomic<uint64_t> g_delayedUs(0);
+bool g_realDelays = false;
+std::atomic<bool> g_frozen(false);
+
+uint64_t hostElapsedUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(HostSteadyClock::now() - g_start).count();
+}
+
+uint64_t nowUs() {
+    uint64_t offset = g_offsetUs.load(std::memory_order_relaxed);
+    return g_frozen.load(std::memory_order_relaxed) ? offset : hostElapsedUs() + offset;
+}
+
+void sleepUs(uint64_t us) {
+    g_delayedUs.fetch_add(us, std::memory_order_relaxed);
+    if (g_realDelays) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    } else {
+        g_offsetUs.fetch_add(us, std::memory_order_relaxed);
+    }
+}
+
+} // namespace
+
+namespace HostClock {
+
+uint64_t micros64() {
+    return nowUs();
+}
+
+void setRealDelays(bool real) {
+    g_realDelays = real;
+}
+
+uint64_t delayedUs() {
+    return g_delayedUs.load(std::memory_order_relaxed);
+}
+
+void resetDelayed() {
+    g_delayedUs.store(0, std::memory_order_relaxed);
+}
+
+void advance(uint32_t ms) {
+    g_offsetUs.fetch_add((uint64_t)ms * 1000, std::memory_order_relaxed);
+}
+
+void advanceUs(uint64_t us) {
+    g_offsetUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+void setFrozen(bool frozen) {
+    if (frozen == g_frozen.load(std::memory_order_relaxed)) return;
+
+    // Fold host time in or out of the offset so the clock does not jump
+    uint64_t elapsed = hostElapsedUs();
+    if (frozen) {
+        g_offsetUs.fetch_add(elapsed, std::memory_order_relaxed);
+    } else {
+        g_offsetUs.fetch_sub(elapsed, std::memory_order_relaxed);
+    }
+    g_frozen.store(frozen, std::memory_order_relaxed);
+}
+
+} // namespace HostClock
+
+unsigned long millis() {
+    return (unsigned long)(uint32_t)(nowUs() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)(uint32_t)nowUs();
+}
+
+void delay(uint32_t ms) {
+    sleepUs((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    sleepUs(us);
+}
+
+void yield() {
+}
+
+// GPIO
+
+namespace {
+
+uint64_t g_outputs = 0;       // Pins in OUTPUT mode
+uint64_t g_writtenHigh = 0;   // Last level written, whatever the mode
+uint64_t g_inputsLow = 0;     // Inputs held LOW by setInputLevel()
+uint64_t g_switches[HostGpio::PIN_COUNT] = { 0 };
+uint32_t g_gpioReads = 0;
+uint32_t g_gpioWrites = 0;
+
+inline uint64_t pinBit(uint8_t pin) {
+    return pin < HostGpio::PIN_COUNT ? (1ULL << pin) : 0;
+}
+
+} // namespace
+
+namespace HostGpio {
+
+void setSwitch(uint8_t pinA, uint8_t pinB, bool closed) {
+    if (pinA >= PIN_COUNT || pinB >= PIN_COUNT) return;
+    if (closed) {
+        g_switches[pinA] |= pinBit(pinB);
+        g_switches[pinB] |= pinBit(pinA);
+    } else {
+        g_switches[pinA] &= ~pinBit(pinB);
+        g_switches[pinB] &= ~pinBit(pinA);
+    }
+}
+
+void openAllSwitches() {
+    memset(g_switches, 0, sizeof(g_switches));
+}
+
+void setInputLevel(uint8_t pin, uint8_t level) {
+    if (level == LOW) {
+        g_inputsLow |= pinBit(pin);
+    } else {
+        g_inputsLow &= ~pinBit(pin);
+    }
+}
+
+uint32_t reads() {
+    return g_gpioReads;
+}
+
+uint32_t writes() {
+    return g_gpioWrites;
+}
+
+void resetCounters() {
+    g_gpioReads = 0;
+    g_gpioWrites = 0;
+}
+
+} // namespace HostGpio
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (mode == OUTPUT) {
+        g_outputs |= pinBit(pin);
+    } else {
+        g_outputs &= ~pinBit(pin);
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    g_gpioWrites++;
+    if (val == LOW) {
+        g_writtenHigh &= ~pinBit(pin);
+    } else {
+        g_writtenHigh |= pinBit(pin);
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    g_gpioReads++;
+    if (pin >= HostGpio::PIN_COUNT) return HIGH;
+    if (g_outputs & pinBit(pin)) {
+        return (g_writtenHigh & pinBit(pin)) ? HIGH : LOW;
+    }
+    uint64_t drivenLow = g_outputs & ~g_writtenHigh;
+    if ((g_switches[pin] & drivenLow) || (g_inputsLow & pinBit(pin))) {
+        return LOW;
+    }
+    return HIGH;
+}
+
+// I2C bus; the devices on it are modelled by their drivers (see AS5600.h)
+
+TwoWire Wire;
+
+// Random numbers are seeded deterministically so runs are comparable
+
+namespace {
+std::mt19937& rng() {
+    static std::mt19937 engine(0x4d50);
+    return engine;
+}
+} // namespace
+
+long random(long max) {
+    if (max <= 0) return 0;
+    return (long)(rng()() % (unsigned long)max);
+}
+
+long random(long min, long max) {
+    if (min >= max) return min;
+    return min + random(max - min);
+}
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0) rng().seed((std::mt19937::result_type)seed);
+}
+
+// ESP
+
+EspClass ESP;
+
+uint32_t EspClass::getHeapSize() { return (uint32_t)HostHeap::simulatedHeapSize(); }
+uint32_t EspClass::getFreeHeap() { return (uint32_t)HostHeap::simulatedFree(); }
+uint32_t EspClass::getMinFreeHeap() {
+    int64_t free = (int64_t)HostHeap::simulatedHeapSize() - HostHeap::snapshot().peak;
+    return free > 0 ? (uint32_t)free : 0;
+}
+uint32_t EspClass::getMaxAllocHeap() { return (uint32_t)HostHeap::simulatedFree(); }
+uint32_t EspClass::getPsramSize() { return 2 * 1024 * 1024; }
+uint32_t EspClass::getFreePsram() { return 2 * 1024 * 1024; }
+uint64_t EspClass::getEfuseMac() { return 0x0000a1b2c3d4e5f6ULL; }
+const char* EspClass::getSdkVersion() { return "host"; }
+uint32_t EspClass::getCpuFreqMHz() { return 240; }
+
+void EspClass::restart() {
+    _restarts++;
+}
+
+// FreeRTOS
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, param, priority, handle, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* param,
+                                   UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    // Run inline: the task body becomes part of the calling request's cost
+    if (handle != nullptr) *handle = nullptr;
+    fn(param);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    sleepUs((uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t increment) {
+    TickType_t wake = *previousWakeTime + increment;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) > 0) vTaskDelay(wake - now);
+    *previousWakeTime = wake;
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)millis();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+    return 0;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // Single threaded: every caller is the same task
+    static int mainTask;
+    return &mainTask;
+}
+
+BaseType_t xPortGetCoreID() {
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal Arduino-ESP32 surface for building the firmware on Linux.
+// Only what the compiled sources use is provided. Hardware the input
+// handlers touch is modelled (HostGpio, HostHid, Encoder.h, AS5600.h);
+// the rest lives in the handler stubs instead.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+#include "HostFreeRTOS.h"
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+// Time (see HostClock for the virtual delay model)
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// GPIO (see HostGpio for the pin model)
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Chip information backed by the host heap tracker
+class EspClass {
+public:
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getPsramSize();
+    uint32_t getFreePsram();
+    uint64_t getEfuseMac();
+    const char* getSdkVersion();
+    uint32_t getCpuFreqMHz();
+
+    // Restarting is recorded instead of performed
+    void restart();
+    uint32_t restartCount() const { return _restarts; }
+
+private:
+    uint32_t _restarts = 0;
+};
+
+extern EspClass ESP;
+
+#include "HardwareSerial.h"
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,23 @@
+#ifndef HOST_ASYNCTCP_H
+#define HOST_ASYNCTCP_H
+
+#include "Arduino.h"
+
+// Peer of a simulated connection
+class AsyncClient {
+public:
+    explicit AsyncClient(const IPAddress& remote = IPAddress(192, 168, 4, 2), uint16_t port = 50000)
+        : _remoteIP(remote), _remotePort(port) {}
+
+    IPAddress remoteIP() const { return _remoteIP; }
+    uint16_t remotePort() const { return _remotePort; }
+    IPAddress localIP() const { return IPAddress(192, 168, 4, 1); }
+    uint16_t localPort() const { return 80; }
+    bool connected() const { return true; }
+
+private:
+    IPAddress _remoteIP;
+    uint16_t _remotePort;
+};
+
+#endif // HOST_ASYNCTCP_H
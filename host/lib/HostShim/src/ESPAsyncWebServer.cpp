@@ -0,0 +1,706 @@
+#include "ESPAsyncWebServer.h"
+#include <algorithm>
+#ifdef ASYNCWEBSERVER_REGEX
+#include <regex>
+#endif
+
+// Payload bytes per TCP segment (lwIP default MSS)
+static const size_t HOST_TCP_MSS = 1436;
+
+// Responses
+
+AsyncWebServerResponse::AsyncWebServerResponse(int code, const String& contentType, const String& content)
+    : _code(code), _contentType(contentType), _content(content), _contentLength(content.length()) {}
+
+void AsyncWebServerResponse::addHeader(const String& name, const String& value) {
+    _headers.push_back(AsyncWebHeader(name, value));
+}
+
+size_t AsyncWebServerResponse::transmit() {
+    return _contentLength;
+}
+
+AsyncFileResponse::AsyncFileResponse(FS& fs, const String& path, const String& contentType, bool download)
+    : AsyncWebServerResponse(200, contentType, String()) {
+    String resolved = path;
+    if (!download && !fs.exists(resolved) && fs.exists(resolved + ".gz")) {
+        resolved += ".gz";
+        addHeader("Content-Encoding", "gzip");
+    }
+    _file = fs.open(resolved, "r");
+    if (_file && _file.isDirectory()) {
+        _file.close();
+    }
+    _contentLength = _file ? _file.size() : 0;
+    if (_contentType.isEmpty()) {
+        _contentType = "text/plain";
+    }
+}
+
+size_t AsyncFileResponse::transmit() {
+    if (!_file) return 0;
+    uint8_t segment[HOST_TCP_MSS];
+    size_t total = 0;
+    size_t n;
+    while ((n = _file.read(segment, sizeof(segment))) > 0) {
+        total += n;
+    }
+    _file.close();
+    return total;
+}
+
+AsyncChunkedResponse::AsyncChunkedResponse(const String& contentType, AwsResponseFiller filler)
+    : AsyncWebServerResponse(200, contentType, String()), _filler(filler) {}
+
+size_t AsyncChunkedResponse::transmit() {
+    if (!_filler) return 0;
+    // Keep the body for inspection; the library would send each piece as a chunk
+    uint8_t segment[HOST_TCP_MSS];
+    size_t total = 0;
+    size_t n;
+    while ((n = _filler(segment, sizeof(segment), total)) > 0) {
+        _content.concat((const char*)segment, n);
+        total += n;
+    }
+    _contentLength = total;
+    return total;
+}
+
+// Request
+
+AsyncWebServerRequest::AsyncWebServerRequest(AsyncWebServer* server, AsyncClient* client,
+                                             WebRequestMethodComposite method, const String& url,
+                                             const String& query, const String& contentType, size_t contentLength)
+    : _server(server), _client(client), _method(method), _url(url), _host("192.168.4.1"),
+      _contentType(contentType), _contentLength(contentLength) {
+    // Query string parameters, as parsed by the library
+    unsigned int start = 0;
+    while (start < query.length()) {
+        int end = query.indexOf('&', start);
+        if (end < 0) end = query.length();
+        String pair = query.substring(start, end);
+        int eq = pair.indexOf('=');
+        if (pair.length() > 0) {
+            if (eq < 0) {
+                _params.push_back(new AsyncWebParameter(pair, String()));
+            } else {
+                _params.push_back(new AsyncWebParameter(pair.substring(0, eq), pair.substring(eq + 1)));
+            }
+        }
+        start = end + 1;
+    }
+    _headers.push_back(new AsyncWebHeader("Host", _host));
+    if (contentLength > 0) {
+        _headers.push_back(new AsyncWebHeader("Content-Type", contentType));
+        _headers.push_back(new AsyncWebHeader("Content-Length", String((unsigned long)contentLength)));
+    }
+}
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+    if (_onDisconnect) _onDisconnect();
+    for (auto* p : _params) delete p;
+    for (auto* h : _headers) delete h;
+    for (auto* r : _created) delete r;
+}
+
+const char* AsyncWebServerRequest::methodToString() const {
+    switch (_method) {
+        case HTTP_GET: return "GET";
+        case HTTP_POST: return "POST";
+        case HTTP_DELETE: return "DELETE";
+        case HTTP_PUT: return "PUT";
+        case HTTP_PATCH: return "PATCH";
+        case HTTP_HEAD: return "HEAD";
+        case HTTP_OPTIONS: return "OPTIONS";
+        default: return "UNKNOWN";
+    }
+}
+
+bool AsyncWebServerRequest::hasParam(const String& name, bool post, bool file) const {
+    return getParam(name, post, file) != nullptr;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(const String& name, bool post, bool file) const {
+    for (auto* p : _params) {
+        if (p->name() == name && p->isPost() == post && p->isFile() == file) return p;
+    }
+    return nullptr;
+}
+
+AsyncWebParameter* AsyncWebServerRequest::getParam(size_t num) const {
+    return num < _params.size() ? _params[num] : nullptr;
+}
+
+const String& AsyncWebServerRequest::arg(const String& name) const {
+    static const String empty;
+    for (auto* p : _params) {
+        if (p->name() == name) return p->value();
+    }
+    return empty;
+}
+
+bool AsyncWebServerRequest::hasArg(const char* name) const {
+    for (auto* p : _params) {
+        if (p->name() == name) return true;
+    }
+    return false;
+}
+
+const String& AsyncWebServerRequest::pathArg(size_t i) const {
+    static const String empty;
+    return i < _pathParams.size() ? _pathParams[i] : empty;
+}
+
+bool AsyncWebServerRequest::hasHeader(const String& name) const {
+    return getHeader(name) != nullptr;
+}
+
+AsyncWebHeader* AsyncWebServerRequest::getHeader(const String& name) const {
+    for (auto* h : _headers) {
+        if (h->name().equalsIgnoreCase(name)) return h;
+    }
+    return nullptr;
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::track(AsyncWebServerResponse* response) {
+    _created.push_back(response);
+    return response;
+}
+
+uint32_t AsyncWebServerRequest::unsentResponses() const {
+    uint32_t n = 0;
+    for (auto* r : _created) {
+        if (std::find(_sent.begin(), _sent.end(), r) == _sent.end()) n++;
+    }
+    return n;
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse* response) {
+    if (response == nullptr) return;
+    if (std::find(_created.begin(), _created.end(), response) == _created.end()) {
+        track(response);
+    }
+    _sent.push_back(response);
+    _sendCount++;
+    if (!response->sourceValid()) {
+        // The library swaps in a bare 500 when the body source is missing
+        response = track(new AsyncWebServerResponse(500, String(), String()));
+        _sent.push_back(response);
+    }
+    _response = response;
+    _bytesSent += response->transmit();
+}
+
+void AsyncWebServerRequest::send(int code, const String& contentType, const String& content) {
+    send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send(FS& fs, const String& path, const String& contentType, bool download) {
+    send(beginResponse(fs, path, contentType, download));
+}
+
+void AsyncWebServerRequest::redirect(const String& url) {
+    AsyncWebServerResponse* response = beginResponse(302);
+    response->addHeader("Location", url);
+    send(response);
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(int code, const String& contentType,
+                                                             const String& content) {
+    return track(new AsyncWebServerResponse(code, contentType, content));
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginResponse(FS& fs, const String& path, const String& contentType,
+                                                             bool download) {
+    return track(new AsyncFileResponse(fs, path, contentType, download));
+}
+
+AsyncWebServerResponse* AsyncWebServerRequest::beginChunkedResponse(const String& contentType,
+                                                                    AwsResponseFiller callback) {
+    return track(new AsyncChunkedResponse(contentType, callback));
+}
+
+// Callback handler (matching rules from AsyncCallbackWebHandler::canHandle)
+
+void AsyncCallbackWebHandler::setUri(const String& uri) {
+    _uri = uri;
+    _isRegex = uri.startsWith("^") && uri.endsWith("$");
+}
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest* request) {
+    if (!_onRequest) return false;
+    if (!(_method & request->method())) return false;
+
+#ifdef ASYNCWEBSERVER_REGEX
+    if (_isRegex) {
+        std::regex pattern(_uri.c_str());
+        std::smatch matches;
+        std::string s(request->url().c_str());
+        if (std::regex_search(s, matches, pattern)) {
+            for (size_t i = 1; i < matches.size(); ++i) {
+                request->_addPathParam(matches[i].str().c_str());
+            }
+        } else {
+            return false;
+        }
+    } else
+#endif
+    if (_uri.length() && _uri.startsWith("/*.")) {
+        String uriTemplate = _uri.substring(_uri.lastIndexOf("."));
+        if (!request->url().endsWith(uriTemplate)) return false;
+    } else if (_uri.length() && _uri.endsWith("*")) {
+        String uriTemplate = _uri.substring(0, _uri.length() - 1);
+        if (!request->url().startsWith(uriTemplate)) return false;
+    } else if (_uri.length() && (_uri != request->url() && !request->url().startsWith(_uri + "/"))) {
+        return false;
+    }
+    return true;
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest* request) {
+    if (_onRequest) {
+        _onRequest(request);
+    } else {
+        request->send(500);
+    }
+}
+
+void AsyncCallbackWebHandler::handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index,
+                                           uint8_t* data, size_t len, bool final) {
+    if (_onUpload) _onUpload(request, filename, index, data, len, final);
+}
+
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index,
+                                         size_t total) {
+    if (_onBody) _onBody(request, data, len, index, total);
+}
+
+// Static handler (path resolution from AsyncStaticWebHandler)
+
+AsyncStaticWebHandler::AsyncStaticWebHandler(const char* uri, FS& fs, const char* path, const char* cacheControl)
+    : _fs(fs), _uri(uri), _path(path), _defaultFile("index.htm"), _cacheControl(cacheControl) {
+    if (_uri.length() == 0 || _uri[0] != '/') _uri = "/" + _uri;
+    if (_path.length() == 0 || _path[0] != '/') _path = "/" + _path;
+
+    _isDir = _path[_path.length() - 1] == '/';
+
+    if (_uri[_uri.length() - 1] == '/') _uri = _uri.substring(0, _uri.length() - 1);
+    if (_path[_path.length() - 1] == '/') _path = _path.substring(0, _path.length() - 1);
+}
+
+bool AsyncStaticWebHandler::resolve(AsyncWebServerRequest* request, String& resolved) {
+    String path = request->url().substring(_uri.length());
+    bool canSkipFileCheck = (_isDir && path.length() == 0) || (path.length() && path[path.length() - 1] == '/');
+
+    path = _path + path;
+
+    if (!canSkipFileCheck && (_fs.exists(path) || _fs.exists(path + ".gz"))) {
+        File f = _fs.open(path, "r");
+        bool isDir = f && f.isDirectory();
+        if (!isDir) {
+            resolved = path;
+            return true;
+        }
+    }
+
+    if (_defaultFile.length() == 0) return false;
+
+    if (path.length() == 0 || path[path.length() - 1] != '/') path += "/";
+    path += _defaultFile;
+
+    if (_fs.exists(path) || _fs.exists(path + ".gz")) {
+        resolved = path;
+        return true;
+    }
+    return false;
+}
+
+bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest* request) {
+    if (request->method() != HTTP_GET || !request->url().startsWith(_uri)) return false;
+    String resolved;
+    return resolve(request, resolved);
+}
+
+void AsyncStaticWebHandler::handleRequest(AsyncWebServerRequest* request) {
+    String resolved;
+    if (!resolve(request, resolved)) {
+        request->send(404);
+        return;
+    }
+    AsyncWebServerResponse* response = request->beginResponse(_fs, resolved, String());
+    if (_cacheControl.length()) {
+        response->addHeader("Cache-Control", _cacheControl);
+    }
+    request->send(response);
+}
+
+// Server
+
+std::vector<AsyncWebServer*>& AsyncWebServer::hostInstances() {
+    static std::vector<AsyncWebServer*> instances;
+    return instances;
+}
+
+AsyncWebServer::AsyncWebServer(uint16_t port) : _port(port), _catchAllHandler(new AsyncCallbackWebHandler()) {
+    hostInstances().push_back(this);
+}
+
+AsyncWebServer::~AsyncWebServer() {
+    reset();
+    delete _catchAllHandler;
+    auto& instances = hostInstances();
+    instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+}
+
+AsyncWebHandler& AsyncWebServer::addHandler(AsyncWebHandler* handler) {
+    _handlers.push_back(handler);
+    return *handler;
+}
+
+bool AsyncWebServer::removeHandler(AsyncWebHandler* handler) {
+    auto it = std::find(_handlers.begin(), _handlers.end(), handler);
+    if (it == _handlers.end()) return false;
+    _handlers.erase(it);
+    return true;
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, ArRequestHandlerFunction onRequest) {
+    return on(uri, HTTP_ANY, onRequest);
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest) {
+    return on(uri, method, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload) {
+    return on(uri, method, onRequest, onUpload, nullptr);
+}
+
+AsyncCallbackWebHandler& AsyncWebServer::on(const char* uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload,
+                                            ArBodyHandlerFunction onBody) {
+    AsyncCallbackWebHandler* handler = new AsyncCallbackWebHandler();
+    handler->setUri(uri);
+    handler->setMethod(method);
+    handler->onRequest(onRequest);
+    handler->onUpload(onUpload);
+    handler->onBody(onBody);
+    addHandler(handler);
+    return *handler;
+}
+
+AsyncStaticWebHandler& AsyncWebServer::serveStatic(const char* uri, FS& fs, const char* path,
+                                                   const char* cacheControl) {
+    AsyncStaticWebHandler* handler = new AsyncStaticWebHandler(uri, fs, path, cacheControl);
+    addHandler(handler);
+    return *handler;
+}
+
+void AsyncWebServer::onNotFound(ArRequestHandlerFunction fn) {
+    _catchAllHandler->onRequest(fn);
+}
+
+void AsyncWebServer::onFileUpload(ArUploadHandlerFunction fn) {
+    _catchAllHandler->onUpload(fn);
+}
+
+void AsyncWebServer::onRequestBody(ArBodyHandlerFunction fn) {
+    _catchAllHandler->onBody(fn);
+}
+
+void AsyncWebServer::reset() {
+    // Handlers owned elsewhere (the WebSocket) are not deleted, as in the library
+    for (auto* h : _handlers) {
+        if (dynamic_cast<AsyncWebSocket*>(h) == nullptr) delete h;
+    }
+    _handlers.clear();
+    _catchAllHandler->onRequest(nullptr);
+    _catchAllHandler->onUpload(nullptr);
+    _catchAllHandler->onBody(nullptr);
+}
+
+AsyncWebHandler* AsyncWebServer::attachHandler(AsyncWebServerRequest* request) {
+    for (auto* h : _handlers) {
+        if (h->filter(request) && h->canHandle(request)) {
+            return h;
+        }
+    }
+    return _catchAllHandler;
+}
+
+// A multipart/form-data part: where its content sits in the body
+struct MultipartPart {
+    String name;
+    String filename;
+    size_t offset;
+    size_t length;
+};
+
+static String dispositionValue(const std::string& headers, const char* key) {
+    std::string needle = std::string(key) + "=\"";
+    size_t start = headers.find(needle);
+    if (start == std::string::npos) return String();
+    start += needle.size();
+    size_t end = headers.find('"', start);
+    return end == std::string::npos ? String() : String(headers.substr(start, end - start).c_str());
+}
+
+// Parsed in place: copying the body would show up in the heap figures
+static std::vector<MultipartPart> parseMultipart(const uint8_t* body, size_t length, const String& contentType) {
+    std::vector<MultipartPart> parts;
+    int b = contentType.indexOf("boundary=");
+    if (b < 0) return parts;
+    std::string delimiter = std::string("\r\n--") + contentType.substring(b + 9).c_str();
+    static const char HEADER_END[] = "\r\n\r\n";
+
+    const char* data = (const char*)body;
+    const char* end = data + length;
+    auto find = [&](const char* from, const char* needle, size_t needleLength) {
+        return std::search(from, end, needle, needle + needleLength);
+    };
+
+    // The first delimiter has no leading CRLF
+    const char* pos = find(data, delimiter.c_str() + 2, delimiter.size() - 2);
+    size_t delimiterLength = delimiter.size() - 2;
+    while (pos != end) {
+        const char* headerStart = pos + delimiterLength;
+        if (end - headerStart >= 2 && headerStart[0] == '-' && headerStart[1] == '-') break;  // Closing delimiter
+        const char* headerEnd = find(headerStart, HEADER_END, 4);
+        if (headerEnd == end) break;
+        const char* next = find(headerEnd + 4, delimiter.c_str(), delimiter.size());
+        if (next == end) break;
+
+        std::string headers(headerStart, headerEnd);
+        MultipartPart part;
+        part.name = dispositionValue(headers, " name");
+        part.filename = dispositionValue(headers, " filename");
+        part.offset = (headerEnd + 4) - data;
+        part.length = next - (headerEnd + 4);
+        parts.push_back(part);
+        pos = next;
+        delimiterLength = delimiter.size();
+    }
+    return parts;
+}
+
+HostRequestResult AsyncWebServer::hostRequest(WebRequestMethodComposite method, const String& urlWithQuery,
+                                              const uint8_t* body, size_t bodyLength, size_t chunkSize,
+                                              const String& contentType) {
+    HostRequestResult result;
+
+    int q = urlWithQuery.indexOf('?');
+    String url = q < 0 ? urlWithQuery : urlWithQuery.substring(0, q);
+    String query = q < 0 ? String() : urlWithQuery.substring(q + 1);
+
+    AsyncWebServerRequest request(this, &_client, method, url, query, contentType, bodyLength);
+    AsyncWebHandler* handler = attachHandler(&request);
+    request._handler = handler;
+    result.matched = handler != _catchAllHandler;
+    result.handlerUri = handler->hostUri();
+
+    if (chunkSize == 0) chunkSize = HOST_TCP_MSS;
+    if (bodyLength > 0 && contentType.startsWith("multipart/form-data")) {
+        // The library parses forms itself: fields become post params and
+        // file fields go to the upload handler, chunk by chunk
+        for (const MultipartPart& part : parseMultipart(body, bodyLength, contentType)) {
+            if (part.filename.isEmpty()) {
+                String value;
+                value.concat((const char*)body + part.offset, part.length);
+                request._params.push_back(new AsyncWebParameter(part.name, value, true));
+                continue;
+            }
+            std::unique_ptr<uint8_t[]> segment(new uint8_t[chunkSize + 1]);
+            size_t index = 0;
+            do {
+                size_t len = std::min(chunkSize, part.length - index);
+                memcpy(segment.get(), body + part.offset + index, len);
+                segment[len] = 0;
+                handler->handleUpload(&request, part.filename, index, segment.get(), len, index + len == part.length);
+                index += len;
+            } while (index < part.length);
+        }
+    } else if (bodyLength > 0) {
+        // Deliver the body the way AsyncTCP does: one callback per segment,
+        // from a receive buffer the handler may scribble past the end of
+        std::unique_ptr<uint8_t[]> segment(new uint8_t[chunkSize + 1]);
+        for (size_t index = 0; index < bodyLength; index += chunkSize) {
+            size_t len = std::min(chunkSize, bodyLength - index);
+            memcpy(segment.get(), body + index, len);
+            segment[len] = 0;
+            handler->handleBody(&request, segment.get(), len, index, bodyLength);
+        }
+    }
+    handler->handleRequest(&request);
+
+    if (request.response() != nullptr) {
+        result.code = request.response()->code();
+        result.contentType = request.response()->contentType();
+    }
+    result.responseBytes = request.bytesSent();
+    result.sendCount = request.sendCount();
+    result.unsentResponses = request.unsentResponses();
+    return result;
+}
+
+// WebSocket
+
+AsyncWebSocketClient::AsyncWebSocketClient(AsyncWebSocket* server, uint32_t id)
+    : _server(server), _id(id), _client(IPAddress(192, 168, 4, (uint8_t)(1 + id % 250)), (uint16_t)(50000 + id)) {}
+
+void AsyncWebSocketClient::close(uint16_t code, const char* message) {
+    if (_status != WS_CONNECTED) return;
+    _status = WS_DISCONNECTING;
+}
+
+void AsyncWebSocketClient::queue(size_t len) {
+    if (_status != WS_CONNECTED) return;
+    if (_inFlight >= WS_MAX_QUEUED_MESSAGES) {
+        // The library logs "Too many messages queued" and drops the message
+        _overflows++;
+        return;
+    }
+    _inFlight++;
+    _messages++;
+    _bytes += len;
+}
+
+void AsyncWebSocketClient::text(const char* message, size_t len) {
+    queue(len);
+}
+
+void AsyncWebSocketClient::binary(const char* message, size_t len) {
+    queue(len);
+}
+
+void AsyncWebSocketClient::hostDrain() {
+    if (!_stalled) _inFlight = 0;
+}
+
+std::vector<AsyncWebSocket*>& AsyncWebSocket::hostInstances() {
+    static std::vector<AsyncWebSocket*> instances;
+    return instances;
+}
+
+AsyncWebSocket::AsyncWebSocket(const String& url) : _url(url) {
+    hostInstances().push_back(this);
+}
+
+AsyncWebSocket::~AsyncWebSocket() {
+    for (auto* c : _clients) delete c;
+    auto& instances = hostInstances();
+    instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+}
+
+bool AsyncWebSocket::availableForWriteAll() {
+    for (auto* c : _clients) {
+        if (c->queueIsFull()) return false;
+    }
+    return true;
+}
+
+bool AsyncWebSocket::availableForWrite(uint32_t id) {
+    AsyncWebSocketClient* c = client(id);
+    return c == nullptr || !c->queueIsFull();
+}
+
+size_t AsyncWebSocket::count() const {
+    size_t n = 0;
+    for (auto* c : _clients) {
+        if (c->status() == WS_CONNECTED) n++;
+    }
+    return n;
+}
+
+AsyncWebSocketClient* AsyncWebSocket::client(uint32_t id) {
+    for (auto* c : _clients) {
+        if (c->id() == id && c->status() == WS_CONNECTED) return c;
+    }
+    return nullptr;
+}
+
+void AsyncWebSocket::close(uint32_t id, uint16_t code, const char* message) {
+    AsyncWebSocketClient* c = client(id);
+    if (c != nullptr) c->close(code, message);
+}
+
+void AsyncWebSocket::closeAll(uint16_t code, const char* message) {
+    for (auto* c : _clients) c->close(code, message);
+}
+
+void AsyncWebSocket::cleanupClients(uint16_t maxClients) {
+    if (count() > maxClients) {
+        for (auto* c : _clients) {
+            if (c->status() == WS_CONNECTED) {
+                c->close();
+                break;
+            }
+        }
+    }
+    finishCloses();
+}
+
+void AsyncWebSocket::text(uint32_t id, const String& message) {
+    AsyncWebSocketClient* c = client(id);
+    if (c != nullptr) c->text(message);
+}
+
+void AsyncWebSocket::textAll(const char* message, size_t len) {
+    for (auto* c : _clients) c->text(message, len);
+}
+
+void AsyncWebSocket::binaryAll(const char* message, size_t len) {
+    for (auto* c : _clients) c->binary(message, len);
+}
+
+AsyncWebSocketClient* AsyncWebSocket::hostConnect() {
+    AsyncWebSocketClient* c = new AsyncWebSocketClient(this, _nextId++);
+    _clients.push_back(c);
+    if (_eventHandler) _eventHandler(this, c, WS_EVT_CONNECT, nullptr, nullptr, 0);
+    return c;
+}
+
+void AsyncWebSocket::hostReceive(uint32_t id, const String& message) {
+    AsyncWebSocketClient* c = client(id);
+    if (c == nullptr || !_eventHandler) return;
+
+    AwsFrameInfo info = {};
+    info.message_opcode = WS_TEXT;
+    info.opcode = WS_TEXT;
+    info.final = 1;
+    info.masked = 1;
+    info.len = message.length();
+    info.index = 0;
+
+    // Handlers NUL-terminate in place, so leave room past the payload
+    std::unique_ptr<uint8_t[]> data(new uint8_t[message.length() + 1]);
+    memcpy(data.get(), message.c_str(), message.length());
+    data[message.length()] = 0;
+    _eventHandler(this, c, WS_EVT_DATA, &info, data.get(), message.length());
+}
+
+void AsyncWebSocket::hostDisconnect(uint32_t id) {
+    for (auto* c : _clients) {
+        if (c->id() == id) c->close();
+    }
+    finishCloses();
+}
+
+void AsyncWebSocket::hostDrain() {
+    for (auto* c : _clients) c->hostDrain();
+    finishCloses();
+}
+
+void AsyncWebSocket::finishCloses() {
+    for (auto it = _clients.begin(); it != _clients.end();) {
+        AsyncWebSocketClient* c = *it;
+        if (c->status() == WS_CONNECTED) {
+            ++it;
+            continue;
+        }
+        if (_eventHandler) _eventHandler(this, c, WS_EVT_DISCONNECT, nullptr, nullptr, 0);
+        it = _clients.erase(it);
+        delete c;
+    }
+}
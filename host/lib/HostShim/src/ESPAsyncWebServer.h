@@ -0,0 +1,499 @@
+#ifndef HOST_ESPASYNCWEBSERVER_H
+#define HOST_ESPASYNCWEBSERVER_H
+
+// Stand-in for me-no-dev/ESPAsyncWebServer. Handler registration, matching
+// order, body chunk delivery and the response API follow the library; the
+// network side is replaced by hostRequest()/hostConnect() entry points the
+// load test drives directly.
+
+#include "Arduino.h"
+#include "AsyncTCP.h"
+#include "FS.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifndef DEFAULT_MAX_WS_CLIENTS
+#define DEFAULT_MAX_WS_CLIENTS 8
+#endif
+#ifndef WS_MAX_QUEUED_MESSAGES
+#define WS_MAX_QUEUED_MESSAGES 32
+#endif
+
+typedef enum {
+    HTTP_GET     = 0b00000001,
+    HTTP_POST    = 0b00000010,
+    HTTP_DELETE  = 0b00000100,
+    HTTP_PUT     = 0b00001000,
+    HTTP_PATCH   = 0b00010000,
+    HTTP_HEAD    = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY     = 0b01111111,
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServer;
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+class AsyncWebHandler;
+class AsyncWebSocket;
+class AsyncWebSocketClient;
+
+typedef std::function<void(AsyncWebServerRequest* request)> ArRequestHandlerFunction;
+typedef std::function<bool(AsyncWebServerRequest* request)> ArRequestFilterFunction;
+typedef std::function<void(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data,
+                           size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total)>
+    ArBodyHandlerFunction;
+typedef std::function<size_t(uint8_t* buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+typedef std::function<void(void)> ArDisconnectHandler;
+
+class AsyncWebParameter {
+public:
+    AsyncWebParameter(const String& name, const String& value, bool form = false, bool file = false, size_t size = 0)
+        : _name(name), _value(value), _size(size), _isForm(form), _isFile(file) {}
+
+    const String& name() const { return _name; }
+    const String& value() const { return _value; }
+    size_t size() const { return _size; }
+    bool isPost() const { return _isForm; }
+    bool isFile() const { return _isFile; }
+
+private:
+    String _name;
+    String _value;
+    size_t _size;
+    bool _isForm;
+    bool _isFile;
+};
+
+class AsyncWebHeader {
+public:
+    AsyncWebHeader(const String& name, const String& value) : _name(name), _value(value) {}
+
+    const String& name() const { return _name; }
+    const String& value() const { return _value; }
+
+private:
+    String _name;
+    String _value;
+};
+
+class AsyncWebServerResponse {
+public:
+    AsyncWebServerResponse(int code, const String& contentType, const String& content);
+    virtual ~AsyncWebServerResponse() {}
+
+    void setCode(int code) { _code = code; }
+    void setContentLength(size_t len) { _contentLength = len; }
+    void setContentType(const String& type) { _contentType = type; }
+    void addHeader(const String& name, const String& value);
+
+    // Host inspection
+    int code() const { return _code; }
+    const String& contentType() const { return _contentType; }
+    size_t contentLength() const { return _contentLength; }
+    const String& content() const { return _content; }
+    const std::vector<AsyncWebHeader>& headers() const { return _headers; }
+    virtual bool sourceValid() const { return true; }
+
+    // Push the body through a send-sized buffer; returns bytes "sent"
+    virtual size_t transmit();
+
+protected:
+    int _code;
+    String _contentType;
+    String _content;
+    size_t _contentLength;
+    std::vector<AsyncWebHeader> _headers;
+};
+
+// Streams a file from the filesystem in TCP-segment sized reads
+class AsyncFileResponse : public AsyncWebServerResponse {
+public:
+    AsyncFileResponse(FS& fs, const String& path, const String& contentType, bool download);
+
+    bool sourceValid() const override { return (bool)_file; }
+    size_t transmit() override;
+
+private:
+    File _file;
+};
+
+// Pulls the body from a filler callback, a segment at a time, until it returns 0
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+public:
+    AsyncChunkedResponse(const String& contentType, AwsResponseFiller filler);
+
+    size_t transmit() override;
+
+private:
+    AwsResponseFiller _filler;
+};
+
+class AsyncWebServerRequest {
+    friend class AsyncWebServer;
+
+public:
+    AsyncWebServerRequest(AsyncWebServer* server, AsyncClient* client, WebRequestMethodComposite method,
+                          const String& url, const String& query, const String& contentType, size_t contentLength);
+    ~AsyncWebServerRequest();
+
+    AsyncClient* client() { return _client; }
+    WebRequestMethodComposite method() const { return _method; }
+    const String& url() const { return _url; }
+    const String& host() const { return _host; }
+    const String& contentType() const { return _contentType; }
+    size_t contentLength() const { return _contentLength; }
+    const char* methodToString() const;
+
+    size_t params() const { return _params.size(); }
+    bool hasParam(const String& name, bool post = false, bool file = false) const;
+    AsyncWebParameter* getParam(const String& name, bool post = false, bool file = false) const;
+    AsyncWebParameter* getParam(size_t num) const;
+    size_t args() const { return params(); }
+    const String& arg(const String& name) const;
+    bool hasArg(const char* name) const;
+    const String& pathArg(size_t i) const;
+
+    size_t headers() const { return _headers.size(); }
+    bool hasHeader(const String& name) const;
+    AsyncWebHeader* getHeader(const String& name) const;
+    void addInterestingHeader(const String& name) {}
+
+    void send(AsyncWebServerResponse* response);
+    void send(int code, const String& contentType = String(), const String& content = String());
+    void send(FS& fs, const String& path, const String& contentType = String(), bool download = false);
+    void redirect(const String& url);
+
+    AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(),
+                                          const String& content = String());
+    AsyncWebServerResponse* beginResponse(FS& fs, const String& path, const String& contentType = String(),
+                                          bool download = false);
+    AsyncWebServerResponse* beginChunkedResponse(const String& contentType, AwsResponseFiller callback);
+
+    // Called when the request is freed, whether it was answered or the
+    // client went away, as in the library
+    void onDisconnect(ArDisconnectHandler fn) { _onDisconnect = fn; }
+
+    void* _tempObject = nullptr;
+
+    // Used by the regex matcher, as in the library
+    void _addPathParam(const char* param) { _pathParams.push_back(String(param)); }
+
+    // Host inspection
+    AsyncWebServerResponse* response() const { return _response; }
+    uint32_t sendCount() const { return _sendCount; }
+    size_t bytesSent() const { return _bytesSent; }
+    uint32_t unsentResponses() const;
+
+private:
+    AsyncWebServerResponse* track(AsyncWebServerResponse* response);
+
+    AsyncWebServer* _server;
+    AsyncClient* _client;
+    WebRequestMethodComposite _method;
+    String _url;
+    String _host;
+    String _contentType;
+    size_t _contentLength;
+    AsyncWebHandler* _handler = nullptr;
+    AsyncWebServerResponse* _response = nullptr;
+    uint32_t _sendCount = 0;
+    size_t _bytesSent = 0;
+    std::vector<AsyncWebParameter*> _params;
+    std::vector<AsyncWebHeader*> _headers;
+    std::vector<String> _pathParams;
+    std::vector<AsyncWebServerResponse*> _created;
+    std::vector<AsyncWebServerResponse*> _sent;
+    ArDisconnectHandler _onDisconnect = nullptr;
+};
+
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+
+    AsyncWebHandler& setFilter(ArRequestFilterFunction fn) {
+        _filter = fn;
+        return *this;
+    }
+    bool filter(AsyncWebServerRequest* request) { return _filter == nullptr || _filter(request); }
+
+    virtual bool canHandle(AsyncWebServerRequest* request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest* request) {}
+    virtual void handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data,
+                              size_t len, bool final) {}
+    virtual void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) {}
+    virtual bool isRequestHandlerTrivial() { return true; }
+
+    // Host route listing
+    virtual const char* hostKind() const { return "handler"; }
+    virtual String hostUri() const { return String(); }
+    virtual WebRequestMethodComposite hostMethods() const { return 0; }
+
+protected:
+    ArRequestFilterFunction _filter = nullptr;
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+    void setUri(const String& uri);
+    void setMethod(WebRequestMethodComposite method) { _method = method; }
+    void onRequest(ArRequestHandlerFunction fn) { _onRequest = fn; }
+    void onUpload(ArUploadHandlerFunction fn) { _onUpload = fn; }
+    void onBody(ArBodyHandlerFunction fn) { _onBody = fn; }
+
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+    void handleUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data,
+                      size_t len, bool final) override;
+    void handleBody(AsyncWebServerRequest* request, uint8_t* data, size_t len, size_t index, size_t total) override;
+    bool isRequestHandlerTrivial() override { return _onRequest ? false : true; }
+
+    const char* hostKind() const override { return _isRegex ? "regex" : "callback"; }
+    String hostUri() const override { return _uri; }
+    WebRequestMethodComposite hostMethods() const override { return _method; }
+    bool hasBodyHandler() const { return (bool)_onBody; }
+
+private:
+    String _uri;
+    WebRequestMethodComposite _method = HTTP_ANY;
+    ArRequestHandlerFunction _onRequest = nullptr;
+    ArUploadHandlerFunction _onUpload = nullptr;
+    ArBodyHandlerFunction _onBody = nullptr;
+    bool _isRegex = false;
+};
+
+class AsyncStaticWebHandler : public AsyncWebHandler {
+public:
+    AsyncStaticWebHandler(const char* uri, FS& fs, const char* path, const char* cacheControl);
+
+    AsyncStaticWebHandler& setIsDir(bool isDir) {
+        _isDir = isDir;
+        return *this;
+    }
+    AsyncStaticWebHandler& setDefaultFile(const char* filename) {
+        _defaultFile = String(filename);
+        return *this;
+    }
+    AsyncStaticWebHandler& setCacheControl(const char* cacheControl) {
+        _cacheControl = String(cacheControl);
+        return *this;
+    }
+
+    bool canHandle(AsyncWebServerRequest* request) override;
+    void handleRequest(AsyncWebServerRequest* request) override;
+
+    const char* hostKind() const override { return "static"; }
+    String hostUri() const override { return _uri + "/"; }
+    WebRequestMethodComposite hostMethods() const override { return HTTP_GET; }
+
+private:
+    bool resolve(AsyncWebServerRequest* request, String& resolved);
+
+    FS& _fs;
+    String _uri;
+    String _path;
+    String _defaultFile;
+    String _cacheControl;
+    bool _isDir;
+};
+
+// Outcome of one simulated request
+struct HostRequestResult {
+    bool matched = false;        // A registered handler (not onNotFound) took the request
+    String handlerUri;           // URI the matching handler was registered with
+    int code = 0;                // 0 when the handler never responded
+    String contentType;
+    size_t responseBytes = 0;
+    uint32_t sendCount = 0;      // More than one is a double send
+    uint32_t unsentResponses = 0; // beginResponse() results that were never sent (leaked on device)
+};
+
+class AsyncWebServer {
+public:
+    explicit AsyncWebServer(uint16_t port);
+    ~AsyncWebServer();
+
+    void begin() { _started = true; }
+    void end() { _started = false; }
+
+    AsyncWebHandler& addHandler(AsyncWebHandler* handler);
+    bool removeHandler(AsyncWebHandler* handler);
+
+    AsyncCallbackWebHandler& on(const char* uri, ArRequestHandlerFunction onRequest);
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload);
+    AsyncCallbackWebHandler& on(const char* uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody);
+
+    AsyncStaticWebHandler& serveStatic(const char* uri, FS& fs, const char* path, const char* cacheControl = NULL);
+
+    void onNotFound(ArRequestHandlerFunction fn);
+    void onFileUpload(ArUploadHandlerFunction fn);
+    void onRequestBody(ArBodyHandlerFunction fn);
+    void reset();
+
+    // Host entry points
+    HostRequestResult hostRequest(WebRequestMethodComposite method, const String& urlWithQuery,
+                                  const uint8_t* body = nullptr, size_t bodyLength = 0, size_t chunkSize = 1436,
+                                  const String& contentType = "application/json");
+    const std::vector<AsyncWebHandler*>& hostHandlers() const { return _handlers; }
+    uint16_t port() const { return _port; }
+    bool started() const { return _started; }
+    static std::vector<AsyncWebServer*>& hostInstances();
+
+private:
+    AsyncWebHandler* attachHandler(AsyncWebServerRequest* request);
+
+    uint16_t _port;
+    bool _started = false;
+    std::vector<AsyncWebHandler*> _handlers;
+    AsyncCallbackWebHandler* _catchAllHandler;
+    AsyncClient _client;
+};
+
+// WebSocket
+
+typedef enum {
+    WS_EVT_CONNECT,
+    WS_EVT_DISCONNECT,
+    WS_EVT_PONG,
+    WS_EVT_ERROR,
+    WS_EVT_DATA
+} AwsEventType;
+
+typedef enum {
+    WS_DISCONNECTED,
+    WS_CONNECTED,
+    WS_DISCONNECTING
+} AwsClientStatus;
+
+typedef enum {
+    WS_CONTINUATION,
+    WS_TEXT,
+    WS_BINARY,
+    WS_DISCONNECT = 0x08,
+    WS_PING,
+    WS_PONG
+} AwsFrameType;
+
+typedef struct {
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+} AwsFrameInfo;
+
+typedef std::function<void(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg,
+                           uint8_t* data, size_t len)> AwsEventHandler;
+
+class AsyncWebSocketClient {
+public:
+    AsyncWebSocketClient(AsyncWebSocket* server, uint32_t id);
+
+    uint32_t id() const { return _id; }
+    AwsClientStatus status() const { return _status; }
+    AsyncClient* client() { return &_client; }
+    AsyncWebSocket* server() { return _server; }
+    IPAddress remoteIP() const { return _client.remoteIP(); }
+    uint16_t remotePort() const { return _client.remotePort(); }
+
+    void close(uint16_t code = 0, const char* message = NULL);
+    void ping(const uint8_t* data = NULL, size_t len = 0) {}
+    void keepAlivePeriod(uint16_t seconds) {}
+
+    // Room in the library's per-client message queue
+    bool canSend() const { return !_stalled && _inFlight < WS_MAX_QUEUED_MESSAGES; }
+    bool queueIsFull() const { return !canSend(); }
+    size_t queueLen() const { return _inFlight; }
+
+    void text(const char* message, size_t len);
+    void text(const char* message) { text(message, strlen(message)); }
+    void text(const uint8_t* message, size_t len) { text((const char*)message, len); }
+    void text(const String& message) { text(message.c_str(), message.length()); }
+    void binary(const char* message, size_t len);
+    void binary(const char* message) { binary(message, strlen(message)); }
+    void binary(const uint8_t* message, size_t len) { binary((const char*)message, len); }
+    void binary(const String& message) { binary(message.c_str(), message.length()); }
+
+    // Host controls: a stalled client stops acknowledging, so its queue fills
+    void hostSetStalled(bool stalled) { _stalled = stalled; }
+    void hostDrain();
+    uint32_t hostMessages() const { return _messages; }
+    uint64_t hostBytes() const { return _bytes; }
+    uint32_t hostOverflows() const { return _overflows; }
+
+private:
+    void queue(size_t len);
+
+    AsyncWebSocket* _server;
+    uint32_t _id;
+    AwsClientStatus _status = WS_CONNECTED;
+    AsyncClient _client;
+    bool _stalled = false;
+    size_t _inFlight = 0;
+    uint32_t _messages = 0;
+    uint64_t _bytes = 0;
+    uint32_t _overflows = 0;
+};
+
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+    explicit AsyncWebSocket(const String& url);
+    ~AsyncWebSocket();
+
+    const char* url() const { return _url.c_str(); }
+    void enable(bool e) { _enabled = e; }
+    bool enabled() const { return _enabled; }
+    bool availableForWriteAll();
+    bool availableForWrite(uint32_t id);
+
+    size_t count() const;
+    AsyncWebSocketClient* client(uint32_t id);
+    bool hasClient(uint32_t id) { return client(id) != nullptr; }
+
+    void close(uint32_t id, uint16_t code = 0, const char* message = NULL);
+    void closeAll(uint16_t code = 0, const char* message = NULL);
+    void cleanupClients(uint16_t maxClients = DEFAULT_MAX_WS_CLIENTS);
+
+    void text(uint32_t id, const String& message);
+    void textAll(const char* message, size_t len);
+    void textAll(const String& message) { textAll(message.c_str(), message.length()); }
+    void binaryAll(const char* message, size_t len);
+    void binaryAll(const uint8_t* message, size_t len) { binaryAll((const char*)message, len); }
+
+    void onEvent(AwsEventHandler handler) { _eventHandler = handler; }
+
+    // WebSocket upgrades are not routed through hostRequest()
+    bool canHandle(AsyncWebServerRequest* request) override { return false; }
+    const char* hostKind() const override { return "websocket"; }
+    String hostUri() const override { return _url; }
+    WebRequestMethodComposite hostMethods() const override { return HTTP_GET; }
+
+    // Host entry points
+    AsyncWebSocketClient* hostConnect();
+    void hostReceive(uint32_t id, const String& message);
+    void hostDisconnect(uint32_t id);
+    // Deliver in-flight messages and finish pending closes
+    void hostDrain();
+    const std::vector<AsyncWebSocketClient*>& hostClients() const { return _clients; }
+    static std::vector<AsyncWebSocket*>& hostInstances();
+
+private:
+    void finishCloses();
+
+    String _url;
+    bool _enabled = true;
+    uint32_t _nextId = 1;
+    std::vector<AsyncWebSocketClient*> _clients;
+    AwsEventHandler _eventHandler = nullptr;
+};
+
+#endif // HOST_ESPASYNCWEBSERVER_H
@@ -0,0 +1,15 @@
+#ifndef HOST_ESPMDNS_H
+#define HOST_ESPMDNS_H
+
+#include "Arduino.h"
+
+class MDNSResponder {
+public:
+    bool begin(const char* hostName) { return true; }
+    void end() {}
+    bool addService(const char* service, const char* proto, uint16_t port) { return true; }
+};
+
+extern MDNSResponder MDNS;
+
+#endif // HOST_ESPMDNS_H
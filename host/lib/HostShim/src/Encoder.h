@@ -0,0 +1,36 @@
+#ifndef HOST_ENCODER_H
+#define HOST_ENCODER_H
+
+#include "Arduino.h"
+
+// Quadrature encoder counter. There are no pin interrupts on the host; the
+// harness sets the count of the encoder wired to a pin with hostTurn().
+class Encoder {
+public:
+    Encoder(uint8_t pinA, uint8_t pinB) : _pin(pinA < PIN_COUNT ? pinA : 0) {}
+
+    int32_t read() { return counts()[_pin]; }
+    void write(int32_t position) { counts()[_pin] = position; }
+    int32_t readAndReset() {
+        int32_t position = counts()[_pin];
+        counts()[_pin] = 0;
+        return position;
+    }
+
+    // Host controls: move the encoder whose A channel is on pinA
+    static void hostTurn(uint8_t pinA, int32_t steps) {
+        if (pinA < PIN_COUNT) counts()[pinA] += steps;
+    }
+
+private:
+    static const uint8_t PIN_COUNT = 64;
+
+    static int32_t* counts() {
+        static int32_t positions[PIN_COUNT] = { 0 };
+        return positions;
+    }
+
+    uint8_t _pin;
+};
+
+#endif // HOST_ENCODER_H
@@ -0,0 +1,282 @@
+#include "FS.h"
+#include "LittleFS.h"
+#include "LittleFSImage.h"
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+#include <sys/stat.h>
+
+namespace stdfs = std::filesystem;
+
+fs::LittleFSFS LittleFS;
+
+namespace fs {
+
+// Size of the "spiffs" partition in custom_partitions.csv
+static const size_t LITTLEFS_PARTITION_SIZE = 0x100000;
+
+class FileImpl {
+public:
+    ~FileImpl() { close(); }
+
+    void close() {
+        if (file != nullptr) {
+            fclose(file);
+            file = nullptr;
+        }
+        if (imageFile != nullptr) {
+            image::close(imageFile);
+            imageFile = nullptr;
+        }
+    }
+
+    bool isOpen() const { return file != nullptr || imageFile != nullptr; }
+
+    FS* owner = nullptr;
+    FILE* file = nullptr;
+    image::OpenFile* imageFile = nullptr; // Set instead of file when an image is mounted
+    bool directory = false;
+    std::string path;                 // Path inside the filesystem
+    std::string name;                 // Last path component
+    std::string hostPath;
+    std::vector<std::string> entries; // Directory listing, sorted
+    size_t nextEntry = 0;
+};
+
+std::string FS::hostPath(const char* path) const {
+    std::string p = path != nullptr ? path : "";
+    if (p.empty() || p[0] != '/') p = "/" + p;
+    return _root + p;
+}
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+File FS::open(const char* path, const char* mode, const bool create) {
+    if (path == nullptr || mode == nullptr) return File();
+
+    std::string fsPath = path[0] == '/' ? path : std::string("/") + path;
+    std::string host = hostPath(path);
+    std::error_code ec;
+
+    auto impl = std::make_shared<FileImpl>();
+    impl->owner = this;
+    impl->path = fsPath;
+    impl->name = baseName(fsPath);
+    impl->hostPath = host;
+
+    if (image::isMounted()) {
+        if (mode[0] == 'r' && image::isDirectory(fsPath.c_str())) {
+            impl->directory = true;
+            image::list(fsPath.c_str(), impl->entries);
+            return File(impl);
+        }
+        impl->imageFile = image::open(fsPath.c_str(), mode, create);
+        return impl->imageFile != nullptr ? File(impl) : File();
+    }
+
+    if (mode[0] == 'r' && stdfs::is_directory(host, ec)) {
+        impl->directory = true;
+        for (const auto& entry : stdfs::directory_iterator(host, ec)) {
+            impl->entries.push_back(entry.path().filename().string());
+        }
+        std::sort(impl->entries.begin(), impl->entries.end());
+        return File(impl);
+    }
+
+    if (mode[0] != 'r' && create) {
+        stdfs::create_directories(stdfs::path(host).parent_path(), ec);
+    }
+
+    impl->file = fopen(host.c_str(), mode);
+    if (impl->file == nullptr) return File();
+    return File(impl);
+}
+
+bool FS::exists(const char* path) {
+    if (image::isMounted()) return image::exists(path);
+    std::error_code ec;
+    return stdfs::exists(hostPath(path), ec);
+}
+
+bool FS::remove(const char* path) {
+    if (image::isMounted()) return image::remove(path);
+    std::error_code ec;
+    std::string host = hostPath(path);
+    if (stdfs::is_directory(host, ec)) return false;
+    return stdfs::remove(host, ec);
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+    if (image::isMounted()) return image::rename(pathFrom, pathTo);
+    std::error_code ec;
+    stdfs::rename(hostPath(pathFrom), hostPath(pathTo), ec);
+    return !ec;
+}
+
+bool FS::mkdir(const char* path) {
+    if (image::isMounted()) return image::mkdir(path);
+    std::error_code ec;
+    std::string host = hostPath(path);
+    if (stdfs::is_directory(host, ec)) return true;
+    return stdfs::create_directory(host, ec);
+}
+
+bool FS::rmdir(const char* path) {
+    if (image::isMounted()) return image::rmdir(path);
+    std::error_code ec;
+    std::string host = hostPath(path);
+    if (!stdfs::is_directory(host, ec) || !stdfs::is_empty(host, ec)) return false;
+    return stdfs::remove(host, ec);
+}
+
+bool LittleFSFS::begin(bool, const char*, uint8_t, const char*) {
+    if (image::isMounted()) return true;
+    std::error_code ec;
+    return stdfs::is_directory(_root, ec);
+}
+
+bool LittleFSFS::mountImage(const std::string& path, std::string& error, size_t blockSize) {
+    return image::mount(path, blockSize, error);
+}
+
+bool LittleFSFS::format() {
+    if (image::isMounted()) return image::format();
+    std::error_code ec;
+    for (const auto& entry : stdfs::directory_iterator(_root, ec)) {
+        stdfs::remove_all(entry.path(), ec);
+    }
+    return !ec;
+}
+
+size_t LittleFSFS::totalBytes() {
+    if (image::isMounted()) return image::totalBytes();
+    return LITTLEFS_PARTITION_SIZE;
+}
+
+size_t LittleFSFS::usedBytes() {
+    if (image::isMounted()) return image::usedBytes();
+    std::error_code ec;
+    size_t used = 0;
+    for (const auto& entry : stdfs::recursive_directory_iterator(_root, ec)) {
+        if (entry.is_regular_file(ec)) used += (size_t)entry.file_size(ec);
+    }
+    return used;
+}
+
+size_t File::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+    if (!_impl || !_impl->isOpen()) return 0;
+    if (_impl->imageFile != nullptr) return image::write(_impl->imageFile, buf, size);
+    return fwrite(buf, 1, size, _impl->file);
+}
+
+int File::available() {
+    if (!_impl || !_impl->isOpen()) return 0;
+    return (int)(size() - position());
+}
+
+int File::read() {
+    if (!_impl || !_impl->isOpen()) return -1;
+    if (_impl->imageFile != nullptr) {
+        uint8_t c;
+        return image::read(_impl->imageFile, &c, 1) == 1 ? c : -1;
+    }
+    return fgetc(_impl->file);
+}
+
+int File::peek() {
+    if (!_impl || !_impl->isOpen()) return -1;
+    if (_impl->imageFile != nullptr) {
+        int c = read();
+        if (c >= 0) image::seek(_impl->imageFile, -1, SEEK_CUR);
+        return c;
+    }
+    int c = fgetc(_impl->file);
+    if (c != EOF) ungetc(c, _impl->file);
+    return c;
+}
+
+void File::flush() {
+    if (_impl && _impl->file != nullptr) fflush(_impl->file);
+    if (_impl && _impl->imageFile != nullptr) image::flush(_impl->imageFile);
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+    if (!_impl || !_impl->isOpen()) return 0;
+    if (_impl->imageFile != nullptr) return image::read(_impl->imageFile, buf, size);
+    return fread(buf, 1, size, _impl->file);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!_impl || !_impl->isOpen()) return false;
+    int whence = mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END;
+    if (_impl->imageFile != nullptr) return image::seek(_impl->imageFile, (long)pos, whence);
+    return fseek(_impl->file, (long)pos, whence) == 0;
+}
+
+size_t File::position() const {
+    if (!_impl || !_impl->isOpen()) return 0;
+    if (_impl->imageFile != nullptr) return image::position(_impl->imageFile);
+    long pos = ftell(_impl->file);
+    return pos < 0 ? 0 : (size_t)pos;
+}
+
+size_t File::size() const {
+    if (!_impl || !_impl->isOpen()) return 0;
+    if (_impl->imageFile != nullptr) return image::size(_impl->imageFile);
+    fflush(_impl->file);
+    struct stat st;
+    if (fstat(fileno(_impl->file), &st) != 0) return 0;
+    return (size_t)st.st_size;
+}
+
+void File::close() {
+    if (_impl) {
+        _impl->close();
+        _impl.reset();
+    }
+}
+
+File::operator bool() const {
+    return _impl && (_impl->directory || _impl->isOpen());
+}
+
+time_t File::getLastWrite() {
+    if (!_impl) return 0;
+    if (image::isMounted()) return image::lastWrite(_impl->path.c_str());
+    struct stat st;
+    if (stat(_impl->hostPath.c_str(), &st) != 0) return 0;
+    return st.st_mtime;
+}
+
+const char* File::path() const {
+    return _impl ? _impl->path.c_str() : nullptr;
+}
+
+const char* File::name() const {
+    return _impl ? _impl->name.c_str() : nullptr;
+}
+
+bool File::isDirectory() const {
+    return _impl && _impl->directory;
+}
+
+File File::openNextFile(const char* mode) {
+    if (!_impl || !_impl->directory || _impl->nextEntry >= _impl->entries.size()) return File();
+    std::string child = _impl->path;
+    if (child.empty() || child[child.length() - 1] != '/') child += "/";
+    child += _impl->entries[_impl->nextEntry++];
+    return _impl->owner->open(child.c_str(), mode);
+}
+
+void File::rewindDirectory() {
+    if (_impl) _impl->nextEntry = 0;
+}
+
+} // namespace fs
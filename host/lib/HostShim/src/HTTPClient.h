@@ -0,0 +1,7 @@
+#ifndef HOST_HTTPCLIENT_H
+#define HOST_HTTPCLIENT_H
+
+// OTAUpdateManager is stubbed on the host; the client is never constructed
+class HTTPClient;
+
+#endif // HOST_HTTPCLIENT_H
@@ -0,0 +1,13 @@
+#ifndef HOST_HARDWARESERIAL_H
+#define HOST_HARDWARESERIAL_H
+
+#include "USBCDC.h"
+
+class USBCDC;
+
+// A few sources still log through Serial; it behaves like USBSerial
+typedef USBCDC HardwareSerial;
+
+extern HardwareSerial Serial;
+
+#endif // HOST_HARDWARESERIAL_H
@@ -0,0 +1,32 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <stdint.h>
+
+// millis()/micros() run on the host's monotonic clock plus a virtual offset.
+// By default delay() only advances the offset, so handlers that sleep (LED
+// reinitialisation, restart grace periods) cost their nominal time in the
+// latency figures without stalling the load test.
+namespace HostClock {
+
+// Microseconds since start, including the virtual offset (64-bit micros())
+uint64_t micros64();
+
+// Sleep for real in delay() instead of advancing the virtual offset
+void setRealDelays(bool real);
+
+// Microseconds requested through delay()/vTaskDelay() since the last reset
+uint64_t delayedUs();
+void resetDelayed();
+
+// Move the clock forward without sleeping (used to age timeouts)
+void advance(uint32_t ms);
+void advanceUs(uint64_t us);
+
+// Stop counting host time: the clock then moves only through advance() and
+// delay(), so a replay produces the same timestamps on any machine
+void setFrozen(bool frozen);
+
+} // namespace HostClock
+
+#endif // HOST_CLOCK_H
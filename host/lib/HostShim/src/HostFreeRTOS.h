@@ -0,0 +1,64 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// FreeRTOS types and calls used by the API layer. The host build is single
+// threaded: tasks created from request handlers run inline to completion.
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef void* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+
+#define configTICK_RATE_HZ   1000
+#define configMAX_PRIORITIES 25
+#define portTICK_PERIOD_MS   (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(ms) * configTICK_RATE_HZ / 1000)
+#define portMAX_DELAY        ((TickType_t)0xffffffffUL)
+#define tskNO_AFFINITY       0x7fffffff
+
+typedef struct {
+    volatile int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+
+static inline void hostMuxEnter(portMUX_TYPE* mux) {
+    while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static inline void hostMuxExit(portMUX_TYPE* mux) {
+    __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+#define portENTER_CRITICAL(mux)     hostMuxEnter(mux)
+#define portEXIT_CRITICAL(mux)      hostMuxExit(mux)
+#define portENTER_CRITICAL_ISR(mux) hostMuxEnter(mux)
+#define portEXIT_CRITICAL_ISR(mux)  hostMuxExit(mux)
+#define taskENTER_CRITICAL(mux)     hostMuxEnter(mux)
+#define taskEXIT_CRITICAL(mux)      hostMuxExit(mux)
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param,
+                       UBaseType_t priority, TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t handle);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previousWakeTime, TickType_t increment);
+TickType_t xTaskGetTickCount();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xPortGetCoreID();
+
+#endif // HOST_FREERTOS_H
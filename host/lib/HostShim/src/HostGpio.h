@@ -0,0 +1,28 @@
+#ifndef HOST_GPIO_H
+#define HOST_GPIO_H
+
+#include <stdint.h>
+
+// Pin model behind pinMode()/digitalWrite()/digitalRead(). Inputs idle HIGH,
+// as with the pull-ups on the key matrix columns. A closed switch between two
+// pins pulls an input LOW while the pin at its other end is an output driven
+// LOW, which is all a row/column scan needs to see a key.
+namespace HostGpio {
+
+const uint8_t PIN_COUNT = 64;
+
+// Press or release the switch between two pins (a key at a row and a column)
+void setSwitch(uint8_t pinA, uint8_t pinB, bool closed);
+void openAllSwitches();
+
+// Level an input reads when no switch pulls it down
+void setInputLevel(uint8_t pin, uint8_t level);
+
+// Calls since the last reset, to put a number on scan cost
+uint32_t reads();
+uint32_t writes();
+void resetCounters();
+
+} // namespace HostGpio
+
+#endif // HOST_GPIO_H
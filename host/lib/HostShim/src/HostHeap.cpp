@@ -0,0 +1,149 @@
+#include "HostHeap.h"
+#include <atomic>
+#include <stdlib.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+#endif
+
+namespace {
+
+std::atomic<int64_t> g_current(0);
+std::atomic<int64_t> g_peak(0);
+std::atomic<size_t> g_largest(0);
+std::atomic<uint64_t> g_allocations(0);
+std::atomic<uint64_t> g_largeAllocations(0);
+size_t g_largeThreshold = 16 * 1024;
+
+// Internal RAM available to the application on an ESP32-S3 with WiFi up
+const size_t DEFAULT_SIMULATED_HEAP = 320 * 1024;
+
+inline void trackAlloc(size_t usable, size_t requested) {
+    int64_t now = g_current.fetch_add((int64_t)usable, std::memory_order_relaxed) + (int64_t)usable;
+    int64_t peak = g_peak.load(std::memory_order_relaxed);
+    while (now > peak && !g_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+    size_t largest = g_largest.load(std::memory_order_relaxed);
+    while (requested > largest && !g_largest.compare_exchange_weak(largest, requested, std::memory_order_relaxed)) {
+    }
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (requested >= g_largeThreshold) {
+        g_largeAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline void trackFree(size_t usable) {
+    g_current.fetch_sub((int64_t)usable, std::memory_order_relaxed);
+}
+
+} // namespace
+
+#if defined(__GLIBC__)
+extern "C" {
+
+void* malloc(size_t size) {
+    void* p = __libc_malloc(size);
+    if (p != nullptr) trackAlloc(malloc_usable_size(p), size);
+    return p;
+}
+
+void* calloc(size_t count, size_t size) {
+    void* p = __libc_calloc(count, size);
+    if (p != nullptr) trackAlloc(malloc_usable_size(p), count * size);
+    return p;
+}
+
+void* realloc(void* ptr, size_t size) {
+    size_t before = ptr != nullptr ? malloc_usable_size(ptr) : 0;
+    void* p = __libc_realloc(ptr, size);
+    if (p != nullptr) {
+        trackFree(before);
+        trackAlloc(malloc_usable_size(p), size);
+    } else if (size == 0 && ptr != nullptr) {
+        trackFree(before);
+    }
+    return p;
+}
+
+void* memalign(size_t alignment, size_t size) {
+    void* p = __libc_memalign(alignment, size);
+    if (p != nullptr) trackAlloc(malloc_usable_size(p), size);
+    return p;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    void* p = memalign(alignment, size);
+    if (p == nullptr) return 12;  // ENOMEM
+    *out = p;
+    return 0;
+}
+
+void free(void* ptr) {
+    if (ptr == nullptr) return;
+    trackFree(malloc_usable_size(ptr));
+    __libc_free(ptr);
+}
+
+} // extern "C"
+#endif
+
+namespace HostHeap {
+
+bool available() {
+#if defined(__GLIBC__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+Snapshot snapshot() {
+    Snapshot s;
+    s.current = g_current.load(std::memory_order_relaxed);
+    s.peak = g_peak.load(std::memory_order_relaxed);
+    s.largest = g_largest.load(std::memory_order_relaxed);
+    s.allocations = g_allocations.load(std::memory_order_relaxed);
+    s.largeAllocations = g_largeAllocations.load(std::memory_order_relaxed);
+    return s;
+}
+
+void resetWindow() {
+    g_peak.store(g_current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    g_largest.store(0, std::memory_order_relaxed);
+    g_allocations.store(0, std::memory_order_relaxed);
+    g_largeAllocations.store(0, std::memory_order_relaxed);
+}
+
+void setLargeThreshold(size_t bytes) {
+    g_largeThreshold = bytes;
+}
+
+size_t simulatedHeapSize() {
+    static size_t size = 0;
+    if (size == 0) {
+        const char* env = getenv("MACROPAD_HOST_HEAP");
+        size = env != nullptr ? (size_t)strtoul(env, nullptr, 10) : DEFAULT_SIMULATED_HEAP;
+        if (size == 0) size = DEFAULT_SIMULATED_HEAP;
+    }
+    return size;
+}
+
+size_t simulatedFree() {
+    int64_t used = g_current.load(std::memory_order_relaxed);
+    int64_t size = (int64_t)simulatedHeapSize();
+    return used >= size ? 0 : (size_t)(size - used);
+}
+
+} // namespace HostHeap
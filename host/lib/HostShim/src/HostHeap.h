@@ -0,0 +1,36 @@
+#ifndef HOST_HEAP_H
+#define HOST_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Heap accounting for the load test. On glibc the allocator entry points are
+// wrapped so every malloc/new made by the handlers is counted; elsewhere the
+// figures stay at zero and the memory columns are reported as unavailable.
+namespace HostHeap {
+
+struct Snapshot {
+    int64_t current;           // Bytes currently allocated
+    int64_t peak;              // High-water mark since resetWindow()
+    size_t largest;            // Largest single allocation since resetWindow()
+    uint64_t allocations;      // Allocation calls since resetWindow()
+    uint64_t largeAllocations; // Allocations >= the large threshold since resetWindow()
+};
+
+bool available();
+Snapshot snapshot();
+
+// Start a new measurement window (peak restarts from the current level)
+void resetWindow();
+
+// Allocation size counted as "large" (default 16 KB)
+void setLargeThreshold(size_t bytes);
+
+// Size of the heap ESP.getFreeHeap() and heap_caps_* report against.
+// Defaults to the ESP32-S3 internal heap; override with MACROPAD_HOST_HEAP.
+size_t simulatedHeapSize();
+size_t simulatedFree();
+
+} // namespace HostHeap
+
+#endif // HOST_HEAP_H
@@ -0,0 +1,84 @@
+#include "HostHid.h"
+#include "HostClock.h"
+#include "tusb.h"
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+bool g_mounted = true;
+bool g_ready = true;
+bool g_suspended = false;
+std::vector<HostHid::Report> g_reports;
+
+bool record(HostHid::ReportKind kind, uint8_t reportId, const uint8_t* data, size_t length) {
+    if (!g_mounted || !g_ready) return false;
+
+    HostHid::Report report;
+    report.kind = kind;
+    report.reportId = reportId;
+    report.length = (uint8_t)(length < sizeof(report.data) ? length : sizeof(report.data));
+    memset(report.data, 0, sizeof(report.data));
+    memcpy(report.data, data, report.length);
+    report.timestampUs = HostClock::micros64();
+    g_reports.push_back(report);
+    return true;
+}
+
+} // namespace
+
+namespace HostHid {
+
+void setMounted(bool mounted) {
+    g_mounted = mounted;
+}
+
+void setReady(bool ready) {
+    g_ready = ready;
+}
+
+void setSuspended(bool suspended) {
+    g_suspended = suspended;
+}
+
+const std::vector<Report>& reports() {
+    return g_reports;
+}
+
+void clear() {
+    g_reports.clear();
+}
+
+void reserve(size_t count) {
+    if (g_reports.capacity() - g_reports.size() >= count) return;
+    g_reports.reserve(std::max(g_reports.capacity() * 2, g_reports.size() + count));
+}
+
+} // namespace HostHid
+
+bool tud_mounted(void) {
+    return g_mounted;
+}
+
+bool tud_suspended(void) {
+    return g_suspended;
+}
+
+bool tud_hid_ready(void) {
+    return g_mounted && g_ready;
+}
+
+bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len) {
+    return record(HostHid::REPORT_OTHER, report_id, (const uint8_t*)report, len);
+}
+
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]) {
+    uint8_t data[8] = { modifier, 0 };
+    if (keycode != nullptr) memcpy(&data[2], keycode, 6);
+    return record(HostHid::REPORT_KEYBOARD, report_id, data, sizeof(data));
+}
+
+bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal) {
+    uint8_t data[5] = { buttons, (uint8_t)x, (uint8_t)y, (uint8_t)vertical, (uint8_t)horizontal };
+    return record(HostHid::REPORT_MOUSE, report_id, data, sizeof(data));
+}
@@ -0,0 +1,41 @@
+#ifndef HOST_HID_H
+#define HOST_HID_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Stands in for the USB host on the other end of the HID interface. Every
+// report the firmware hands to TinyUSB is recorded with its timestamp so a
+// harness can check what was sent and how long it took to get there.
+namespace HostHid {
+
+enum ReportKind : uint8_t {
+    REPORT_KEYBOARD,   // data = modifier, reserved, keycode[6]
+    REPORT_MOUSE,      // data = buttons, x, y, vertical, horizontal
+    REPORT_OTHER       // data = raw report (consumer control and the like)
+};
+
+struct Report {
+    ReportKind kind;
+    uint8_t reportId;
+    uint8_t length;
+    uint8_t data[8];
+    uint64_t timestampUs;
+};
+
+// Bus state seen by tud_mounted()/tud_hid_ready(); both default to true
+void setMounted(bool mounted);
+void setReady(bool ready);
+// Host suspend seen by tud_suspended(); defaults to false
+void setSuspended(bool suspended);
+
+const std::vector<Report>& reports();
+void clear();
+// Make room for count more reports, so recording them does not allocate
+// inside a harness's measurement window
+void reserve(size_t count);
+
+} // namespace HostHid
+
+#endif // HOST_HID_H
@@ -0,0 +1,29 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include "Printable.h"
+#include "WString.h"
+
+class IPAddress : public Printable {
+public:
+    IPAddress() : IPAddress(0, 0, 0, 0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        _bytes[0] = a;
+        _bytes[1] = b;
+        _bytes[2] = c;
+        _bytes[3] = d;
+    }
+
+    uint8_t operator[](int index) const { return _bytes[index]; }
+    bool operator==(const IPAddress& other) const;
+    bool operator!=(const IPAddress& other) const { return !(*this == other); }
+
+    String toString() const;
+    size_t printTo(Print& p) const override;
+
+private:
+    uint8_t _bytes[4];
+};
+
+#endif // HOST_IPADDRESS_H
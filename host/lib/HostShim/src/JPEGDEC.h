@@ -0,0 +1,6 @@
+#ifndef HOST_JPEGDEC_H
+#define HOST_JPEGDEC_H
+
+typedef struct jpeg_draw_tag JPEGDRAW;
+
+#endif // HOST_JPEGDEC_H
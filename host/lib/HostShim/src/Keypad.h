@@ -0,0 +1,8 @@
+#ifndef HOST_KEYPAD_H
+#define HOST_KEYPAD_H
+
+// KeyHandler scans the matrix itself and only holds an unused pointer
+class Keypad {
+};
+
+#endif // HOST_KEYPAD_H
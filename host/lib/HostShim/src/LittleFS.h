@@ -0,0 +1,27 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+class LittleFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = "spiffs");
+    bool format();
+    size_t totalBytes();
+    size_t usedBytes();
+    void end() {}
+
+    // Host control: serve a LittleFS image instead of the directory root
+    // (see LittleFSImage.h)
+    bool mountImage(const std::string& path, std::string& error, size_t blockSize = 4096);
+};
+
+} // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+using fs::LittleFSFS;
+
+#endif // HOST_LITTLEFS_H
@@ -0,0 +1,284 @@
+#include "LittleFSImage.h"
+
+#ifdef HOST_LITTLEFS_IMAGE
+
+#include <lfs.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace fs {
+namespace image {
+
+// esp_littlefs defaults (CONFIG_LITTLEFS_*), so allocation matches the device
+static const lfs_size_t READ_SIZE = 128;
+static const lfs_size_t PROG_SIZE = 128;
+static const lfs_size_t CACHE_SIZE = 512;
+static const lfs_size_t LOOKAHEAD_SIZE = 128;
+static const int32_t BLOCK_CYCLES = 512;
+
+// esp_littlefs keeps each file's modification time in this attribute
+static const uint8_t MTIME_ATTRIBUTE = 't';
+
+struct OpenFile {
+    lfs_file_t file;
+    std::string path;
+    bool written = false;
+};
+
+static std::vector<uint8_t> flash;
+static lfs_t lfs;
+static lfs_config config;
+static bool mounted = false;
+static Counters traffic;
+
+static int flashRead(const lfs_config* c, lfs_block_t block, lfs_off_t off, void* buffer, lfs_size_t size) {
+    memcpy(buffer, &flash[(size_t)block * c->block_size + off], size);
+    traffic.readBytes += size;
+    return LFS_ERR_OK;
+}
+
+static int flashProg(const lfs_config* c, lfs_block_t block, lfs_off_t off, const void* buffer, lfs_size_t size) {
+    // NOR flash can only clear bits
+    uint8_t* target = &flash[(size_t)block * c->block_size + off];
+    const uint8_t* source = (const uint8_t*)buffer;
+    for (lfs_size_t i = 0; i < size; i++) {
+        target[i] &= source[i];
+    }
+    traffic.progBytes += size;
+    return LFS_ERR_OK;
+}
+
+static int flashErase(const lfs_config* c, lfs_block_t block) {
+    memset(&flash[(size_t)block * c->block_size], 0xFF, c->block_size);
+    traffic.erasedBlocks++;
+    return LFS_ERR_OK;
+}
+
+static int flashSync(const lfs_config*) {
+    return LFS_ERR_OK;
+}
+
+bool mount(const std::string& imagePath, size_t blockSize, std::string& error) {
+    FILE* file = fopen(imagePath.c_str(), "rb");
+    if (file == nullptr) {
+        error = "cannot open " + imagePath;
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length <= 0 || length % (long)blockSize != 0) {
+        fclose(file);
+        error = imagePath + " is not a whole number of " + std::to_string(blockSize) + " byte blocks";
+        return false;
+    }
+    flash.resize((size_t)length);
+    size_t loaded = fread(flash.data(), 1, flash.size(), file);
+    fclose(file);
+    if (loaded != flash.size()) {
+        error = "cannot read " + imagePath;
+        return false;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.read = flashRead;
+    config.prog = flashProg;
+    config.erase = flashErase;
+    config.sync = flashSync;
+    config.read_size = READ_SIZE;
+    config.prog_size = PROG_SIZE;
+    config.block_size = (lfs_size_t)blockSize;
+    config.block_count = (lfs_size_t)(flash.size() / blockSize);
+    config.block_cycles = BLOCK_CYCLES;
+    config.cache_size = CACHE_SIZE;
+    config.lookahead_size = LOOKAHEAD_SIZE;
+
+    int result = lfs_mount(&lfs, &config);
+    if (result != LFS_ERR_OK) {
+        error = "not a LittleFS image with " + std::to_string(blockSize) + " byte blocks (" +
+                std::to_string(result) + ")";
+        return false;
+    }
+    mounted = true;
+    traffic = Counters();
+    return true;
+}
+
+bool isMounted() {
+    return mounted;
+}
+
+bool format() {
+    if (mounted) lfs_unmount(&lfs);
+    mounted = lfs_format(&lfs, &config) == LFS_ERR_OK && lfs_mount(&lfs, &config) == LFS_ERR_OK;
+    return mounted;
+}
+
+size_t totalBytes() {
+    return (size_t)config.block_count * config.block_size;
+}
+
+size_t usedBytes() {
+    lfs_ssize_t blocks = lfs_fs_size(&lfs);
+    return blocks < 0 ? 0 : (size_t)blocks * config.block_size;
+}
+
+Counters counters() {
+    return traffic;
+}
+
+bool exists(const char* path) {
+    lfs_info info;
+    return lfs_stat(&lfs, path, &info) == LFS_ERR_OK;
+}
+
+bool isDirectory(const char* path) {
+    lfs_info info;
+    return lfs_stat(&lfs, path, &info) == LFS_ERR_OK && info.type == LFS_TYPE_DIR;
+}
+
+bool list(const char* path, std::vector<std::string>& names) {
+    lfs_dir_t dir;
+    if (lfs_dir_open(&lfs, &dir, path) != LFS_ERR_OK) return false;
+    lfs_info info;
+    while (lfs_dir_read(&lfs, &dir, &info) > 0) {
+        if (strcmp(info.name, ".") == 0 || strcmp(info.name, "..") == 0) continue;
+        names.push_back(info.name);
+    }
+    lfs_dir_close(&lfs, &dir);
+    std::sort(names.begin(), names.end());
+    return true;
+}
+
+bool remove(const char* path) {
+    // Like the directory backend, remove() is for files only
+    return !isDirectory(path) && lfs_remove(&lfs, path) == LFS_ERR_OK;
+}
+
+bool rename(const char* pathFrom, const char* pathTo) {
+    return lfs_rename(&lfs, pathFrom, pathTo) == LFS_ERR_OK;
+}
+
+bool mkdir(const char* path) {
+    int result = lfs_mkdir(&lfs, path);
+    return result == LFS_ERR_OK || (result == LFS_ERR_EXIST && isDirectory(path));
+}
+
+bool rmdir(const char* path) {
+    return isDirectory(path) && lfs_remove(&lfs, path) == LFS_ERR_OK;
+}
+
+time_t lastWrite(const char* path) {
+    time_t modified = 0;
+    lfs_ssize_t length = lfs_getattr(&lfs, path, MTIME_ATTRIBUTE, &modified, sizeof(modified));
+    return length == (lfs_ssize_t)sizeof(modified) ? modified : 0;
+}
+
+OpenFile* open(const char* path, const char* mode, bool create) {
+    int flags;
+    switch (mode[0]) {
+        case 'r': flags = LFS_O_RDONLY; break;
+        case 'w': flags = LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC; break;
+        case 'a': flags = LFS_O_WRONLY | LFS_O_CREAT | LFS_O_APPEND; break;
+        default: return nullptr;
+    }
+    if (strchr(mode, '+') != nullptr) {
+        flags = (flags & ~LFS_O_RDWR) | LFS_O_RDWR;
+    }
+
+    // As on the device, create makes the missing parent directories
+    if (create && mode[0] != 'r') {
+        std::string parent = path;
+        for (size_t slash = parent.find('/', 1); slash != std::string::npos; slash = parent.find('/', slash + 1)) {
+            lfs_mkdir(&lfs, parent.substr(0, slash).c_str());
+        }
+    }
+
+    OpenFile* file = new OpenFile();
+    file->path = path;
+    if (lfs_file_open(&lfs, &file->file, path, flags) != LFS_ERR_OK) {
+        delete file;
+        return nullptr;
+    }
+    return file;
+}
+
+void close(OpenFile* file) {
+    lfs_file_close(&lfs, &file->file);
+    if (file->written) {
+        time_t now = time(nullptr);
+        lfs_setattr(&lfs, file->path.c_str(), MTIME_ATTRIBUTE, &now, sizeof(now));
+    }
+    delete file;
+}
+
+size_t read(OpenFile* file, uint8_t* buffer, size_t size) {
+    lfs_ssize_t n = lfs_file_read(&lfs, &file->file, buffer, (lfs_size_t)size);
+    return n < 0 ? 0 : (size_t)n;
+}
+
+size_t write(OpenFile* file, const uint8_t* buffer, size_t size) {
+    lfs_ssize_t n = lfs_file_write(&lfs, &file->file, buffer, (lfs_size_t)size);
+    if (n > 0) file->written = true;
+    return n < 0 ? 0 : (size_t)n;
+}
+
+bool seek(OpenFile* file, long offset, int whence) {
+    int lfsWhence = whence == SEEK_SET ? LFS_SEEK_SET : whence == SEEK_CUR ? LFS_SEEK_CUR : LFS_SEEK_END;
+    return lfs_file_seek(&lfs, &file->file, (lfs_soff_t)offset, lfsWhence) >= 0;
+}
+
+size_t position(OpenFile* file) {
+    lfs_soff_t pos = lfs_file_tell(&lfs, &file->file);
+    return pos < 0 ? 0 : (size_t)pos;
+}
+
+size_t size(OpenFile* file) {
+    lfs_soff_t length = lfs_file_size(&lfs, &file->file);
+    return length < 0 ? 0 : (size_t)length;
+}
+
+void flush(OpenFile* file) {
+    lfs_file_sync(&lfs, &file->file);
+}
+
+} // namespace image
+} // namespace fs
+
+#else
+
+namespace fs {
+namespace image {
+
+bool mount(const std::string&, size_t, std::string& error) {
+    error = "built without -DHOST_LITTLEFS_IMAGE (use the native_storage env)";
+    return false;
+}
+bool isMounted() { return false; }
+bool format() { return false; }
+size_t totalBytes() { return 0; }
+size_t usedBytes() { return 0; }
+Counters counters() { return Counters(); }
+bool exists(const char*) { return false; }
+bool isDirectory(const char*) { return false; }
+bool list(const char*, std::vector<std::string>&) { return false; }
+bool remove(const char*) { return false; }
+bool rename(const char*, const char*) { return false; }
+bool mkdir(const char*) { return false; }
+bool rmdir(const char*) { return false; }
+time_t lastWrite(const char*) { return 0; }
+OpenFile* open(const char*, const char*, bool) { return nullptr; }
+void close(OpenFile*) {}
+size_t read(OpenFile*, uint8_t*, size_t) { return 0; }
+size_t write(OpenFile*, const uint8_t*, size_t) { return 0; }
+bool seek(OpenFile*, long, int) { return false; }
+size_t position(OpenFile*) { return 0; }
+size_t size(OpenFile*) { return 0; }
+void flush(OpenFile*) {}
+
+} // namespace image
+} // namespace fs
+
+#endif // HOST_LITTLEFS_IMAGE
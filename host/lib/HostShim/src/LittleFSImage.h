@@ -0,0 +1,58 @@
+#ifndef HOST_LITTLEFS_IMAGE_H
+#define HOST_LITTLEFS_IMAGE_H
+
+// Optional backend for the host LittleFS: a filesystem image (the
+// littlefs.bin `pio run -t buildfs` produces) mounted with the real littlefs
+// library, so block allocation, metadata compaction and wear show up on the
+// host. The image is loaded into memory; the file itself is never written.
+//
+// Needs -DHOST_LITTLEFS_IMAGE and littlefs in lib_deps (see the
+// native_storage env); other builds get stubs and mount() fails.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+namespace fs {
+namespace image {
+
+struct OpenFile;
+
+// Flash traffic since mount, in the units the device's flash works in
+struct Counters {
+    uint64_t readBytes = 0;
+    uint64_t progBytes = 0;
+    uint64_t erasedBlocks = 0;
+};
+
+bool mount(const std::string& imagePath, size_t blockSize, std::string& error);
+bool isMounted();
+bool format();
+size_t totalBytes();
+size_t usedBytes();
+Counters counters();
+
+bool exists(const char* path);
+bool isDirectory(const char* path);
+bool list(const char* path, std::vector<std::string>& names);
+bool remove(const char* path);
+bool rename(const char* pathFrom, const char* pathTo);
+bool mkdir(const char* path);
+bool rmdir(const char* path);
+time_t lastWrite(const char* path);
+
+OpenFile* open(const char* path, const char* mode, bool create);
+void close(OpenFile* file);
+size_t read(OpenFile* file, uint8_t* buffer, size_t size);
+size_t write(OpenFile* file, const uint8_t* buffer, size_t size);
+bool seek(OpenFile* file, long offset, int whence);
+size_t position(OpenFile* file);
+size_t size(OpenFile* file);
+void flush(OpenFile* file);
+
+} // namespace image
+} // namespace fs
+
+#endif // HOST_LITTLEFS_IMAGE_H
@@ -0,0 +1,44 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include "Arduino.h"
+#include <map>
+
+// In-memory NVS namespace
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) { return true; }
+    void end() {}
+    bool clear() {
+        _values.clear();
+        return true;
+    }
+    bool remove(const char* key) { return _values.erase(key) > 0; }
+    bool isKey(const char* key) { return _values.count(key) > 0; }
+
+    size_t putString(const char* key, const String& value) {
+        _values[key] = value;
+        return value.length();
+    }
+    String getString(const char* key, const String& defaultValue = String()) {
+        auto it = _values.find(key);
+        return it == _values.end() ? defaultValue : it->second;
+    }
+    size_t putInt(const char* key, int32_t value) { return putString(key, String((long)value)) ? 4 : 0; }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) {
+        return isKey(key) ? (int32_t)getString(key).toInt() : defaultValue;
+    }
+    size_t putUInt(const char* key, uint32_t value) { return putString(key, String((unsigned long)value)) ? 4 : 0; }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) {
+        return isKey(key) ? (uint32_t)strtoul(getString(key).c_str(), nullptr, 10) : defaultValue;
+    }
+    size_t putBool(const char* key, bool value) { return putString(key, value ? "1" : "0") ? 1 : 0; }
+    bool getBool(const char* key, bool defaultValue = false) {
+        return isKey(key) ? getString(key) == "1" : defaultValue;
+    }
+
+private:
+    std::map<String, String> _values;
+};
+
+#endif // HOST_PREFERENCES_H
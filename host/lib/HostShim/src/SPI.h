@@ -0,0 +1,6 @@
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+class SPIClass;
+
+#endif // HOST_SPI_H
@@ -0,0 +1,6 @@
+#ifndef HOST_USB_H
+#define HOST_USB_H
+
+#include "Arduino.h"
+
+#endif // HOST_USB_H
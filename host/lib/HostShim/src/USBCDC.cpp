@@ -0,0 +1,15 @@
+#include "USBCDC.h"
+
+HardwareSerial Serial;
+
+size_t USBCDC::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t USBCDC::write(const uint8_t* buffer, size_t size) {
+    _bytesWritten += size;
+    if (_echo) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
@@ -0,0 +1,31 @@
+#ifndef HOST_USBCDC_H
+#define HOST_USBCDC_H
+
+#include "Arduino.h"
+
+// Serial console. Output is counted and discarded unless echo is enabled,
+// so logging cost shows up in the latency figures without flooding stdout.
+class USBCDC : public Stream {
+public:
+    void begin(unsigned long baud = 0) {}
+    void end() {}
+    operator bool() const { return true; }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    // Host controls
+    void setEcho(bool echo) { _echo = echo; }
+    uint64_t bytesWritten() const { return _bytesWritten; }
+
+private:
+    bool _echo = false;
+    uint64_t _bytesWritten = 0;
+};
+
+#endif // HOST_USBCDC_H
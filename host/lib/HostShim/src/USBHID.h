@@ -0,0 +1,7 @@
+#ifndef HOST_USBHID_H
+#define HOST_USBHID_H
+
+// KEY_* constants come from HIDHandler.h when the framework does not provide them
+#include "Arduino.h"
+
+#endif // HOST_USBHID_H
@@ -0,0 +1,48 @@
+#ifndef HOST_USBHIDMOUSE_H
+#define HOST_USBHIDMOUSE_H
+
+#include "Arduino.h"
+#include "tusb.h"
+
+#define MOUSE_LEFT    0x01
+#define MOUSE_RIGHT   0x02
+#define MOUSE_MIDDLE  0x04
+#define MOUSE_BACKWARD 0x08
+#define MOUSE_FORWARD 0x10
+
+// Sends the library's mouse reports through the TinyUSB calls, so macro
+// mouse actions land in HostHid's report stream next to HIDHandler's
+class USBHIDMouse {
+public:
+    void begin() {}
+    void end() {}
+
+    void move(int8_t x, int8_t y, int8_t wheel = 0, int8_t pan = 0) {
+        tud_hid_mouse_report(REPORT_ID, _buttons, x, y, wheel, pan);
+    }
+
+    void click(uint8_t b = MOUSE_LEFT) {
+        _buttons = b;
+        move(0, 0);
+        _buttons = 0;
+        move(0, 0);
+    }
+
+    void press(uint8_t b = MOUSE_LEFT) { buttons(_buttons | b); }
+    void release(uint8_t b = MOUSE_LEFT) { buttons(_buttons & ~b); }
+    bool isPressed(uint8_t b = MOUSE_LEFT) { return (_buttons & b) != 0; }
+
+private:
+    static const uint8_t REPORT_ID = 2;   // HID_REPORT_ID_MOUSE in the framework's USBHID
+
+    void buttons(uint8_t b) {
+        if (b != _buttons) {
+            _buttons = b;
+            move(0, 0);
+        }
+    }
+
+    uint8_t _buttons = 0;
+};
+
+#endif // HOST_USBHIDMOUSE_H
@@ -0,0 +1,6 @@
+#ifndef HOST_UPDATE_H
+#define HOST_UPDATE_H
+
+class UpdateClass;
+
+#endif // HOST_UPDATE_H
@@ -0,0 +1,293 @@
+#include "WString.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+template <typename T>
+std::string unsignedToString(T value, unsigned char base) {
+    if (base < 2 || base > 36) base = 10;
+    char buf[8 * sizeof(T) + 1];
+    char* p = buf + sizeof(buf);
+    *--p = '\0';
+    do {
+        unsigned digit = (unsigned)(value % base);
+        *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while (value != 0);
+    return std::string(p);
+}
+
+template <typename T, typename U>
+std::string signedToString(T value, unsigned char base) {
+    if (base == 10 && value < 0) {
+        return "-" + unsignedToString<U>((U)0 - (U)value, 10);
+    }
+    return unsignedToString<U>((U)value, base);
+}
+
+std::string floatToString(double value, unsigned int decimalPlaces) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+    return std::string(buf);
+}
+
+} // namespace
+
+String::String(const char* cstr) {
+    if (cstr != nullptr) _buffer = cstr;
+}
+
+String::String(const char* cstr, unsigned int length) {
+    if (cstr != nullptr) _buffer.assign(cstr, length);
+}
+
+String::String(char c) : _buffer(1, c) {}
+String::String(unsigned char value, unsigned char base) : _buffer(unsignedToString<unsigned char>(value, base)) {}
+String::String(int value, unsigned char base) : _buffer(signedToString<int, unsigned int>(value, base)) {}
+String::String(unsigned int value, unsigned char base) : _buffer(unsignedToString<unsigned int>(value, base)) {}
+String::String(long value, unsigned char base) : _buffer(signedToString<long, unsigned long>(value, base)) {}
+String::String(unsigned long value, unsigned char base) : _buffer(unsignedToString<unsigned long>(value, base)) {}
+String::String(long long value, unsigned char base)
+    : _buffer(signedToString<long long, unsigned long long>(value, base)) {}
+String::String(unsigned long long value, unsigned char base)
+    : _buffer(unsignedToString<unsigned long long>(value, base)) {}
+String::String(float value, unsigned int decimalPlaces) : _buffer(floatToString(value, decimalPlaces)) {}
+String::String(double value, unsigned int decimalPlaces) : _buffer(floatToString(value, decimalPlaces)) {}
+
+String& String::operator=(const char* cstr) {
+    // ArduinoJson clears its destination by assigning a null pointer
+    if (cstr == nullptr) {
+        _buffer.clear();
+    } else {
+        _buffer = cstr;
+    }
+    return *this;
+}
+
+bool String::reserve(unsigned int size) {
+    _buffer.reserve(size);
+    return true;
+}
+
+bool String::concat(const String& str) {
+    _buffer += str._buffer;
+    return true;
+}
+
+bool String::concat(const char* cstr) {
+    if (cstr == nullptr) return false;
+    _buffer += cstr;
+    return true;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+    if (cstr == nullptr) return false;
+    _buffer.append(cstr, length);
+    return true;
+}
+
+bool String::concat(char c) {
+    _buffer += c;
+    return true;
+}
+
+bool String::concat(unsigned char num) { return concat(String(num)); }
+bool String::concat(int num) { return concat(String(num)); }
+bool String::concat(unsigned int num) { return concat(String(num)); }
+bool String::concat(long num) { return concat(String(num)); }
+bool String::concat(unsigned long num) { return concat(String(num)); }
+bool String::concat(long long num) { return concat(String(num)); }
+bool String::concat(unsigned long long num) { return concat(String(num)); }
+bool String::concat(float num) { return concat(String(num)); }
+bool String::concat(double num) { return concat(String(num)); }
+
+StringSumHelper operator+(const StringSumHelper& lhs, const String& rhs) {
+    StringSumHelper out(lhs);
+    out.concat(rhs);
+    return out;
+}
+
+StringSumHelper operator+(const StringSumHelper& lhs, const char* cstr) {
+    StringSumHelper out(lhs);
+    out.concat(cstr);
+    return out;
+}
+
+#define HOST_STRING_SUM(type)                                         \
+    StringSumHelper operator+(const StringSumHelper& lhs, type num) { \
+        StringSumHelper out(lhs);                                     \
+        out.concat(num);                                              \
+        return out;                                                   \
+    }
+
+HOST_STRING_SUM(char)
+HOST_STRING_SUM(unsigned char)
+HOST_STRING_SUM(int)
+HOST_STRING_SUM(unsigned int)
+HOST_STRING_SUM(long)
+HOST_STRING_SUM(unsigned long)
+HOST_STRING_SUM(long long)
+HOST_STRING_SUM(unsigned long long)
+HOST_STRING_SUM(float)
+HOST_STRING_SUM(double)
+
+#undef HOST_STRING_SUM
+
+int String::compareTo(const String& s) const {
+    return _buffer.compare(s._buffer);
+}
+
+bool String::equals(const char* cstr) const {
+    if (cstr == nullptr) return _buffer.empty();
+    return _buffer == cstr;
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+    if (length() != s.length()) return false;
+    for (unsigned int i = 0; i < length(); i++) {
+        if (tolower((unsigned char)_buffer[i]) != tolower((unsigned char)s._buffer[i])) return false;
+    }
+    return true;
+}
+
+bool String::startsWith(const String& prefix) const {
+    return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String& prefix, unsigned int offset) const {
+    if (offset > length() || prefix.length() > length() - offset) return false;
+    return _buffer.compare(offset, prefix.length(), prefix._buffer) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+    if (suffix.length() > length()) return false;
+    return _buffer.compare(length() - suffix.length(), suffix.length(), suffix._buffer) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+    return index < length() ? _buffer[index] : 0;
+}
+
+void String::setCharAt(unsigned int index, char c) {
+    if (index < length()) _buffer[index] = c;
+}
+
+char& String::operator[](unsigned int index) {
+    static char dummy;
+    if (index >= length()) {
+        dummy = 0;
+        return dummy;
+    }
+    return _buffer[index];
+}
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const {
+    if (bufsize == 0 || buf == nullptr) return;
+    if (index >= length()) {
+        buf[0] = 0;
+        return;
+    }
+    unsigned int n = bufsize - 1;
+    if (n > length() - index) n = length() - index;
+    memcpy(buf, _buffer.data() + index, n);
+    buf[n] = 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+    size_t pos = _buffer.find(ch, fromIndex);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+    if (fromIndex > length()) return -1;
+    size_t pos = _buffer.find(str._buffer, fromIndex);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(char ch) const {
+    return length() == 0 ? -1 : lastIndexOf(ch, length() - 1);
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const {
+    size_t pos = _buffer.rfind(ch, fromIndex);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::lastIndexOf(const String& str) const {
+    if (str.length() > length()) return -1;
+    return lastIndexOf(str, length() - str.length());
+}
+
+int String::lastIndexOf(const String& str, unsigned int fromIndex) const {
+    size_t pos = _buffer.rfind(str._buffer, fromIndex);
+    return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+    if (left > right) {
+        unsigned int temp = right;
+        right = left;
+        left = temp;
+    }
+    String out;
+    if (left >= length()) return out;
+    if (right > length()) right = length();
+    out._buffer = _buffer.substr(left, right - left);
+    return out;
+}
+
+void String::replace(char find, char replace) {
+    for (char& c : _buffer) {
+        if (c == find) c = replace;
+    }
+}
+
+void String::replace(const String& find, const String& replace) {
+    if (find.length() == 0) return;
+    size_t pos = 0;
+    while ((pos = _buffer.find(find._buffer, pos)) != std::string::npos) {
+        _buffer.replace(pos, find.length(), replace._buffer);
+        pos += replace.length();
+    }
+}
+
+void String::remove(unsigned int index) {
+    remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if (index >= length()) return;
+    if (count > length() - index) count = length() - index;
+    _buffer.erase(index, count);
+}
+
+void String::toLowerCase() {
+    for (char& c : _buffer) c = (char)tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+    for (char& c : _buffer) c = (char)toupper((unsigned char)c);
+}
+
+void String::trim() {
+    size_t begin = 0;
+    while (begin < _buffer.length() && isspace((unsigned char)_buffer[begin])) begin++;
+    size_t end = _buffer.length();
+    while (end > begin && isspace((unsigned char)_buffer[end - 1])) end--;
+    _buffer = _buffer.substr(begin, end - begin);
+}
+
+long String::toInt() const {
+    return atol(_buffer.c_str());
+}
+
+float String::toFloat() const {
+    return (float)atof(_buffer.c_str());
+}
+
+double String::toDouble() const {
+    return atof(_buffer.c_str());
+}
@@ -0,0 +1,76 @@
+#include "WiFi.h"
+#include "ESPmDNS.h"
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+namespace {
+
+struct HostNetwork {
+    const char* ssid;
+    int32_t rssi;
+    wifi_auth_mode_t auth;
+    int32_t channel;
+};
+
+const HostNetwork HOST_NETWORKS[] = {
+    { "HostNetwork", -52, WIFI_AUTH_WPA2_PSK, 6 },
+    { "Office-5G", -61, WIFI_AUTH_WPA2_ENTERPRISE, 36 },
+    { "Guest", -70, WIFI_AUTH_OPEN, 1 },
+    { "Neighbour", -84, WIFI_AUTH_WPA_WPA2_PSK, 11 },
+};
+const int16_t HOST_NETWORK_COUNT = sizeof(HOST_NETWORKS) / sizeof(HOST_NETWORKS[0]);
+
+} // namespace
+
+bool WiFiClass::mode(wifi_mode_t m) {
+    _mode = m;
+    return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid,
+                             bool connect) {
+    if (ssid != nullptr) _ssid = ssid;
+    _status = WL_CONNECTED;
+    return _status;
+}
+
+bool WiFiClass::disconnect(bool wifioff, bool eraseap) {
+    _status = WL_DISCONNECTED;
+    return true;
+}
+
+bool WiFiClass::softAP(const char* ssid, const char* passphrase, int channel, int ssidHidden, int maxConnection,
+                       bool ftmResponder) {
+    if (ssid != nullptr) _apSsid = ssid;
+    return true;
+}
+
+int16_t WiFiClass::scanNetworks(bool async, bool showHidden, bool passive, uint32_t maxMsPerChan, uint8_t channel) {
+    // Async scans complete immediately; scanComplete() reports the result
+    _scanCount = HOST_NETWORK_COUNT;
+    return async ? WIFI_SCAN_RUNNING : _scanCount;
+}
+
+String WiFiClass::SSID(uint8_t i) const {
+    return i < HOST_NETWORK_COUNT ? String(HOST_NETWORKS[i].ssid) : String();
+}
+
+int32_t WiFiClass::RSSI(uint8_t i) const {
+    return i < HOST_NETWORK_COUNT ? HOST_NETWORKS[i].rssi : 0;
+}
+
+uint8_t* WiFiClass::BSSID(uint8_t i) {
+    for (int b = 0; b < 6; b++) {
+        _bssid[b] = (uint8_t)(0x10 * (i + 1) + b);
+    }
+    return _bssid;
+}
+
+wifi_auth_mode_t WiFiClass::encryptionType(uint8_t i) const {
+    return i < HOST_NETWORK_COUNT ? HOST_NETWORKS[i].auth : WIFI_AUTH_OPEN;
+}
+
+int32_t WiFiClass::channel(uint8_t i) const {
+    return i < HOST_NETWORK_COUNT ? HOST_NETWORKS[i].channel : 0;
+}
@@ -0,0 +1,94 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+
+typedef enum {
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+    WIFI_MODE_MAX
+} wifi_mode_t;
+
+#define WIFI_OFF    WIFI_MODE_NULL
+#define WIFI_STA    WIFI_MODE_STA
+#define WIFI_AP     WIFI_MODE_AP
+#define WIFI_AP_STA WIFI_MODE_APSTA
+
+typedef enum {
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK,
+    WIFI_AUTH_WAPI_PSK,
+    WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+
+typedef enum {
+    WL_NO_SHIELD = 255,
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_DISCONNECTED
+} wl_status_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED  (-2)
+
+// A radio that is always associated and always sees the same few networks,
+// so scan and status handlers produce representative payloads
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t m);
+    wifi_mode_t getMode() const { return _mode; }
+
+    wl_status_t begin(const char* ssid, const char* passphrase = NULL, int32_t channel = 0,
+                      const uint8_t* bssid = NULL, bool connect = true);
+    bool disconnect(bool wifioff = false, bool eraseap = false);
+    wl_status_t status() const { return _status; }
+    bool setSleep(bool enabled) { return true; }
+    bool setAutoReconnect(bool autoReconnect) { return true; }
+    bool setAutoConnect(bool autoConnect) { return true; }
+    bool setHostname(const char* hostname) { return true; }
+
+    bool softAP(const char* ssid, const char* passphrase = NULL, int channel = 1, int ssidHidden = 0,
+                int maxConnection = 4, bool ftmResponder = false);
+    IPAddress softAPIP() const { return IPAddress(192, 168, 4, 1); }
+    String softAPSSID() const { return _apSsid; }
+
+    IPAddress localIP() const { return IPAddress(192, 168, 1, 50); }
+    String macAddress() const { return String("A1:B2:C3:D4:E5:F6"); }
+    String SSID() const { return _ssid; }
+    int32_t RSSI() const { return -52; }
+    int32_t channel() const { return 6; }
+
+    int16_t scanNetworks(bool async = false, bool showHidden = false, bool passive = false,
+                         uint32_t maxMsPerChan = 300, uint8_t channel = 0);
+    int16_t scanComplete() const { return _scanCount; }
+    void scanDelete() { _scanCount = WIFI_SCAN_FAILED; }
+    String SSID(uint8_t i) const;
+    int32_t RSSI(uint8_t i) const;
+    uint8_t* BSSID(uint8_t i);
+    wifi_auth_mode_t encryptionType(uint8_t i) const;
+    int32_t channel(uint8_t i) const;
+
+private:
+    wifi_mode_t _mode = WIFI_MODE_AP;
+    wl_status_t _status = WL_CONNECTED;
+    String _ssid = "HostNetwork";
+    String _apSsid = "MacroPad";
+    int16_t _scanCount = WIFI_SCAN_FAILED;
+    uint8_t _bssid[6] = { 0 };
+};
+
+extern WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,16 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+// I2C bus without transfers; the devices on it are modelled by their drivers
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+    void end() {}
+    void setClock(uint32_t frequency) {}
+};
+
+extern TwoWire Wire;
+
+#endif // HOST_WIRE_H
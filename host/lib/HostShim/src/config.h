@@ -0,0 +1,6 @@
+#ifndef HOST_CONFIG_H
+#define HOST_CONFIG_H
+
+// WiFiManager.cpp includes "config.h"; nothing in it is used by the API layer
+
+#endif // HOST_CONFIG_H
@@ -0,0 +1,55 @@
+#ifndef HOST_ESP32S3_ROM_MINIZ_H
+#define HOST_ESP32S3_ROM_MINIZ_H
+
+// The slice of the ROM's tinfl API that OTAInflater uses, on top of zlib's
+// raw inflate; link with -lz
+#include <stddef.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TINFL_LZ_DICT_SIZE 32768
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+
+typedef enum {
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct {
+    z_stream stream;
+    int started;
+} tinfl_decompressor;
+
+#define tinfl_init(r) memset((r), 0, sizeof(*(r)))
+
+// zlib keeps its own window, so the circular output buffer is only written to
+static inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const unsigned char* in, size_t* inSize,
+                                            unsigned char* outStart, unsigned char* outNext, size_t* outSize,
+                                            int flags) {
+    (void)outStart;
+    (void)flags;
+    if (!r->started) {
+        if (inflateInit2(&r->stream, -15) != Z_OK) return TINFL_STATUS_FAILED;
+        r->started = 1;
+    }
+
+    r->stream.next_in = (Bytef*)in;
+    r->stream.avail_in = (uInt)*inSize;
+    r->stream.next_out = outNext;
+    r->stream.avail_out = (uInt)*outSize;
+    int ret = inflate(&r->stream, Z_NO_FLUSH);
+    *inSize -= r->stream.avail_in;
+    *outSize -= r->stream.avail_out;
+
+    if (ret == Z_STREAM_END) {
+        inflateEnd(&r->stream);
+        r->started = 0;
+        return TINFL_STATUS_DONE;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) return TINFL_STATUS_FAILED;
+    return r->stream.avail_out == 0 ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
+
+#endif // HOST_ESP32S3_ROM_MINIZ_H
@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+// zlib's CRC-32 matches the ROM's esp_rom_crc32_le; link with -lz
+#include <stdint.h>
+#include <zlib.h>
+
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    return (uint32_t)crc32(crc, buf, len);
+}
+
+#endif // HOST_ESP_ROM_CRC_H
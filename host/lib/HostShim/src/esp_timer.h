@@ -0,0 +1,10 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include "HostClock.h"
+
+static inline int64_t esp_timer_get_time() {
+    return (int64_t)HostClock::micros64();
+}
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,7 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+// Handle types only; the modules that create queues are not built on the host
+#include "HostFreeRTOS.h"
+
+#endif // HOST_FREERTOS_QUEUE_H
@@ -0,0 +1,7 @@
+#ifndef HOST_MBEDTLS_VERSION_H
+#define HOST_MBEDTLS_VERSION_H
+
+// Matches the API in mbedtls/sha256.h
+#define MBEDTLS_VERSION_NUMBER 0x03000000
+
+#endif // HOST_MBEDTLS_VERSION_H
@@ -0,0 +1,17 @@
+#ifndef HOST_TUSB_H
+#define HOST_TUSB_H
+
+// TinyUSB device calls HIDHandler makes. Reports go to HostHid's sink
+// instead of an endpoint; HIDHandler.h defines the report constants itself.
+
+#include <stdint.h>
+#include "HostHid.h"
+
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_hid_ready(void);
+bool tud_hid_report(uint8_t report_id, void const* report, uint16_t len);
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, const uint8_t keycode[6]);
+bool tud_hid_mouse_report(uint8_t report_id, uint8_t buttons, int8_t x, int8_t y, int8_t vertical, int8_t horizontal);
+
+#endif // HOST_TUSB_H
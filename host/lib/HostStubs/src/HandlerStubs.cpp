@@ -0,0 +1,344 @@
+// HandlerStubs.cpp
+//
+// Host replacements for the modules the API layer calls into but which drive
+// hardware (key matrix, USB HID, OTA, display). State changes are kept in
+// memory so handlers see consistent results across requests.
+
+#include "KeyHandler.h"
+#include "HIDHandler.h"
+#include "OTAUpdateManager.h"
+#include "OTAPipeline.h"
+#include "UpdateProgressDisplay.h"
+#include "MetricsRegistry.h"
+#include "PersistenceService.h"
+#include "EventBus.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include <USBHIDMouse.h>
+#include <algorithm>
+
+// Globals normally defined in main.cpp
+USBCDC USBSerial;
+USBHIDMouse Mouse;
+HIDHandler* hidHandler = nullptr;
+KeyHandler* keyHandler = nullptr;
+
+void createWorkingActionsFile() {
+    File src = LittleFS.open("/config/defaults/actions.json", "r");
+    if (!src) return;
+    File dst = LittleFS.open("/config/actions.json", "w");
+    if (dst) {
+        uint8_t buf[512];
+        size_t n;
+        while ((n = src.read(buf, sizeof(buf))) > 0) {
+            dst.write(buf, n);
+        }
+        dst.close();
+    }
+    src.close();
+}
+
+// KeyHandler: layer bookkeeping without the matrix scanner
+
+KeyHandler::KeyHandler(uint8_t rows, uint8_t cols,
+                       const std::vector<Component>& components,
+                       uint8_t* rowsPins, uint8_t* colPins) {
+    numRows = rows;
+    numCols = cols;
+    rowPins = nullptr;
+    this->colPins = nullptr;
+    keypad = nullptr;
+    keyStates = nullptr;
+    lastDebounceTime = nullptr;
+    lastAction = nullptr;
+
+    for (const Component& comp : components) {
+        if (comp.type == "button" || (comp.type == "encoder" && comp.withButton)) {
+            ComponentPosition pos;
+            pos.row = comp.startRow;
+            pos.col = comp.startCol;
+            pos.id = comp.id;
+            componentPositions.push_back(pos);
+        }
+    }
+    std::sort(componentPositions.begin(), componentPositions.end());
+    actionMap = new KeyConfig[componentPositions.size()];
+}
+
+KeyHandler::~KeyHandler() {
+    cleanup();
+}
+
+void KeyHandler::cleanup() {
+    delete[] actionMap;
+    actionMap = nullptr;
+    componentPositions.clear();
+}
+
+uint8_t KeyHandler::getTotalKeys() {
+    return componentPositions.size();
+}
+
+void KeyHandler::loadKeyConfiguration(const std::map<String, ActionConfig>& actions) {
+    String defaultLayerName = "default-actions-layer";
+    auto named = actions.find("__default_layer_name__");
+    if (named != actions.end() && !named->second.targetLayer.isEmpty()) {
+        defaultLayerName = named->second.targetLayer;
+    }
+
+    layerConfigs.clear();
+    for (const auto& entry : actions) {
+        if (entry.first == "__default_layer_name__") continue;
+
+        // "layerName:componentId" entries belong to a named layer
+        String layerName = defaultLayerName;
+        String componentId = entry.first;
+        int colonPos = componentId.indexOf(':');
+        if (colonPos > 0) {
+            layerName = componentId.substring(0, colonPos);
+            componentId = componentId.substring(colonPos + 1);
+        }
+
+        const ActionConfig& actionConfig = entry.second;
+        KeyConfig keyConfig;
+        if (actionConfig.type == "hid") {
+            keyConfig.type = ACTION_HID;
+            for (size_t i = 0; i < std::min(actionConfig.report.size(), (size_t)8); i++) {
+                keyConfig.hidReport[i] = strtoul(actionConfig.report[i].c_str(), nullptr, 16);
+            }
+        } else if (actionConfig.type == "multimedia") {
+            keyConfig.type = ACTION_MULTIMEDIA;
+            for (size_t i = 0; i < std::min(actionConfig.report.size(), (size_t)4); i++) {
+                keyConfig.consumerReport[i] = strtoul(actionConfig.report[i].c_str(), nullptr, 16);
+            }
+        } else if (actionConfig.type == "mouse") {
+            keyConfig.type = ACTION_MOUSE;
+        } else if (actionConfig.type == "macro") {
+            keyConfig.type = ACTION_MACRO;
+            keyConfig.macroId = actionConfig.macroId;
+        } else if (actionConfig.type == "layer") {
+            keyConfig.type = ACTION_LAYER;
+            keyConfig.targetLayer = actionConfig.targetLayer;
+        } else if (actionConfig.type == "cycle-layer") {
+            keyConfig.type = ACTION_CYCLE_LAYER;
+        }
+        layerConfigs[layerName][componentId] = keyConfig;
+    }
+
+    if (!isLayerAvailable(currentLayer)) {
+        currentLayer = defaultLayerName;
+    }
+    applyLayerToActionMap(currentLayer);
+}
+
+void KeyHandler::applyLayerToActionMap(const String& layerName) {
+    auto layer = layerConfigs.find(layerName);
+    if (layer == layerConfigs.end()) return;
+
+    for (size_t i = 0; i < componentPositions.size(); i++) {
+        auto config = layer->second.find(componentPositions[i].id);
+        actionMap[i] = config != layer->second.end() ? config->second : KeyConfig();
+    }
+}
+
+bool KeyHandler::switchToLayer(const String& layerName) {
+    if (!isLayerAvailable(layerName)) return false;
+    currentLayer = layerName;
+    applyLayerToActionMap(currentLayer);
+    saveCurrentLayer();
+    return true;
+}
+
+bool KeyHandler::isLayerAvailable(const String& layerName) const {
+    return layerConfigs.find(layerName) != layerConfigs.end();
+}
+
+std::vector<String> KeyHandler::getAvailableLayers() const {
+    std::vector<String> layers;
+    for (const auto& layer : layerConfigs) {
+        layers.push_back(layer.first);
+    }
+    return layers;
+}
+
+bool KeyHandler::saveCurrentLayer() {
+    PersistenceService::putString("layer", currentLayer);
+    EventBus::publish(EVENT_LAYER, 0, 0, 0, currentLayer.c_str());
+    return true;
+}
+
+bool KeyHandler::assignMacroToButton(const String& buttonId, const String& macroId) {
+    for (size_t i = 0; i < componentPositions.size(); i++) {
+        if (componentPositions[i].id == buttonId) {
+            actionMap[i].type = ACTION_MACRO;
+            actionMap[i].macroId = macroId;
+            saveCurrentLayer();
+            return true;
+        }
+    }
+    return false;
+}
+
+// HIDHandler: every report is accepted
+
+HIDHandler::HIDHandler() {
+}
+
+HIDHandler::~HIDHandler() {
+}
+
+bool HIDHandler::sendKeyboardReport(const uint8_t* report, size_t length) {
+    metricHidReportsSent.inc();
+    return true;
+}
+
+bool HIDHandler::sendConsumerReport(const uint8_t* report, size_t length) {
+    metricHidReportsSent.inc();
+    return true;
+}
+
+bool HIDHandler::sendMouseReport(const uint8_t* report, size_t length) {
+    metricHidReportsSent.inc();
+    return true;
+}
+
+bool HIDHandler::sendEmptyKeyboardReport() {
+    metricHidReportsSent.inc();
+    return true;
+}
+
+bool HIDHandler::sendEmptyConsumerReport() {
+    metricHidReportsSent.inc();
+    return true;
+}
+
+bool HIDHandler::sendEmptyMouseReport() {
+    metricHidReportsSent.inc();
+    return true;
+}
+
+// OTAUpdateManager: offline, so checks fail fast and pulled updates are
+// refused. Pushed uploads are hashed and verified for real but not flashed;
+// .gz and patch uploads are not decoded.
+
+String OTAUpdateManager::_updateStatus = "Idle";
+bool OTAUpdateManager::_updateAvailable = false;
+String OTAUpdateManager::_availableVersion = "";
+String OTAUpdateManager::_releaseNotes = "";
+String OTAUpdateManager::_firmwareUrl = "";
+String OTAUpdateManager::_expectedSha256 = "";
+String OTAUpdateManager::_expectedSha256Url = "";
+String OTAUpdateManager::_lastError = "";
+OTAUpdateManager::UpdateState OTAUpdateManager::_updateState = OTAUpdateManager::IDLE;
+int OTAUpdateManager::_updateProgress = 0;
+SHA256Hasher OTAUpdateManager::_sha256;
+int OTAUpdateManager::_lastReportedPercent = -1;
+bool OTAUpdateManager::_uploadActive = false;
+size_t OTAUpdateManager::_uploadTotal = 0;
+size_t OTAUpdateManager::_uploadReceived = 0;
+unsigned long OTAUpdateManager::_uploadLastWrite = 0;
+uint8_t OTAUpdateManager::_uploadDigest[SHA256Hasher::DIGEST_SIZE] = {};
+UpdateProgressCallback OTAUpdateManager::_uploadCallback = nullptr;
+
+bool OTAUpdateManager::checkForUpdates() {
+    _lastError = "offline";
+    return false;
+}
+
+bool OTAUpdateManager::performUpdate(const String& url) {
+    return performUpdate(url, nullptr);
+}
+
+bool OTAUpdateManager::performUpdate(const String& url, UpdateProgressCallback callback) {
+    _updateState = FAILED;
+    _lastError = "offline";
+    return false;
+}
+
+String OTAUpdateManager::getUpdateStatus() { return _updateStatus; }
+String OTAUpdateManager::getLastError() { return _lastError; }
+bool OTAUpdateManager::isUpdateAvailable() { return _updateAvailable; }
+String OTAUpdateManager::getAvailableVersion() { return _availableVersion; }
+String OTAUpdateManager::getReleaseNotes() { return _releaseNotes; }
+String OTAUpdateManager::getFirmwareUrl() { return _firmwareUrl; }
+
+void OTAUpdateManager::setExpectedDigest(const String& url, const String& sha256Hex) {
+    _expectedSha256Url = url;
+    _expectedSha256 = sha256Hex;
+}
+OTAUpdateManager::UpdateState OTAUpdateManager::getUpdateState() { return _updateState; }
+int OTAUpdateManager::getUpdateProgress() { return _updateProgress; }
+
+bool OTAUpdateManager::isBusy() { return _uploadActive; }
+bool OTAUpdateManager::isUploadActive() { return _uploadActive; }
+
+bool OTAUpdateManager::beginUpload(const String& name, size_t total, const String& sha256Hex,
+                                   const String& signatureHex, UpdateProgressCallback callback) {
+    if (_uploadActive) {
+        _lastError = "Update already in progress";
+        return false;
+    }
+    if (!SHA256Hasher::parseHex(sha256Hex, _uploadDigest)) {
+        _lastError = "Upload needs the image's SHA-256 (sha256=<hex>)";
+        _updateState = FAILED;
+        return false;
+    }
+    _uploadActive = true;
+    _uploadTotal = total;
+    _uploadReceived = 0;
+    _uploadCallback = callback;
+    _lastReportedPercent = -1;
+    _updateState = INSTALLING;
+    _sha256.begin();
+    return true;
+}
+
+bool OTAUpdateManager::writeUpload(const uint8_t* data, size_t length) {
+    if (!_uploadActive) return false;
+    _sha256.add(data, length);
+    _uploadReceived += length;
+    int percent = _uploadTotal > 0 ? (int)std::min((size_t)99, _uploadReceived * 100 / _uploadTotal) : 0;
+    if (percent != _lastReportedPercent) {
+        _lastReportedPercent = percent;
+        _updateProgress = percent;
+        if (_uploadCallback != nullptr) _uploadCallback(_uploadReceived, _uploadTotal, percent);
+    }
+    return true;
+}
+
+bool OTAUpdateManager::finishUpload() {
+    if (!_uploadActive) return false;
+    _uploadActive = false;
+    _sha256.calculate();
+    if (memcmp(_sha256.getBytes(), _uploadDigest, SHA256Hasher::DIGEST_SIZE) != 0) {
+        _lastError = "SHA-256 mismatch: got " + _sha256.toString();
+        _updateState = FAILED;
+        return false;
+    }
+    _updateProgress = 100;
+    _updateStatus = "Upload installed, restarting...";
+    _updateState = COMPLETE;
+    return true;
+}
+
+void OTAUpdateManager::abortUpload(const String& reason) {
+    _uploadActive = false;
+    _lastError = reason;
+    _updateState = FAILED;
+}
+
+// OTAPipeline: never started, so there is no transfer to report
+
+OTAPipeline::Stats OTAPipeline::getStats() {
+    Stats stats = {};
+    return stats;
+}
+
+// UpdateProgressDisplay: no panel
+
+void UpdateProgressDisplay::updateProgress(size_t current, size_t total, int percentage) {
+}
+
+void UpdateProgressDisplay::drawProgressScreen(const String& title, int percentage, const String& message) {
+}
@@ -0,0 +1,1513 @@
+// InputBench.cpp
+//
+// Runs the real input path on the host: KeyHandler scans a simulated key
+// matrix, EncoderHandler reads simulated encoders, MacroHandler plays the
+// macros in data/macros and HIDHandler hands every report to a recording USB
+// sink. Each scenario checks what reached the sink against
+// config/actions.json and times the handler calls that produced it. Results
+// are written as JSON and can be compared with a previous run; the exit code
+// is 1 on a failed check or a regression.
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include <USBHIDMouse.h>
+#include <Adafruit_NeoPixel.h>
+#include <Encoder.h>
+#include <AS5600.h>
+#include "HostClock.h"
+#include "HostGpio.h"
+#include "HostHeap.h"
+#include "HostHid.h"
+#include "ConfigManager.h"
+#include "KeyHandler.h"
+#include "HIDHandler.h"
+#include "EncoderHandler.h"
+#include "MacroHandler.h"
+#include "LEDHandler.h"
+#include "PersistenceService.h"
+#include "MetricsRegistry.h"
+#include "TaskManager.h"
+#include "BinaryLog.h"
+#include "InputEventStream.h"
+#include <stdarg.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+// Globals normally defined in main.cpp
+USBCDC USBSerial;
+USBHIDMouse Mouse;
+
+void createWorkingActionsFile() {
+    File src = LittleFS.open("/config/defaults/actions.json", "r");
+    if (!src) return;
+    File dst = LittleFS.open("/config/actions.json", "w");
+    if (dst) {
+        uint8_t buf[512];
+        size_t n;
+        while ((n = src.read(buf, sizeof(buf))) > 0) {
+            dst.write(buf, n);
+        }
+        dst.close();
+    }
+    src.close();
+}
+
+namespace {
+
+// Regression thresholds against --baseline
+const double P99_REGRESSION = 1.25;    // p99 latency up by more than 25%
+const double ALLOC_REGRESSION = 1.10;  // Allocations per iteration up by more than 10%
+
+// Matrix wiring, as in main.cpp
+const uint8_t ROWS = 5;
+const uint8_t COLS = 5;
+uint8_t ROW_PINS[ROWS] = { 3, 5, 8, 9, 10 };
+uint8_t COL_PINS[COLS] = { 11, 21, 13, 6, 12 };
+
+// Longest a macro may run, in virtual time, before it counts as stuck
+const uint32_t MACRO_TIMEOUT_MS = 60000;
+
+// Reports one sampled call may send without the recording sink growing
+// inside the measurement window
+const size_t REPORTS_PER_CALL = 256;
+
+// Failure messages kept per scenario
+const size_t MAX_MESSAGES = 5;
+
+struct Options {
+    std::string dataDir = "data";
+    std::string outFile = "host_input_results.json";
+    std::string baselineFile;
+    uint32_t iterations = 200;
+    bool echoLog = false;
+    std::string replayFile;      // Timeline to replay instead of the scenarios
+    std::string goldenFile;      // Report stream the replay must reproduce
+    std::string recordFile;      // Where to write the replay's report stream
+};
+
+struct Result {
+    std::string name;
+    uint32_t iterations = 0;
+    double p50Us = 0, p90Us = 0, p99Us = 0, maxUs = 0;
+    double reportsPerIteration = 0;
+    double allocsPerIteration = 0;
+    double gpioReadsPerIteration = 0;
+    uint32_t failures = 0;
+    std::vector<std::string> messages;
+};
+
+// A button whose action ends up as a HID report
+struct KeyCase {
+    String id;
+    uint8_t row = 0;
+    uint8_t col = 0;
+    String type;                 // "hid", "multimedia" or "mouse"
+    uint8_t report[8] = { 0 };
+};
+
+struct EncoderCase {
+    String id;
+    uint8_t pinA = 0;
+    int8_t direction = 1;
+    String cwType, ccwType;
+    uint8_t cwReport[8] = { 0 };
+    uint8_t ccwReport[8] = { 0 };
+};
+
+bool parseArgs(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "%s needs a value\n", name);
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--data") {
+            const char* v = next("--data");
+            if (v == nullptr) return false;
+            options.dataDir = v;
+        } else if (arg == "--out") {
+            const char* v = next("--out");
+            if (v == nullptr) return false;
+            options.outFile = v;
+        } else if (arg == "--baseline") {
+            const char* v = next("--baseline");
+            if (v == nullptr) return false;
+            options.baselineFile = v;
+        } else if (arg == "--iterations") {
+            const char* v = next("--iterations");
+            if (v == nullptr) return false;
+            options.iterations = std::max(1, atoi(v));
+        } else if (arg == "--log") {
+            options.echoLog = true;
+        } else if (arg == "--replay") {
+            const char* v = next("--replay");
+            if (v == nullptr) return false;
+            options.replayFile = v;
+        } else if (arg == "--golden") {
+            const char* v = next("--golden");
+            if (v == nullptr) return false;
+            options.goldenFile = v;
+        } else if (arg == "--record") {
+            const char* v = next("--record");
+            if (v == nullptr) return false;
+            options.recordFile = v;
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--data DIR] [--iterations N] [--baseline FILE] [--out FILE] [--log]\n"
+                    "       [--replay TIMELINE [--golden FILE] [--record FILE]]\n",
+                    argv[0]);
+            return false;
+        }
+    }
+    if (options.replayFile.empty() && (!options.goldenFile.empty() || !options.recordFile.empty())) {
+        fprintf(stderr, "--golden and --record need --replay\n");
+        return false;
+    }
+    return true;
+}
+
+std::string readHostFile(const stdfs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void fail(Result& result, const char* format, ...) {
+    result.failures++;
+    if (result.messages.size() >= MAX_MESSAGES) return;
+
+    char message[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    result.messages.push_back(message);
+}
+
+// Accumulates timed handler calls for one scenario
+class Sampler {
+public:
+    explicit Sampler(Result& result) : _result(result) {}
+
+    // Fail the scenario if a sampled call allocates once warmupIterations
+    // have run: the input and HID paths must not touch the heap after boot
+    void requireNoAllocations(uint32_t warmupIterations) {
+        _allocFree = true;
+        _warmup = warmupIterations;
+    }
+
+    void begin() {
+        HostHid::reserve(REPORTS_PER_CALL);
+        HostHeap::resetWindow();
+        HostGpio::resetCounters();
+        _reportsStart = HostHid::reports().size();
+        _start = std::chrono::steady_clock::now();
+    }
+
+    // Time spent since begin() joins the current iteration
+    void end() {
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        _iterationUs += std::chrono::duration<double, std::micro>(elapsed).count();
+        uint64_t allocs = HostHeap::snapshot().allocations;
+        _allocs += allocs;
+        if (_allocFree && _latencies.size() >= _warmup) {
+            _steadyAllocs += allocs;
+        }
+        _gpioReads += HostGpio::reads();
+        _reports += HostHid::reports().size() - _reportsStart;
+    }
+
+    void nextIteration() {
+        _latencies.push_back(_iterationUs);
+        _iterationUs = 0;
+    }
+
+    void finish() {
+        uint32_t n = (uint32_t)_latencies.size();
+        _result.iterations = n;
+        if (n == 0) return;
+
+        std::sort(_latencies.begin(), _latencies.end());
+        _result.p50Us = percentile(_latencies, 0.50);
+        _result.p90Us = percentile(_latencies, 0.90);
+        _result.p99Us = percentile(_latencies, 0.99);
+        _result.maxUs = _latencies.back();
+        _result.reportsPerIteration = (double)_reports / n;
+        _result.allocsPerIteration = (double)_allocs / n;
+        _result.gpioReadsPerIteration = (double)_gpioReads / n;
+        if (_steadyAllocs > 0) {
+            fail(_result, "%llu allocations after %u warm-up iterations",
+                 (unsigned long long)_steadyAllocs, _warmup);
+        }
+    }
+
+private:
+    Result& _result;
+    std::vector<double> _latencies;
+    std::chrono::steady_clock::time_point _start;
+    double _iterationUs = 0;
+    size_t _reportsStart = 0;
+    uint64_t _reports = 0;
+    uint64_t _allocs = 0;
+    uint64_t _gpioReads = 0;
+    bool _allocFree = false;
+    uint32_t _warmup = 0;
+    uint64_t _steadyAllocs = 0;
+};
+
+void parseReport(JsonArrayConst array, uint8_t* report, size_t size) {
+    size_t i = 0;
+    for (JsonVariantConst value : array) {
+        if (i >= size) break;
+        report[i++] = (uint8_t)strtoul(value | "0", nullptr, 16);
+    }
+}
+
+// The configured actions of one layer, read independently of ConfigManager
+bool loadLayerConfig(const char* path, const String& layerName, DynamicJsonDocument& doc, JsonObjectConst& layer) {
+    std::string json = readHostFile(LittleFS.hostPath(path));
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return false;
+    }
+    for (JsonObjectConst entry : doc["actions"]["layers"].as<JsonArrayConst>()) {
+        if (layerName == (entry["layer-name"] | "")) {
+            layer = entry["layer-config"];
+            return true;
+        }
+    }
+    fprintf(stderr, "%s: no layer %s\n", path, layerName.c_str());
+    return false;
+}
+
+std::vector<KeyCase> buildKeyCases(const std::vector<Component>& components, JsonObjectConst layer) {
+    std::vector<KeyCase> cases;
+    for (const Component& component : components) {
+        if (component.type != "button") continue;
+        JsonObjectConst action = layer[component.id.c_str()];
+        if (action.isNull()) continue;
+
+        KeyCase c;
+        c.id = component.id;
+        c.row = (uint8_t)component.startRow;
+        c.col = (uint8_t)component.startCol;
+        c.type = action["type"] | "";
+        if (c.type != "hid" && c.type != "multimedia" && c.type != "mouse") continue;
+        if (c.row >= ROWS || c.col >= COLS) continue;
+        parseReport(action["report"], c.report, sizeof(c.report));
+        cases.push_back(c);
+    }
+    return cases;
+}
+
+std::vector<EncoderCase> buildEncoderCases(JsonObjectConst layer) {
+    std::vector<EncoderCase> cases;
+    DynamicJsonDocument doc(16384);
+    std::string json = readHostFile(LittleFS.hostPath("/config/components.json"));
+    if (deserializeJson(doc, json)) return cases;
+
+    for (JsonObjectConst component : doc["components"].as<JsonArrayConst>()) {
+        String type = component["type"] | "";
+        if (type != "encoder") continue;
+
+        EncoderCase c;
+        c.id = component["id"] | "";
+        c.pinA = component["mechanical"]["pin_a"] | 0;
+        c.direction = component["configuration"]["direction"] | 1;
+        String sensor = component["configuration"]["type"] | "mechanical";
+
+        JsonObjectConst action = layer[c.id.c_str()];
+        c.cwType = action["clockwise"]["type"] | "";
+        c.ccwType = action["counterclockwise"]["type"] | "";
+        parseReport(action["clockwise"]["report"], c.cwReport, sizeof(c.cwReport));
+        parseReport(action["counterclockwise"]["report"], c.ccwReport, sizeof(c.ccwReport));
+        if (sensor == "mechanical" && c.pinA > 0) {
+            cases.push_back(c);
+        }
+    }
+    return cases;
+}
+
+// Bring up the encoders as initializeEncoderHandler() does on the device
+void initializeEncoders(const std::vector<Component>& components) {
+    uint8_t count = 0;
+    for (const Component& component : components) {
+        if (component.type == "encoder") count++;
+    }
+    if (count == 0) return;
+
+    DynamicJsonDocument doc(16384);
+    std::string json = readHostFile(LittleFS.hostPath("/config/components.json"));
+    if (deserializeJson(doc, json)) return;
+
+    encoderHandler = new EncoderHandler(count);
+    uint8_t index = 0;
+    for (JsonObjectConst component : doc["components"].as<JsonArrayConst>()) {
+        String type = component["type"] | "";
+        if (type != "encoder") continue;
+
+        String sensor = component["configuration"]["type"] | "mechanical";
+        encoderHandler->configureEncoder(index++,
+                                         sensor == "as5600" ? ENCODER_TYPE_AS5600 : ENCODER_TYPE_MECHANICAL,
+                                         component["mechanical"]["pin_a"] | 0,
+                                         component["mechanical"]["pin_b"] | 0,
+                                         component["configuration"]["direction"] | 1,
+                                         0);
+    }
+    encoderHandler->begin();
+}
+
+// One pass of the hid and ui tasks, so queued reports and bus events drain
+void runOutputTasks() {
+    updateMacroHandler();
+    updateHIDHandler();
+    updateLEDs();
+    BinaryLog::drain();
+}
+
+uint16_t consumerUsage(const HostHid::Report& report) {
+    return (uint16_t)(report.data[0] | (report.data[1] << 8));
+}
+
+// What the scan that pressed or released a key must have sent
+void checkKeyReports(Result& result, const KeyCase& c, bool pressed, size_t first) {
+    const std::vector<HostHid::Report>& reports = HostHid::reports();
+    if (reports.size() <= first) {
+        fail(result, "%s %s: no report", c.id.c_str(), pressed ? "press" : "release");
+        return;
+    }
+    const HostHid::Report& report = reports.back();
+
+    if (c.type == "hid") {
+        if (report.kind != HostHid::REPORT_KEYBOARD) {
+            fail(result, "%s: expected a keyboard report", c.id.c_str());
+            return;
+        }
+        std::multiset<uint8_t> expected, sent;
+        for (int i = 2; i < 8; i++) {
+            if (pressed && c.report[i] != 0) expected.insert(c.report[i]);
+            if (report.data[i] != 0) sent.insert(report.data[i]);
+        }
+        uint8_t modifier = pressed ? c.report[0] : 0;
+        if (report.data[0] != modifier || expected != sent) {
+            fail(result, "%s %s: keyboard report %02X %02X %02X %02X %02X %02X %02X %02X",
+                 c.id.c_str(), pressed ? "press" : "release", report.data[0], report.data[1], report.data[2],
+                 report.data[3], report.data[4], report.data[5], report.data[6], report.data[7]);
+        }
+    } else if (c.type == "multimedia") {
+        uint16_t usage = pressed ? c.report[2] : 0;
+        if (report.kind != HostHid::REPORT_OTHER || consumerUsage(report) != usage) {
+            fail(result, "%s %s: consumer usage 0x%04X, expected 0x%04X",
+                 c.id.c_str(), pressed ? "press" : "release", consumerUsage(report), usage);
+        }
+    } else if (c.type == "mouse") {
+        uint8_t expected[4] = { 0 };
+        if (pressed) memcpy(expected, c.report, 4);
+        if (report.kind != HostHid::REPORT_MOUSE || memcmp(report.data, expected, 4) != 0) {
+            fail(result, "%s %s: mouse report %02X %02X %02X %02X, expected %02X %02X %02X %02X",
+                 c.id.c_str(), pressed ? "press" : "release", report.data[0], report.data[1],
+                 report.data[2], report.data[3], expected[0], expected[1], expected[2], expected[3]);
+        }
+    }
+}
+
+Result runIdleScan(const Options& options) {
+    Result result;
+    result.name = "matrix_scan_idle";
+    HostGpio::openAllSwitches();
+
+    Sampler sampler(result);
+    sampler.requireNoAllocations(1);
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        HostClock::advance(DEBOUNCE_TIME);
+        size_t before = HostHid::reports().size();
+        sampler.begin();
+        keyHandler->updateKeys();
+        sampler.end();
+        sampler.nextIteration();
+        if (HostHid::reports().size() != before) {
+            fail(result, "idle scan sent a report");
+        }
+        runOutputTasks();
+    }
+    sampler.finish();
+    return result;
+}
+
+// Press and release every reporting key; one iteration is one full tap
+std::vector<Result> runKeyTaps(const Options& options, const std::vector<KeyCase>& cases) {
+    Result taps;
+    taps.name = "key_tap";
+    Result leds;
+    leds.name = "led_frame";
+
+    Sampler tapSampler(taps);
+    Sampler ledSampler(leds);
+    // One tap of every key first: a key's first report may still allocate
+    tapSampler.requireNoAllocations((uint32_t)cases.size());
+    uint32_t framesBefore = strip ? strip->shows() : 0;
+
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        const KeyCase& c = cases[i % cases.size()];
+        for (int phase = 0; phase < 2; phase++) {
+            bool pressed = phase == 0;
+            HostGpio::setSwitch(ROW_PINS[c.row], COL_PINS[c.col], pressed);
+            HostClock::advance(DEBOUNCE_TIME);
+
+            size_t first = HostHid::reports().size();
+            tapSampler.begin();
+            keyHandler->updateKeys();
+            tapSampler.end();
+            checkKeyReports(taps, c, pressed, first);
+
+            ledSampler.begin();
+            updateLEDs();
+            ledSampler.end();
+            runOutputTasks();
+        }
+        tapSampler.nextIteration();
+        ledSampler.nextIteration();
+    }
+    tapSampler.finish();
+    ledSampler.finish();
+
+    if (strip != nullptr && numLEDs > 0 && strip->shows() == framesBefore) {
+        fail(leds, "no LED frame was shown for %u key taps", options.iterations);
+    }
+    return { taps, leds };
+}
+
+// Cycle-layer keys change the action map; the layer must actually move
+Result runLayerCycle(const Options& options, const std::vector<Component>& components, JsonObjectConst layer) {
+    Result result;
+    result.name = "layer_cycle";
+
+    const Component* key = nullptr;
+    for (const Component& component : components) {
+        String type = layer[component.id.c_str()]["type"] | "";
+        if (component.type == "button" && type == "cycle-layer") {
+            key = &component;
+            break;
+        }
+    }
+    if (key == nullptr || keyHandler->getAvailableLayers().size() < 2) {
+        return result;
+    }
+
+    String original = keyHandler->getCurrentLayer();
+    Sampler sampler(result);
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        String before = keyHandler->getCurrentLayer();
+        for (int phase = 0; phase < 2; phase++) {
+            HostGpio::setSwitch(ROW_PINS[key->startRow], COL_PINS[key->startCol], phase == 0);
+            HostClock::advance(DEBOUNCE_TIME);
+            sampler.begin();
+            keyHandler->updateKeys();
+            sampler.end();
+            runOutputTasks();
+        }
+        sampler.nextIteration();
+        if (keyHandler->getCurrentLayer() == before) {
+            fail(result, "%s left the layer at %s", key->id.c_str(), before.c_str());
+        }
+    }
+    sampler.finish();
+    keyHandler->switchToLayer(original);
+    return result;
+}
+
+// One detent per iteration, alternating direction
+Result runEncoderSteps(const Options& options, const std::vector<EncoderCase>& cases) {
+    Result result;
+    result.name = "encoder_step";
+    if (encoderHandler == nullptr || cases.empty()) return result;
+
+    const uint32_t encoderDebounceMs = 200;   // Above EncoderHandler's 150 ms
+    Sampler sampler(result);
+    // Both directions of every encoder first
+    sampler.requireNoAllocations((uint32_t)cases.size() * 2);
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        const EncoderCase& c = cases[i % cases.size()];
+        bool clockwise = (i / cases.size()) % 2 == 0;
+        Encoder::hostTurn(c.pinA, clockwise ? c.direction : -c.direction);
+        HostClock::advance(encoderDebounceMs);
+
+        size_t first = HostHid::reports().size();
+        sampler.begin();
+        encoderHandler->updateEncoders();
+        sampler.end();
+        sampler.nextIteration();
+
+        const String& type = clockwise ? c.cwType : c.ccwType;
+        const uint8_t* expected = clockwise ? c.cwReport : c.ccwReport;
+        const std::vector<HostHid::Report>& reports = HostHid::reports();
+        if (type == "multimedia" || type == "hid") {
+            // The action is sent and released within the step
+            if (reports.size() < first + 2) {
+                fail(result, "%s %s: %zu reports", c.id.c_str(), clockwise ? "cw" : "ccw", reports.size() - first);
+            } else if (type == "multimedia" && consumerUsage(reports[first]) != expected[2]) {
+                fail(result, "%s %s: consumer usage 0x%04X, expected 0x%04X", c.id.c_str(),
+                     clockwise ? "cw" : "ccw", consumerUsage(reports[first]), expected[2]);
+            } else if (type == "hid" && (reports[first].data[0] != expected[0] ||
+                                         memcmp(&reports[first].data[2], &expected[2], 6) != 0)) {
+                fail(result, "%s %s: keyboard report differs from the configured one", c.id.c_str(),
+                     clockwise ? "cw" : "ccw");
+            }
+        }
+        runOutputTasks();
+    }
+    sampler.finish();
+    return result;
+}
+
+// Play each macro to completion, polling as the hid task does
+std::vector<Result> runMacros(const Options& options) {
+    std::vector<Result> results;
+    if (macroHandler == nullptr) return results;
+
+    const uint32_t periodMs = TaskManager::getConfig(TASK_HID).periodMs;
+    for (const String& id : macroHandler->getAvailableMacros()) {
+        Result result;
+        result.name = std::string("macro/") + id.c_str();
+        Sampler sampler(result);
+        sampler.requireNoAllocations(1);
+        long expectedReports = -1;
+
+        for (uint32_t i = 0; i < options.iterations; i++) {
+            size_t first = HostHid::reports().size();
+            sampler.begin();
+            bool started = macroHandler->executeMacro(id);
+            sampler.end();
+            if (!started) {
+                fail(result, "did not start");
+                break;
+            }
+
+            uint32_t elapsedMs = 0;
+            while (macroHandler->isExecuting() && elapsedMs < MACRO_TIMEOUT_MS) {
+                HostClock::advance(periodMs);
+                elapsedMs += periodMs;
+                sampler.begin();
+                updateMacroHandler();
+                updateHIDHandler();
+                sampler.end();
+            }
+            sampler.nextIteration();
+            runOutputTasks();
+
+            long sent = (long)(HostHid::reports().size() - first);
+            if (macroHandler->isExecuting()) {
+                fail(result, "still running after %u ms", MACRO_TIMEOUT_MS);
+                break;
+            }
+            if (sent == 0) {
+                fail(result, "sent no reports");
+            } else if (expectedReports >= 0 && sent != expectedReports) {
+                fail(result, "sent %ld reports, %ld on the first run", sent, expectedReports);
+            }
+            expectedReports = sent;
+        }
+        sampler.finish();
+        results.push_back(result);
+    }
+    return results;
+}
+
+// Reload the macros while one is running, as a macro upload does from the
+// web server task: the run must stop without leaving keys down, and the
+// reloaded macro must play to the end
+Result runMacroReload(const Options& options) {
+    Result result;
+    result.name = "macro_reload";
+    if (macroHandler == nullptr) return result;
+
+    const uint32_t periodMs = TaskManager::getConfig(TASK_HID).periodMs;
+    std::vector<String> ids = macroHandler->getAvailableMacros();
+    if (ids.empty()) return result;
+
+    Sampler sampler(result);
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        const String& id = ids[i % ids.size()];
+        if (!macroHandler->executeMacro(id)) {
+            fail(result, "%s did not start", id.c_str());
+            break;
+        }
+
+        // Run until the macro has sent something, so the reload lands mid-run
+        size_t first = HostHid::reports().size();
+        uint32_t elapsedMs = 0;
+        while (macroHandler->isExecuting() && HostHid::reports().size() == first &&
+               elapsedMs < MACRO_TIMEOUT_MS) {
+            HostClock::advance(periodMs);
+            elapsedMs += periodMs;
+            updateMacroHandler();
+            updateHIDHandler();
+        }
+
+        sampler.begin();
+        bool loaded = macroHandler->loadMacros();
+        sampler.end();
+        sampler.nextIteration();
+        runOutputTasks();
+
+        if (!loaded) {
+            fail(result, "reload during %s failed", id.c_str());
+            break;
+        }
+        if (macroHandler->isExecuting()) {
+            fail(result, "%s still running after the reload", id.c_str());
+            break;
+        }
+        for (auto it = HostHid::reports().rbegin(); it != HostHid::reports().rend(); ++it) {
+            if (it->kind != HostHid::REPORT_KEYBOARD) continue;
+            static const uint8_t released[8] = { 0 };
+            if (memcmp(it->data, released, sizeof(released)) != 0) {
+                fail(result, "%s: keys left down after the reload", id.c_str());
+            }
+            break;
+        }
+
+        if (!macroHandler->executeMacro(id)) {
+            fail(result, "%s did not start after the reload", id.c_str());
+            break;
+        }
+        elapsedMs = 0;
+        while (macroHandler->isExecuting() && elapsedMs < MACRO_TIMEOUT_MS) {
+            HostClock::advance(periodMs);
+            elapsedMs += periodMs;
+            updateMacroHandler();
+            updateHIDHandler();
+        }
+        runOutputTasks();
+        if (macroHandler->isExecuting()) {
+            fail(result, "%s still running %u ms after the reload", id.c_str(), MACRO_TIMEOUT_MS);
+            break;
+        }
+    }
+    sampler.finish();
+    return result;
+}
+
+// Reload the actions file into the key map, as a config upload does
+Result runConfigReload(const Options& options) {
+    Result result;
+    result.name = "config_reload";
+
+    String layer = keyHandler->getCurrentLayer();
+    Sampler sampler(result);
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        sampler.begin();
+        std::map<String, ActionConfig> actions = ConfigManager::loadActions("/config/actions.json");
+        keyHandler->loadKeyConfiguration(actions);
+        keyHandler->applyLayerToActionMap(layer);
+        sampler.end();
+        sampler.nextIteration();
+        if (actions.empty()) {
+            fail(result, "no actions loaded");
+            break;
+        }
+        BinaryLog::drain();
+    }
+    sampler.finish();
+    return result;
+}
+
+// The built-in scenarios, checked against the current layer of actions.json
+bool runScenarios(const Options& options, const std::vector<Component>& components, std::vector<Result>& results) {
+    DynamicJsonDocument actionsDoc(32768);
+    JsonObjectConst layer;
+    if (!loadLayerConfig("/config/actions.json", keyHandler->getCurrentLayer(), actionsDoc, layer)) {
+        return false;
+    }
+    std::vector<KeyCase> keyCases = buildKeyCases(components, layer);
+    std::vector<EncoderCase> encoderCases = buildEncoderCases(layer);
+
+    printf("Running input scenarios x %u iterations: %zu keys, %zu encoders\n",
+           options.iterations, keyCases.size(), encoderCases.size());
+
+    results.push_back(runIdleScan(options));
+    if (!keyCases.empty()) {
+        for (const Result& r : runKeyTaps(options, keyCases)) results.push_back(r);
+    }
+    results.push_back(runLayerCycle(options, components, layer));
+    results.push_back(runEncoderSteps(options, encoderCases));
+    for (const Result& r : runMacros(options)) results.push_back(r);
+    results.push_back(runMacroReload(options));
+    results.push_back(runConfigReload(options));
+    return true;
+}
+
+// Replay
+
+// Idle time before each replay run, longer than any handler throttle or
+// debounce window, so every run starts from the same state
+const uint32_t REPLAY_IDLE_MS = 1000;
+
+// Idle time after the last event of a timeline, so its reports drain
+const uint32_t REPLAY_SETTLE_MS = 1000;
+
+// Time from the start of a run to the first event of a device capture
+const uint32_t CAPTURE_LEAD_IN_MS = 100;
+
+// Default hold time of a "tap" event
+const uint32_t REPLAY_TAP_MS = 60;
+
+// Input signals a timeline can drive
+enum ReplayEventType : uint8_t {
+    REPLAY_KEY,        // Close (value 1) or open (0) a matrix switch
+    REPLAY_ENCODER,    // Turn a mechanical encoder by `value` counts
+    REPLAY_ANGLE,      // Set the AS5600 magnet to raw angle `value`
+    REPLAY_MACRO,      // Start a macro, as a macro key would
+    REPLAY_USB_READY   // The USB host accepts reports (value 1) or is busy (0)
+};
+
+struct ReplayEvent {
+    uint64_t atUs = 0;
+    ReplayEventType type = REPLAY_KEY;
+    uint8_t row = 0;
+    uint8_t col = 0;
+    uint8_t pin = 0;
+    int32_t value = 0;
+    String macroId;
+};
+
+struct ReplayTimeline {
+    std::string name;
+    String layer;                     // Layer each run starts on; empty keeps the current one
+    uint64_t durationUs = 0;
+    std::vector<ReplayEvent> events;  // Sorted by time
+    uint32_t skipped = 0;             // Capture events there is no input to drive (sliders)
+};
+
+struct ReplayEncoder {
+    String id;
+    uint8_t pinA = 0;
+    int8_t direction = 1;
+    bool as5600 = false;
+};
+
+// One task of the input path, scheduled as TaskManager's trampoline does
+struct ReplayTask {
+    ManagedTask task;
+    void (*work)();
+    uint64_t periodUs;
+    uint64_t nextUs;
+};
+
+// The task bodies from main.cpp, minus the display and the network
+void replayKeyboardTask() {
+    if (keyHandler) keyHandler->updateKeys();
+}
+
+void replayEncoderTask() {
+    if (encoderHandler) encoderHandler->updateEncoders();
+}
+
+void replayHidTask() {
+    updateMacroHandler();
+    updateHIDHandler();
+}
+
+void replayUiTask() {
+    updateLEDs();
+}
+
+// Encoders in components.json order, which is also their EncoderHandler index
+std::vector<ReplayEncoder> loadReplayEncoders() {
+    std::vector<ReplayEncoder> encoders;
+    DynamicJsonDocument doc(16384);
+    std::string json = readHostFile(LittleFS.hostPath("/config/components.json"));
+    if (deserializeJson(doc, json)) return encoders;
+
+    for (JsonObjectConst component : doc["components"].as<JsonArrayConst>()) {
+        String type = component["type"] | "";
+        if (type != "encoder") continue;
+
+        ReplayEncoder encoder;
+        encoder.id = component["id"] | "";
+        encoder.pinA = component["mechanical"]["pin_a"] | 0;
+        encoder.direction = (component["configuration"]["direction"] | 1) < 0 ? -1 : 1;
+        encoder.as5600 = String(component["configuration"]["type"] | "mechanical") == "as5600";
+        encoders.push_back(encoder);
+    }
+    return encoders;
+}
+
+// Matrix positions in KeyHandler's component index order
+std::vector<std::pair<uint8_t, uint8_t>> keyPositions(const std::vector<Component>& components) {
+    std::vector<std::pair<uint8_t, uint8_t>> positions;
+    for (const Component& comp : components) {
+        if (comp.type == "button" || (comp.type == "encoder" && comp.withButton)) {
+            positions.push_back(std::make_pair((uint8_t)comp.startRow, (uint8_t)comp.startCol));
+        }
+    }
+    std::sort(positions.begin(), positions.end());
+    return positions;
+}
+
+const Component* findComponent(const std::vector<Component>& components, const String& id) {
+    for (const Component& component : components) {
+        if (component.id == id) return &component;
+    }
+    return nullptr;
+}
+
+const ReplayEncoder* findEncoder(const std::vector<ReplayEncoder>& encoders, const String& id) {
+    for (const ReplayEncoder& encoder : encoders) {
+        if (encoder.id == id) return &encoder;
+    }
+    return nullptr;
+}
+
+// A scripted timeline: {"name", "layer", "settle_ms", "events": [{"at_ms", ...}]}
+bool parseReplayScript(const std::string& json, const std::vector<Component>& components,
+                       const std::vector<ReplayEncoder>& encoders, ReplayTimeline& timeline) {
+    DynamicJsonDocument doc(json.size() * 4 + 4096);
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        fprintf(stderr, "Timeline: %s\n", error.c_str());
+        return false;
+    }
+
+    timeline.name = doc["name"] | "replay";
+    timeline.layer = doc["layer"] | "";
+    uint32_t settleMs = doc["settle_ms"] | REPLAY_SETTLE_MS;
+
+    uint32_t index = 0;
+    for (JsonObjectConst entry : doc["events"].as<JsonArrayConst>()) {
+        index++;
+        ReplayEvent event;
+        event.atUs = (uint64_t)(entry["at_ms"] | 0u) * 1000;
+
+        if (entry.containsKey("key") || entry.containsKey("tap")) {
+            bool tap = entry.containsKey("tap");
+            String id = tap ? (entry["tap"] | "") : (entry["key"] | "");
+            const Component* component = findComponent(components, id);
+            if (component == nullptr || component->startRow >= ROWS || component->startCol >= COLS) {
+                fprintf(stderr, "Timeline event %u: no key %s in the matrix\n", index, id.c_str());
+                return false;
+            }
+            event.type = REPLAY_KEY;
+            event.row = (uint8_t)component->startRow;
+            event.col = (uint8_t)component->startCol;
+            event.value = (tap || (entry["down"] | false)) ? 1 : 0;
+            timeline.events.push_back(event);
+            if (tap) {
+                event.atUs += (uint64_t)(entry["hold_ms"] | REPLAY_TAP_MS) * 1000;
+                event.value = 0;
+                timeline.events.push_back(event);
+            }
+        } else if (entry.containsKey("encoder")) {
+            const ReplayEncoder* encoder = findEncoder(encoders, entry["encoder"] | "");
+            if (encoder == nullptr || encoder->as5600) {
+                fprintf(stderr, "Timeline event %u: no mechanical encoder %s\n", index,
+                        (const char*)(entry["encoder"] | ""));
+                return false;
+            }
+            // Steps are clockwise-positive, as the handler sees them
+            event.type = REPLAY_ENCODER;
+            event.pin = encoder->pinA;
+            event.value = (int32_t)(entry["steps"] | 1) * encoder->direction;
+            timeline.events.push_back(event);
+        } else if (entry.containsKey("angle")) {
+            const ReplayEncoder* encoder = findEncoder(encoders, entry["angle"] | "");
+            if (encoder == nullptr || !encoder->as5600) {
+                fprintf(stderr, "Timeline event %u: no AS5600 encoder %s\n", index,
+                        (const char*)(entry["angle"] | ""));
+                return false;
+            }
+            event.type = REPLAY_ANGLE;
+            event.value = entry["raw"] | 0;
+            timeline.events.push_back(event);
+        } else if (entry.containsKey("macro")) {
+            event.type = REPLAY_MACRO;
+            event.macroId = entry["macro"] | "";
+            timeline.events.push_back(event);
+        } else if (entry.containsKey("usb_ready")) {
+            event.type = REPLAY_USB_READY;
+            event.value = (entry["usb_ready"] | true) ? 1 : 0;
+            timeline.events.push_back(event);
+        } else {
+            fprintf(stderr, "Timeline event %u: no key, tap, encoder, angle, macro or usb_ready\n", index);
+            return false;
+        }
+    }
+
+    std::stable_sort(timeline.events.begin(), timeline.events.end(),
+                     [](const ReplayEvent& a, const ReplayEvent& b) { return a.atUs < b.atUs; });
+    uint64_t lastUs = timeline.events.empty() ? 0 : timeline.events.back().atUs;
+    timeline.durationUs = lastUs + (uint64_t)settleMs * 1000;
+    return true;
+}
+
+// A capture of the device's input event stream: the binary WebSocket frames
+// of a subscribe_input session, concatenated in the order they arrived
+bool parseCapture(const std::string& bytes, const std::vector<Component>& components,
+                  const std::vector<ReplayEncoder>& encoders, ReplayTimeline& timeline) {
+    std::vector<std::pair<uint8_t, uint8_t>> positions = keyPositions(components);
+    std::vector<int32_t> encoderPositions(encoders.size(), 0);
+    timeline.name = "capture";
+
+    const uint8_t* data = (const uint8_t*)bytes.data();
+    size_t offset = 0;
+    bool haveFirst = false;
+    uint32_t firstUs = 0;
+    uint32_t dropped = 0;
+
+    while (offset + sizeof(InputEventStream::FrameHeader) <= bytes.size()) {
+        InputEventStream::FrameHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+        if (header.version != InputEventStream::FRAME_VERSION ||
+            offset + (size_t)header.count * sizeof(InputEvent) > bytes.size()) {
+            fprintf(stderr, "Capture: bad frame at byte %zu\n", offset - sizeof(header));
+            return false;
+        }
+        dropped += header.dropped;
+
+        for (uint8_t i = 0; i < header.count; i++) {
+            InputEvent in;
+            memcpy(&in, data + offset, sizeof(in));
+            offset += sizeof(in);
+
+            if (!haveFirst) {
+                firstUs = in.timestampUs;
+                haveFirst = true;
+            }
+            ReplayEvent event;
+            event.atUs = (uint64_t)CAPTURE_LEAD_IN_MS * 1000 + (uint32_t)(in.timestampUs - firstUs);
+
+            if (in.type == INPUT_EVENT_KEY && in.id < positions.size()) {
+                event.type = REPLAY_KEY;
+                event.row = positions[in.id].first;
+                event.col = positions[in.id].second;
+                event.value = in.value ? 1 : 0;
+                timeline.events.push_back(event);
+            } else if (in.type == INPUT_EVENT_ENCODER && in.id < encoders.size() && !encoders[in.id].as5600) {
+                // The event carries the handler's absolute position; turn by the difference
+                event.type = REPLAY_ENCODER;
+                event.pin = encoders[in.id].pinA;
+                event.value = (in.value - encoderPositions[in.id]) * encoders[in.id].direction;
+                encoderPositions[in.id] = in.value;
+                timeline.events.push_back(event);
+            } else if (in.type != INPUT_EVENT_MACRO) {
+                // Macro events are output; sliders and AS5600 angles are not in the stream
+                timeline.skipped++;
+            }
+        }
+    }
+
+    if (dropped > 0) {
+        printf("Capture lost %u event(s) on the device; the replay will differ there\n", dropped);
+    }
+    std::stable_sort(timeline.events.begin(), timeline.events.end(),
+                     [](const ReplayEvent& a, const ReplayEvent& b) { return a.atUs < b.atUs; });
+    uint64_t lastUs = timeline.events.empty() ? 0 : timeline.events.back().atUs;
+    timeline.durationUs = lastUs + (uint64_t)REPLAY_SETTLE_MS * 1000;
+    return true;
+}
+
+bool loadTimeline(const std::string& path, const std::vector<Component>& components, ReplayTimeline& timeline) {
+    std::string bytes = readHostFile(path);
+    if (bytes.empty()) {
+        fprintf(stderr, "Timeline %s not found\n", path.c_str());
+        return false;
+    }
+
+    std::vector<ReplayEncoder> encoders = loadReplayEncoders();
+    size_t first = bytes.find_first_not_of(" \t\r\n");
+    if (first != std::string::npos && bytes[first] == '{') {
+        return parseReplayScript(bytes, components, encoders, timeline);
+    }
+    return parseCapture(bytes, components, encoders, timeline);
+}
+
+void applyReplayEvent(const ReplayEvent& event) {
+    switch (event.type) {
+        case REPLAY_KEY:
+            HostGpio::setSwitch(ROW_PINS[event.row], COL_PINS[event.col], event.value != 0);
+            break;
+        case REPLAY_ENCODER:
+            Encoder::hostTurn(event.pin, event.value);
+            break;
+        case REPLAY_ANGLE:
+            AS5600::hostSetRawAngle((uint16_t)event.value);
+            break;
+        case REPLAY_MACRO:
+            if (macroHandler) macroHandler->executeMacro(event.macroId);
+            break;
+        case REPLAY_USB_READY:
+            HostHid::setReady(event.value != 0);
+            break;
+    }
+}
+
+// Play the timeline once on the virtual clock; returns the reports it sent,
+// stamped relative to the start of the run
+std::vector<HostHid::Report> replayOnce(const ReplayTimeline& timeline, std::vector<ReplayTask>& tasks,
+                                        std::vector<Sampler>& samplers) {
+    // Start on a whole millisecond after the idle gap, from a clean bus
+    uint64_t nowUs = HostClock::micros64();
+    uint64_t startUs = (nowUs / 1000 + REPLAY_IDLE_MS) * 1000;
+    HostClock::advanceUs(startUs - nowUs);
+    HostGpio::openAllSwitches();
+    HostHid::setReady(true);
+    if (timeline.layer.length() > 0 && keyHandler->getCurrentLayer() != timeline.layer) {
+        keyHandler->switchToLayer(timeline.layer);
+    }
+    BinaryLog::drain();
+    HostHid::clear();
+
+    for (ReplayTask& task : tasks) task.nextUs = startUs;
+    size_t nextEvent = 0;
+    const uint64_t endUs = startUs + timeline.durationUs;
+
+    while (true) {
+        nowUs = HostClock::micros64();
+        while (nextEvent < timeline.events.size() && startUs + timeline.events[nextEvent].atUs <= nowUs) {
+            applyReplayEvent(timeline.events[nextEvent++]);
+        }
+
+        // Due tasks run in priority order; delays inside them move the clock
+        for (size_t i = 0; i < tasks.size(); i++) {
+            ReplayTask& task = tasks[i];
+            if (task.nextUs > HostClock::micros64()) continue;
+
+            samplers[i].begin();
+            task.work();
+            samplers[i].end();
+            samplers[i].nextIteration();
+
+            // Fixed-rate schedule; an overrun resynchronises instead of bursting
+            task.nextUs += task.periodUs;
+            uint64_t afterUs = HostClock::micros64();
+            if (task.nextUs <= afterUs) task.nextUs = afterUs + task.periodUs;
+        }
+        BinaryLog::drain();
+
+        nowUs = HostClock::micros64();
+        if (nowUs >= endUs) break;
+
+        uint64_t wakeUs = endUs;
+        for (const ReplayTask& task : tasks) wakeUs = std::min(wakeUs, task.nextUs);
+        if (nextEvent < timeline.events.size()) {
+            wakeUs = std::min(wakeUs, startUs + timeline.events[nextEvent].atUs);
+        }
+        if (wakeUs > nowUs) HostClock::advanceUs(wakeUs - nowUs);
+    }
+
+    std::vector<HostHid::Report> stream = HostHid::reports();
+    for (HostHid::Report& report : stream) report.timestampUs -= startUs;
+    HostGpio::openAllSwitches();
+    HostHid::setReady(true);
+    return stream;
+}
+
+// Virtual time from each input event to the first report after it, for
+// events answered before the next one
+void measureInputLatency(const ReplayTimeline& timeline, const std::vector<HostHid::Report>& stream,
+                         std::vector<double>& latencies, uint32_t& unanswered) {
+    size_t r = 0;
+    for (size_t i = 0; i < timeline.events.size(); i++) {
+        const ReplayEvent& event = timeline.events[i];
+        if (event.type == REPLAY_USB_READY) continue;
+
+        uint64_t untilUs = i + 1 < timeline.events.size() ? timeline.events[i + 1].atUs : timeline.durationUs;
+        while (r < stream.size() && stream[r].timestampUs < event.atUs) r++;
+        if (r < stream.size() && stream[r].timestampUs < untilUs) {
+            latencies.push_back((double)(stream[r].timestampUs - event.atUs));
+        } else {
+            unanswered++;
+        }
+    }
+}
+
+const char* reportKindName(HostHid::ReportKind kind) {
+    switch (kind) {
+        case HostHid::REPORT_KEYBOARD: return "keyboard";
+        case HostHid::REPORT_MOUSE: return "mouse";
+        default: return "other";
+    }
+}
+
+std::string reportHex(const HostHid::Report& report) {
+    std::string hex;
+    char byte[4];
+    for (uint8_t i = 0; i < report.length; i++) {
+        snprintf(byte, sizeof(byte), i == 0 ? "%02X" : " %02X", report.data[i]);
+        hex += byte;
+    }
+    return hex;
+}
+
+std::string describeReport(const HostHid::Report& report) {
+    char line[96];
+    snprintf(line, sizeof(line), "%.3f ms %s #%u [%s]", report.timestampUs / 1000.0,
+             reportKindName(report.kind), report.reportId, reportHex(report).c_str());
+    return line;
+}
+
+bool sameReport(const HostHid::Report& a, const HostHid::Report& b) {
+    return a.kind == b.kind && a.reportId == b.reportId && a.length == b.length &&
+           a.timestampUs == b.timestampUs && memcmp(a.data, b.data, a.length) == 0;
+}
+
+// Compare two report streams; the first difference becomes a failure message
+bool compareStreams(Result& result, const char* what, const std::vector<HostHid::Report>& expected,
+                    const std::vector<HostHid::Report>& actual) {
+    size_t n = std::min(expected.size(), actual.size());
+    for (size_t i = 0; i < n; i++) {
+        if (!sameReport(expected[i], actual[i])) {
+            fail(result, "%s: report %zu is %s", what, i, describeReport(actual[i]).c_str());
+            fail(result, "%s: expected %s", what, describeReport(expected[i]).c_str());
+            return false;
+        }
+    }
+    if (expected.size() != actual.size()) {
+        fail(result, "%s: %zu reports, expected %zu", what, actual.size(), expected.size());
+        return false;
+    }
+    return true;
+}
+
+bool writeStream(const std::string& path, const ReplayTimeline& timeline,
+                 const std::vector<HostHid::Report>& stream) {
+    DynamicJsonDocument doc(4096 + stream.size() * 192);
+    doc["timeline"] = timeline.name;
+    doc["duration_ms"] = (uint32_t)(timeline.durationUs / 1000);
+    JsonArray reports = doc.createNestedArray("reports");
+    for (const HostHid::Report& report : stream) {
+        JsonObject obj = reports.createNestedObject();
+        obj["t_us"] = report.timestampUs;
+        obj["kind"] = reportKindName(report.kind);
+        obj["id"] = report.reportId;
+        obj["data"] = reportHex(report);
+    }
+
+    std::string json;
+    serializeJsonPretty(doc, json);
+    std::ofstream out(path, std::ios::binary);
+    out << json;
+    return (bool)out;
+}
+
+bool readStream(const std::string& path, std::vector<HostHid::Report>& stream) {
+    std::string json = readHostFile(path);
+    if (json.empty()) {
+        fprintf(stderr, "Golden stream %s not found\n", path.c_str());
+        return false;
+    }
+
+    DynamicJsonDocument doc(json.size() * 2 + 4096);
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        fprintf(stderr, "Golden stream %s: %s\n", path.c_str(), error.c_str());
+        return false;
+    }
+
+    for (JsonObjectConst obj : doc["reports"].as<JsonArrayConst>()) {
+        HostHid::Report report;
+        memset(&report, 0, sizeof(report));
+        String kind = obj["kind"] | "";
+        report.kind = kind == "keyboard" ? HostHid::REPORT_KEYBOARD
+                    : kind == "mouse" ? HostHid::REPORT_MOUSE : HostHid::REPORT_OTHER;
+        report.reportId = obj["id"] | 0;
+        report.timestampUs = obj["t_us"] | (uint64_t)0;
+
+        std::istringstream hex(std::string(obj["data"] | ""));
+        unsigned int byte;
+        while (report.length < sizeof(report.data) && hex >> std::hex >> byte) {
+            report.data[report.length++] = (uint8_t)byte;
+        }
+        stream.push_back(report);
+    }
+    return true;
+}
+
+// Replay a timeline --iterations times. Each task becomes a result row timed
+// in host CPU time; input_latency is in virtual time; report_stream carries
+// the golden and run-to-run checks.
+bool runReplay(const Options& options, const std::vector<Component>& components, std::vector<Result>& results) {
+    ReplayTimeline timeline;
+    if (!loadTimeline(options.replayFile, components, timeline)) return false;
+
+    std::vector<HostHid::Report> golden;
+    if (!options.goldenFile.empty() && !readStream(options.goldenFile, golden)) return false;
+
+    const ManagedTask order[] = { TASK_KEYBOARD, TASK_ENCODER, TASK_HID, TASK_UI };
+    void (*const work[])() = { replayKeyboardTask, replayEncoderTask, replayHidTask, replayUiTask };
+    std::vector<ReplayTask> tasks;
+    std::vector<Result> taskResults(4);
+    for (size_t i = 0; i < 4; i++) {
+        ReplayTask task;
+        task.task = order[i];
+        task.work = work[i];
+        task.periodUs = (uint64_t)TaskManager::getConfig(order[i]).periodMs * 1000;
+        task.nextUs = 0;
+        tasks.push_back(task);
+        taskResults[i].name = std::string("replay/") + TaskManager::getConfig(order[i]).name;
+    }
+    std::vector<Sampler> samplers;
+    for (Result& r : taskResults) samplers.push_back(Sampler(r));
+
+    printf("Replaying %s x %u: %zu events over %.1f s of virtual time",
+           timeline.name.c_str(), options.iterations, timeline.events.size(), timeline.durationUs / 1e6);
+    if (timeline.skipped > 0) printf(" (%u event(s) skipped)", timeline.skipped);
+    printf("\n");
+
+    Result stream;
+    stream.name = "replay/report_stream";
+    Result latency;
+    latency.name = "replay/input_latency";
+    std::vector<HostHid::Report> first;
+    std::vector<double> latencies;
+    uint32_t unanswered = 0;
+
+    for (uint32_t run = 0; run < options.iterations; run++) {
+        std::vector<HostHid::Report> reports = replayOnce(timeline, tasks, samplers);
+        if (run == 0) {
+            first = reports;
+            measureInputLatency(timeline, reports, latencies, unanswered);
+            if (!options.goldenFile.empty()) compareStreams(stream, "golden", golden, reports);
+        } else if (!compareStreams(stream, "rerun", first, reports)) {
+            fail(stream, "run %u differs from the first run", run + 1);
+            break;
+        }
+    }
+    for (Sampler& sampler : samplers) sampler.finish();
+
+    stream.iterations = options.iterations;
+    stream.reportsPerIteration = (double)first.size();
+
+    latency.iterations = (uint32_t)latencies.size();
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        latency.p50Us = percentile(latencies, 0.50);
+        latency.p90Us = percentile(latencies, 0.90);
+        latency.p99Us = percentile(latencies, 0.99);
+        latency.maxUs = latencies.back();
+    }
+    if (unanswered > 0) {
+        printf("%u input event(s) sent no report before the next event\n", unanswered);
+    }
+
+    if (!options.recordFile.empty()) {
+        if (writeStream(options.recordFile, timeline, first)) {
+            printf("Report stream written to %s\n", options.recordFile.c_str());
+        } else {
+            fprintf(stderr, "Writing %s failed\n", options.recordFile.c_str());
+        }
+    }
+
+    for (const Result& r : taskResults) results.push_back(r);
+    results.push_back(latency);
+    results.push_back(stream);
+    return true;
+}
+
+void addResult(JsonArray array, const Result& r) {
+    JsonObject obj = array.createNestedObject();
+    obj["name"] = r.name;
+    obj["iterations"] = r.iterations;
+    obj["p50_us"] = r.p50Us;
+    obj["p90_us"] = r.p90Us;
+    obj["p99_us"] = r.p99Us;
+    obj["max_us"] = r.maxUs;
+    obj["reports_per_iteration"] = r.reportsPerIteration;
+    obj["allocs_per_iteration"] = r.allocsPerIteration;
+    obj["gpio_reads_per_iteration"] = r.gpioReadsPerIteration;
+    obj["failures"] = r.failures;
+    JsonArray messages = obj.createNestedArray("messages");
+    for (const std::string& message : r.messages) messages.add(message);
+}
+
+bool writeResults(const Options& options, const std::vector<Result>& results) {
+    DynamicJsonDocument doc(8 * 1024 + results.size() * 1024);
+    doc["iterations"] = options.iterations;
+    doc["heap_tracking"] = HostHeap::available();
+    JsonArray array = doc.createNestedArray("results");
+    for (const Result& r : results) addResult(array, r);
+
+    std::string json;
+    serializeJsonPretty(doc, json);
+    std::ofstream out(options.outFile, std::ios::binary);
+    out << json;
+    return (bool)out;
+}
+
+// Compare with a previous results file; returns the number of regressions
+int compareWithBaseline(const Options& options, const std::vector<Result>& results) {
+    std::string json = readHostFile(options.baselineFile);
+    if (json.empty()) {
+        fprintf(stderr, "Baseline %s not found\n", options.baselineFile.c_str());
+        return 0;
+    }
+
+    DynamicJsonDocument doc(json.size() * 2 + 4096);
+    DeserializationError error = deserializeJson(doc, json);
+    if (error) {
+        fprintf(stderr, "Baseline %s: %s\n", options.baselineFile.c_str(), error.c_str());
+        return 0;
+    }
+
+    int regressions = 0;
+    for (JsonObject base : doc["results"].as<JsonArray>()) {
+        std::string name = base["name"].as<std::string>();
+        auto current = std::find_if(results.begin(), results.end(), [&](const Result& r) { return r.name == name; });
+        if (current == results.end()) continue;
+
+        double baseP99 = base["p99_us"] | 0.0;
+        double baseAllocs = base["allocs_per_iteration"] | 0.0;
+
+        std::vector<std::string> reasons;
+        if (baseP99 > 0 && current->p99Us > baseP99 * P99_REGRESSION) reasons.push_back("p99");
+        if (current->allocsPerIteration > baseAllocs * ALLOC_REGRESSION &&
+            current->allocsPerIteration - baseAllocs >= 1) {
+            reasons.push_back("allocs");
+        }
+
+        if (!reasons.empty()) {
+            regressions++;
+            printf("REGRESSION %-32s", name.c_str());
+            for (const std::string& reason : reasons) printf(" %s", reason.c_str());
+            printf("  (p99 %.1f -> %.1f us, allocs %.1f -> %.1f)\n",
+                   baseP99, current->p99Us, baseAllocs, current->allocsPerIteration);
+        }
+    }
+    return regressions;
+}
+
+void printTable(const std::vector<Result>& results) {
+    printf("\n%-32s %6s %9s %9s %9s %8s %8s %8s  %s\n",
+           "scenario", "iters", "p50 us", "p99 us", "max us", "reports", "allocs", "gpio rd", "checks");
+    for (const Result& r : results) {
+        char checks[32];
+        if (r.failures == 0) {
+            snprintf(checks, sizeof(checks), "ok");
+        } else {
+            snprintf(checks, sizeof(checks), "FAILED %u", r.failures);
+        }
+        printf("%-32.32s %6u %9.2f %9.2f %9.2f %8.1f %8.1f %8.1f  %s\n",
+               r.name.c_str(), r.iterations, r.p50Us, r.p99Us, r.maxUs, r.reportsPerIteration,
+               r.allocsPerIteration, r.gpioReadsPerIteration, checks);
+        for (const std::string& message : r.messages) {
+            printf("    %s\n", message.c_str());
+        }
+    }
+}
+
+// Work on a scratch copy so layer saves and macro edits cannot modify the tree
+std::string prepareFilesystem(const std::string& dataDir) {
+    char tmpl[] = "/tmp/macropad-fs-XXXXXX";
+    const char* dir = mkdtemp(tmpl);
+    if (dir == nullptr) return std::string();
+
+    std::error_code ec;
+    stdfs::copy(dataDir, dir, stdfs::copy_options::recursive, ec);
+    if (ec) {
+        fprintf(stderr, "Copying %s failed: %s\n", dataDir.c_str(), ec.message().c_str());
+        return std::string();
+    }
+    return dir;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArgs(argc, argv, options)) return 2;
+
+    std::string root = prepareFilesystem(options.dataDir);
+    if (root.empty()) return 2;
+
+    // A replay runs on virtual time only, so its reports carry exact timestamps
+    if (!options.replayFile.empty()) {
+        HostClock::setFrozen(true);
+    }
+
+    USBSerial.setEcho(options.echoLog);
+    LittleFS.setRoot(root.c_str());
+    if (!LittleFS.begin(true)) {
+        fprintf(stderr, "No filesystem at %s\n", root.c_str());
+        return 2;
+    }
+
+    // Bring up the input path in the order setup() does on the device
+    BinaryLog::begin();
+    MetricsRegistry::begin();
+    PersistenceService::begin();
+    TaskManager::begin();
+    initializeHIDHandler();
+    initializeLED();
+    initializeMacroHandler();
+
+    std::vector<Component> components = ConfigManager::loadComponents("/config/components.json");
+    keyHandler = new KeyHandler(ROWS, COLS, components, ROW_PINS, COL_PINS);
+    keyHandler->begin();
+    keyHandler->loadKeyConfiguration(ConfigManager::loadActions("/config/actions.json"));
+    keyHandler->applyLayerToActionMap(keyHandler->getCurrentLayer());
+    initializeEncoders(components);
+
+    if (!HostHeap::available()) {
+        printf("Heap tracking unavailable on this platform; allocation columns are zero\n");
+    }
+
+    // Let the first scan see every key as released
+    HostClock::advance(DEBOUNCE_TIME);
+    runOutputTasks();
+    HostHid::clear();
+
+    std::vector<Result> results;
+    if (!options.replayFile.empty()) {
+        if (!runReplay(options, components, results)) return 2;
+    } else if (!runScenarios(options, components, results)) {
+        return 2;
+    }
+
+    printTable(results);
+
+    int failures = 0;
+    for (const Result& r : results) {
+        if (r.failures > 0) failures++;
+    }
+
+    if (!writeResults(options, results)) {
+        fprintf(stderr, "Writing %s failed\n", options.outFile.c_str());
+    } else {
+        printf("Results written to %s\n", options.outFile.c_str());
+    }
+
+    int regressions = 0;
+    if (!options.baselineFile.empty()) {
+        regressions = compareWithBaseline(options, results);
+        printf("%d regression(s) against %s\n", regressions, options.baselineFile.c_str());
+    }
+    printf("%d scenario(s) failed their checks\n", failures);
+
+    std::error_code ec;
+    stdfs::remove_all(root, ec);
+    return (failures > 0 || regressions > 0) ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+// StorageBench.cpp
+//
+// Runs the device's StorageBenchmark suite on the host, either against a
+// LittleFS image mounted with the real littlefs library or against a
+// scratch copy of a data directory. With an image the results also count
+// flash traffic (bytes read and programmed, blocks erased), which depends
+// only on littlefs and the suite, not on the host; timings are host CPU
+// time and only compare with other host runs.
+//
+//   storage_bench --image littlefs.bin [--block 4096] [--out results.json] [--log]
+//   storage_bench --data data [--out results.json] [--log]
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include "LittleFSImage.h"
+#include "StorageBenchmark.h"
+#include <filesystem>
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+USBCDC USBSerial;
+
+int main(int argc, char** argv) {
+    std::string imagePath;
+    std::string dataDir;
+    std::string outPath;
+    size_t blockSize = 4096;
+    bool log = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--image" && hasValue) {
+            imagePath = argv[++i];
+        } else if (arg == "--data" && hasValue) {
+            dataDir = argv[++i];
+        } else if (arg == "--block" && hasValue) {
+            blockSize = strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--out" && hasValue) {
+            outPath = argv[++i];
+        } else if (arg == "--log") {
+            log = true;
+        } else {
+            imagePath.clear();
+            dataDir.clear();
+            break;
+        }
+    }
+    if (imagePath.empty() == dataDir.empty()) {
+        fprintf(stderr,
+                "usage: %s --image littlefs.bin [--block BYTES] [--out FILE] [--log]\n"
+                "       %s --data DIR [--out FILE] [--log]\n",
+                argv[0], argv[0]);
+        return 2;
+    }
+    USBSerial.setEcho(log);
+
+    std::string scratch;
+    if (!imagePath.empty()) {
+        std::string error;
+        if (!LittleFS.mountImage(imagePath, error, blockSize)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+    } else {
+        // The suite only touches /.bench, but a copy keeps the tree clean
+        char tmpl[] = "/tmp/macropad-bench-XXXXXX";
+        const char* dir = mkdtemp(tmpl);
+        std::error_code ec;
+        if (dir != nullptr) stdfs::copy(dataDir, dir, stdfs::copy_options::recursive, ec);
+        if (dir == nullptr || ec) {
+            fprintf(stderr, "Copying %s failed: %s\n", dataDir.c_str(), ec.message().c_str());
+            return 2;
+        }
+        scratch = dir;
+        LittleFS.setRoot(scratch);
+    }
+
+    DynamicJsonDocument doc(StorageBenchmark::RESULTS_DOCUMENT_SIZE);
+    JsonObject results = doc.to<JsonObject>();
+    bool ok = StorageBenchmark::run(results);
+    if (fs::image::isMounted()) {
+        fs::image::Counters counters = fs::image::counters();
+        JsonObject flash = results.createNestedObject("flash");
+        flash["read_bytes"] = counters.readBytes;
+        flash["prog_bytes"] = counters.progBytes;
+        flash["erased_blocks"] = counters.erasedBlocks;
+    }
+
+    if (!scratch.empty()) {
+        std::error_code ec;
+        stdfs::remove_all(scratch, ec);
+    }
+    if (!ok) {
+        fprintf(stderr, "benchmark failed: %s\n", StorageBenchmark::getLastError().c_str());
+        return 1;
+    }
+
+    String json;
+    serializeJsonPretty(doc, json);
+    if (outPath.empty()) {
+        printf("%s\n", json.c_str());
+        return 0;
+    }
+    FILE* out = fopen(outPath.c_str(), "w");
+    if (out == nullptr || fwrite(json.c_str(), 1, json.length(), out) != json.length()) {
+        fprintf(stderr, "cannot write %s\n", outPath.c_str());
+        return 2;
+    }
+    fclose(out);
+    printf("Results written to %s\n", outPath.c_str());
+    return 0;
+}
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Decode binary log frames from the device's serial output.
+
+After `log binary` is typed on the serial console, the log drain task sends
+BinaryLog records as frames instead of text (see src/BinaryLog.h). A frame
+holds the address of the format string in flash and the raw arguments; the
+format strings are read from the firmware ELF the device runs. Ordinary text
+between frames is passed through unchanged.
+
+    python scripts/binlog_decode.py .pio/build/esp32-s3-mini-n4r2/firmware.elf capture.bin
+    python scripts/binlog_decode.py firmware.elf /dev/ttyACM0     # after `stty -F /dev/ttyACM0 raw`
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_MAGIC = b"\xfe\xb1"
+LEVELS = {1: "E", 2: "W", 3: "I", 4: "D", 5: "T"}
+
+# Argument encodings, matching BinaryLogArgType
+ARG_INT32, ARG_UINT32, ARG_INT64, ARG_UINT64, ARG_DOUBLE, ARG_STRING = range(1, 7)
+
+CONVERSION = re.compile(r"%(?:(%)|([-+ #0-9.]*)[hlLqjzt]*([a-zA-Z]))")
+
+
+class Elf:
+    """Allocated sections of a 32-bit little-endian ELF, for reading strings by address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1:
+            sys.exit(f"{path} is not a 32-bit ELF file")
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, flags, addr, offset, size = struct.unpack_from("<IIIIII", data, shoff + i * shentsize)
+            # SHT_PROGBITS sections with SHF_ALLOC hold the rodata strings
+            if sh_type == 1 and flags & 0x2 and size:
+                self.sections.append((addr, data[offset:offset + size]))
+
+    def string(self, address):
+        for base, contents in self.sections:
+            if base <= address < base + len(contents):
+                end = contents.find(b"\0", address - base)
+                return contents[address - base:end].decode("utf-8", "replace")
+        return None
+
+
+def read_args(payload, count):
+    args, pos = [], 0
+    for _ in range(count):
+        kind = payload[pos]
+        pos += 1
+        if kind == ARG_INT32:
+            value, = struct.unpack_from("<i", payload, pos)
+            pos += 4
+        elif kind == ARG_UINT32:
+            value, = struct.unpack_from("<I", payload, pos)
+            pos += 4
+        elif kind == ARG_INT64:
+            value, = struct.unpack_from("<q", payload, pos)
+            pos += 8
+        elif kind == ARG_UINT64:
+            value, = struct.unpack_from("<Q", payload, pos)
+            pos += 8
+        elif kind == ARG_DOUBLE:
+            value, = struct.unpack_from("<d", payload, pos)
+            pos += 8
+        elif kind == ARG_STRING:
+            length = payload[pos]
+            value = payload[pos + 1:pos + 1 + length].decode("utf-8", "replace")
+            pos += 1 + length
+        else:
+            break
+        args.append(value)
+    return args
+
+
+def format_record(fmt, args):
+    """printf one conversion at a time, as BinaryLog::emitText does on the device."""
+    args = list(args)
+
+    def convert(match):
+        percent, flags, conversion = match.groups()
+        if percent:
+            return "%"
+        if not args:
+            return ""
+        value = args.pop(0)
+        try:
+            if conversion in "diu":
+                return ("%" + flags + "d") % int(value)
+            if conversion in "xXoc":
+                return ("%" + flags + conversion) % int(value)
+            if conversion in "fFeEgGaA":
+                return ("%" + flags + conversion.replace("a", "e").replace("A", "E")) % float(value)
+            if conversion == "p":
+                return "0x%x" % int(value)
+            return ("%" + flags + "s") % value
+        except (TypeError, ValueError):
+            return str(value)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(stream, elf, out):
+    buffer = b""
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buffer += chunk
+        while True:
+            start = buffer.find(FRAME_MAGIC)
+            if start < 0:
+                # Keep a trailing byte in case it begins the next magic
+                keep = 1 if buffer.endswith(FRAME_MAGIC[:1]) else 0
+                out.write(buffer[:len(buffer) - keep].decode("utf-8", "replace"))
+                buffer = buffer[len(buffer) - keep:]
+                break
+            out.write(buffer[:start].decode("utf-8", "replace"))
+            buffer = buffer[start:]
+            if len(buffer) < 4:
+                break
+            length, = struct.unpack_from("<H", buffer, 2)
+            if len(buffer) < 4 + length:
+                break
+            timestamp, address, level, count = struct.unpack_from("<IIBB", buffer, 4)
+            payload = buffer[14:4 + length]
+            buffer = buffer[4 + length:]
+
+            fmt = elf.string(address)
+            if fmt is None:
+                out.write(f"[{timestamp / 1e6:12.6f}] ? <format 0x{address:08x} not in ELF>\n")
+                continue
+            text = format_record(fmt, read_args(payload, count))
+            out.write(f"[{timestamp / 1e6:12.6f}] {LEVELS.get(level, '?')} {text}")
+            if not text.endswith("\n"):
+                out.write("\n")
+        out.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware.elf of the build running on the device")
+    parser.add_argument("input", nargs="?", default="-", help="capture file or serial device (default: stdin)")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    stream = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    try:
+        decode(stream, elf, sys.stdout)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
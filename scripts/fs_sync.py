@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""Push changed web assets and default configs to a device's LittleFS.
+
+Instead of flashing the whole filesystem image, each directory is compared
+by manifest (path, size, SHA-256) and only the files that differ are sent.
+The device stages them next to the live directory and swaps it in when all
+have arrived, so a directory is never half updated. Files the device has
+but the local tree does not are removed from a synced directory; other
+directories (the user's /config files, /macros) are never touched.
+
+    python scripts/fs_sync.py 192.168.4.1
+    python scripts/fs_sync.py macropad.local --dir web --dry-run
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import sys
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+DEFAULT_DIRS = ["web", "config/defaults", "images"]
+
+
+def local_manifest(root):
+    files = []
+    for base, dirs, names in os.walk(root):
+        dirs[:] = sorted(d for d in dirs if not d.startswith("."))
+        for name in sorted(names):
+            if name.startswith("."):
+                continue  # .DS_Store and friends
+            full = os.path.join(base, name)
+            with open(full, "rb") as f:
+                data = f.read()
+            files.append({
+                "path": os.path.relpath(full, root).replace(os.sep, "/"),
+                "size": len(data),
+                "sha256": hashlib.sha256(data).hexdigest(),
+            })
+    return files
+
+
+def request(base, method, path, params=None, body=None, content_type="application/json"):
+    url = base + path + ("?" + urllib.parse.urlencode(params) if params else "")
+    req = urllib.request.Request(url, data=body, method=method)
+    if body is not None:
+        req.add_header("Content-Type", content_type)
+    try:
+        with urllib.request.urlopen(req, timeout=30) as resp:
+            return json.loads(resp.read() or b"{}")
+    except urllib.error.HTTPError as e:
+        message = e.read().decode(errors="replace")
+        try:
+            message = json.loads(message).get("message", message)
+        except ValueError:
+            pass
+        raise SystemExit(f"{method} {path}: HTTP {e.code}: {message}")
+
+
+def sync_dir(base, data_dir, rel, dry_run):
+    root = os.path.join(data_dir, rel)
+    dev_dir = "/" + rel
+    files = local_manifest(root)
+    by_path = {f["path"]: f for f in files}
+
+    if dry_run:
+        remote = request(base, "GET", "/api/fs/manifest", {"dir": dev_dir}).get("files", [])
+        remote_by_path = {f["path"]: f for f in remote}
+        changed = [f for f in files if remote_by_path.get(f["path"], {}).get("sha256") != f["sha256"]]
+        removed = [p for p in remote_by_path if p not in by_path]
+        print(f"{dev_dir}: {len(changed)} to send ({sum(f['size'] for f in changed)} bytes), "
+              f"{len(removed)} to remove")
+        for f in changed:
+            print(f"  + {f['path']}")
+        for p in removed:
+            print(f"  - {p}")
+        return
+
+    start = time.time()
+    needed = request(base, "POST", "/api/fs/sync", {"dir": dev_dir},
+                     json.dumps({"files": files}).encode())["needed"]
+    sent = 0
+    try:
+        for path in needed:
+            with open(os.path.join(root, path), "rb") as f:
+                data = f.read()
+            request(base, "POST", "/api/fs/file", {"path": path}, data, "application/octet-stream")
+            sent += len(data)
+            print(f"  {path} ({len(data)} bytes)")
+        request(base, "POST", "/api/fs/commit")
+    except BaseException:
+        request(base, "POST", "/api/fs/abort")
+        raise
+    print(f"{dev_dir}: {len(needed)} of {len(files)} files, {sent} bytes in {time.time() - start:.1f} s")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("device", help="device address, e.g. 192.168.4.1")
+    parser.add_argument("--data", default="data", help="local filesystem tree (default: data)")
+    parser.add_argument("--dir", action="append",
+                        help=f"directory below --data to sync, repeatable (default: {' '.join(DEFAULT_DIRS)})")
+    parser.add_argument("--dry-run", action="store_true", help="only compare with the device's manifest")
+    args = parser.parse_args()
+
+    base = args.device if "://" in args.device else "http://" + args.device
+    for rel in args.dir or DEFAULT_DIRS:
+        rel = rel.strip("/")
+        if not os.path.isdir(os.path.join(args.data, rel)):
+            sys.exit(f"{os.path.join(args.data, rel)} is not a directory")
+        sync_dir(base.rstrip("/"), args.data, rel, args.dry_run)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+"""Build a delta patch that turns one firmware image into another.
+
+The device applies it against its running partition (OTAPatcher), so a
+minor release downloads as tens of KB instead of the whole image.
+
+    python scripts/make_delta.py old/firmware.bin new/firmware.bin \\
+        -o firmware.bin.from-1.0.0.patch.gz
+
+Name the patch "<image>.from-<running version>.patch.gz" and attach it to
+the release next to the image. The device picks it when its own version
+matches, and falls back to the full image if the running firmware is not
+the exact source image. The patch is checked by applying it here before it
+is written.
+
+Format "MPD1" (little-endian), gzip-compressed when the name ends in .gz:
+    header  "MPD1", u32 source size, u8[32] source SHA-256, u32 target size
+    ops     u8 1, u32 source offset, u32 length, <length diff bytes>
+              target byte = source byte + diff byte (mod 256)
+            u8 2, u32 length, <length literal bytes>
+            u8 0  end
+Diff bytes are mostly zero where code only moved, so they compress well.
+"""
+
+import argparse
+import gzip
+import hashlib
+import struct
+import sys
+
+BLOCK = 16          # Seed match length
+MIN_MATCH = 32      # Shorter matches are cheaper as literals
+GIVE_UP = 32        # Stop extending once the score drops this far below its best
+FAST = 64           # Exact-compare stride while regions are identical
+
+
+def build_index(src):
+    index = {}
+    for i in range(len(src) - BLOCK + 1):
+        index.setdefault(src[i:i + BLOCK], i)
+    return index
+
+
+def extend_forward(src, tgt, s, t):
+    """Length of the approximate match at src[s:], tgt[t:] (bsdiff scoring)."""
+    limit = min(len(src) - s, len(tgt) - t)
+    i = score = best_score = best_len = 0
+    while i < limit:
+        if i + FAST <= limit and src[s + i:s + i + FAST] == tgt[t + i:t + i + FAST]:
+            i += FAST
+            score += FAST
+        else:
+            score += 1 if src[s + i] == tgt[t + i] else -1
+            i += 1
+        if score > best_score:
+            best_score, best_len = score, i
+        elif score < best_score - GIVE_UP:
+            break
+    return best_len
+
+
+def extend_backward(src, tgt, s, t, limit):
+    limit = min(limit, s)
+    i = score = best_score = best_len = 0
+    while i < limit:
+        i += 1
+        score += 1 if src[s - i] == tgt[t - i] else -1
+        if score > best_score:
+            best_score, best_len = score, i
+        elif score < best_score - GIVE_UP:
+            break
+    return best_len
+
+
+def likely_aligned(src, tgt, s, t):
+    """Cheap check before trying to continue the previous alignment."""
+    if s < 0 or s + 8 > len(src) or t + 8 > len(tgt):
+        return False
+    return sum(a == b for a, b in zip(src[s:s + 8], tgt[t:t + 8])) >= 6
+
+
+def diff(src, tgt):
+    index = build_index(src)
+    ops = []
+    t = literal_start = 0
+    offset = None  # source position minus target position of the last match
+
+    while t + BLOCK <= len(tgt):
+        candidates = []
+        if offset is not None and likely_aligned(src, tgt, t + offset, t):
+            candidates.append(t + offset)
+        seed = index.get(tgt[t:t + BLOCK])
+        if seed is not None and seed not in candidates:
+            candidates.append(seed)
+
+        best = None
+        for s in candidates:
+            length = extend_forward(src, tgt, s, t)
+            if length >= MIN_MATCH and (best is None or length > best[1]):
+                best = (s, length)
+        if best is None:
+            t += 1
+            continue
+
+        s, length = best
+        back = extend_backward(src, tgt, s, t, t - literal_start)
+        s, t, length = s - back, t - back, length + back
+
+        if literal_start < t:
+            ops.append((2, tgt[literal_start:t]))
+        ops.append((1, s, length))
+        offset = s - t
+        t += length
+        literal_start = t
+
+    if literal_start < len(tgt):
+        ops.append((2, tgt[literal_start:]))
+    return ops
+
+
+def encode(src, tgt, ops):
+    out = bytearray(b"MPD1")
+    out += struct.pack("<I", len(src))
+    out += hashlib.sha256(src).digest()
+    out += struct.pack("<I", len(tgt))
+    pos = 0
+    for op in ops:
+        if op[0] == 1:
+            _, s, length = op
+            out += struct.pack("<BII", 1, s, length)
+            out += bytes((tgt[pos + i] - src[s + i]) & 0xFF for i in range(length))
+            pos += length
+        else:
+            out += struct.pack("<BI", 2, len(op[1]))
+            out += op[1]
+            pos += len(op[1])
+    out += b"\x00"
+    return bytes(out)
+
+
+def apply(src, patch):
+    """Reference decoder, used to check every patch before it is written."""
+    if patch[:4] != b"MPD1":
+        raise ValueError("not an MPD1 patch")
+    source_size, = struct.unpack_from("<I", patch, 4)
+    if source_size != len(src) or patch[8:40] != hashlib.sha256(src).digest():
+        raise ValueError("patch was made for a different source image")
+    target_size, = struct.unpack_from("<I", patch, 40)
+    out = bytearray()
+    pos = 44
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == 0:
+            break
+        if op == 1:
+            s, length = struct.unpack_from("<II", patch, pos)
+            pos += 8
+            out += bytes((src[s + i] + patch[pos + i]) & 0xFF for i in range(length))
+        elif op == 2:
+            length, = struct.unpack_from("<I", patch, pos)
+            pos += 4
+            out += patch[pos:pos + length]
+        else:
+            raise ValueError(f"unknown op {op}")
+        pos += length
+    if len(out) != target_size:
+        raise ValueError("patched image has the wrong size")
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="image the device is running")
+    parser.add_argument("target", help="new image")
+    parser.add_argument("-o", "--output", required=True,
+                        help="patch file; gzip-compressed if it ends in .gz")
+    args = parser.parse_args()
+
+    with open(args.source, "rb") as f:
+        src = f.read()
+    with open(args.target, "rb") as f:
+        tgt = f.read()
+
+    patch = encode(src, tgt, diff(src, tgt))
+    if apply(src, patch) != tgt:
+        sys.exit("internal error: patch does not reproduce the target image")
+
+    data = gzip.compress(patch, compresslevel=9, mtime=0) if args.output.endswith(".gz") else patch
+    with open(args.output, "wb") as f:
+        f.write(data)
+
+    print(f"{args.output}: {len(data)} bytes for a {len(tgt)} byte image "
+          f"({100 * len(data) / max(1, len(tgt)):.1f}%)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Local HTTP stand-in for the firmware download server.
+
+Serves one firmware image so OTA throughput can be measured end to end
+without GitHub in the path. The device is pointed at it with
+/api/firmware/update?url=http://<host>:<port>/firmware.bin, and the device's
+own timing is read back from /api/firmware/status ("transfer").
+"<path>.sha256" returns the image digest and "<path>.sig" serves
+"<image>.sig" when it exists, as a release would. For a .gz image both
+describe the uncompressed firmware, which is what the device checks.
+A delta patch is served with --full, the image it produces: its digest is
+published and it is served to any path that is not a patch, which is where
+the device falls back to when the patch does not fit its firmware.
+
+    python scripts/ota_server.py .pio/build/esp32-s3-mini-n4r2/firmware.bin
+    python scripts/ota_server.py firmware.bin --rate 200   # cap at 200 KB/s
+    python scripts/ota_server.py firmware.bin.from-1.0.0.patch.gz --full firmware.bin
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import sys
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class FirmwareHandler(BaseHTTPRequestHandler):
+    image = b""
+    full = None       # Image a patch produces, served for non-patch paths
+    image_name = ""
+    digest = ""
+    signature = None
+    rate = 0          # Bytes per second, 0 = unlimited
+    chunk = 1460      # One TCP segment
+
+    def do_GET(self):
+        if self.path.endswith(".sha256"):
+            self.send_small(f"{self.digest}  {self.image_name}\n".encode())
+            return
+        if self.path.endswith(".sig"):
+            if self.signature is None:
+                self.send_error(404)
+            else:
+                self.send_small(self.signature)
+            return
+
+        image = self.image if self.full is None or ".patch" in self.path else self.full
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(image)))
+        self.end_headers()
+
+        start = time.monotonic()
+        sent = 0
+        try:
+            while sent < len(image):
+                block = image[sent:sent + self.chunk]
+                self.wfile.write(block)
+                sent += len(block)
+                if self.rate > 0:
+                    # Sleep until the schedule for this many bytes is reached
+                    due = start + sent / self.rate
+                    delay = due - time.monotonic()
+                    if delay > 0:
+                        time.sleep(delay)
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+
+        elapsed = time.monotonic() - start
+        kbps = sent / elapsed / 1024 if elapsed > 0 else 0
+        print(f"{self.client_address[0]}: sent {sent}/{len(image)} bytes "
+              f"in {elapsed:.2f} s ({kbps:.1f} KB/s)", flush=True)
+
+    def send_small(self, body):
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):
+        sys.stderr.write(f"{self.client_address[0]} {fmt % args}\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="firmware .bin to serve")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--rate", type=float, default=0,
+                        help="throttle to this many KB/s (default: unlimited)")
+    parser.add_argument("--chunk", type=int, default=1460,
+                        help="bytes per socket write (default: 1460)")
+    parser.add_argument("--full", help="image a delta patch produces (firmware .bin)")
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        FirmwareHandler.image = f.read()
+    if args.full:
+        with open(args.full, "rb") as f:
+            FirmwareHandler.full = f.read()
+        plain_path, plain = args.full, FirmwareHandler.full
+    else:
+        plain_path = args.image[:-3] if args.image.endswith(".gz") else args.image
+        plain = gzip.decompress(FirmwareHandler.image) if plain_path != args.image else FirmwareHandler.image
+    FirmwareHandler.image_name = os.path.basename(plain_path)
+    FirmwareHandler.digest = hashlib.sha256(plain).hexdigest()
+    if os.path.exists(plain_path + ".sig"):
+        with open(plain_path + ".sig", "rb") as f:
+            FirmwareHandler.signature = f.read()
+    FirmwareHandler.rate = args.rate * 1024
+    FirmwareHandler.chunk = max(1, args.chunk)
+
+    server = ThreadingHTTPServer(("0.0.0.0", args.port), FirmwareHandler)
+    print(f"Serving {os.path.basename(args.image)} ({len(FirmwareHandler.image)} bytes) "
+          f"on port {args.port}", flush=True)
+    print(f"sha256 {FirmwareHandler.digest}"
+          f"{' (signed)' if FirmwareHandler.signature else ''}", flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,58 @@
+"""Write the release metadata that OTA updates are verified against.
+
+Runs after the firmware is built and writes next to firmware.bin:
+  firmware.bin.gz      compressed image; the device inflates it while flashing
+  firmware.bin.sha256  digest in sha256sum format
+  firmware.bin.sig     DER ECDSA/RSA signature of the image, only when
+                       OTA_SIGNING_KEY names a private key PEM
+
+Upload them with the .bin to the GitHub release. The digest and signature
+cover the uncompressed image, so they also apply to the .gz download. The device fetches
+"<asset url>.sha256" and "<asset url>.sig" before it downloads the image.
+
+Can also be run by hand:  python scripts/release_digest.py firmware.bin
+"""
+
+import gzip
+import hashlib
+import os
+import subprocess
+import sys
+
+
+def write_release_digest(image_path):
+    """Write <image>.gz, <image>.sha256 and, with a signing key, <image>.sig."""
+    with open(image_path, "rb") as f:
+        image = f.read()
+    digest = hashlib.sha256(image).hexdigest()
+
+    # mtime=0 keeps the archive reproducible for identical images
+    compressed = gzip.compress(image, compresslevel=9, mtime=0)
+    with open(image_path + ".gz", "wb") as f:
+        f.write(compressed)
+    print(f"Compressed: {len(image)} -> {len(compressed)} bytes "
+          f"({100 * len(compressed) // max(1, len(image))}%)")
+
+    with open(image_path + ".sha256", "w") as f:
+        f.write(f"{digest}  {os.path.basename(image_path)}\n")
+    print(f"SHA-256: {digest}")
+
+    key = os.environ.get("OTA_SIGNING_KEY")
+    if key:
+        subprocess.run(["openssl", "dgst", "-sha256", "-sign", key,
+                        "-out", image_path + ".sig", image_path], check=True)
+        print(f"Signed with {key}")
+
+
+def after_build(source, target, env):
+    write_release_digest(str(target[0]))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", after_build)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        if len(sys.argv) != 2:
+            sys.exit(__doc__)
+        write_release_digest(sys.argv[1])
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""Run the LittleFS benchmark suite on a device and compare results.
+
+The device runs the suite in the background (POST /api/storage/benchmark);
+this polls for the JSON and saves it. Any two result files can then be
+compared, e.g. before and after a firmware change, or two host runs of
+`native_storage` against the same image. Latencies and flash traffic should
+not grow, throughputs should not drop; changes beyond --threshold are
+reported as regressions and make the exit status 1.
+
+    python scripts/storage_bench.py run 192.168.4.1 --out v1.3.json
+    python scripts/storage_bench.py compare v1.2.json v1.3.json
+"""
+
+import argparse
+import json
+import sys
+import time
+import urllib.error
+import urllib.request
+
+
+def request(base, method, path):
+    req = urllib.request.Request(base + path, method=method, data=b"" if method == "POST" else None)
+    try:
+        with urllib.request.urlopen(req, timeout=30) as resp:
+            return resp.status, json.loads(resp.read() or b"{}")
+    except urllib.error.HTTPError as e:
+        try:
+            return e.code, json.loads(e.read() or b"{}")
+        except ValueError:
+            return e.code, {}
+
+
+def run(args):
+    base = (args.device if "://" in args.device else "http://" + args.device).rstrip("/")
+    status, body = request(base, "POST", "/api/storage/benchmark")
+    if status != 202:
+        sys.exit(f"Could not start the benchmark: HTTP {status}: {body.get('message', body)}")
+
+    deadline = time.time() + args.timeout
+    while time.time() < deadline:
+        time.sleep(1)
+        status, body = request(base, "GET", "/api/storage/benchmark")
+        if status == 200:
+            break
+        if status != 202:
+            sys.exit(f"HTTP {status}: {body.get('message', body)}")
+    else:
+        sys.exit(f"No results after {args.timeout} s")
+
+    if "error" in body:
+        sys.exit(f"Benchmark failed: {body['error']}")
+    text = json.dumps(body, indent=2)
+    if args.out:
+        with open(args.out, "w") as f:
+            f.write(text + "\n")
+        print(f"Results written to {args.out} ({body.get('duration_ms', 0)} ms on the device)")
+    else:
+        print(text)
+
+
+def metrics(results):
+    """Flatten results to {name: (value, higher_is_better)}."""
+    out = {}
+
+    def add(name, value, key):
+        if not isinstance(value, (int, float)) or isinstance(value, bool):
+            return
+        if key.endswith("_kbps") or key == "ratio":
+            out[name] = (value, True)
+        elif key.endswith("_us") or key.endswith("_bytes") or key.endswith("_blocks"):
+            out[name] = (value, False)
+
+    for section, value in results.items():
+        if isinstance(value, dict):
+            for key, v in value.items():
+                add(f"{section}.{key}", v, key)
+        elif isinstance(value, list):
+            for entry in value:
+                # Entries are told apart by block size, file count or directory
+                label = entry.get("dir") or entry.get("block") or entry.get("files")
+                for key, v in entry.items():
+                    add(f"{section}[{label}].{key}", v, key)
+    return out
+
+
+def compare(args):
+    with open(args.baseline) as f:
+        before = json.load(f)
+    with open(args.current) as f:
+        after = json.load(f)
+
+    if before.get("suite") != after.get("suite"):
+        sys.exit(f"Suite versions differ ({before.get('suite')} vs {after.get('suite')}); results are not comparable")
+    if before.get("platform") != after.get("platform"):
+        print(f"Warning: comparing {before.get('platform')} with {after.get('platform')}")
+
+    old, new = metrics(before), metrics(after)
+    print(f"{'metric':42} {before.get('firmware', '?'):>12} {after.get('firmware', '?'):>12} {'change':>8}")
+    regressions = 0
+    for name in sorted(old.keys() & new.keys()):
+        (a, higher_is_better), (b, _) = old[name], new[name]
+        change = (b - a) / a if a else 0.0
+        worse = -change if higher_is_better else change
+        flag = ""
+        if worse > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:42} {a:>12g} {b:>12g} {change:>+8.0%}{flag}")
+
+    print(f"{regressions} regression(s) beyond {args.threshold:.0%}")
+    sys.exit(1 if regressions else 0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("run", help="run the suite on a device")
+    p.add_argument("device", help="device address, e.g. 192.168.4.1")
+    p.add_argument("--out", help="write the results here instead of printing them")
+    p.add_argument("--timeout", type=int, default=120, help="seconds to wait for results (default: 120)")
+    p.set_defaults(func=run)
+
+    p = sub.add_parser("compare", help="compare two result files")
+    p.add_argument("baseline")
+    p.add_argument("current")
+    p.add_argument("--threshold", type=float, default=0.2, help="relative change counted as a regression (default: 0.2)")
+    p.set_defaults(func=compare)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
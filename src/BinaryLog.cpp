@@ -0,0 +1,256 @@
+#include "BinaryLog.h"
+#include "TaskManager.h"
+#include <USBCDC.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <stdio.h>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+uint8_t* BinaryLog::_buffer = nullptr;
+size_t BinaryLog::_capacity = 0;
+std::atomic<uint32_t> BinaryLog::_head(0);
+std::atomic<uint32_t> BinaryLog::_tail(0);
+std::atomic<uint32_t> BinaryLog::_dropped(0);
+volatile bool BinaryLog::_binaryOutput = false;
+
+// Constants
+static const uint8_t PADDING_LEVEL = 0xFF;         // Fills the gap before the ring wraps
+static const size_t FALLBACK_BUFFER_SIZE = 8192;   // Internal RAM when there is no PSRAM
+static const uint32_t DRAIN_INTERVAL_MS = 20;
+static const uint8_t FRAME_MAGIC[2] = {0xFE, 0xB1};
+static const size_t FRAME_HEADER_SIZE = 4 + 10;    // Magic, length, timestamp, format, level, count
+static const size_t TEXT_BUFFER_SIZE = 256;
+
+bool BinaryLog::begin() {
+    if (_buffer != nullptr) return true;
+
+    static_assert((BLOG_BUFFER_SIZE & (BLOG_BUFFER_SIZE - 1)) == 0, "BLOG_BUFFER_SIZE must be a power of two");
+    size_t capacity = BLOG_BUFFER_SIZE;
+    uint8_t* buffer = (uint8_t*)heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buffer == nullptr) {
+        capacity = FALLBACK_BUFFER_SIZE;
+        buffer = (uint8_t*)heap_caps_malloc(capacity, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (buffer == nullptr) {
+        USBSerial.println("BinaryLog: No memory for the log ring");
+        return false;
+    }
+
+    // Zeroed memory reads as "not committed yet"
+    memset(buffer, 0, capacity);
+    _capacity = capacity;
+    _head.store(0);
+    _tail.store(0);
+    _buffer = buffer;
+
+#ifndef HOST_BUILD
+    // Host tasks run inline; the host build calls drain() itself
+    xTaskCreatePinnedToCore(drainTask, "log_drain", 4096, NULL, tskIDLE_PRIORITY + 1, NULL, NETWORK_TASK_CORE);
+#endif
+    return true;
+}
+
+void BinaryLog::write(uint8_t level, const char* format, const Payload& payload) {
+    const uint32_t length = (sizeof(RecordHeader) + payload.size + 3) & ~3u;
+    const uint32_t capacity = (uint32_t)_capacity;
+
+    // Reserve space; a record never wraps, so pad out the end if it won't fit
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t position;
+    uint32_t reserved;
+    do {
+        position = head & (capacity - 1);
+        uint32_t room = capacity - position;
+        reserved = length <= room ? length : room + length;
+        if (head + reserved - _tail.load(std::memory_order_acquire) > capacity) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!_head.compare_exchange_weak(head, head + reserved,
+                                          std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    if (reserved != length) {
+        RecordHeader* padding = (RecordHeader*)&_buffer[position];
+        padding->level = PADDING_LEVEL;
+        __atomic_store_n(&padding->length, (uint16_t)(reserved - length), __ATOMIC_RELEASE);
+        position = 0;
+    }
+
+    RecordHeader* header = (RecordHeader*)&_buffer[position];
+    header->level = level;
+    header->argCount = payload.count;
+    header->timestampUs = (uint32_t)esp_timer_get_time();
+    header->format = format;
+    memcpy(header + 1, payload.data, payload.size);
+    __atomic_store_n(&header->length, (uint16_t)length, __ATOMIC_RELEASE);
+}
+
+void BinaryLog::drain() {
+    if (_buffer == nullptr) return;
+
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t head = _head.load(std::memory_order_acquire);
+    while (tail != head) {
+        RecordHeader* header = (RecordHeader*)&_buffer[tail & (_capacity - 1)];
+        uint16_t length = __atomic_load_n(&header->length, __ATOMIC_ACQUIRE);
+        if (length == 0) {
+            break;  // Reserved but still being written
+        }
+
+        if (header->level != PADDING_LEVEL) {
+            const uint8_t* payload = (const uint8_t*)(header + 1);
+            if (_binaryOutput) {
+                emitFrame(header, payload);
+            } else {
+                emitText(header, payload);
+            }
+        }
+
+        // Clear it so the next writer here starts from "not committed"
+        memset(header, 0, length);
+        tail += length;
+        _tail.store(tail, std::memory_order_release);
+    }
+
+    static uint32_t reportedDrops = 0;
+    uint32_t dropped = _dropped.load(std::memory_order_relaxed);
+    if (dropped != reportedDrops) {
+        USBSerial.printf("BinaryLog: %u records dropped\n", dropped - reportedDrops);
+        reportedDrops = dropped;
+    }
+}
+
+void BinaryLog::drainTask(void* parameter) {
+    while (true) {
+        drain();
+        vTaskDelay(pdMS_TO_TICKS(DRAIN_INTERVAL_MS));
+    }
+}
+
+// One decoded argument
+struct LogArg {
+    uint8_t type;
+    int64_t integer;
+    double real;
+    char text[BLOG_MAX_STRING + 1];
+};
+
+static const uint8_t* readArg(const uint8_t* p, LogArg& arg) {
+    arg.type = *p++;
+    arg.integer = 0;
+    arg.real = 0;
+    arg.text[0] = '\0';
+    switch (arg.type) {
+        case BLOG_ARG_INT32: { int32_t v; memcpy(&v, p, 4); arg.integer = v; p += 4; break; }
+        case BLOG_ARG_UINT32: { uint32_t v; memcpy(&v, p, 4); arg.integer = v; p += 4; break; }
+        case BLOG_ARG_INT64:
+        case BLOG_ARG_UINT64: { memcpy(&arg.integer, p, 8); p += 8; break; }
+        case BLOG_ARG_DOUBLE: { memcpy(&arg.real, p, 8); arg.integer = (int64_t)arg.real; p += 8; break; }
+        case BLOG_ARG_STRING: {
+            uint8_t length = *p++;
+            memcpy(arg.text, p, length);
+            arg.text[length] = '\0';
+            p += length;
+            break;
+        }
+    }
+    if (arg.type != BLOG_ARG_DOUBLE) arg.real = (double)arg.integer;
+    return p;
+}
+
+// printf the record's arguments one conversion at a time, widening each to
+// long long or double; scripts/binlog_decode.py does the same on the host
+void BinaryLog::emitText(const RecordHeader* header, const uint8_t* payload) {
+    char out[TEXT_BUFFER_SIZE];
+    size_t n = 0;
+    uint8_t argIndex = 0;
+    LogArg arg;
+
+    const char* f = header->format;
+    while (*f != '\0' && n < sizeof(out) - 1) {
+        if (*f != '%') {
+            out[n++] = *f++;
+            continue;
+        }
+        if (f[1] == '%') {
+            out[n++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion
+        const char* start = f++;
+        while (*f != '\0' && strchr("-+ #0123456789.", *f) != nullptr) f++;
+        size_t flagsLength = f - start;
+        while (*f != '\0' && strchr("hlLqjzt", *f) != nullptr) f++;
+        char conversion = *f;
+        if (conversion == '\0') break;
+        f++;
+
+        if (argIndex >= header->argCount) {
+            continue;  // Missing argument: drop the conversion
+        }
+        payload = readArg(payload, arg);
+        argIndex++;
+        if (flagsLength > 12) {
+            continue;
+        }
+
+        char spec[20];
+        memcpy(spec, start, flagsLength);
+        spec[flagsLength] = '\0';
+        int written;
+        switch (conversion) {
+            case 'd': case 'i':
+                strcat(spec, "lld");
+                written = snprintf(out + n, sizeof(out) - n, spec, (long long)arg.integer);
+                break;
+            case 'u': case 'x': case 'X': case 'o': {
+                size_t end = strlen(spec);
+                spec[end] = 'l'; spec[end + 1] = 'l'; spec[end + 2] = conversion; spec[end + 3] = '\0';
+                written = snprintf(out + n, sizeof(out) - n, spec, (unsigned long long)arg.integer);
+                break;
+            }
+            case 'c':
+                strcat(spec, "c");
+                written = snprintf(out + n, sizeof(out) - n, spec, (int)arg.integer);
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+                size_t end = strlen(spec);
+                spec[end] = conversion; spec[end + 1] = '\0';
+                written = snprintf(out + n, sizeof(out) - n, spec, arg.real);
+                break;
+            }
+            case 'p':
+                written = snprintf(out + n, sizeof(out) - n, "0x%llx", (unsigned long long)arg.integer);
+                break;
+            default:
+                strcat(spec, "s");
+                written = snprintf(out + n, sizeof(out) - n, spec, arg.text);
+                break;
+        }
+        if (written > 0) {
+            n += (size_t)written < sizeof(out) - n ? (size_t)written : sizeof(out) - 1 - n;
+        }
+    }
+    USBSerial.write((const uint8_t*)out, n);
+}
+
+void BinaryLog::emitFrame(const RecordHeader* header, const uint8_t* payload) {
+    uint8_t frame[FRAME_HEADER_SIZE + MAX_PAYLOAD + 4];
+    size_t payloadSize = header->length - sizeof(RecordHeader);
+    uint16_t length = (uint16_t)(FRAME_HEADER_SIZE - 4 + payloadSize);
+    uint32_t format = (uint32_t)(uintptr_t)header->format;
+
+    frame[0] = FRAME_MAGIC[0];
+    frame[1] = FRAME_MAGIC[1];
+    memcpy(&frame[2], &length, 2);
+    memcpy(&frame[4], &header->timestampUs, 4);
+    memcpy(&frame[8], &format, 4);
+    frame[12] = header->level;
+    frame[13] = header->argCount;
+    memcpy(&frame[FRAME_HEADER_SIZE], payload, payloadSize);
+    USBSerial.write(frame, FRAME_HEADER_SIZE + payloadSize);
+}
@@ -0,0 +1,201 @@
+#ifndef BINARY_LOG_H
+#define BINARY_LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+#include <type_traits>
+
+// Binary logging for hot paths. BLOG_* calls below BLOG_LEVEL compile to
+// nothing. Enabled calls copy the format string's address, a timestamp and
+// the raw arguments into a lock-free ring (in PSRAM when there is some); no
+// formatting and no USB traffic happen in the caller. A low-priority drain
+// task turns records into text on USBSerial, or, in binary mode, sends them
+// as frames that scripts/binlog_decode.py decodes with the firmware ELF.
+//
+//   BLOG_DEBUG("Key event: %s %s\n", componentId.c_str(), pressed ? "PRESSED" : "RELEASED");
+//
+// Arguments may be integers, floating point, pointers or C strings (pass
+// String::c_str()); strings are copied, up to BLOG_MAX_STRING bytes. Format
+// strings must be literals: only their address is recorded.
+
+#define BLOG_LEVEL_NONE  0
+#define BLOG_LEVEL_ERROR 1
+#define BLOG_LEVEL_WARN  2
+#define BLOG_LEVEL_INFO  3
+#define BLOG_LEVEL_DEBUG 4
+#define BLOG_LEVEL_TRACE 5
+
+#ifndef BLOG_LEVEL
+#define BLOG_LEVEL BLOG_LEVEL_INFO
+#endif
+
+// Ring size in bytes (power of two)
+#ifndef BLOG_BUFFER_SIZE
+#define BLOG_BUFFER_SIZE 65536
+#endif
+
+#define BLOG_MAX_ARGS   8
+#define BLOG_MAX_STRING 32
+
+// Argument encodings, shared with scripts/binlog_decode.py
+enum BinaryLogArgType : uint8_t {
+    BLOG_ARG_INT32 = 1,
+    BLOG_ARG_UINT32 = 2,
+    BLOG_ARG_INT64 = 3,
+    BLOG_ARG_UINT64 = 4,
+    BLOG_ARG_DOUBLE = 5,
+    BLOG_ARG_STRING = 6   // u8 length, then the bytes
+};
+
+class BinaryLog {
+public:
+    // Record header in the ring; `length` is written last and commits it
+    struct RecordHeader {
+        uint16_t length;        // Whole record, 4-byte aligned; 0 while being written
+        uint8_t level;
+        uint8_t argCount;
+        uint32_t timestampUs;
+        const char* format;
+    };
+
+    static const size_t MAX_PAYLOAD = BLOG_MAX_ARGS * (2 + BLOG_MAX_STRING);
+
+    // Arguments encoded on the caller's stack before they go into the ring
+    struct Payload {
+        uint8_t data[MAX_PAYLOAD];
+        size_t size;
+        uint8_t count;
+
+        Payload() : size(0), count(0) {}
+
+        void add() {}
+
+        template <typename T, typename... Rest>
+        void add(const T& value, const Rest&... rest) {
+            put(value);
+            add(rest...);
+        }
+
+        template <typename T>
+        typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+        put(T value) {
+            if (sizeof(T) <= 4) {
+                if (std::is_signed<T>::value) {
+                    putValue(BLOG_ARG_INT32, (int32_t)value);
+                } else {
+                    putValue(BLOG_ARG_UINT32, (uint32_t)value);
+                }
+            } else if (std::is_signed<T>::value) {
+                putValue(BLOG_ARG_INT64, (int64_t)value);
+            } else {
+                putValue(BLOG_ARG_UINT64, (uint64_t)value);
+            }
+        }
+
+        void put(double value) { putValue(BLOG_ARG_DOUBLE, value); }
+        void put(float value) { putValue(BLOG_ARG_DOUBLE, (double)value); }
+        void put(const char* value) { putString(value); }
+        void put(const void* value) { putValue(BLOG_ARG_UINT64, (uint64_t)(uintptr_t)value); }
+
+        template <typename V>
+        void putValue(uint8_t type, V value) {
+            if (count >= BLOG_MAX_ARGS) return;
+            data[size++] = type;
+            memcpy(&data[size], &value, sizeof(value));
+            size += sizeof(value);
+            count++;
+        }
+
+        void putString(const char* value) {
+            if (count >= BLOG_MAX_ARGS) return;
+            if (value == nullptr) value = "(null)";
+            size_t length = strnlen(value, BLOG_MAX_STRING);
+            data[size++] = BLOG_ARG_STRING;
+            data[size++] = (uint8_t)length;
+            memcpy(&data[size], value, length);
+            size += length;
+            count++;
+        }
+    };
+
+    // Allocate the ring and start the drain task
+    static bool begin();
+
+    // Copy one record into the ring; drops it if the ring is full
+    static void write(uint8_t level, const char* format, const Payload& payload);
+
+    // Emit everything committed so far; the drain task calls this
+    static void drain();
+
+    // Send frames for scripts/binlog_decode.py instead of text
+    static void setBinaryOutput(bool binary) { _binaryOutput = binary; }
+    static bool isBinaryOutput() { return _binaryOutput; }
+
+    static uint32_t getDropped() { return _dropped.load(std::memory_order_relaxed); }
+    static size_t getCapacity() { return _capacity; }
+
+    // Compile-time printf format check; never called
+    static int checkFormat(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+    template <typename... Args>
+    static void log(uint8_t level, const char* format, const Args&... args) {
+        if (_buffer == nullptr) return;
+        Payload payload;
+        payload.add(args...);
+        write(level, format, payload);
+    }
+
+private:
+    static void drainTask(void* parameter);
+    static void emitText(const RecordHeader* header, const uint8_t* payload);
+    static void emitFrame(const RecordHeader* header, const uint8_t* payload);
+
+    static uint8_t* _buffer;
+    static size_t _capacity;
+    static std::atomic<uint32_t> _head;     // Bytes reserved by writers
+    static std::atomic<uint32_t> _tail;     // Bytes released by the drain
+    static std::atomic<uint32_t> _dropped;
+    static volatile bool _binaryOutput;
+};
+
+// The format check sits in an unevaluated sizeof, so it costs no code
+#define BLOG_RECORD(level, format, ...) \
+    do { \
+        (void)sizeof(BinaryLog::checkFormat(format, ##__VA_ARGS__)); \
+        BinaryLog::log(level, format, ##__VA_ARGS__); \
+    } while (0)
+
+#define BLOG_DISCARD(format, ...) do { } while (0)
+
+#if BLOG_LEVEL >= BLOG_LEVEL_ERROR
+#define BLOG_ERROR(format, ...) BLOG_RECORD(BLOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define BLOG_ERROR(format, ...) BLOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#if BLOG_LEVEL >= BLOG_LEVEL_WARN
+#define BLOG_WARN(format, ...) BLOG_RECORD(BLOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#else
+#define BLOG_WARN(format, ...) BLOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#if BLOG_LEVEL >= BLOG_LEVEL_INFO
+#define BLOG_INFO(format, ...) BLOG_RECORD(BLOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define BLOG_INFO(format, ...) BLOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#if BLOG_LEVEL >= BLOG_LEVEL_DEBUG
+#define BLOG_DEBUG(format, ...) BLOG_RECORD(BLOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define BLOG_DEBUG(format, ...) BLOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#if BLOG_LEVEL >= BLOG_LEVEL_TRACE
+#define BLOG_TRACE(format, ...) BLOG_RECORD(BLOG_LEVEL_TRACE, format, ##__VA_ARGS__)
+#else
+#define BLOG_TRACE(format, ...) BLOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#endif // BINARY_LOG_H
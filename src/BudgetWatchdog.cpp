@@ -0,0 +1,228 @@
+#include "BudgetWatchdog.h"
+#include "MetricsRegistry.h"
+#include "SpanTrace.h"
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include <esp_heap_caps.h>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+BudgetWatchdog::StageStats BudgetWatchdog::_stages[STAGE_COUNT];
+BudgetWatchdog::Overrun BudgetWatchdog::_ring[BUDGET_OVERRUN_RING_SIZE];
+uint32_t BudgetWatchdog::_sequence = 0;
+uint32_t BudgetWatchdog::_reported = 0;
+std::atomic<uint16_t> BudgetWatchdog::_active(0);
+BudgetWatchdog::OverrunHandler BudgetWatchdog::_handler = nullptr;
+portMUX_TYPE BudgetWatchdog::_mux = portMUX_INITIALIZER_UNLOCKED;
+String BudgetWatchdog::_lastError = "";
+
+// Constants
+static const char* STAGE_NAMES[STAGE_COUNT] = {
+    "keys", "encoders", "macros", "hid", "network", "update_progress", "leds", "display", "loop"
+};
+
+// Default budgets in microseconds: a stage should finish well inside its
+// task period (TaskManager.cpp), the display excepted, which redraws rarely
+static const uint32_t DEFAULT_BUDGETS_US[STAGE_COUNT] = {
+    2000,    // keys (10 ms period)
+    2000,    // encoders (10 ms)
+    2000,    // macros (5 ms)
+    2000,    // hid (5 ms)
+    5000,    // network (10 ms)
+    10000,   // update_progress (20 ms)
+    5000,    // leds (20 ms)
+    50000,   // display (20 ms; a full-screen redraw takes tens of ms)
+    10000    // loop (20 ms delay)
+};
+
+void BudgetWatchdog::begin() {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        _stages[i].budgetUs = DEFAULT_BUDGETS_US[i];
+    }
+    loadConfig();
+    reset();
+}
+
+void BudgetWatchdog::loadConfig() {
+    if (!LittleFS.exists(BUDGET_CONFIG_PATH)) {
+        return;
+    }
+
+    File file = LittleFS.open(BUDGET_CONFIG_PATH, "r");
+    if (!file) {
+        return;
+    }
+
+    DynamicJsonDocument doc(512);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+
+    if (error) {
+        _lastError = String("Failed to parse ") + BUDGET_CONFIG_PATH + ": " + error.c_str();
+        USBSerial.println(_lastError);
+        return;
+    }
+
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        JsonVariant budget = doc[STAGE_NAMES[i]];
+        if (budget.isNull()) continue;
+        _stages[i].budgetUs = budget.as<uint32_t>();
+    }
+}
+
+void BudgetWatchdog::exit(WatchdogStage stage, uint32_t durationUs) {
+    _active.fetch_and((uint16_t)~(1u << stage), std::memory_order_relaxed);
+    record(stage, durationUs);
+}
+
+void BudgetWatchdog::record(WatchdogStage stage, uint32_t durationUs) {
+    if (stage >= STAGE_COUNT) return;
+
+    // Each stage runs in exactly one task, so its counters have one writer
+    StageStats& stats = _stages[stage];
+    stats.runs++;
+    stats.totalUs += durationUs;
+    if (durationUs > stats.maxUs) stats.maxUs = durationUs;
+
+    if (stats.budgetUs == 0 || durationUs <= stats.budgetUs) {
+        return;
+    }
+    stats.overruns++;
+    SPAN_INSTANT(SPAN_OVERRUN, stage);
+
+    // Snapshot outside the critical section; the largest-block walk is not free
+    Overrun overrun;
+    overrun.timestampMs = millis();
+    overrun.durationUs = durationUs;
+    overrun.budgetUs = stats.budgetUs;
+    overrun.freeHeap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    overrun.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    overrun.concurrentStages = _active.load(std::memory_order_relaxed) & ~(1u << stage);
+    overrun.hidQueueDepth = (uint16_t)metricHidQueueDepth.value();
+    overrun.stage = stage;
+    overrun.core = (uint8_t)xPortGetCoreID();
+
+    portENTER_CRITICAL(&_mux);
+    overrun.sequence = ++_sequence;
+    _ring[(overrun.sequence - 1) % BUDGET_OVERRUN_RING_SIZE] = overrun;
+    portEXIT_CRITICAL(&_mux);
+}
+
+void BudgetWatchdog::poll() {
+    while (true) {
+        Overrun overrun;
+        uint32_t skipped = 0;
+
+        portENTER_CRITICAL(&_mux);
+        if (_reported == _sequence) {
+            portEXIT_CRITICAL(&_mux);
+            return;
+        }
+        // Entries older than the ring were overwritten before we got to them
+        if (_sequence - _reported > BUDGET_OVERRUN_RING_SIZE) {
+            skipped = _sequence - _reported - BUDGET_OVERRUN_RING_SIZE;
+            _reported += skipped;
+        }
+        overrun = _ring[_reported % BUDGET_OVERRUN_RING_SIZE];
+        _reported++;
+        portEXIT_CRITICAL(&_mux);
+
+        if (skipped > 0) {
+            USBSerial.printf("Budget: %u overruns not shown (ring full)\n", skipped);
+        }
+        printOverrun(overrun);
+        if (_handler) {
+            _handler(overrun);
+        }
+    }
+}
+
+void BudgetWatchdog::printOverrun(const Overrun& overrun) {
+    String concurrent;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        if (overrun.concurrentStages & (1u << i)) {
+            if (concurrent.length() > 0) concurrent += ",";
+            concurrent += STAGE_NAMES[i];
+        }
+    }
+
+    USBSerial.printf("Budget: %s took %u us (budget %u) at %u ms on core %u; heap %u, largest %u, hid queue %u%s%s\n",
+                     STAGE_NAMES[overrun.stage], overrun.durationUs, overrun.budgetUs,
+                     overrun.timestampMs, overrun.core, overrun.freeHeap, overrun.largestFreeBlock,
+                     overrun.hidQueueDepth, concurrent.length() > 0 ? ", during " : "", concurrent.c_str());
+}
+
+bool BudgetWatchdog::setBudget(WatchdogStage stage, uint32_t budgetUs) {
+    if (stage >= STAGE_COUNT) {
+        _lastError = "Invalid stage";
+        return false;
+    }
+    _stages[stage].budgetUs = budgetUs;
+    return true;
+}
+
+uint32_t BudgetWatchdog::getBudget(WatchdogStage stage) {
+    return stage < STAGE_COUNT ? _stages[stage].budgetUs : 0;
+}
+
+const char* BudgetWatchdog::getStageName(WatchdogStage stage) {
+    return stage < STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+void BudgetWatchdog::getStatus(JsonObject status) {
+    JsonArray stages = status.createNestedArray("stages");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const StageStats& stats = _stages[i];
+        JsonObject obj = stages.createNestedObject();
+        obj["name"] = STAGE_NAMES[i];
+        obj["budget_us"] = stats.budgetUs;
+        obj["runs"] = stats.runs;
+        obj["avg_us"] = stats.runs > 0 ? (uint32_t)(stats.totalUs / stats.runs) : 0;
+        obj["max_us"] = stats.maxUs;
+        obj["overruns"] = stats.overruns;
+    }
+
+    // Copy the ring out so the critical section stays short
+    Overrun ring[BUDGET_OVERRUN_RING_SIZE];
+    portENTER_CRITICAL(&_mux);
+    uint32_t sequence = _sequence;
+    memcpy(ring, _ring, sizeof(ring));
+    portEXIT_CRITICAL(&_mux);
+
+    status["overruns_total"] = sequence;
+    JsonArray overruns = status.createNestedArray("overruns");
+    uint32_t count = sequence < BUDGET_OVERRUN_RING_SIZE ? sequence : BUDGET_OVERRUN_RING_SIZE;
+    for (uint32_t n = 0; n < count; n++) {
+        const Overrun& overrun = ring[(sequence - 1 - n) % BUDGET_OVERRUN_RING_SIZE];
+        JsonObject obj = overruns.createNestedObject();
+        obj["sequence"] = overrun.sequence;
+        obj["time_ms"] = overrun.timestampMs;
+        obj["stage"] = STAGE_NAMES[overrun.stage];
+        obj["duration_us"] = overrun.durationUs;
+        obj["budget_us"] = overrun.budgetUs;
+        obj["core"] = overrun.core;
+        obj["free_heap"] = overrun.freeHeap;
+        obj["largest_free_block"] = overrun.largestFreeBlock;
+        obj["hid_queue"] = overrun.hidQueueDepth;
+        JsonArray concurrent = obj.createNestedArray("during");
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            if (overrun.concurrentStages & (1u << i)) {
+                concurrent.add(STAGE_NAMES[i]);
+            }
+        }
+    }
+}
+
+void BudgetWatchdog::reset() {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        _stages[i].runs = 0;
+        _stages[i].totalUs = 0;
+        _stages[i].maxUs = 0;
+        _stages[i].overruns = 0;
+    }
+    portENTER_CRITICAL(&_mux);
+    _sequence = 0;
+    _reported = 0;
+    portEXIT_CRITICAL(&_mux);
+}
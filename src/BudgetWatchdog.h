@@ -0,0 +1,126 @@
+#ifndef BUDGET_WATCHDOG_H
+#define BUDGET_WATCHDOG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+// Per-stage time budgets for the task bodies and loop().
+//
+// Each stage of a managed task (see TaskManager) is timed with a StageTimer.
+// A stage that takes longer than its budget is recorded, with a snapshot of
+// heap and HID state and the other stages running at that moment, into a
+// fixed ring. poll() reports new overruns on serial from loop(), so the
+// task that overran never waits on the console. Budgets default to the
+// values in BudgetWatchdog.cpp and can be overridden at boot from
+// BUDGET_CONFIG_PATH:
+//
+//   {"display": 30000, "network": 8000}   (microseconds, 0 disables)
+
+#define BUDGET_CONFIG_PATH "/config/budgets.json"
+
+#ifndef BUDGET_OVERRUN_RING_SIZE
+#define BUDGET_OVERRUN_RING_SIZE 32
+#endif
+
+// Timed stages, in task order
+enum WatchdogStage {
+    STAGE_KEYS,              // keyboard_task: matrix scan
+    STAGE_ENCODERS,          // encoder_task: encoder poll
+    STAGE_MACROS,            // hid_task: macro steps
+    STAGE_HID,               // hid_task: report delivery
+    STAGE_NETWORK,           // network_task: WebSocket/HTTP housekeeping
+    STAGE_UPDATE_PROGRESS,   // ui_task: OTA progress screen
+    STAGE_LEDS,              // ui_task: LED frame
+    STAGE_DISPLAY,           // ui_task: display refresh
+    STAGE_LOOP,              // loop(): serial commands, persistence
+    STAGE_COUNT
+};
+
+class BudgetWatchdog {
+public:
+    // One recorded overrun
+    struct Overrun {
+        uint32_t sequence;           // 1-based, counts every overrun since reset
+        uint32_t timestampMs;
+        uint32_t durationUs;
+        uint32_t budgetUs;
+        uint32_t freeHeap;
+        uint32_t largestFreeBlock;
+        uint16_t concurrentStages;   // Bit mask of other stages running at the time
+        uint16_t hidQueueDepth;
+        uint8_t stage;
+        uint8_t core;
+    };
+
+    // Called from poll() for every new overrun, e.g. to dump a trace
+    typedef void (*OverrunHandler)(const Overrun& overrun);
+
+    // Load budgets from BUDGET_CONFIG_PATH
+    static void begin();
+
+    // Mark a stage as running; StageTimer calls these
+    static void enter(WatchdogStage stage) {
+        _active.fetch_or((uint16_t)(1u << stage), std::memory_order_relaxed);
+    }
+    static void exit(WatchdogStage stage, uint32_t durationUs);
+
+    // Record a stage timed elsewhere (loop())
+    static void record(WatchdogStage stage, uint32_t durationUs);
+
+    // Report overruns recorded since the last call; run from loop()
+    static void poll();
+
+    static void setOverrunHandler(OverrunHandler handler) { _handler = handler; }
+
+    static bool setBudget(WatchdogStage stage, uint32_t budgetUs);
+    static uint32_t getBudget(WatchdogStage stage);
+    static const char* getStageName(WatchdogStage stage);
+
+    // Budgets, per-stage timing and the overrun ring, newest first
+    static void getStatus(JsonObject status);
+
+    // Clear statistics and the overrun ring
+    static void reset();
+
+    static String getLastError() { return _lastError; }
+
+private:
+    struct StageStats {
+        uint32_t budgetUs;
+        uint32_t runs;
+        uint64_t totalUs;
+        uint32_t maxUs;
+        uint32_t overruns;
+    };
+
+    static void loadConfig();
+    static void printOverrun(const Overrun& overrun);
+
+    static StageStats _stages[STAGE_COUNT];
+    static Overrun _ring[BUDGET_OVERRUN_RING_SIZE];
+    static uint32_t _sequence;
+    static uint32_t _reported;
+    static std::atomic<uint16_t> _active;
+    static OverrunHandler _handler;
+    static portMUX_TYPE _mux;
+    static String _lastError;
+};
+
+// Times a stage against its budget for the rest of the scope
+class StageTimer {
+public:
+    explicit StageTimer(WatchdogStage stage) : _stage(stage), _start(micros()) {
+        BudgetWatchdog::enter(_stage);
+    }
+    ~StageTimer() { BudgetWatchdog::exit(_stage, micros() - _start); }
+
+private:
+    StageTimer(const StageTimer&);
+    StageTimer& operator=(const StageTimer&);
+
+    WatchdogStage _stage;
+    uint32_t _start;
+};
+
+#endif // BUDGET_WATCHDOG_H
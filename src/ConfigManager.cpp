@@ -6,6 +6,8 @@
 #include <LittleFS.h>
 #include <USBCDC.h>
 #include "JsonUtils.h" // Include centralized JSON utilities
+#include "SpanTrace.h"
+#include "MemoryPolicy.h"
 
 // Global references
 extern USBCDC USBSerial;
@@ -31,8 +33,10 @@ std::vector<Component> ConfigManager::loadComponents(const char* filePath) {
     // Estimate buffer size based on JSON content with a 1.5 multiplier
     size_t bufferSize = estimateJsonBufferSize(jsonStr);
     
-    DynamicJsonDocument doc(bufferSize);
+    PsramJsonDocument doc(bufferSize);
+    SPAN_BEGIN(SPAN_JSON_PARSE, jsonStr.length());
     DeserializationError error = deserializeJson(doc, jsonStr);
+    SPAN_END(SPAN_JSON_PARSE);
     
     Serial.printf("Free heap after parsing: %d bytes\n", ESP.getFreeHeap());
     
@@ -47,7 +51,7 @@ std::vector<Component> ConfigManager::loadComponents(const char* filePath) {
             // If we can estimate and allocate the required size, retry
             if (requiredSize > 0 && requiredSize <= ESP.getFreeHeap() / 2) {
                 Serial.printf("Retrying with estimated size: %u bytes\n", requiredSize);
-                DynamicJsonDocument retryDoc(requiredSize);
+                PsramJsonDocument retryDoc(requiredSize);
                 error = deserializeJson(retryDoc, jsonStr);
                 if (!error) {
                     // Process with the retry document
@@ -130,13 +134,20 @@ std::map<String, ActionConfig> ConfigManager::loadActions(const char* filePath)
         if (fileSize > 3000) {
             bufferSize = 32768; // Use 32KB for larger files
         }
+        // Strings read from a stream are copied into the document, and every
+        // report code takes a slot: a file with many layers outgrows 32KB
+        if (fileSize * 6 > bufferSize) {
+            bufferSize = fileSize * 6;
+        }
         
         USBSerial.printf("Allocating JSON buffer of %d bytes (free heap: %d)\n", 
                      bufferSize, ESP.getFreeHeap());
         
-        DynamicJsonDocument fullDoc(bufferSize);
+        PsramJsonDocument fullDoc(bufferSize);
         
+        SPAN_BEGIN(SPAN_JSON_PARSE, fileSize);
         DeserializationError error = deserializeJson(fullDoc, file);
+        SPAN_END(SPAN_JSON_PARSE);
         
         if (error) {
             USBSerial.printf("Failed to parse actions.json with error: %s\n", error.c_str());
@@ -146,6 +157,12 @@ std::map<String, ActionConfig> ConfigManager::loadActions(const char* filePath)
             String jsonString = file.readString();
             file.close();
             
+            // The working file is the only one recreating can fix; retrying
+            // any other path would fail the same way forever
+            if (strcmp(filePath, "/config/actions.json") != 0) {
+                return actions;
+            }
+            
             USBSerial.println("Calling createWorkingActionsFile to recover from parse error");
             createWorkingActionsFile();
             
@@ -630,9 +647,12 @@ std::map<String, DisplayMode> ConfigManager::loadDisplayModes(const char* filePa
         return displayModes;
     }
     
-    // Parse the JSON
-    DynamicJsonDocument doc(8192);  // Allocate a large buffer
+    // Parse the JSON; 8KB covers the shipped file, larger ones are sized from their content
+    size_t bufferSize = estimateJsonBufferSize(jsonStr, 3.0);
+    PsramJsonDocument doc(bufferSize > 8192 ? bufferSize : 8192);
+    SPAN_BEGIN(SPAN_JSON_PARSE, jsonStr.length());
     DeserializationError error = deserializeJson(doc, jsonStr);
+    SPAN_END(SPAN_JSON_PARSE);
     
     if (error) {
         USBSerial.printf("Error parsing display modes JSON: %s\n", error.c_str());
@@ -675,8 +695,10 @@ std::vector<DisplayElement> ConfigManager::loadDisplayElements(const char* fileP
     }
     
     // Parse the JSON
-    DynamicJsonDocument doc(16384);  // Larger buffer for elements
+    PsramJsonDocument doc(16384);  // Larger buffer for elements
+    SPAN_BEGIN(SPAN_JSON_PARSE, jsonStr.length());
     DeserializationError error = deserializeJson(doc, jsonStr);
+    SPAN_END(SPAN_JSON_PARSE);
     
     if (error) {
         USBSerial.printf("Error parsing display elements JSON: %s\n", error.c_str());
@@ -0,0 +1,474 @@
+#include "ConfigSnapshot.h"
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include <algorithm>
+#include <time.h>
+#include "FileSystemUtils.h"
+#include "VersionManager.h"
+#include "MemoryPolicy.h"
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+String ConfigSnapshot::_lastError = "";
+
+// Constants
+const size_t ConfigSnapshot::MAX_SNAPSHOTS = 4;
+static const char* SNAPSHOT_DIR = "/.snap";
+static const char* OBJECT_DIR = "/.snap/obj";
+static const char* RESTORE_JOURNAL = "/.snap/restore";
+static const char* TRACKED_DIRS[] = {"/config", "/macros"};
+static const char* UNTRACKED_PREFIX = "/config/defaults/";  // Shipped with the firmware
+static const size_t SNAPSHOT_DOCUMENT_SIZE = 8192;
+static const size_t OBJECT_NAME_LENGTH = 16;                // Hex digits of the SHA-256
+// Earliest file time taken as wall-clock time (November 2023). Without SNTP
+// the clock counts from boot, so earlier times repeat after every reset
+static const time_t WALL_CLOCK_MIN = 1700000000;
+
+void ConfigSnapshot::begin() {
+    File journal = LittleFS.open(RESTORE_JOURNAL, "r");
+    if (!journal) {
+        return;
+    }
+    int id = journal.readStringUntil('\n').toInt();
+    journal.close();
+
+    USBSerial.printf("ConfigSnapshot: Finishing interrupted restore of snapshot %d\n", id);
+    if (!applyRestore(id)) {
+        USBSerial.printf("ConfigSnapshot: Restore failed: %s\n", _lastError.c_str());
+    }
+    LittleFS.remove(RESTORE_JOURNAL);
+}
+
+int ConfigSnapshot::take(const String& reason) {
+    return takeSnapshot(reason, -1);
+}
+
+bool ConfigSnapshot::restore(int id) {
+    std::vector<FileEntry> files;
+    if (!loadManifest(id, files)) {
+        return fail("Snapshot " + String(id) + " not found");
+    }
+    for (const FileEntry& file : files) {
+        if (!LittleFS.exists(objectPath(file.digest))) {
+            return fail("Snapshot " + String(id) + " is incomplete");
+        }
+    }
+
+    // Keep what is being replaced, without pruning the snapshot we restore
+    if (takeSnapshot("before restore of " + String(id), id) < 0) {
+        return false;
+    }
+
+    File journal = LittleFS.open(RESTORE_JOURNAL, "w");
+    if (!journal) {
+        return fail("Failed to write restore journal");
+    }
+    journal.printf("%d\n", id);
+    journal.close();
+
+    bool restored = applyRestore(id);
+    LittleFS.remove(RESTORE_JOURNAL);
+    if (restored) {
+        USBSerial.printf("ConfigSnapshot: Restored snapshot %d\n", id);
+    }
+    return restored;
+}
+
+bool ConfigSnapshot::list(JsonArray snapshots) {
+    std::vector<int> ids = listIds();
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+        File file = LittleFS.open(manifestPath(*it), "r");
+        if (!file) continue;
+        PsramJsonDocument doc(SNAPSHOT_DOCUMENT_SIZE);
+        DeserializationError error = deserializeJson(doc, file);
+        file.close();
+        if (error) continue;
+
+        size_t bytes = 0;
+        for (JsonObject entry : doc["files"].as<JsonArray>()) {
+            bytes += entry["size"].as<size_t>();
+        }
+
+        JsonObject snapshot = snapshots.createNestedObject();
+        if (snapshot.isNull()) {
+            return fail("Too many snapshots to list");
+        }
+        snapshot["id"] = *it;
+        snapshot["reason"] = doc["reason"].as<const char*>();
+        snapshot["version"] = doc["version"].as<const char*>();
+        snapshot["files"] = doc["files"].size();
+        snapshot["bytes"] = bytes;
+    }
+    return true;
+}
+
+int ConfigSnapshot::takeSnapshot(const String& reason, int keepId) {
+    std::vector<int> ids = listIds();
+    int latest = ids.empty() ? -1 : ids.back();
+
+    // The previous manifest lets unchanged files skip hashing
+    std::vector<FileEntry> previous;
+    if (latest >= 0) {
+        loadManifest(latest, previous);
+    }
+
+    std::vector<FileEntry> files;
+    for (const char* dir : TRACKED_DIRS) {
+        if (!scanFiles(dir, files, previous)) {
+            return -1;
+        }
+    }
+
+    // Nothing changed: the latest snapshot already describes this state
+    bool changed = latest < 0 || files.size() != previous.size();
+    for (size_t i = 0; !changed && i < files.size(); i++) {
+        auto match = std::find_if(previous.begin(), previous.end(), [&](const FileEntry& entry) {
+            return entry.path == files[i].path;
+        });
+        changed = match == previous.end() || memcmp(match->digest, files[i].digest, SHA256Hasher::DIGEST_SIZE) != 0;
+    }
+    if (!changed) {
+        return latest;
+    }
+
+    FileSystemUtils::createDirPath(OBJECT_DIR);
+    size_t stored = 0;
+    for (const FileEntry& file : files) {
+        if (LittleFS.exists(objectPath(file.digest))) continue;
+        if (!storeObject(file)) {
+            return -1;
+        }
+        stored++;
+    }
+
+    int id = latest + 1;
+    if (!writeManifest(id, reason, files)) {
+        return -1;
+    }
+    prune(keepId);
+
+    USBSerial.printf("ConfigSnapshot: Snapshot %d (%s), %u files, %u new\n", id, reason.c_str(),
+                     (unsigned)files.size(), (unsigned)stored);
+    return id;
+}
+
+bool ConfigSnapshot::scanFiles(const char* dir, std::vector<FileEntry>& files, const std::vector<FileEntry>& previous) {
+    File root = LittleFS.open(dir, "r");
+    if (!root || !root.isDirectory()) {
+        return true;  // Nothing to snapshot
+    }
+
+    File child = root.openNextFile();
+    while (child) {
+        String path = child.path();
+        if (child.isDirectory()) {
+            child.close();
+            if (!scanFiles(path.c_str(), files, previous)) {
+                return false;
+            }
+        } else if (isTracked(path)) {
+            FileEntry entry;
+            entry.path = path;
+            entry.size = child.size();
+            entry.modified = child.getLastWrite();
+
+            auto match = std::find_if(previous.begin(), previous.end(), [&](const FileEntry& file) {
+                return file.path == path;
+            });
+            // A boot-relative time can repeat with other contents, so the
+            // digest is only reused for files stamped from a set clock
+            if (match != previous.end() && match->size == entry.size && match->modified == entry.modified &&
+                entry.modified >= WALL_CLOCK_MIN) {
+                memcpy(entry.digest, match->digest, SHA256Hasher::DIGEST_SIZE);
+            } else {
+                SHA256Hasher hasher;
+                hasher.begin();
+                uint8_t buffer[512];
+                size_t n;
+                while ((n = child.read(buffer, sizeof(buffer))) > 0) {
+                    hasher.add(buffer, n);
+                }
+                hasher.calculate();
+                memcpy(entry.digest, hasher.getBytes(), SHA256Hasher::DIGEST_SIZE);
+            }
+            child.close();
+            files.push_back(entry);
+        } else {
+            child.close();
+        }
+        child = root.openNextFile();
+    }
+    return true;
+}
+
+bool ConfigSnapshot::loadManifest(int id, std::vector<FileEntry>& files) {
+    File file = LittleFS.open(manifestPath(id), "r");
+    if (!file) {
+        return false;
+    }
+    PsramJsonDocument doc(SNAPSHOT_DOCUMENT_SIZE);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+        return fail("Snapshot " + String(id) + " is corrupt");
+    }
+
+    for (JsonObject entry : doc["files"].as<JsonArray>()) {
+        FileEntry file;
+        file.path = entry["path"].as<const char*>();
+        file.size = entry["size"].as<size_t>();
+        file.modified = entry["mtime"].as<long>();
+        if (!SHA256Hasher::parseHex(entry["sha256"].as<const char*>(), file.digest)) {
+            return fail("Snapshot " + String(id) + " is corrupt");
+        }
+        files.push_back(file);
+    }
+    return true;
+}
+
+bool ConfigSnapshot::writeManifest(int id, const String& reason, const std::vector<FileEntry>& files) {
+    PsramJsonDocument doc(SNAPSHOT_DOCUMENT_SIZE);
+    doc["id"] = id;
+    doc["reason"] = reason;
+    doc["version"] = VersionManager::getVersionString();
+    JsonArray list = doc.createNestedArray("files");
+
+    // A file written in the current second could still change without its
+    // time moving; leave its time out so the next snapshot reads it again
+    time_t now = time(nullptr);
+    for (const FileEntry& file : files) {
+        JsonObject entry = list.createNestedObject();
+        entry["path"] = file.path;
+        entry["size"] = file.size;
+        entry["mtime"] = file.modified < now ? (long)file.modified : 0L;
+        entry["sha256"] = SHA256Hasher::toHex(file.digest);
+    }
+    if (doc.overflowed()) {
+        return fail("Too many config files to snapshot");
+    }
+
+    // Written aside and renamed, so a manifest is never half written
+    String path = manifestPath(id);
+    String temp = path + ".tmp";
+    File out = LittleFS.open(temp, "w");
+    if (!out) {
+        return fail("Failed to write snapshot manifest");
+    }
+    bool written = serializeJson(doc, out) > 0;
+    out.close();
+    if (!written || !LittleFS.rename(temp, path)) {
+        LittleFS.remove(temp);
+        return fail("Failed to write snapshot manifest");
+    }
+    return true;
+}
+
+bool ConfigSnapshot::storeObject(const FileEntry& file) {
+    // Copying an object back out verifies its hash; the same check here
+    // catches a file that changed since it was scanned
+    String object = objectPath(file.digest);
+    String temp = object + ".tmp";
+    File from = LittleFS.open(file.path, "r");
+    File to = LittleFS.open(temp, "w");
+    if (!from || !to) {
+        return fail("Failed to store " + file.path);
+    }
+
+    SHA256Hasher hasher;
+    hasher.begin();
+    uint8_t buffer[512];
+    size_t n;
+    bool written = true;
+    while ((n = from.read(buffer, sizeof(buffer))) > 0) {
+        hasher.add(buffer, n);
+        if (to.write(buffer, n) != n) {
+            written = false;
+            break;
+        }
+    }
+    from.close();
+    to.close();
+    hasher.calculate();
+
+    if (!written || memcmp(hasher.getBytes(), file.digest, SHA256Hasher::DIGEST_SIZE) != 0 ||
+        !LittleFS.rename(temp, object)) {
+        LittleFS.remove(temp);
+        return fail(written ? "Config changed while snapshotting: " + file.path : "Failed to store " + file.path);
+    }
+    return true;
+}
+
+bool ConfigSnapshot::copyObject(const FileEntry& file, const String& toPath) {
+    String temp = toPath + ".tmp";
+    File from = LittleFS.open(objectPath(file.digest), "r");
+    File to = LittleFS.open(temp, "w", true);
+    if (!from || !to) {
+        return fail("Failed to restore " + toPath);
+    }
+
+    SHA256Hasher hasher;
+    hasher.begin();
+    uint8_t buffer[512];
+    size_t n;
+    bool written = true;
+    while ((n = from.read(buffer, sizeof(buffer))) > 0) {
+        hasher.add(buffer, n);
+        if (to.write(buffer, n) != n) {
+            written = false;
+            break;
+        }
+    }
+    from.close();
+    to.close();
+    hasher.calculate();
+
+    // Rename replaces the live file in one step
+    if (!written || memcmp(hasher.getBytes(), file.digest, SHA256Hasher::DIGEST_SIZE) != 0 ||
+        !LittleFS.rename(temp, toPath)) {
+        LittleFS.remove(temp);
+        return fail(written ? "Snapshot copy of " + toPath + " is corrupt" : "Failed to restore " + toPath);
+    }
+    return true;
+}
+
+bool ConfigSnapshot::applyRestore(int id) {
+    std::vector<FileEntry> files;
+    if (!loadManifest(id, files)) {
+        return fail("Snapshot " + String(id) + " not found");
+    }
+
+    // Rewrite only what differs; a redo after a reset skips finished files
+    std::vector<FileEntry> current;
+    for (const char* dir : TRACKED_DIRS) {
+        scanFiles(dir, current, std::vector<FileEntry>());
+    }
+    bool success = true;
+    for (const FileEntry& file : files) {
+        auto match = std::find_if(current.begin(), current.end(), [&](const FileEntry& entry) {
+            return entry.path == file.path;
+        });
+        if (match != current.end() && memcmp(match->digest, file.digest, SHA256Hasher::DIGEST_SIZE) == 0) {
+            continue;
+        }
+        success = copyObject(file, file.path) && success;
+    }
+
+    // Configs created after the snapshot go too
+    for (const char* dir : TRACKED_DIRS) {
+        removeUntracked(dir, files);
+    }
+    return success;
+}
+
+void ConfigSnapshot::removeUntracked(const char* dir, const std::vector<FileEntry>& keep) {
+    File root = LittleFS.open(dir, "r");
+    if (!root || !root.isDirectory()) {
+        return;
+    }
+
+    std::vector<String> remove;
+    File child = root.openNextFile();
+    while (child) {
+        String path = child.path();
+        if (child.isDirectory()) {
+            child.close();
+            removeUntracked(path.c_str(), keep);
+        } else {
+            child.close();
+            bool kept = std::any_of(keep.begin(), keep.end(), [&](const FileEntry& file) {
+                return file.path == path;
+            });
+            if (isTracked(path) && !kept) {
+                remove.push_back(path);
+            }
+        }
+        child = root.openNextFile();
+    }
+    root.close();
+
+    for (const String& path : remove) {
+        LittleFS.remove(path);
+    }
+}
+
+void ConfigSnapshot::prune(int keepId) {
+    std::vector<int> ids = listIds();
+    size_t count = ids.size();
+    for (int id : ids) {
+        if (count <= MAX_SNAPSHOTS) break;
+        if (id == keepId) continue;
+        LittleFS.remove(manifestPath(id));
+        count--;
+    }
+
+    // Drop contents no remaining snapshot refers to
+    std::vector<String> referenced;
+    for (int id : listIds()) {
+        std::vector<FileEntry> files;
+        if (!loadManifest(id, files)) {
+            return;  // Unsure what is still needed; keep everything
+        }
+        for (const FileEntry& file : files) {
+            referenced.push_back(objectPath(file.digest));
+        }
+    }
+
+    File dir = LittleFS.open(OBJECT_DIR, "r");
+    if (!dir) {
+        return;
+    }
+    std::vector<String> unreferenced;
+    File object = dir.openNextFile();
+    while (object) {
+        String path = object.path();
+        object.close();
+        if (std::find(referenced.begin(), referenced.end(), path) == referenced.end()) {
+            unreferenced.push_back(path);
+        }
+        object = dir.openNextFile();
+    }
+    dir.close();
+
+    for (const String& path : unreferenced) {
+        LittleFS.remove(path);
+    }
+}
+
+std::vector<int> ConfigSnapshot::listIds() {
+    std::vector<int> ids;
+    File dir = LittleFS.open(SNAPSHOT_DIR, "r");
+    if (!dir) {
+        return ids;
+    }
+    File entry = dir.openNextFile();
+    while (entry) {
+        String path = entry.path();
+        String name = path.substring(path.lastIndexOf('/') + 1);
+        if (!entry.isDirectory() && name.endsWith(".json") && name.length() > 5 && isdigit((unsigned char)name[0])) {
+            ids.push_back(name.toInt());
+        }
+        entry.close();
+        entry = dir.openNextFile();
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+String ConfigSnapshot::manifestPath(int id) {
+    return String(SNAPSHOT_DIR) + "/" + String(id) + ".json";
+}
+
+String ConfigSnapshot::objectPath(const uint8_t* digest) {
+    return String(OBJECT_DIR) + "/" + SHA256Hasher::toHex(digest).substring(0, OBJECT_NAME_LENGTH);
+}
+
+bool ConfigSnapshot::isTracked(const String& path) {
+    return !path.startsWith(UNTRACKED_PREFIX) && !path.endsWith(".tmp");
+}
+
+bool ConfigSnapshot::fail(const String& error) {
+    _lastError = error;
+    USBSerial.printf("ConfigSnapshot: %s\n", error.c_str());
+    return false;
+}
@@ -0,0 +1,67 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+#include "SHA256Hasher.h"
+
+// Versioned copies of the user's configuration (/config without its
+// defaults, and /macros), so a firmware rollback can take its configs
+// with it.
+//
+// File contents are stored once per SHA-256 in /.snap/obj; a snapshot is a
+// small manifest (/.snap/<id>.json) of paths and hashes. Files whose size
+// and modification time match the previous snapshot are not read again,
+// and only new contents are written, so a snapshot costs what changed.
+//
+// Restores run from a journal (/.snap/restore): a restore cut short by a
+// reset is redone on the next boot, so it always completes as a whole.
+class ConfigSnapshot {
+public:
+    // Finish an interrupted restore; call once LittleFS is mounted
+    static void begin();
+
+    // Snapshot the current configs. Returns the snapshot id, or -1 on
+    // error. When nothing changed the latest snapshot's id is returned.
+    static int take(const String& reason);
+
+    // Put the configs of a snapshot back; the current state is
+    // snapshotted first, so a restore can itself be undone
+    static bool restore(int id);
+
+    // Snapshots, newest first: {"id", "reason", "version", "files", "bytes"}
+    static bool list(JsonArray snapshots);
+
+    static String getLastError() { return _lastError; }
+
+private:
+    struct FileEntry {
+        String path;
+        size_t size;
+        time_t modified;
+        uint8_t digest[SHA256Hasher::DIGEST_SIZE];
+    };
+
+    static bool scanFiles(const char* dir, std::vector<FileEntry>& files, const std::vector<FileEntry>& previous);
+    static bool loadManifest(int id, std::vector<FileEntry>& files);
+    static bool writeManifest(int id, const String& reason, const std::vector<FileEntry>& files);
+    static bool storeObject(const FileEntry& file);
+    static bool copyObject(const FileEntry& file, const String& toPath);
+    static bool applyRestore(int id);
+    static int takeSnapshot(const String& reason, int keepId);
+    static void prune(int keepId);
+    static std::vector<int> listIds();
+    static String manifestPath(int id);
+    static String objectPath(const uint8_t* digest);
+    static void removeUntracked(const char* dir, const std::vector<FileEntry>& keep);
+    static bool isTracked(const String& path);
+    static bool fail(const String& error);
+
+    static String _lastError;
+
+    // Snapshots kept; older ones and their unreferenced contents are removed
+    static const size_t MAX_SNAPSHOTS;
+};
+
+#endif // CONFIG_SNAPSHOT_H
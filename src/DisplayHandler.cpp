@@ -1,9 +1,12 @@
 // DisplayHandler.cpp
 #include "DisplayHandler.h"
-#include "WiFiManager.h"
-#include "KeyHandler.h"
-#include "MacroHandler.h"
 #include "HIDHandler.h"
+#include "EventBus.h"
+#include "MetricsRegistry.h"
+#include "BinaryLog.h"
+#include "PowerManager.h"
+#include "SpanTrace.h"
+#include "MemoryPolicy.h"
 #include <LittleFS.h>
 #include <Arduino.h>
 #include <JPEGDEC.h> // Include the JPEG decoder library
@@ -11,10 +14,6 @@
 // External declaration for USBSerial
 extern USBCDC USBSerial;
 
-// External references
-extern KeyHandler* keyHandler;
-extern MacroHandler* macroHandler;
-
 // Global variables
 Adafruit_ST7789* display = nullptr;
 bool temporaryMessageActive = false;
@@ -28,6 +27,14 @@ std::map<String, DisplayMode> displayModes;
 String lastNormalContent = "";
 static bool screenInitialized = false;
 
+// State shown on the main layout, kept current by the event bus
+static int stateEventSubscription = -1;
+static const uint16_t STATE_EVENT_QUEUE_DEPTH = 16;
+static BusEvent layerState = {};
+static BusEvent wifiState = {};
+static BusEvent macroState = {};
+static bool stateChanged = false;
+
 // Add these global variables at the top with other globals
 bool backgroundLoaded = false;
 uint16_t* backgroundBuffer = nullptr;
@@ -40,19 +47,19 @@ JPEGDEC jpeg;
 int jpegDrawCallback(JPEGDRAW *pDraw) {
     // Check if the background buffer exists
     if (!backgroundBuffer) {
-        USBSerial.println("ERROR: JPEG callback called but backgroundBuffer is NULL");
+        BLOG_ERROR("ERROR: JPEG callback called but backgroundBuffer is NULL\n");
         return 0; // Return 0 to stop decoding
     }
     
-    USBSerial.printf("JPEG block: x=%d, y=%d, w=%d, h=%d\n", 
-                   pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight);
+    BLOG_TRACE("JPEG block: x=%d, y=%d, w=%d, h=%d\n", 
+               pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight);
     
     // Get image dimensions from the JPEG decoder
     int jpegWidth = jpeg.getWidth();
     int jpegHeight = jpeg.getHeight();
     
-    USBSerial.printf("JPEG dimensions: %dx%d, display buffer: 240x280\n", 
-                   jpegWidth, jpegHeight);
+    BLOG_TRACE("JPEG dimensions: %dx%d, display buffer: 240x280\n", 
+               jpegWidth, jpegHeight);
     
     // Copy the decoded pixel block to the buffer with dimension correction
     for (int y = 0; y < pDraw->iHeight; y++) {
@@ -89,7 +96,7 @@ int jpegDrawCallback(JPEGDRAW *pDraw) {
                 uint16_t pixel = pDraw->pPixels[srcIndex];
                 backgroundBuffer[bufferIndex] = pixel;
             } else {
-                USBSerial.printf("WARNING: Buffer index out of bounds: %lu\n", bufferIndex);
+                BLOG_WARN("WARNING: Buffer index out of bounds: %lu\n", (unsigned long)bufferIndex);
             }
         }
     }
@@ -98,9 +105,28 @@ int jpegDrawCallback(JPEGDRAW *pDraw) {
     return 1;
 }
 
+// Take queued state events; true if any arrived
+static bool applyStateEvents() {
+    bool changed = false;
+    BusEvent event;
+    while (EventBus::poll(stateEventSubscription, event)) {
+        switch (event.topic) {
+            case EVENT_LAYER: layerState = event; break;
+            case EVENT_WIFI: wifiState = event; break;
+            case EVENT_MACRO: macroState = event; break;
+        }
+        changed = true;
+    }
+    return changed;
+}
+
 void initializeDisplay() {
     USBSerial.println("Starting display initialization...");
     
+    // The bus replays the current layer, WiFi and macro state right away
+    stateEventSubscription = EventBus::subscribe("display", EVENT_LAYER | EVENT_WIFI | EVENT_MACRO,
+                                                 STATE_EVENT_QUEUE_DEPTH);
+    
     // Initialize SPI with HSPI
     SPIClass* spi = new SPIClass(HSPI);
     spi->begin(TFT_SCLK, -1, TFT_MOSI, TFT_CS);
@@ -227,6 +253,11 @@ void updateDisplay() {
         screenInitialized = true;
     }
     
+    // Collect state changes every call so the queue never overflows
+    if (applyStateEvents()) {
+        stateChanged = true;
+    }
+    
     // Rate limit display updates to prevent flickering
     uint32_t currentTime = millis();
     if (currentTime - lastDisplayUpdate < 500) { // Increased to 500ms to reduce flickering
@@ -244,31 +275,7 @@ void updateDisplay() {
         return;
     }
     
-    // Store current state values to detect changes
-    static String lastLayer = "";
-    static String lastWifiStatus = "";
-    static String lastIpAddress = "";
-    static String lastMacroStatus = "";
-    
-    // Get current state values
-    String currentLayer = keyHandler ? keyHandler->getCurrentLayer() : "default";
-    String currentWifiStatus = WiFiManager::isConnected() ? "Connected" : "Disconnected";
-    String currentIpAddress = WiFiManager::getLocalIP().toString();
-    String currentMacroStatus = (macroHandler && macroHandler->isExecuting()) ? "Running" : "Ready";
-    
-    // Check if any state has changed
-    bool stateChanged = (lastLayer != currentLayer) || 
-                        (lastWifiStatus != currentWifiStatus) || 
-                        (lastIpAddress != currentIpAddress) || 
-                        (lastMacroStatus != currentMacroStatus);
-    
-    // Update last state values
-    lastLayer = currentLayer;
-    lastWifiStatus = currentWifiStatus;
-    lastIpAddress = currentIpAddress;
-    lastMacroStatus = currentMacroStatus;
-    
-    // If no state has changed, skip redrawing to prevent flicker
+    // Skip redrawing unless the bus reported a change, to prevent flicker
     if (!stateChanged) {
         return;
     }
@@ -444,7 +451,7 @@ void activateDisplayMode(const String& modeName) {
         // the correct background is loaded for the new mode
         backgroundLoaded = false;
         if (backgroundBuffer != nullptr) {
-            free(backgroundBuffer);
+            MemoryPolicy::release(backgroundBuffer);
             backgroundBuffer = nullptr;
         }
     }
@@ -496,6 +503,7 @@ void showTemporaryMessage(const char* message, uint32_t duration) {
         USBSerial.println("Cannot show temporary message - display not initialized");
         return;
     }
+    PowerLock displayLock(POWER_LOCK_DISPLAY);
     
     // Save current state
     temporaryMessageActive = true;
@@ -560,9 +568,9 @@ void loadBackgroundImage() {
         return;
     }
     
-    // Allocate buffer for the background (240x280 pixels)
+    // Allocate buffer for the background (240x280 pixels); 134 KB, so PSRAM
     USBSerial.println("Allocating background buffer...");
-    backgroundBuffer = (uint16_t*)malloc(240 * 280 * sizeof(uint16_t));
+    backgroundBuffer = (uint16_t*)MemoryPolicy::allocate(ALLOC_IMAGE, 240 * 280 * sizeof(uint16_t));
     if (!backgroundBuffer) {
         USBSerial.println("ERROR: Failed to allocate background buffer");
         return;
@@ -668,7 +676,7 @@ bool loadBackgroundImageFromFile(const String& imagePath) {
         }
         
         // Read the entire file into a buffer for decoding
-        uint8_t* jpegBuffer = (uint8_t*)malloc(fileSize);
+        uint8_t* jpegBuffer = (uint8_t*)MemoryPolicy::allocate(ALLOC_IMAGE, fileSize);
         if (!jpegBuffer) {
             USBSerial.println("ERROR: Failed to allocate JPEG buffer");
             jpegFile.close();
@@ -681,7 +689,7 @@ bool loadBackgroundImageFromFile(const String& imagePath) {
         
         if (bytesRead != fileSize) {
             USBSerial.printf("ERROR: Failed to read JPEG file. Read %u of %u bytes\n", bytesRead, fileSize);
-            free(jpegBuffer);
+            MemoryPolicy::release(jpegBuffer);
             return false;
         }
         
@@ -690,14 +698,14 @@ bool loadBackgroundImageFromFile(const String& imagePath) {
             USBSerial.println("ERROR: File doesn't have JPEG header signature (0xFF 0xD8)");
             USBSerial.printf("First bytes: 0x%02X 0x%02X 0x%02X 0x%02X\n", 
                            jpegBuffer[0], jpegBuffer[1], jpegBuffer[2], jpegBuffer[3]);
-            free(jpegBuffer);
+            MemoryPolicy::release(jpegBuffer);
             return false;
         }
         
         // Initialize the JPEG decoder with the file data
         if (!jpeg.openRAM(jpegBuffer, fileSize, jpegDrawCallback)) {
             USBSerial.println("ERROR: Failed to initialize JPEG decoder");
-            free(jpegBuffer);
+            MemoryPolicy::release(jpegBuffer);
             return false;
         }
         
@@ -710,7 +718,7 @@ bool loadBackgroundImageFromFile(const String& imagePath) {
         // Check if the image dimensions are valid
         if (width <= 0 || height <= 0) {
             USBSerial.println("ERROR: Invalid JPEG dimensions");
-            free(jpegBuffer);
+            MemoryPolicy::release(jpegBuffer);
             return false;
         }
         
@@ -731,7 +739,7 @@ bool loadBackgroundImageFromFile(const String& imagePath) {
         int decoded = jpeg.decode(0, 0, 0); // Scale to fit in the display
         
         // Clean up the JPEG buffer
-        free(jpegBuffer);
+        MemoryPolicy::release(jpegBuffer);
         
         if (decoded <= 0) {
             USBSerial.printf("ERROR: JPEG decoding failed! Error code: %d\n", decoded);
@@ -891,9 +899,12 @@ void displayBackgroundImage() {
     
     // Write the pixels directly to the display - this improves performance
     // and eliminates potential issues with buffer alignment
+    SPAN_BEGIN(SPAN_DISPLAY_FLUSH, dispWidth * dispHeight);
     display->writePixels(backgroundBuffer, dispWidth * dispHeight);
+    SPAN_END(SPAN_DISPLAY_FLUSH);
     
     display->endWrite();
+    metricDisplayFlushBytes.inc(2 * dispWidth * dispHeight * 2); // Clear + image, RGB565
     USBSerial.println("Background displayed successfully");
 }
 
@@ -904,6 +915,7 @@ void displayMainLayout() {
         USBSerial.println("ERROR: Display not initialized");
         return;
     }
+    PowerLock displayLock(POWER_LOCK_DISPLAY);
     
     // First display the background
     if (!backgroundLoaded) {
@@ -946,11 +958,14 @@ void displayMainLayout() {
     int startY = 40;
     int lineHeight = 20;
     
-    // Get current values
-    String wifiStatus = WiFiManager::isConnected() ? WiFiManager::getSSID() : "Disconnected";
-    String ipAddress = WiFiManager::getLocalIP().toString();
-    String macroStatus = (macroHandler && macroHandler->isExecuting()) ? "Running" : "Ready";
-    String layerName = keyHandler ? keyHandler->getCurrentLayer() : "default";
+    // Get current values from the last state events
+    applyStateEvents();
+    stateChanged = false;
+    uint32_t ip = (uint32_t)wifiState.value;
+    String wifiStatus = (wifiState.flags & EVENT_WIFI_CONNECTED) ? String(wifiState.text) : "Disconnected";
+    String ipAddress = IPAddress(ip & 0xFF, (ip >> 8) & 0xFF, (ip >> 16) & 0xFF, ip >> 24).toString();
+    String macroStatus = macroState.value ? "Running" : "Ready";
+    String layerName = layerState.text[0] ? String(layerState.text) : "default";
     
     // Draw info lines - adjusted for landscape orientation
     drawTextWithShadow(("WiFi: " + wifiStatus).c_str(), 10, startY);
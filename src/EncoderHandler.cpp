@@ -1,6 +1,10 @@
 #include "EncoderHandler.h"
 #include "HIDHandler.h"  // Include for hidHandler
 #include "ConfigManager.h"  // For loading encoder actions
+#include "EventBus.h"
+#include "PersistenceService.h"
+#include "PowerManager.h"
+#include "BinaryLog.h"
 
 extern USBCDC USBSerial;
 extern HIDHandler* hidHandler;  // Access to the global HID handler
@@ -11,6 +15,10 @@ EncoderHandler* encoderHandler = nullptr;
 // Map to store encoder actions loaded from the config
 std::map<String, EncoderAction> encoderActions;
 
+// The same actions by encoder index (encoder-1 -> 0), filled when they are
+// loaded so a step does not build an ID string to look its action up
+static EncoderAction* actionsByIndex[MAX_ENCODERS] = {nullptr};
+
 EncoderHandler::EncoderHandler(uint8_t numEncoders) 
     : numEncoders(numEncoders), 
       mechanicalEncoders(nullptr), 
@@ -111,6 +119,7 @@ void EncoderHandler::loadEncoderActions(const std::map<String, ActionConfig>& ac
     USBSerial.println("Loading encoder actions from configuration");
     
     // Clear previous actions
+    memset(actionsByIndex, 0, sizeof(actionsByIndex));
     encoderActions.clear();
     
     // Process each action
@@ -343,6 +352,13 @@ void EncoderHandler::loadEncoderActions(const std::map<String, ActionConfig>& ac
         }
     }
     
+    for (auto& pair : encoderActions) {
+        int encoderNum = pair.first.substring(8).toInt();
+        if (encoderNum > 0 && encoderNum <= MAX_ENCODERS) {
+            actionsByIndex[encoderNum - 1] = &pair.second;
+        }
+    }
+    
     USBSerial.printf("Loaded actions for %d encoders\n", encoderActions.size());
 }
 
@@ -446,15 +462,9 @@ void EncoderHandler::executeEncoderAction(uint8_t encoderIndex, bool clockwise)
         return;
     }
     
-    // Get the encoder ID - use 1-based index to match the configuration
-    String encoderId = "encoder-" + String(encoderIndex + 1);
-    
-    // Debug output to verify encoder ID
-    USBSerial.printf("Looking for encoder ID: %s\n", encoderId.c_str());
-    
     // Check if we have actions configured for this encoder
-    if (encoderActions.find(encoderId) != encoderActions.end()) {
-        EncoderAction& action = encoderActions[encoderId];
+    if (encoderIndex < MAX_ENCODERS && actionsByIndex[encoderIndex] != nullptr) {
+        const EncoderAction& action = *actionsByIndex[encoderIndex];
         
         // No direction inversion - use clockwise directly
         bool actualDirection = clockwise;
@@ -465,12 +475,12 @@ void EncoderHandler::executeEncoderAction(uint8_t encoderIndex, bool clockwise)
                 actualDirection ? action.cwConsumerReport : action.ccwConsumerReport;
                 
             if (reportToSend.size() == HID_CONSUMER_REPORT_SIZE) {
-                USBSerial.printf("Encoder %d Action: %s multimedia command\n", 
-                             encoderIndex, actualDirection ? "CW" : "CCW");
+                BLOG_DEBUG("Encoder %d Action: %s multimedia command\n", 
+                           encoderIndex, actualDirection ? "CW" : "CCW");
                              
                 // Send consumer report
                 if (!hidHandler->sendConsumerReport(reportToSend.data(), reportToSend.size())) {
-                    USBSerial.printf("FAILED to send multimedia command\n");
+                    BLOG_WARN("FAILED to send multimedia command\n");
                     return;
                 }
                 
@@ -487,12 +497,12 @@ void EncoderHandler::executeEncoderAction(uint8_t encoderIndex, bool clockwise)
                 actualDirection ? action.cwHidReport : action.ccwHidReport;
                 
             if (reportToSend.size() == HID_KEYBOARD_REPORT_SIZE) {
-                USBSerial.printf("Encoder %d Action: %s HID command\n", 
-                             encoderIndex, actualDirection ? "CW" : "CCW");
+                BLOG_DEBUG("Encoder %d Action: %s HID command\n", 
+                           encoderIndex, actualDirection ? "CW" : "CCW");
                              
                 // Send HID report
                 if (!hidHandler->sendKeyboardReport(reportToSend.data(), reportToSend.size())) {
-                    USBSerial.printf("FAILED to send HID command\n");
+                    BLOG_WARN("FAILED to send HID command\n");
                     return;
                 }
                 
@@ -513,24 +523,18 @@ void EncoderHandler::executeEncoderButtonAction(uint8_t encoderIndex, bool press
         return;
     }
     
-    // Get the encoder ID - use 1-based index to match the configuration
-    String encoderId = "encoder-" + String(encoderIndex + 1);
-    
-    // Debug output to verify encoder ID
-    USBSerial.printf("Looking for encoder ID: %s\n", encoderId.c_str());
-    
     // Check if we have actions configured for this encoder
-    if (encoderActions.find(encoderId) != encoderActions.end()) {
-        EncoderAction& action = encoderActions[encoderId];
+    if (encoderIndex < MAX_ENCODERS && actionsByIndex[encoderIndex] != nullptr) {
+        const EncoderAction& action = *actionsByIndex[encoderIndex];
         
         // Debug output for loaded action
-        USBSerial.printf("Found action for %s, type: %s\n", encoderId.c_str(), action.type.c_str());
+        BLOG_DEBUG("Found action for encoder %d, type: %s\n", encoderIndex, action.type.c_str());
         
         if (action.type == "multimedia") {
             if (pressed) {
                 // Send button press report
                 if (action.buttonPressConsumerReport.size() == HID_CONSUMER_REPORT_SIZE) {
-                    USBSerial.printf("Encoder %d Button: PRESS multimedia command\n", encoderIndex);
+                    BLOG_DEBUG("Encoder %d Button: PRESS multimedia command\n", encoderIndex);
                     
                     // Send consumer report with multiple error checks
                     bool reportSent = false;
@@ -543,11 +547,11 @@ void EncoderHandler::executeEncoderButtonAction(uint8_t encoderIndex, bool press
                     }
                     
                     if (!reportSent) {
-                        USBSerial.printf("FAILED to send multimedia command\n");
+                        BLOG_WARN("FAILED to send multimedia command\n");
                         return;
                     }
                 } else {
-                    USBSerial.printf("No valid button press report found for encoder %d\n", encoderIndex);
+                    BLOG_WARN("No valid button press report found for encoder %d\n", encoderIndex);
                 }
             } else {
                 // Send empty report to release the button
@@ -559,7 +563,7 @@ void EncoderHandler::executeEncoderButtonAction(uint8_t encoderIndex, bool press
             if (pressed) {
                 // Send button press report
                 if (action.cwHidReport.size() == HID_KEYBOARD_REPORT_SIZE) {
-                    USBSerial.printf("Encoder %d Button: PRESS HID command\n", encoderIndex);
+                    BLOG_DEBUG("Encoder %d Button: PRESS HID command\n", encoderIndex);
                     
                     // Send HID report with multiple error checks
                     bool reportSent = false;
@@ -572,7 +576,7 @@ void EncoderHandler::executeEncoderButtonAction(uint8_t encoderIndex, bool press
                     }
                     
                     if (!reportSent) {
-                        USBSerial.printf("FAILED to send HID command\n");
+                        BLOG_WARN("FAILED to send HID command\n");
                         return;
                     }
                 }
@@ -586,7 +590,7 @@ void EncoderHandler::executeEncoderButtonAction(uint8_t encoderIndex, bool press
             // Process button action based on buttonPressAction type
             if (pressed) {
                 if (action.buttonPressConsumerReport.size() == HID_CONSUMER_REPORT_SIZE) {
-                    USBSerial.printf("Encoder %d Button: PRESS multimedia command (new format)\n", encoderIndex);
+                    BLOG_DEBUG("Encoder %d Button: PRESS multimedia command (new format)\n", encoderIndex);
                     
                     // Send consumer report with multiple error checks
                     bool reportSent = false;
@@ -599,11 +603,11 @@ void EncoderHandler::executeEncoderButtonAction(uint8_t encoderIndex, bool press
                     }
                     
                     if (!reportSent) {
-                        USBSerial.printf("FAILED to send multimedia command\n");
+                        BLOG_WARN("FAILED to send multimedia command\n");
                         return;
                     }
                 } else {
-                    USBSerial.printf("No valid button press report found for encoder %d (new format)\n", encoderIndex);
+                    BLOG_WARN("No valid button press report found for encoder %d (new format)\n", encoderIndex);
                 }
             } else {
                 // Send empty report to release the button
@@ -614,7 +618,7 @@ void EncoderHandler::executeEncoderButtonAction(uint8_t encoderIndex, bool press
     } 
     else {
         // No action configured for this encoder
-        USBSerial.printf("Encoder %d: No action configured\n", encoderIndex);
+        BLOG_DEBUG("Encoder %d: No action configured\n", encoderIndex);
     }
 }
 
@@ -629,7 +633,7 @@ void EncoderHandler::handleAS5600Encoder(uint8_t encoderIndex) {
     
     // Check sensor connectivity
     if (!as5600Encoders[encoderIndex].isConnected()) {
-        USBSerial.printf("Warning: AS5600 encoder %d disconnected\n", encoderIndex);
+        BLOG_WARN("Warning: AS5600 encoder %d disconnected\n", encoderIndex);
         return;
     }
     
@@ -676,7 +680,7 @@ void EncoderHandler::handleAS5600Encoder(uint8_t encoderIndex) {
     
     // Sanity check movement
     if (abs(rawDiff) > MAX_STEPS_PER_CYCLE) {
-        USBSerial.printf("Warning: Excessive movement on AS5600 encoder %d\n", encoderIndex);
+        BLOG_WARN("Warning: Excessive movement on AS5600 encoder %d\n", encoderIndex);
         return;
     }
     
@@ -686,8 +690,8 @@ void EncoderHandler::handleAS5600Encoder(uint8_t encoderIndex) {
         config.absolutePosition += rawDiff * config.direction;
         config.lastRawPosition = currentRawPosition;
         
-        USBSerial.printf("AS5600 Encoder %d: Raw Diff = %d, Total Position = %ld\n", 
-                      encoderIndex, rawDiff, config.absolutePosition);
+        BLOG_DEBUG("AS5600 Encoder %d: Raw Diff = %d, Total Position = %ld\n", 
+                   encoderIndex, rawDiff, config.absolutePosition);
     }
 }
 
@@ -714,14 +718,15 @@ void EncoderHandler::handleMechanicalEncoder(uint8_t encoderIndex) {
         // Update the absolute position
         config.absolutePosition = newAbsolutePosition;
         
-        USBSerial.printf("Mechanical Encoder %d: Position Change = %ld, Total Position = %ld\n", 
-                      encoderIndex, positionChange, config.absolutePosition);
+        BLOG_DEBUG("Mechanical Encoder %d: Position Change = %ld, Total Position = %ld\n", 
+                   encoderIndex, positionChange, config.absolutePosition);
     }
 }
 
 
 void EncoderHandler::updateEncoders() {
     if (!encoderConfigs) return;
+    PowerLock scanLock(POWER_LOCK_SCAN);
 
     // Static variables to track previous positions and debounce encoders
     static long prevPositions[MAX_ENCODERS] = {0};
@@ -747,8 +752,13 @@ void EncoderHandler::updateEncoders() {
             // Determine rotation direction
             bool clockwise = (currentPosition > prevPositions[i]);
             
-            USBSerial.printf("Encoder %d rotated %s (position: %ld)\n", 
-                          i, clockwise ? "clockwise" : "counterclockwise", currentPosition);
+            BLOG_DEBUG("Encoder %d rotated %s (position: %ld)\n", 
+                       i, clockwise ? "clockwise" : "counterclockwise", currentPosition);
+            
+            PersistenceService::noteActivity();
+            
+            // The input stream and metrics pick this up from the bus
+            EventBus::publish(EVENT_ENCODER, i, currentPosition, clockwise ? 1 : 0);
             
             // Send HID report for rotation
             executeEncoderAction(i, clockwise);
@@ -0,0 +1,240 @@
+#include "EventBus.h"
+#include "MetricsRegistry.h"
+#include <USBCDC.h>
+#include <string.h>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+EventBus::Cell EventBus::_pool[EVENT_BUS_POOL_SIZE];
+uint32_t EventBus::_poolUsed = 0;
+EventBus::Subscriber EventBus::_subscribers[EventBus::MAX_SUBSCRIBERS];
+std::atomic<int> EventBus::_subscriberCount(0);
+BusEvent EventBus::_latest[EVENT_TOPIC_COUNT];
+uint8_t EventBus::_latestValid = 0;
+portMUX_TYPE EventBus::_mux = portMUX_INITIALIZER_UNLOCKED;
+std::atomic<uint32_t> EventBus::_published(0);
+
+int EventBus::subscribe(const char* name, uint8_t topics, uint16_t depth) {
+    uint32_t capacity = 1;
+    while (capacity < depth) {
+        capacity <<= 1;
+    }
+    return addSubscriber(name, topics, nullptr, capacity);
+}
+
+int EventBus::subscribe(const char* name, uint8_t topics, EventHandler handler) {
+    if (handler == nullptr) return -1;
+    return addSubscriber(name, topics, handler, 0);
+}
+
+int EventBus::findSubscriber(const char* name) {
+    int count = _subscriberCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(_subscribers[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int EventBus::addSubscriber(const char* name, uint8_t topics, EventHandler handler, uint32_t depth) {
+    portENTER_CRITICAL(&_mux);
+    int handle = findSubscriber(name);
+    if (handle >= 0) {
+        _subscribers[handle].topics.store(topics, std::memory_order_relaxed);
+        portEXIT_CRITICAL(&_mux);
+        return handle;
+    }
+
+    int count = _subscriberCount.load(std::memory_order_relaxed);
+    if (count >= MAX_SUBSCRIBERS || _poolUsed + depth > EVENT_BUS_POOL_SIZE) {
+        portEXIT_CRITICAL(&_mux);
+        USBSerial.printf("EventBus: No room for subscriber %s\n", name);
+        return -1;
+    }
+
+    Subscriber& subscriber = _subscribers[count];
+    subscriber.name = name;
+    subscriber.topics.store(topics, std::memory_order_relaxed);
+    subscriber.handler = handler;
+    subscriber.cells = depth > 0 ? &_pool[_poolUsed] : nullptr;
+    subscriber.capacity = depth;
+    for (uint32_t i = 0; i < depth; i++) {
+        subscriber.cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    subscriber.enqueuePosition.store(0, std::memory_order_relaxed);
+    subscriber.dequeuePosition = 0;
+    subscriber.delivered.store(0, std::memory_order_relaxed);
+    subscriber.dropped.store(0, std::memory_order_relaxed);
+    _poolUsed += depth;
+
+    // Publishers only look at entries below the count
+    _subscriberCount.store(count + 1, std::memory_order_release);
+
+    // Still under the lock, so no newer state event can be queued first
+    if (handler == nullptr) {
+        replayLatest(subscriber);
+    }
+    portEXIT_CRITICAL(&_mux);
+    return count;
+}
+
+void EventBus::replayLatest(Subscriber& subscriber) {
+    uint8_t topics = subscriber.topics.load(std::memory_order_relaxed) & _latestValid;
+    for (int i = 0; i < EVENT_TOPIC_COUNT; i++) {
+        if (topics & (1 << i)) {
+            push(subscriber, _latest[i]);
+        }
+    }
+}
+
+void EventBus::setTopics(int handle, uint8_t topics) {
+    if (handle < 0 || handle >= _subscriberCount.load(std::memory_order_acquire)) return;
+    _subscribers[handle].topics.store(topics, std::memory_order_relaxed);
+}
+
+void EventBus::publish(EventTopic topic, uint16_t id, int32_t value, uint8_t flags, const char* text) {
+    BusEvent event;
+    event.timestampUs = (uint32_t)micros();
+    event.topic = topic;
+    event.flags = flags;
+    event.id = id;
+    event.value = value;
+    if (text != nullptr) {
+        strncpy(event.text, text, sizeof(event.text) - 1);
+        event.text[sizeof(event.text) - 1] = '\0';
+    } else {
+        event.text[0] = '\0';
+    }
+    _published.fetch_add(1, std::memory_order_relaxed);
+
+    // State events are recorded and queued under the lock, so a subscriber
+    // joining at the same time never sees them out of order. Key and encoder
+    // events take no lock at all.
+    bool isState = (topic & EVENT_STATE_TOPICS) != 0;
+    if (isState) {
+        portENTER_CRITICAL(&_mux);
+        _latest[topicIndex(topic)] = event;
+        _latestValid |= topic;
+    }
+
+    int count = _subscriberCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        Subscriber& subscriber = _subscribers[i];
+        if (subscriber.handler == nullptr && (subscriber.topics.load(std::memory_order_relaxed) & topic)) {
+            push(subscriber, event);
+        }
+    }
+
+    if (isState) {
+        portEXIT_CRITICAL(&_mux);
+    }
+
+    // Inline handlers run outside the lock
+    for (int i = 0; i < count; i++) {
+        Subscriber& subscriber = _subscribers[i];
+        if (subscriber.handler != nullptr && (subscriber.topics.load(std::memory_order_relaxed) & topic)) {
+            subscriber.handler(event);
+            subscriber.delivered.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Bounded multi-producer queue: a cell is free for position p when its
+// sequence is p, and holds the event for p when its sequence is p + 1
+bool EventBus::push(Subscriber& subscriber, const BusEvent& event) {
+    uint32_t position = subscriber.enqueuePosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &subscriber.cells[position & (subscriber.capacity - 1)];
+        uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int32_t difference = (int32_t)(sequence - position);
+        if (difference == 0) {
+            if (subscriber.enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                                 std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // Full: the consumer has not freed this cell yet
+            subscriber.dropped.fetch_add(1, std::memory_order_relaxed);
+            metricBusEventsDropped.inc();
+            return false;
+        } else {
+            position = subscriber.enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->event = event;
+    cell->sequence.store(position + 1, std::memory_order_release);
+    subscriber.delivered.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool EventBus::poll(int handle, BusEvent& event) {
+    if (handle < 0 || handle >= _subscriberCount.load(std::memory_order_acquire)) return false;
+
+    Subscriber& subscriber = _subscribers[handle];
+    if (subscriber.cells == nullptr) return false;
+
+    uint32_t position = subscriber.dequeuePosition;
+    Cell& cell = subscriber.cells[position & (subscriber.capacity - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+        return false;
+    }
+
+    event = cell.event;
+    cell.sequence.store(position + subscriber.capacity, std::memory_order_release);
+    subscriber.dequeuePosition = position + 1;
+    return true;
+}
+
+bool EventBus::getLatest(EventTopic topic, BusEvent& event) {
+    if ((topic & EVENT_STATE_TOPICS) == 0) return false;
+
+    portENTER_CRITICAL(&_mux);
+    bool valid = (_latestValid & topic) != 0;
+    if (valid) {
+        event = _latest[topicIndex(topic)];
+    }
+    portEXIT_CRITICAL(&_mux);
+    return valid;
+}
+
+uint32_t EventBus::getDropped(int handle) {
+    if (handle < 0 || handle >= _subscriberCount.load(std::memory_order_acquire)) return 0;
+    return _subscribers[handle].dropped.load(std::memory_order_relaxed);
+}
+
+uint16_t EventBus::hashId(const String& id) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < id.length(); i++) {
+        hash ^= (uint8_t)id[i];
+        hash *= 16777619u;
+    }
+    return (uint16_t)((hash >> 16) ^ (hash & 0xFFFF));
+}
+
+void EventBus::getStatus(JsonObject status) {
+    status["published"] = _published.load(std::memory_order_relaxed);
+    status["pool_size"] = EVENT_BUS_POOL_SIZE;
+    status["pool_used"] = _poolUsed;
+
+    JsonArray subscribers = status.createNestedArray("subscribers");
+    int count = _subscriberCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        const Subscriber& subscriber = _subscribers[i];
+        JsonObject entry = subscribers.createNestedObject();
+        entry["name"] = subscriber.name;
+        entry["topics"] = subscriber.topics.load(std::memory_order_relaxed);
+        entry["inline"] = subscriber.handler != nullptr;
+        entry["depth"] = subscriber.capacity;
+        if (subscriber.handler == nullptr) {
+            // Read without the consumer's cooperation, so approximate
+            entry["queued"] = subscriber.enqueuePosition.load(std::memory_order_relaxed) -
+                              subscriber.dequeuePosition;
+        }
+        entry["delivered"] = subscriber.delivered.load(std::memory_order_relaxed);
+        entry["dropped"] = subscriber.dropped.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+// Publish/subscribe between subsystems. Publishers (key scan, encoders,
+// macros, USB, WiFi) post a fixed-size event once; every subscriber whose
+// topic mask matches gets a copy in its own bounded queue and drains it from
+// its own task. The queues are lock-free, safe with several publishers on
+// both cores, and carved out of one static pool: publishing never allocates
+// and never blocks. A full queue drops the new event and counts it.
+//
+// Layer, macro, USB and WiFi are state topics: the bus keeps the latest event
+// of each and replays it to new subscribers, so a late subscriber starts
+// from the current state instead of polling for it.
+
+// Cells shared by all subscriber queues
+#ifndef EVENT_BUS_POOL_SIZE
+#define EVENT_BUS_POOL_SIZE 192
+#endif
+
+#define EVENT_TEXT_SIZE 32
+
+// Topics, one bit each so subscribers can OR them into a mask
+enum EventTopic : uint8_t {
+    EVENT_KEY = 0x01,      // id = component index, value = 1 pressed / 0 released, text = component id
+    EVENT_ENCODER = 0x02,  // id = encoder index, value = absolute position, flags bit0 = clockwise
+    EVENT_LAYER = 0x04,    // text = layer name
+    EVENT_MACRO = 0x08,    // id = 16-bit hash of the macro id, value = 1 started / 0 completed, text = macro id
+    EVENT_USB = 0x10,      // value = 1 mounted / 0 unmounted
+    EVENT_WIFI = 0x20      // flags bit0 = connected, bit1 = AP mode, value = IPv4 (a.b.c.d as bytes 0..3), text = SSID
+};
+
+#define EVENT_TOPIC_COUNT 6
+#define EVENT_ALL 0x3F
+#define EVENT_STATE_TOPICS (EVENT_LAYER | EVENT_MACRO | EVENT_USB | EVENT_WIFI)
+
+#define EVENT_WIFI_CONNECTED 0x01
+#define EVENT_WIFI_AP_MODE   0x02
+
+// One event; plain data, copied by value
+struct BusEvent {
+    uint32_t timestampUs;
+    uint8_t topic;
+    uint8_t flags;
+    uint16_t id;
+    int32_t value;
+    char text[EVENT_TEXT_SIZE];   // NUL-terminated, truncated
+};
+
+// Called in the publisher's task; must be quick and must not block
+typedef void (*EventHandler)(const BusEvent& event);
+
+class EventBus {
+public:
+    // Queued subscriber; depth is rounded up to a power of two. Subscribing
+    // again with the same name returns the same handle. -1 if the pool or
+    // the subscriber table is exhausted.
+    static int subscribe(const char* name, uint8_t topics, uint16_t depth);
+
+    // Inline subscriber for cheap consumers such as counters
+    static int subscribe(const char* name, uint8_t topics, EventHandler handler);
+
+    // Change a subscriber's topics; 0 pauses it without giving up its queue
+    static void setTopics(int handle, uint8_t topics);
+
+    // Post an event to every matching subscriber; safe from any task
+    static void publish(EventTopic topic, uint16_t id, int32_t value,
+                        uint8_t flags = 0, const char* text = nullptr);
+
+    // Take the oldest queued event; only the subscriber's own task may call this
+    static bool poll(int handle, BusEvent& event);
+
+    // Latest event of a state topic; false if none was published yet
+    static bool getLatest(EventTopic topic, BusEvent& event);
+
+    static uint32_t getDropped(int handle);
+
+    // 16-bit FNV-1a hash used to identify macros in events
+    static uint16_t hashId(const String& id);
+
+    // Subscribers, queue depths and drop counts
+    static void getStatus(JsonObject status);
+
+private:
+    static const int MAX_SUBSCRIBERS = 8;
+
+    // Bounded queue cell; the sequence number says whether it is free or full
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        BusEvent event;
+    };
+
+    struct Subscriber {
+        const char* name;
+        std::atomic<uint8_t> topics;
+        EventHandler handler;         // Inline subscribers have no queue
+        Cell* cells;
+        uint32_t capacity;            // Power of two
+        std::atomic<uint32_t> enqueuePosition;
+        uint32_t dequeuePosition;     // Owned by the consuming task
+        std::atomic<uint32_t> delivered;
+        std::atomic<uint32_t> dropped;
+    };
+
+    static int findSubscriber(const char* name);
+    static int addSubscriber(const char* name, uint8_t topics, EventHandler handler, uint32_t depth);
+    static bool push(Subscriber& subscriber, const BusEvent& event);
+    static void replayLatest(Subscriber& subscriber);
+    static int topicIndex(uint8_t topic) { return __builtin_ctz(topic); }
+
+    static Cell _pool[EVENT_BUS_POOL_SIZE];
+    static uint32_t _poolUsed;
+    static Subscriber _subscribers[MAX_SUBSCRIBERS];
+    static std::atomic<int> _subscriberCount;
+
+    static BusEvent _latest[EVENT_TOPIC_COUNT];
+    static uint8_t _latestValid;
+
+    // Guards subscribing and the latest state events
+    static portMUX_TYPE _mux;
+
+    static std::atomic<uint32_t> _published;
+};
+
+#endif // EVENT_BUS_H
@@ -0,0 +1,398 @@
+#include "FileSync.h"
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include "FileSystemUtils.h"
+#include "SpanTrace.h"
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+std::vector<FileSync::Entry> FileSync::_entries;
+String FileSync::_dir = "";
+bool FileSync::_active = false;
+unsigned long FileSync::_lastActivity = 0;
+int FileSync::_current = -1;
+bool FileSync::_fileFailed = false;
+size_t FileSync::_fileReceived = 0;
+File FileSync::_file;
+SHA256Hasher FileSync::_hasher;
+String FileSync::_lastError = "";
+
+// Constants
+const unsigned long FileSync::STALL_TIMEOUT_MS = 60000;
+static const char* JOURNAL_PATH = "/.fssync";
+static const char* JOURNAL_STAGING = "staging";
+static const char* JOURNAL_COMMIT = "commit";
+
+void FileSync::begin() {
+    File journal = LittleFS.open(JOURNAL_PATH, "r");
+    if (!journal) {
+        return;
+    }
+
+    String dir = journal.readStringUntil('\n');
+    String state = journal.readStringUntil('\n');
+    dir.trim();
+    state.trim();
+
+    if (isValidDirectory(dir) && state == JOURNAL_COMMIT) {
+        // Every file had arrived; move the unchanged ones that were left
+        // behind and finish the swap
+        USBSerial.printf("FileSync: Finishing interrupted sync of %s\n", dir.c_str());
+        String staging = dir + ".new";
+        while (LittleFS.exists(staging) && journal.available()) {
+            String path = journal.readStringUntil('\n');
+            path.trim();
+            String from = dir + "/" + path;
+            if (isValidPath(path) && LittleFS.exists(from)) {
+                FileSystemUtils::renameFile(from.c_str(), (staging + "/" + path).c_str());
+            }
+        }
+        journal.close();
+        swap(dir);
+    } else {
+        journal.close();
+        if (isValidDirectory(dir)) {
+            USBSerial.printf("FileSync: Discarding interrupted sync of %s\n", dir.c_str());
+            FileSystemUtils::removeTree((dir + ".new").c_str());
+        }
+    }
+
+    LittleFS.remove(JOURNAL_PATH);
+}
+
+bool FileSync::buildManifest(const String& dir, JsonArray files) {
+    if (!isValidDirectory(dir)) {
+        return fail("Invalid directory");
+    }
+    File root = LittleFS.open(dir, "r");
+    if (!root || !root.isDirectory()) {
+        return fail("Directory not found");
+    }
+    root.close();
+    return listFiles(dir, "", files);
+}
+
+bool FileSync::beginSync(const String& dir, JsonArrayConst files, JsonArray needed) {
+    if (isBusy()) {
+        return fail("Sync already in progress");
+    }
+    if (_active) {
+        USBSerial.printf("FileSync: Replacing stalled sync of %s\n", _dir.c_str());
+        abort();
+    }
+    if (!isValidDirectory(dir)) {
+        return fail("Invalid directory");
+    }
+    if (files.isNull()) {
+        return fail("Missing file list");
+    }
+
+    reset();
+    _lastError = "";
+
+    size_t neededBytes = 0;
+    for (JsonObjectConst file : files) {
+        Entry entry;
+        entry.path = file["path"] | "";
+        entry.size = file["size"] | 0;
+        entry.received = false;
+        if (!isValidPath(entry.path) || !SHA256Hasher::parseHex(file["sha256"] | "", entry.digest)) {
+            reset();
+            return fail("Invalid manifest entry: " + entry.path);
+        }
+
+        // Files that already match stay where they are until the commit
+        SHA256Hasher hasher;
+        size_t size = 0;
+        entry.needed = !hashFile(dir + "/" + entry.path, hasher, &size) || size != entry.size ||
+                       memcmp(hasher.getBytes(), entry.digest, SHA256Hasher::DIGEST_SIZE) != 0;
+        if (entry.needed) {
+            neededBytes += entry.size;
+        }
+        _entries.push_back(entry);
+    }
+
+    String staging = dir + ".new";
+    FileSystemUtils::removeTree(staging.c_str());
+    if (!FileSystemUtils::createDirPath(staging.c_str()) || !writeJournal(dir, false)) {
+        reset();
+        FileSystemUtils::removeTree(staging.c_str());
+        return fail("Failed to create staging directory");
+    }
+
+    _dir = dir;
+    _active = true;
+    _lastActivity = millis();
+
+    for (const Entry& entry : _entries) {
+        if (entry.needed && !needed.add(entry.path)) {
+            abort();
+            return fail("Too many files to sync at once");
+        }
+    }
+    USBSerial.printf("FileSync: Syncing %s, %u of %u files needed (%u bytes)\n", dir.c_str(),
+                     (unsigned)needed.size(), (unsigned)_entries.size(), (unsigned)neededBytes);
+    return true;
+}
+
+bool FileSync::beginFile(const String& path) {
+    if (!_active) {
+        return fail("No sync in progress");
+    }
+    if (_current >= 0) {
+        // The previous upload was abandoned
+        _file.close();
+        LittleFS.remove(_dir + ".new/" + _entries[_current].path);
+        _current = -1;
+    }
+
+    for (size_t i = 0; i < _entries.size(); i++) {
+        if (_entries[i].path != path) {
+            continue;
+        }
+        if (!_entries[i].needed) {
+            return fail("File is unchanged: " + path);
+        }
+
+        _entries[i].received = false;
+        _file = LittleFS.open(_dir + ".new/" + path, "w", true);
+        if (!_file) {
+            return fail("Failed to create " + path);
+        }
+        _hasher.begin();
+        _current = (int)i;
+        _fileReceived = 0;
+        _fileFailed = false;
+        _lastActivity = millis();
+        return true;
+    }
+    return fail("File is not part of this sync: " + path);
+}
+
+bool FileSync::writeFile(const uint8_t* data, size_t length) {
+    if (_current < 0 || _fileFailed) {
+        return false;
+    }
+
+    const Entry& entry = _entries[_current];
+    if (length > entry.size - _fileReceived) {
+        _fileFailed = true;
+        _file.close();
+        return fail("File is larger than its manifest entry: " + entry.path);
+    }
+    SPAN_BEGIN(SPAN_FLASH_WRITE, length);
+    size_t written = _file.write(data, length);
+    SPAN_END(SPAN_FLASH_WRITE);
+    if (written != length) {
+        _fileFailed = true;
+        _file.close();
+        return fail("Failed to write " + entry.path + " (filesystem full?)");
+    }
+
+    _hasher.add(data, length);
+    _fileReceived += length;
+    _lastActivity = millis();
+    return true;
+}
+
+bool FileSync::finishFile() {
+    if (_current < 0) {
+        return fail("No file in progress");
+    }
+
+    Entry& entry = _entries[_current];
+    String stagedPath = _dir + ".new/" + entry.path;
+    _current = -1;
+    _file.close();
+
+    if (_fileFailed) {
+        LittleFS.remove(stagedPath);
+        return false;
+    }
+
+    _hasher.calculate();
+    if (_fileReceived != entry.size || memcmp(_hasher.getBytes(), entry.digest, SHA256Hasher::DIGEST_SIZE) != 0) {
+        LittleFS.remove(stagedPath);
+        return fail("Checksum mismatch for " + entry.path);
+    }
+
+    entry.received = true;
+    _lastActivity = millis();
+    return true;
+}
+
+bool FileSync::commit() {
+    if (!_active) {
+        return fail("No sync in progress");
+    }
+    if (_current >= 0) {
+        return fail("A file is still being received");
+    }
+
+    size_t missing = 0;
+    for (const Entry& entry : _entries) {
+        if (entry.needed && !entry.received) missing++;
+    }
+    if (missing > 0) {
+        return fail(String(missing) + " files have not been received");
+    }
+
+    // From here on a reset finishes the swap instead of discarding it
+    if (!writeJournal(_dir, true)) {
+        return fail("Failed to write sync journal");
+    }
+
+    // Unchanged files move into the staging directory, which costs no
+    // space and no copying; files missing from the manifest stay behind
+    String staging = _dir + ".new";
+    for (const Entry& entry : _entries) {
+        if (entry.needed) continue;
+        String from = _dir + "/" + entry.path;
+        if (!FileSystemUtils::renameFile(from.c_str(), (staging + "/" + entry.path).c_str())) {
+            USBSerial.printf("FileSync: Failed to keep %s\n", from.c_str());
+        }
+    }
+
+    bool swapped = swap(_dir);
+    LittleFS.remove(JOURNAL_PATH);
+    USBSerial.printf("FileSync: %s %s\n", _dir.c_str(), swapped ? "updated" : "swap failed");
+    String dir = _dir;
+    reset();
+    return swapped ? true : fail("Failed to swap in " + dir);
+}
+
+void FileSync::abort() {
+    if (!_active) {
+        return;
+    }
+    _file.close();
+    FileSystemUtils::removeTree((_dir + ".new").c_str());
+    LittleFS.remove(JOURNAL_PATH);
+    USBSerial.printf("FileSync: Sync of %s aborted\n", _dir.c_str());
+    reset();
+}
+
+bool FileSync::isBusy() {
+    return _active && millis() - _lastActivity < STALL_TIMEOUT_MS;
+}
+
+bool FileSync::isValidDirectory(const String& dir) {
+    return dir.length() > 1 && dir.startsWith("/") && !dir.endsWith("/") && dir.indexOf("//") < 0 &&
+           dir.indexOf("..") < 0 && !dir.endsWith(".new") && !dir.endsWith(".old");
+}
+
+bool FileSync::isValidPath(const String& path) {
+    return path.length() > 0 && !path.startsWith("/") && !path.endsWith("/") && path.indexOf("//") < 0 &&
+           path.indexOf("..") < 0 && path.indexOf('\\') < 0;
+}
+
+bool FileSync::hashFile(const String& path, SHA256Hasher& hasher, size_t* size) {
+    File file = LittleFS.open(path, "r");
+    if (!file || file.isDirectory()) {
+        return false;
+    }
+
+    hasher.begin();
+    uint8_t buffer[512];
+    size_t total = 0;
+    size_t n;
+    while ((n = file.read(buffer, sizeof(buffer))) > 0) {
+        hasher.add(buffer, n);
+        total += n;
+    }
+    file.close();
+    hasher.calculate();
+    *size = total;
+    return true;
+}
+
+bool FileSync::listFiles(const String& dir, const String& prefix, JsonArray files) {
+    File root = LittleFS.open(dir, "r");
+    if (!root) {
+        return fail("Failed to open " + dir);
+    }
+
+    File child = root.openNextFile();
+    while (child) {
+        String path = child.path();
+        String name = prefix + path.substring(path.lastIndexOf('/') + 1);
+        bool isDirectory = child.isDirectory();
+        child.close();
+
+        if (isDirectory) {
+            if (!listFiles(path, name + "/", files)) {
+                return false;
+            }
+        } else {
+            SHA256Hasher hasher;
+            size_t size = 0;
+            if (!hashFile(path, hasher, &size)) {
+                return fail("Failed to read " + path);
+            }
+
+            JsonObject file = files.createNestedObject();
+            if (file.isNull()) {
+                return fail("Too many files for the manifest");
+            }
+            file["path"] = name;
+            file["size"] = size;
+            file["sha256"] = hasher.toString();
+        }
+        child = root.openNextFile();
+    }
+    return true;
+}
+
+bool FileSync::writeJournal(const String& dir, bool committing) {
+    File journal = LittleFS.open(JOURNAL_PATH, "w");
+    if (!journal) {
+        return false;
+    }
+
+    journal.printf("%s\n%s\n", dir.c_str(), committing ? JOURNAL_COMMIT : JOURNAL_STAGING);
+    if (committing) {
+        for (const Entry& entry : _entries) {
+            if (!entry.needed) journal.printf("%s\n", entry.path.c_str());
+        }
+    }
+    journal.close();
+    return true;
+}
+
+bool FileSync::swap(const String& dir) {
+    String staging = dir + ".new";
+    String previous = dir + ".old";
+
+    // Already swapped before a reset: only the old tree is left to remove
+    if (!LittleFS.exists(staging)) {
+        FileSystemUtils::removeTree(previous.c_str());
+        return LittleFS.exists(dir);
+    }
+
+    FileSystemUtils::removeTree(previous.c_str());
+    if (LittleFS.exists(dir) && !LittleFS.rename(dir, previous)) {
+        return false;
+    }
+    if (!LittleFS.rename(staging, dir)) {
+        LittleFS.rename(previous, dir);
+        return false;
+    }
+    FileSystemUtils::removeTree(previous.c_str());
+    return true;
+}
+
+void FileSync::reset() {
+    _entries.clear();
+    _dir = "";
+    _active = false;
+    _current = -1;
+    _fileFailed = false;
+    _fileReceived = 0;
+}
+
+bool FileSync::fail(const String& error) {
+    _lastError = error;
+    USBSerial.printf("FileSync: %s\n", error.c_str());
+    return false;
+}
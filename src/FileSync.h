@@ -0,0 +1,84 @@
+#ifndef FILE_SYNC_H
+#define FILE_SYNC_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FS.h>
+#include <vector>
+#include "SHA256Hasher.h"
+
+// Incremental LittleFS sync for one directory at a time (/web,
+// /config/defaults, ...). The host compares manifests (path, size,
+// SHA-256) and sends only the files that changed. They are staged in
+// "<dir>.new", the unchanged files are moved in beside them by rename,
+// and the directory is then swapped in by renaming, so it is never half
+// updated. Other directories, such as the user's /config files, are
+// untouched.
+//
+// A journal (/.fssync) records the directory being synced, so begin()
+// can finish or roll back a swap interrupted by a reset.
+class FileSync {
+public:
+    // Recover from an interrupted sync; call once LittleFS is mounted
+    static void begin();
+
+    // List the files below dir as {"path", "size", "sha256"} objects,
+    // paths relative to dir
+    static bool buildManifest(const String& dir, JsonArray files);
+
+    // Start syncing dir to the given manifest; the paths that must be
+    // uploaded are appended to needed
+    static bool beginSync(const String& dir, JsonArrayConst files, JsonArray needed);
+
+    // Stream one needed file into the staging directory
+    static bool beginFile(const String& path);
+    static bool writeFile(const uint8_t* data, size_t length);
+    static bool finishFile();
+
+    // Swap the staged directory in once every needed file has arrived
+    static bool commit();
+
+    // Drop the staged files and end the session
+    static void abort();
+
+    // True while a sync is in progress and has not stalled
+    static bool isBusy();
+
+    static bool isFileOpen() { return _current >= 0; }
+    static String getDirectory() { return _dir; }
+    static String getLastError() { return _lastError; }
+
+private:
+    struct Entry {
+        String path;
+        size_t size;
+        uint8_t digest[SHA256Hasher::DIGEST_SIZE];
+        bool needed;
+        bool received;
+    };
+
+    static bool isValidDirectory(const String& dir);
+    static bool isValidPath(const String& path);
+    static bool hashFile(const String& path, SHA256Hasher& hasher, size_t* size);
+    static bool listFiles(const String& dir, const String& prefix, JsonArray files);
+    static bool writeJournal(const String& dir, bool committing);
+    static bool swap(const String& dir);
+    static void reset();
+    static bool fail(const String& error);
+
+    static std::vector<Entry> _entries;
+    static String _dir;
+    static bool _active;
+    static unsigned long _lastActivity;
+    static int _current;
+    static bool _fileFailed;
+    static size_t _fileReceived;
+    static File _file;
+    static SHA256Hasher _hasher;
+    static String _lastError;
+
+    // A session idle this long can be replaced by a new one
+    static const unsigned long STALL_TIMEOUT_MS;
+};
+
+#endif // FILE_SYNC_H
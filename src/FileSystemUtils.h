@@ -4,6 +4,7 @@
 #include <FS.h>
 #include <LittleFS.h>
 #include <USBCDC.h>
+#include <vector>
 
 extern USBCDC USBSerial;
 
@@ -150,7 +151,38 @@ public:
         free(pathStr);
         return true;
     }
-    
+
+    // Remove a file or a directory with everything below it
+    static bool removeTree(const char *path) {
+        File entry = LittleFS.open(path, "r");
+        if (!entry) {
+            return !LittleFS.exists(path);
+        }
+        if (!entry.isDirectory()) {
+            entry.close();
+            return LittleFS.remove(path);
+        }
+
+        // Collect the children first; removing while iterating is unreliable
+        std::vector<String> children;
+        File child = entry.openNextFile();
+        while (child) {
+            children.push_back(String(child.path()));
+            child = entry.openNextFile();
+        }
+        entry.close();
+
+        bool success = true;
+        for (const String& childPath : children) {
+            success = removeTree(childPath.c_str()) && success;
+        }
+        if (!LittleFS.rmdir(path)) {
+            USBSerial.printf("Failed to remove directory: %s\n", path);
+            return false;
+        }
+        return success;
+    }
+
     // Read entire file into a String
     static String readFile(const char *path) {
         USBSerial.printf("Reading file: %s\n", path);
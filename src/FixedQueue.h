@@ -0,0 +1,51 @@
+#ifndef FIXED_QUEUE_H
+#define FIXED_QUEUE_H
+
+#include <stddef.h>
+
+// First-in first-out queue of up to N objects held in place. Nothing is
+// allocated after construction, so it can stand in for std::queue on paths
+// that must not touch the heap once the firmware is running. push() refuses
+// an item when the queue is full; the caller decides whether that is a drop.
+//
+// Not thread-safe: guard it with the lock that protects its owner.
+template <typename T, size_t N>
+class FixedQueue {
+public:
+    FixedQueue() : _head(0), _count(0) {}
+
+    bool push(const T& item) {
+        if (_count >= N) return false;
+        _items[(_head + _count) % N] = item;
+        _count++;
+        return true;
+    }
+
+    bool pop(T& item) {
+        if (_count == 0) return false;
+        item = _items[_head];
+        _head = (_head + 1) % N;
+        _count--;
+        return true;
+    }
+
+    // Oldest item; only valid while !empty()
+    const T& front() const { return _items[_head]; }
+
+    void clear() {
+        _head = 0;
+        _count = 0;
+    }
+
+    bool empty() const { return _count == 0; }
+    bool full() const { return _count >= N; }
+    size_t size() const { return _count; }
+    static size_t capacity() { return N; }
+
+private:
+    T _items[N];
+    size_t _head;
+    size_t _count;
+};
+
+#endif // FIXED_QUEUE_H
@@ -3,6 +3,11 @@
 #include <stdlib.h>
 #include "HIDHandler.h"
 #include <tusb.h>  // Include the TinyUSB header
+#include "MetricsRegistry.h"
+#include "EventBus.h"
+#include "BinaryLog.h"
+#include "PowerManager.h"
+#include "SpanTrace.h"
 
 extern USBCDC USBSerial;
 
@@ -140,12 +145,13 @@ bool HIDHandler::pressKey(uint8_t key) {
     std::lock_guard<std::mutex> lock(reportMutex);
     
     // Check if key is already pressed
-    if (pressedKeys.find(key) != pressedKeys.end()) {
+    if (isKeyPressed(key)) {
         return true; // Key is already pressed
     }
     
     // Add to pressed keys
-    pressedKeys.insert(key);
+    pressedKeys[key >> 5] |= 1u << (key & 31);
+    pressedCount++;
     
     // If it's a modifier key, update the modifier state
     if (HIDHandler::isModifier(key)) {
@@ -160,13 +166,13 @@ bool HIDHandler::releaseKey(uint8_t key) {
     std::lock_guard<std::mutex> lock(reportMutex);
     
     // Check if key is pressed
-    auto it = pressedKeys.find(key);
-    if (it == pressedKeys.end()) {
+    if (!isKeyPressed(key)) {
         return true; // Key is not pressed, nothing to do
     }
     
     // Remove from pressed keys
-    pressedKeys.erase(it);
+    pressedKeys[key >> 5] &= ~(1u << (key & 31));
+    pressedCount--;
     
     // If it's a modifier key, update the modifier state
     if (HIDHandler::isModifier(key)) {
@@ -174,7 +180,7 @@ bool HIDHandler::releaseKey(uint8_t key) {
     }
     
     // If no keys are pressed, send empty report
-    if (pressedKeys.empty()) {
+    if (pressedCount == 0) {
         return sendEmptyKeyboardReport();
     }
     
@@ -183,16 +189,17 @@ bool HIDHandler::releaseKey(uint8_t key) {
 }
 
 bool HIDHandler::isKeyPressed(uint8_t key) const {
-    return pressedKeys.find(key) != pressedKeys.end();
+    return (pressedKeys[key >> 5] & (1u << (key & 31))) != 0;
 }
 
 bool HIDHandler::areAnyKeysPressed() const {
-    return !pressedKeys.empty();
+    return pressedCount > 0;
 }
 
 void HIDHandler::clearAllKeys() {
     std::lock_guard<std::mutex> lock(reportMutex);
-    pressedKeys.clear();
+    memset(pressedKeys, 0, sizeof(pressedKeys));
+    pressedCount = 0;
     activeModifiers = 0;
     sendEmptyKeyboardReport();
 }
@@ -207,15 +214,23 @@ bool HIDHandler::updateKeyboardReportFromState() {
     // Add regular keys (up to 6)
     int keyIndex = 2; // First key goes in byte 2 (after modifiers and reserved byte)
     
-    for (uint8_t key : pressedKeys) {
-        // Skip modifiers as they're handled separately
-        if (!HIDHandler::isModifier(key)) {
+    bool full = false;
+    for (int word = 0; word < 8 && !full; word++) {
+        uint32_t bits = pressedKeys[word];
+        while (bits != 0) {
+            uint8_t key = (uint8_t)(word * 32 + __builtin_ctz(bits));
+            bits &= bits - 1;
+            
+            // Skip modifiers as they're handled separately
+            if (HIDHandler::isModifier(key)) continue;
+            
             // Make sure we don't exceed the report size
             if (keyIndex < HID_KEYBOARD_REPORT_SIZE) {
                 report[keyIndex++] = key;
             } else {
                 // No more room in the report - this is N-key rollover limitation
-                USBSerial.println("Warning: Too many keys pressed, some ignored");
+                BLOG_WARN("Warning: Too many keys pressed, some ignored\n");
+                full = true;
                 break;
             }
         }
@@ -228,7 +243,7 @@ bool HIDHandler::updateKeyboardReportFromState() {
 // Fixed sendKeyboardReport with proper const casting
 bool HIDHandler::sendKeyboardReport(const uint8_t* report, size_t length) {
     if (!report || length != HID_KEYBOARD_REPORT_SIZE) {
-        USBSerial.println("Invalid keyboard report");
+        BLOG_ERROR("Invalid keyboard report\n");
         return false;
     }
     
@@ -249,7 +264,8 @@ bool HIDHandler::sendKeyboardReport(const uint8_t* report, size_t length) {
     memcpy(keyboardState.report, report, HID_KEYBOARD_REPORT_SIZE);
     
     if (!tud_mounted()) {
-        USBSerial.println("USB device not mounted");
+        BLOG_WARN("USB device not mounted\n");
+        metricHidReportsDropped.inc();
         return false;
     }
     
@@ -262,21 +278,23 @@ bool HIDHandler::sendKeyboardReport(const uint8_t* report, size_t length) {
         memcpy(keycodes, &report[2], 6);
         
         // For keyboard report, we send modifier, reserved byte, and up to 6 key codes
+        SPAN_BEGIN(SPAN_HID_SEND, 1);
         bool success = tud_hid_keyboard_report(1, modifier, keycodes);
+        SPAN_END(SPAN_HID_SEND);
         
         if (success) {
-            USBSerial.print("Keyboard report sent: ");
-            for (size_t i = 0; i < HID_KEYBOARD_REPORT_SIZE; i++) {
-                USBSerial.printf("%02X ", report[i]);
-            }
-            USBSerial.println();
+            metricHidReportsSent.inc();
+            BLOG_DEBUG("Keyboard report sent: %02X %02X %02X %02X %02X %02X %02X %02X\n",
+                       report[0], report[1], report[2], report[3], report[4], report[5], report[6], report[7]);
             return true;
         } else {
-            USBSerial.println("Failed to send keyboard report");
+            BLOG_WARN("Failed to send keyboard report\n");
+            metricHidReportsDropped.inc();
             return false;
         }
     } else {
-        USBSerial.println("HID not ready to send keyboard report");
+        BLOG_WARN("HID not ready to send keyboard report\n");
+        metricHidReportsDropped.inc();
         return false;
     }
 }
@@ -288,7 +306,7 @@ bool HIDHandler::sendEmptyKeyboardReport() {
 
 bool HIDHandler::sendConsumerReport(const uint8_t* report, size_t length) {
     if (!report || length != HID_CONSUMER_REPORT_SIZE) {
-        USBSerial.println("Invalid consumer report");
+        BLOG_ERROR("Invalid consumer report\n");
         return false;
     }
     
@@ -296,7 +314,8 @@ bool HIDHandler::sendConsumerReport(const uint8_t* report, size_t length) {
     memcpy(consumerState.report, report, HID_CONSUMER_REPORT_SIZE);
     
     if (!tud_mounted()) {
-        USBSerial.println("USB device not mounted");
+        BLOG_WARN("USB device not mounted\n");
+        metricHidReportsDropped.inc();
         return false;
     }
     
@@ -308,52 +327,57 @@ bool HIDHandler::sendConsumerReport(const uint8_t* report, size_t length) {
         switch(report[2]) {
             case 0xE9: // Volume Up
                 consumerCode = 0x00E9;
-                USBSerial.println("Preparing Volume UP Command");
+                BLOG_TRACE("Preparing Volume UP Command\n");
                 break;
             case 0xEA: // Volume Down
                 consumerCode = 0x00EA;
-                USBSerial.println("Preparing Volume DOWN Command");
+                BLOG_TRACE("Preparing Volume DOWN Command\n");
                 break;
             case 0xE2: // Mute
                 consumerCode = 0x00E2;
-                USBSerial.println("Preparing Mute Command");
+                BLOG_TRACE("Preparing Mute Command\n");
                 break;
             case 0xCD: // Play/Pause
                 consumerCode = 0x00CD;
-                USBSerial.println("Preparing Play/Pause Command");
+                BLOG_TRACE("Preparing Play/Pause Command\n");
                 break;
             case 0xB5: // Next Track
                 consumerCode = 0x00B5;
-                USBSerial.println("Preparing Next Track Command");
+                BLOG_TRACE("Preparing Next Track Command\n");
                 break;
             case 0xB6: // Previous Track
                 consumerCode = 0x00B6;
-                USBSerial.println("Preparing Previous Track Command");
+                BLOG_TRACE("Preparing Previous Track Command\n");
                 break;
             case 0xB7: // Stop
                 consumerCode = 0x00B7;
-                USBSerial.println("Preparing Stop Command");
+                BLOG_TRACE("Preparing Stop Command\n");
                 break;
             case 0xB8: // Play
                 consumerCode = 0x00B8;
-                USBSerial.println("Preparing Play Command");
+                BLOG_TRACE("Preparing Play Command\n");
                 break;
         }
         
-        USBSerial.printf("Raw Consumer Report: %02X %02X %02X %02X\n",
-                         report[0], report[1], report[2], report[3]);
-        USBSerial.printf("Consumer Code: 0x%04X\n", consumerCode);
+        BLOG_DEBUG("Raw Consumer Report: %02X %02X %02X %02X\n",
+                   report[0], report[1], report[2], report[3]);
+        BLOG_DEBUG("Consumer Code: 0x%04X\n", consumerCode);
         
         // Send the report with Report ID 0x04
+        SPAN_BEGIN(SPAN_HID_SEND, 0x04);
         bool success = tud_hid_report(0x04, reinterpret_cast<uint8_t*>(&consumerCode), sizeof(consumerCode));
+        SPAN_END(SPAN_HID_SEND);
         if (success) {
-            USBSerial.println("Consumer Report Sent Successfully");
+            metricHidReportsSent.inc();
+            BLOG_DEBUG("Consumer Report Sent Successfully\n");
         } else {
-            USBSerial.println("Consumer Report Send Failed");
+            metricHidReportsDropped.inc();
+            BLOG_WARN("Consumer Report Send Failed\n");
         }
         return success;
     } else {
-        USBSerial.println("HID not ready to send consumer report");
+        BLOG_WARN("HID not ready to send consumer report\n");
+        metricHidReportsDropped.inc();
         return false;
     }
 }
@@ -368,28 +392,39 @@ bool HIDHandler::executeMacro(const char* macroId) {
     String macroKey = String(macroId);
     auto it = macros.find(macroKey);
     if (it == macros.end()) {
-        USBSerial.printf("Macro '%s' not found\n", macroId);
+        BLOG_WARN("Macro '%s' not found\n", macroId);
         return false;
     }
     if (executingMacro) {
-        USBSerial.println("Already executing a macro, ignoring request");
+        BLOG_WARN("Already executing a macro, ignoring request\n");
         return false;
     }
     currentMacro = &(it->second);
     currentMacroStep = 0;
     executingMacro = true;
     nextMacroStepTime = millis();
-    USBSerial.printf("Starting execution of macro '%s'\n", macroId);
+    BLOG_INFO("Starting execution of macro '%s'\n", macroId);
     return true;
 }
 
 void HIDHandler::update() {
+    // Announce host attach and detach
+    bool mounted = tud_mounted();
+    if (mounted != usbMounted) {
+        usbMounted = mounted;
+        EventBus::publish(EVENT_USB, 0, mounted ? 1 : 0);
+    }
+    // Light sleep would drop the bus, so it waits for unplug or suspend
+    PowerManager::setUsbBusActive(mounted && !tud_suspended());
+
     std::lock_guard<std::mutex> lock(reportMutex);
+    PowerLock usbLock(POWER_LOCK_USB, !reportQueue.empty() || executingMacro);
     while (!reportQueue.empty()) {
         if (!processNextReport()) {
             break;
         }
     }
+    metricHidQueueDepth.set(reportQueue.size());
     if (executingMacro && currentMacro) {
         unsigned long currentTime = millis();
         if (currentTime >= nextMacroStepTime) {
@@ -404,15 +439,15 @@ void HIDHandler::update() {
                         success = sendConsumerReport(report.data, report.length);
                         break;
                     default:
-                        USBSerial.println("Unknown report type in macro");
+                        BLOG_ERROR("Unknown report type in macro\n");
                         break;
                 }
                 uint16_t delayTime = (currentMacroStep < currentMacro->delays.size()) ? currentMacro->delays[currentMacroStep] : 50;
                 nextMacroStepTime = currentTime + delayTime;
                 currentMacroStep++;
-                USBSerial.printf("Executed macro step %d/%d\n", currentMacroStep, currentMacro->reports.size());
+                BLOG_DEBUG("Executed macro step %d/%d\n", (int)currentMacroStep, (int)currentMacro->reports.size());
             } else {
-                USBSerial.println("Macro execution complete");
+                BLOG_INFO("Macro execution complete\n");
                 executingMacro = false;
                 currentMacro = nullptr;
                 currentMacroStep = 0;
@@ -424,9 +459,8 @@ void HIDHandler::update() {
 }
 
 bool HIDHandler::processNextReport() {
-    if (reportQueue.empty()) return false;
-    HIDReport report = reportQueue.front();
-    reportQueue.pop();
+    HIDReport report;
+    if (!reportQueue.pop(report)) return false;
     bool success = false;
     switch (report.type) {
         case HID_REPORT_KEYBOARD:
@@ -439,7 +473,7 @@ bool HIDHandler::processNextReport() {
             success = sendMouseReport(report.data, report.length);
             break;
         default:
-            USBSerial.println("Unknown report type");
+            BLOG_ERROR("Unknown report type\n");
             break;
     }
     return success;
@@ -532,31 +566,24 @@ void cleanupHIDHandler() {
 
 bool HIDHandler::sendMouseReport(const uint8_t* report, size_t length) {
     if (!report || length < 4) {
-        USBSerial.println("Invalid mouse report");
+        BLOG_ERROR("Invalid mouse report\n");
         return false;
     }
 
     // Debug output with detailed report information
-    USBSerial.printf("Mouse report details:\n");
-    USBSerial.printf("  Buttons: 0x%02X (", report[0]);
-    if (report[0] & 0x01) USBSerial.print("LEFT ");
-    if (report[0] & 0x02) USBSerial.print("RIGHT ");
-    if (report[0] & 0x04) USBSerial.print("MIDDLE ");
-    if (report[0] & 0x08) USBSerial.print("BACK ");
-    if (report[0] & 0x10) USBSerial.print("FORWARD ");
-    USBSerial.printf(")\n");
-    USBSerial.printf("  X: %d\n", (int8_t)report[1]);
-    USBSerial.printf("  Y: %d\n", (int8_t)report[2]);
-    USBSerial.printf("  Wheel: %d\n", (int8_t)report[3]);
+    BLOG_DEBUG("Mouse report: buttons 0x%02X, X %d, Y %d, wheel %d\n",
+               report[0], (int8_t)report[1], (int8_t)report[2], (int8_t)report[3]);
     
     // Check USB state
     if (!tud_mounted()) {
-        USBSerial.println("USB not mounted");
+        BLOG_WARN("USB not mounted\n");
+        metricHidReportsDropped.inc();
         return false;
     }
 
     if (!tud_hid_ready()) {
-        USBSerial.println("HID not ready");
+        BLOG_WARN("HID not ready\n");
+        metricHidReportsDropped.inc();
         return false;
     }
 
@@ -565,6 +592,7 @@ bool HIDHandler::sendMouseReport(const uint8_t* report, size_t length) {
     // report[1] = X movement
     // report[2] = Y movement
     // report[3] = Wheel movement
+    SpanScope sendSpan(SPAN_HID_SEND, REPORT_ID_MOUSE);
     if (tud_hid_mouse_report(
         REPORT_ID_MOUSE,  // Report ID for mouse
         report[0],        // buttons
@@ -573,10 +601,12 @@ bool HIDHandler::sendMouseReport(const uint8_t* report, size_t length) {
         report[3],        // vertical wheel
         0                 // horizontal wheel (not used)
     )) {
-        USBSerial.println("Mouse report sent successfully");
+        BLOG_DEBUG("Mouse report sent successfully\n");
+        metricHidReportsSent.inc();
         return true;
     } else {
-        USBSerial.println("Failed to send mouse report");
+        BLOG_WARN("Failed to send mouse report\n");
+        metricHidReportsDropped.inc();
         return false;
     }
 }
@@ -3,13 +3,12 @@
 
 #include <Arduino.h>
 #include <vector>
-#include <queue>
 #include <mutex>
 #include <map>
-#include <set>
 #include <algorithm>
 #include <ArduinoJson.h>
 #include <tusb.h>  // Use ESP32's built-in TinyUSB library instead of Adafruit's
+#include "FixedQueue.h"
 
 // HID Report Descriptors
 #define HID_KEYBOARD_REPORT_SIZE 8  // 1 byte report ID + 1 byte modifier + 6 bytes keycodes
@@ -17,6 +16,11 @@
 #define HID_MOUSE_REPORT_SIZE    5  // 1 byte report ID + 1 byte buttons + 1 byte x + 1 byte y + 1 byte wheel
 #define HID_MAX_KEYS 6  // Maximum keys in one report (excluding modifiers)
 
+// Reports waiting for the hid task; one scan's worth of keys with room to spare
+#ifndef HID_REPORT_QUEUE_SIZE
+#define HID_REPORT_QUEUE_SIZE 16
+#endif
+
 // Report IDs
 #define REPORT_ID_KEYBOARD   1
 #define REPORT_ID_MOUSE      2
@@ -139,10 +143,15 @@ private:
     ConsumerReportDescriptor consumerState;
     MouseReportDescriptor mouseState;
 
-    // Track pressed keys
-    std::set<uint8_t> pressedKeys;
+    // Track pressed keys: one bit per key code, walked in ascending order
+    // when the report is built, as the std::set it replaces was
+    uint32_t pressedKeys[8] = {0};
+    uint16_t pressedCount = 0;
     uint8_t activeModifiers = 0;
 
+    // Last USB mount state published on the event bus
+    bool usbMounted = false;
+
     // Macro execution variables
     bool executingMacro = false;
     unsigned long nextMacroStepTime = 0;
@@ -151,7 +160,7 @@ private:
 
     // Thread safety for reports
     std::mutex reportMutex;
-    std::queue<HIDReport> reportQueue;
+    FixedQueue<HIDReport, HID_REPORT_QUEUE_SIZE> reportQueue;
 
     // Helper to process the next report in the queue
     bool processNextReport();
@@ -0,0 +1,166 @@
+#include "InputEventStream.h"
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+int InputEventStream::_busHandle = -1;
+uint32_t InputEventStream::_reportedDrops = 0;
+InputEventStream::ClientQueue InputEventStream::_clients[InputEventStream::MAX_SUBSCRIBERS];
+volatile uint8_t InputEventStream::_subscriberCount = 0;
+std::mutex InputEventStream::_clientMutex;
+uint32_t InputEventStream::_sequence = 0;
+uint32_t InputEventStream::_lastBatchTime = 0;
+
+void InputEventStream::begin() {
+    // Paused until the first client subscribes
+    _busHandle = EventBus::subscribe("input_stream", 0, CAPTURE_CAPACITY);
+    _reportedDrops = EventBus::getDropped(_busHandle);
+
+    std::lock_guard<std::mutex> lock(_clientMutex);
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        _clients[i].active = false;
+        _clients[i].count = 0;
+    }
+    _subscriberCount = 0;
+    _lastBatchTime = millis();
+}
+
+bool InputEventStream::subscribe(AsyncWebSocketClient* client) {
+    if (client == nullptr) return false;
+
+    std::lock_guard<std::mutex> lock(_clientMutex);
+    ClientQueue* freeSlot = nullptr;
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        if (_clients[i].active && _clients[i].clientId == client->id()) {
+            return true; // Already subscribed
+        }
+        if (!_clients[i].active && freeSlot == nullptr) {
+            freeSlot = &_clients[i];
+        }
+    }
+
+    if (freeSlot == nullptr) {
+        USBSerial.printf("Input stream: no free slot for client #%u\n", client->id());
+        return false;
+    }
+
+    freeSlot->clientId = client->id();
+    freeSlot->head = 0;
+    freeSlot->count = 0;
+    freeSlot->dropped = 0;
+    freeSlot->active = true;
+    _subscriberCount++;
+    EventBus::setTopics(_busHandle, CAPTURE_TOPICS);
+
+    USBSerial.printf("Input stream: client #%u subscribed\n", client->id());
+    return true;
+}
+
+void InputEventStream::unsubscribe(uint32_t clientId) {
+    std::lock_guard<std::mutex> lock(_clientMutex);
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        if (_clients[i].active && _clients[i].clientId == clientId) {
+            _clients[i].active = false;
+            _clients[i].count = 0;
+            _subscriberCount--;
+            if (_subscriberCount == 0) {
+                EventBus::setTopics(_busHandle, 0);
+            }
+            USBSerial.printf("Input stream: client #%u unsubscribed (%u frames dropped)\n",
+                          clientId, _clients[i].dropped);
+            return;
+        }
+    }
+}
+
+void InputEventStream::enqueueFrame(const uint8_t* frame, size_t length) {
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        ClientQueue& queue = _clients[i];
+        if (!queue.active) continue;
+
+        if (queue.count == MAX_CLIENT_FRAMES) {
+            // Drop the oldest frame to make room
+            queue.head = (queue.head + 1) % MAX_CLIENT_FRAMES;
+            queue.count--;
+            queue.dropped++;
+        }
+
+        size_t slot = (queue.head + queue.count) % MAX_CLIENT_FRAMES;
+        memcpy(queue.frames[slot], frame, length);
+        queue.lengths[slot] = length;
+        queue.count++;
+    }
+}
+
+void InputEventStream::process(AsyncWebSocket& ws) {
+    if (_subscriberCount == 0) {
+        // Discard what was queued before the last client left
+        BusEvent event;
+        while (EventBus::poll(_busHandle, event)) {}
+        return;
+    }
+
+    uint32_t now = millis();
+    if (now - _lastBatchTime < BATCH_INTERVAL_MS) return;
+    _lastBatchTime = now;
+
+    std::lock_guard<std::mutex> lock(_clientMutex);
+
+    // Drain the bus queue into frames of at most MAX_FRAME_EVENTS
+    uint8_t frame[MAX_FRAME_BYTES];
+    FrameHeader* header = reinterpret_cast<FrameHeader*>(frame);
+    InputEvent* events = reinterpret_cast<InputEvent*>(frame + sizeof(FrameHeader));
+
+    while (true) {
+        size_t count = 0;
+        BusEvent event;
+        while (count < MAX_FRAME_EVENTS && EventBus::poll(_busHandle, event)) {
+            InputEvent& out = events[count++];
+            out.timestampUs = event.timestampUs;
+            out.type = event.topic == EVENT_KEY ? INPUT_EVENT_KEY
+                     : event.topic == EVENT_ENCODER ? INPUT_EVENT_ENCODER
+                     : INPUT_EVENT_MACRO;
+            out.flags = event.flags;
+            out.id = event.id;
+            out.value = event.value;
+        }
+        uint32_t drops = EventBus::getDropped(_busHandle);
+
+        if (count == 0) break;
+
+        uint32_t newDrops = drops - _reportedDrops;
+        _reportedDrops = drops;
+
+        header->version = FRAME_VERSION;
+        header->count = count;
+        header->dropped = newDrops > 0xFFFF ? 0xFFFF : newDrops;
+        header->sequence = _sequence++;
+
+        enqueueFrame(frame, sizeof(FrameHeader) + count * sizeof(InputEvent));
+    }
+
+    // Push queued frames to clients that can accept them
+    for (size_t i = 0; i < MAX_SUBSCRIBERS; i++) {
+        ClientQueue& queue = _clients[i];
+        if (!queue.active) continue;
+
+        AsyncWebSocketClient* client = ws.client(queue.clientId);
+        if (client == nullptr || client->status() != WS_CONNECTED) {
+            // Client went away without a disconnect event reaching us
+            queue.active = false;
+            queue.count = 0;
+            _subscriberCount--;
+            if (_subscriberCount == 0) {
+                EventBus::setTopics(_busHandle, 0);
+            }
+            continue;
+        }
+
+        while (queue.count > 0 && client->canSend()) {
+            client->binary(queue.frames[queue.head], queue.lengths[queue.head]);
+            queue.head = (queue.head + 1) % MAX_CLIENT_FRAMES;
+            queue.count--;
+        }
+    }
+}
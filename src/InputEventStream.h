@@ -0,0 +1,92 @@
+#ifndef INPUT_EVENT_STREAM_H
+#define INPUT_EVENT_STREAM_H
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include "EventBus.h"
+#include <mutex>
+
+// Input event types carried in the binary stream
+enum InputEventType : uint8_t {
+    INPUT_EVENT_KEY = 1,      // id = component index, value = 1 pressed / 0 released
+    INPUT_EVENT_ENCODER = 2,  // id = encoder index, value = absolute position, flags bit0 = clockwise
+    INPUT_EVENT_SLIDER = 3,   // id = slider index, value = raw reading (reserved)
+    INPUT_EVENT_MACRO = 4     // id = 16-bit FNV-1a of macro id, value = 1 started / 0 completed
+};
+
+// One event on the wire (little-endian, 12 bytes)
+struct __attribute__((packed)) InputEvent {
+    uint32_t timestampUs;
+    uint8_t type;
+    uint8_t flags;
+    uint16_t id;
+    int32_t value;
+};
+
+// Streams key, encoder, slider and macro events to subscribed WebSocket clients.
+// Events come from the event bus, which queues them only while a client is
+// subscribed, and are batched into binary frames by process(), which runs
+// from WiFiManager::update().
+class InputEventStream {
+public:
+    // Frame header (little-endian, 8 bytes), followed by `count` InputEvents
+    struct __attribute__((packed)) FrameHeader {
+        uint8_t version;
+        uint8_t count;
+        uint16_t dropped;   // Events lost to capture overflow since the previous frame
+        uint32_t sequence;
+    };
+
+    static const uint8_t FRAME_VERSION = 1;
+
+    // Subscribe to the event bus
+    static void begin();
+
+    // Subscribe / unsubscribe a WebSocket client
+    static bool subscribe(AsyncWebSocketClient* client);
+    static void unsubscribe(uint32_t clientId);
+
+    // Batch pending events and push queued frames to clients
+    static void process(AsyncWebSocket& ws);
+
+    // Status accessors
+    static bool hasSubscribers() { return _subscriberCount > 0; }
+    static uint32_t getCaptureDrops() { return EventBus::getDropped(_busHandle); }
+
+private:
+    static const uint16_t CAPTURE_CAPACITY = 64;
+    static const uint8_t CAPTURE_TOPICS = EVENT_KEY | EVENT_ENCODER | EVENT_MACRO;
+    static const size_t MAX_SUBSCRIBERS = 4;
+    static const size_t MAX_CLIENT_FRAMES = 8;
+    static const size_t MAX_FRAME_EVENTS = 32;
+    static const size_t MAX_FRAME_BYTES = sizeof(FrameHeader) + MAX_FRAME_EVENTS * sizeof(InputEvent);
+    static const uint32_t BATCH_INTERVAL_MS = 15;
+
+    // Per-client bounded frame queue, drop-oldest when full
+    struct ClientQueue {
+        uint32_t clientId;
+        bool active;
+        uint8_t head;
+        uint8_t count;
+        uint32_t dropped;
+        uint16_t lengths[MAX_CLIENT_FRAMES];
+        uint8_t frames[MAX_CLIENT_FRAMES][MAX_FRAME_BYTES];
+    };
+
+    static void enqueueFrame(const uint8_t* frame, size_t length);
+
+    // Event bus queue, filled by the input tasks while anyone is subscribed
+    static int _busHandle;
+    static uint32_t _reportedDrops;
+
+    // Subscribers, shared between the AsyncTCP task and the loop
+    static ClientQueue _clients[MAX_SUBSCRIBERS];
+    static volatile uint8_t _subscriberCount;
+    static std::mutex _clientMutex;
+
+    static uint32_t _sequence;
+    static uint32_t _lastBatchTime;
+};
+
+#endif // INPUT_EVENT_STREAM_H
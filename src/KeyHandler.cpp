@@ -3,9 +3,14 @@
 #include "KeyHandler.h"
 #include "HIDHandler.h"
 #include "EncoderHandler.h"  // Include for forwarding encoder button events
-#include "LEDHandler.h"      // Changed from LightingHandler.h
 #include "MacroHandler.h"
+#include "EventBus.h"
+#include "BinaryLog.h"
+#include "MetricsRegistry.h"
 #include "ConfigManager.h"
+#include "PersistenceService.h"
+#include "PowerManager.h"
+#include "SpanTrace.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <USBCDC.h>
@@ -13,11 +18,14 @@
 
 extern USBCDC USBSerial;
 extern HIDHandler* hidHandler;
-// LEDHandler is not a class, it's just a collection of functions
 extern MacroHandler* macroHandler;
 
 KeyHandler* keyHandler = nullptr;
 
+// Current layer in the persistence service's NVS state, and where it used to live
+static const char* CURRENT_LAYER_KEY = "layer";
+static const char* LEGACY_LAYER_PATH = "/config/current_layer.json";
+
 KeyHandler::KeyHandler(uint8_t rows, uint8_t cols, 
                      const std::vector<Component>& components,
                      uint8_t* rowsPins, uint8_t* colPins) {
@@ -55,6 +63,13 @@ KeyHandler::KeyHandler(uint8_t rows, uint8_t cols,
                 pos.row = comp.startRow;
                 pos.col = comp.startCol;
                 pos.id = comp.id;
+                // Parsed once here so a key event does not build substrings
+                if (comp.id.startsWith("encoder-")) {
+                    int encoderNum = comp.id.substring(8).toInt();
+                    if (encoderNum > 0 && encoderNum <= 127) {
+                        pos.encoderIndex = (int8_t)(encoderNum - 1);
+                    }
+                }
                 componentPositions.push_back(pos);
                 
                 USBSerial.printf("Mapped component %s to position [%d,%d]\n", 
@@ -71,9 +86,9 @@ KeyHandler::KeyHandler(uint8_t rows, uint8_t cols,
         lastDebounceTime = new unsigned long[totalKeys]();
         lastAction = new KeyAction[totalKeys]();
         
-        // Create action map
+        // Create action map (KeyConfig's initializers clear it; it holds
+        // Strings, so it must not be memset)
         actionMap = new KeyConfig[totalKeys];
-        memset(actionMap, 0, totalKeys * sizeof(KeyConfig));
         
         USBSerial.printf("KeyHandler initialized with %d keys\n", totalKeys);
         
@@ -548,6 +563,7 @@ void KeyHandler::loadKeyConfiguration(const std::map<String, ActionConfig>& acti
     if (!isLayerAvailable(currentLayer)) {
         currentLayer = defaultLayerName;
         USBSerial.printf("Current layer not available, setting to default: %s\n", currentLayer.c_str());
+        EventBus::publish(EVENT_LAYER, 0, 0, 0, currentLayer.c_str());
     }
     
     // List all available layers and their configs
@@ -615,6 +631,11 @@ void KeyHandler::updateKeys() {
     if (now - lastScan < scanInterval) return;
     lastScan = now;
     
+    // Full speed for the scan and the reports it sends (see PowerManager)
+    PowerLock scanLock(POWER_LOCK_SCAN);
+    MetricTimer scanTimer(metricScanDuration);
+    SpanScope scanSpan(SPAN_SCAN);
+    
     // Configure rows as OUTPUT and columns as INPUT_PULLUP
     for (uint8_t r = 0; r < numRows; r++) {
         pinMode(rowPins[r], OUTPUT);
@@ -653,18 +674,22 @@ void KeyHandler::updateKeys() {
             
             // Process state change
             if (currentReading != keyStates[componentIndex]) {
+                SPAN_BEGIN(SPAN_DEBOUNCE, componentIndex);
                 lastDebounceTime[componentIndex] = now;
                 keyStates[componentIndex] = currentReading;
                 
-                String componentId = componentPositions[componentIndex].id;
+                const String& componentId = componentPositions[componentIndex].id;
                 
                 // Log the event
-                USBSerial.printf("Key event: Row %d, Col %d, ID=%s, State=%s\n", 
-                              r, c, componentId.c_str(), 
-                              currentReading ? "PRESSED" : "RELEASED");
+                BLOG_DEBUG("Key event: Row %d, Col %d, ID=%s, State=%s\n", 
+                           r, c, componentId.c_str(), 
+                           currentReading ? "PRESSED" : "RELEASED");
                 
-                // Sync LEDs
-                syncLEDsWithButtons(componentId.c_str(), currentReading);
+                PersistenceService::noteActivity();
+                
+                // LEDs, the input stream and metrics pick this up from the bus
+                EventBus::publish(EVENT_KEY, componentIndex, currentReading ? 1 : 0, 0, componentId.c_str());
+                SPAN_END(SPAN_DEBOUNCE);
                 
                 // Execute action
                 KeyAction action = currentReading ? KEY_PRESS : KEY_RELEASE;
@@ -682,73 +707,68 @@ void KeyHandler::updateKeys() {
 
 void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
     if (keyIndex >= componentPositions.size() || !actionMap) {
-        USBSerial.printf("EXECUTE ERROR: Invalid keyIndex %d (max: %d) or actionMap is null\n", 
-                     keyIndex, componentPositions.size() - 1);
+        BLOG_ERROR("EXECUTE ERROR: Invalid keyIndex %d (max: %d) or actionMap is null\n", 
+                   keyIndex, (int)componentPositions.size() - 1);
         return;
     }
+    SpanScope dispatchSpan(SPAN_DISPATCH, keyIndex);
 
     const KeyConfig& config = actionMap[keyIndex];
-    String componentId = componentPositions[keyIndex].id;
+    const String& componentId = componentPositions[keyIndex].id;
     
-    USBSerial.printf("Executing action for %s: type=%d, action=%s\n", 
-                 componentId.c_str(), config.type, 
-                 action == KEY_PRESS ? "PRESS" : "RELEASE");
+    BLOG_DEBUG("Executing action for %s: type=%d, action=%s\n", 
+               componentId.c_str(), config.type, 
+               action == KEY_PRESS ? "PRESS" : "RELEASE");
     
     // Check if this is an encoder button - if so, route to EncoderHandler
-    if (componentId.startsWith("encoder-")) {
+    int8_t encoderIndex = componentPositions[keyIndex].encoderIndex;
+    if (encoderIndex >= 0) {
         if (encoderHandler) {
-            // Extract encoder index from ID (encoder-1 -> index 0)
-            int encoderNum = componentId.substring(8).toInt();
-            if (encoderNum > 0) {
-                uint8_t encoderIndex = encoderNum - 1; // Convert 1-based to 0-based index
-                
-                // Forward button event to EncoderHandler
-                USBSerial.printf("Button %s %s - forwarding to EncoderHandler\n", 
-                             componentId.c_str(), 
-                             action == KEY_PRESS ? "PRESSED" : "RELEASED");
-                
-                encoderHandler->executeEncoderButtonAction(encoderIndex, action == KEY_PRESS);
-                
-                // Skip normal KeyHandler processing
-                return;
-            }
+            // Forward button event to EncoderHandler
+            BLOG_DEBUG("Button %s %s - forwarding to EncoderHandler\n", 
+                       componentId.c_str(), 
+                       action == KEY_PRESS ? "PRESSED" : "RELEASED");
+            
+            encoderHandler->executeEncoderButtonAction(encoderIndex, action == KEY_PRESS);
+            
+            // Skip normal KeyHandler processing
+            return;
         } else {
-            USBSerial.println("ERROR: encoderHandler is null, can't forward encoder button event");
+            BLOG_ERROR("ERROR: encoderHandler is null, can't forward encoder button event\n");
         }
     }
     
     // Normal KeyHandler action processing for non-encoder buttons
     if (config.type == ACTION_NONE) {
-        USBSerial.printf("DEBUG: No action configured for %s (layer: %s)\n", 
-                     componentId.c_str(), currentLayer.c_str());
+        BLOG_DEBUG("DEBUG: No action configured for %s (layer: %s)\n", 
+                   componentId.c_str(), currentLayer.c_str());
+#if BLOG_LEVEL >= BLOG_LEVEL_TRACE
         // Print available layers and current configs for debugging
         std::vector<String> layers = getAvailableLayers();
-        USBSerial.printf("Available layers (%d): ", layers.size());
+        BLOG_TRACE("Available layers (%d):\n", (int)layers.size());
         for (const auto& layer : layers) {
-            USBSerial.printf("%s, ", layer.c_str());
+            BLOG_TRACE("  %s\n", layer.c_str());
         }
-        USBSerial.println();
         
         // Print current layer configs
         if (layerConfigs.find(currentLayer) != layerConfigs.end()) {
             std::map<String, KeyConfig>& configs = layerConfigs[currentLayer];
-            USBSerial.printf("Current layer '%s' has %d configurations:\n", 
-                         currentLayer.c_str(), configs.size());
+            BLOG_TRACE("Current layer '%s' has %d configurations:\n", 
+                       currentLayer.c_str(), (int)configs.size());
             for (const auto& config : configs) {
-                USBSerial.printf("  %s: type=%d\n", config.first.c_str(), config.second.type);
+                BLOG_TRACE("  %s: type=%d\n", config.first.c_str(), config.second.type);
             }
         }
+#endif
     }
     
     switch (config.type) {
         case ACTION_HID:
             // Send HID report
             if (action == KEY_PRESS) {
-                USBSerial.print("HID Report: ");
-                for (int i = 0; i < 8; i++) {
-                    USBSerial.printf("%02X ", config.hidReport[i]);
-                }
-                USBSerial.println();
+                BLOG_DEBUG("HID Report: %02X %02X %02X %02X %02X %02X %02X %02X\n",
+                           config.hidReport[0], config.hidReport[1], config.hidReport[2], config.hidReport[3],
+                           config.hidReport[4], config.hidReport[5], config.hidReport[6], config.hidReport[7]);
                 
                 if (hidHandler) {
                     // Process modifier keys (byte 0)
@@ -769,7 +789,7 @@ void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
                         }
                     }
                     
-                    USBSerial.println("HID key press processed");
+                    BLOG_TRACE("HID key press processed\n");
                 }
             } else if (action == KEY_RELEASE) {
                 if (hidHandler) {
@@ -791,7 +811,7 @@ void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
                         }
                     }
                     
-                    USBSerial.println("HID key release processed");
+                    BLOG_TRACE("HID key release processed\n");
                 }
             }
             break;
@@ -799,15 +819,13 @@ void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
         case ACTION_MULTIMEDIA:
             // Send consumer report
             if (action == KEY_PRESS) {
-                USBSerial.print("Consumer Report: ");
-                for (int i = 0; i < 4; i++) {
-                    USBSerial.printf("%02X ", config.consumerReport[i]);
-                }
-                USBSerial.println();
+                BLOG_DEBUG("Consumer Report: %02X %02X %02X %02X\n",
+                           config.consumerReport[0], config.consumerReport[1],
+                           config.consumerReport[2], config.consumerReport[3]);
                 
                 if (hidHandler) {
                     bool sent = hidHandler->sendConsumerReport(config.consumerReport);
-                    USBSerial.printf("Consumer report sent: %s\n", sent ? "SUCCESS" : "FAILED");
+                    BLOG_DEBUG("Consumer report sent: %s\n", sent ? "SUCCESS" : "FAILED");
                 }
             } else if (action == KEY_RELEASE) {
                 if (hidHandler) {
@@ -841,15 +859,13 @@ void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
                 mouseReport[3] = config.mouseReport[3];  // Y
                 mouseReport[4] = config.mouseReport[4];  // Wheel
                 
-                USBSerial.print("Mouse Report: ");
-                for (int i = 0; i < HID_MOUSE_REPORT_SIZE; i++) {
-                    USBSerial.printf("%02X ", mouseReport[i]);
-                }
-                USBSerial.println();
+                BLOG_DEBUG("Mouse Report: %02X %02X %02X %02X %02X\n",
+                           mouseReport[0], mouseReport[1], mouseReport[2], mouseReport[3], mouseReport[4]);
                 
                 if (hidHandler) {
-                    bool sent = hidHandler->sendMouseReport(mouseReport, HID_MOUSE_REPORT_SIZE);
-                    USBSerial.printf("Mouse report sent: %s\n", sent ? "SUCCESS" : "FAILED");
+                    // sendMouseReport() takes the report without its ID byte
+                    bool sent = hidHandler->sendMouseReport(mouseReport + 1, HID_MOUSE_REPORT_SIZE - 1);
+                    BLOG_DEBUG("Mouse report sent: %s\n", sent ? "SUCCESS" : "FAILED");
                     
                     // Add a small delay for click detection
                     if (sent && mouseReport[1] != 0) {  // Only delay if a button was pressed
@@ -866,13 +882,13 @@ void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
         case ACTION_MACRO:
             // Execute macro
             if (action == KEY_PRESS && !config.macroId.isEmpty()) {
-                USBSerial.printf("Executing macro: %s\n", config.macroId.c_str());
+                BLOG_DEBUG("Executing macro: %s\n", config.macroId.c_str());
                 if (macroHandler) {
                     // Use MacroHandler instead of HIDHandler for macro execution
                     bool success = macroHandler->executeMacro(config.macroId);
-                    USBSerial.printf("Macro execution %s\n", success ? "started" : "failed");
+                    BLOG_DEBUG("Macro execution %s\n", success ? "started" : "failed");
                 } else {
-                    USBSerial.println("MacroHandler not initialized");
+                    BLOG_ERROR("MacroHandler not initialized\n");
                 }
             }
             break;
@@ -880,26 +896,26 @@ void KeyHandler::executeAction(uint8_t keyIndex, KeyAction action) {
         case ACTION_LAYER:
             // Switch to target layer
             if (action == KEY_PRESS && !config.targetLayer.isEmpty()) {
-                USBSerial.printf("Switching to layer: %s\n", config.targetLayer.c_str());
+                BLOG_INFO("Switching to layer: %s\n", config.targetLayer.c_str());
                 bool success = switchToLayer(config.targetLayer);
                 
-                USBSerial.printf("Layer switch %s\n", success ? "succeeded" : "failed");
+                BLOG_INFO("Layer switch %s\n", success ? "succeeded" : "failed");
             }
             break;
             
         case ACTION_CYCLE_LAYER:
             // Cycle to next layer
             if (action == KEY_PRESS) {
-                USBSerial.println("Cycling to next layer");
+                BLOG_INFO("Cycling to next layer\n");
                 bool success = cycleToNextLayer();
                 
-                USBSerial.printf("Layer cycle %s\n", success ? "succeeded" : "failed");
+                BLOG_INFO("Layer cycle %s\n", success ? "succeeded" : "failed");
             }
             break;
             
         default:
-            USBSerial.printf("No action configured for component '%s' (key index %d)\n", 
-                         componentPositions[keyIndex].id.c_str(), keyIndex);
+            BLOG_WARN("No action configured for component '%s' (key index %d)\n", 
+                      componentPositions[keyIndex].id.c_str(), keyIndex);
             break;
     }
 }
@@ -1003,26 +1019,47 @@ std::vector<String> KeyHandler::getAvailableLayers() const {
 }
 
 bool KeyHandler::saveCurrentLayer() {
-    DynamicJsonDocument doc(256);
-    doc["currentLayer"] = currentLayer;
-    
-    String jsonStr;
-    serializeJson(doc, jsonStr);
-    
-    File file = LittleFS.open("/config/current_layer.json", "w");
-    if (file) {
-        file.print(jsonStr);
-        file.close();
-        USBSerial.printf("Current layer '%s' saved to LittleFS\n", currentLayer.c_str());
-        return true;
-    } else {
-        USBSerial.println("Failed to save current layer to LittleFS");
-        return false;
-    }
+    // Written behind to NVS, so a layer switch never waits on flash
+    PersistenceService::putString(CURRENT_LAYER_KEY, currentLayer);
+    EventBus::publish(EVENT_LAYER, 0, 0, 0, currentLayer.c_str());
+    return true;
 }
 
 bool KeyHandler::loadCurrentLayer() {
-    if (!LittleFS.exists("/config/current_layer.json")) {
+    String savedLayer = PersistenceService::getString(CURRENT_LAYER_KEY);
+    
+    // Earlier firmware kept the layer in a JSON file; move it over once
+    if (savedLayer.isEmpty() && LittleFS.exists(LEGACY_LAYER_PATH)) {
+        File file = LittleFS.open(LEGACY_LAYER_PATH, "r");
+        if (file) {
+            DynamicJsonDocument doc(1024);
+            DeserializationError error = deserializeJson(doc, file);
+            file.close();
+            
+            if (error) {
+                USBSerial.printf("Failed to parse layer file: %s\n", error.c_str());
+            } else {
+                savedLayer = doc["currentLayer"] | "";
+                USBSerial.printf("Migrated saved layer '%s' from %s\n", savedLayer.c_str(), LEGACY_LAYER_PATH);
+            }
+        }
+        
+        // Keep the file until the layer is in NVS; the write-behind delay
+        // would otherwise leave a window where a power loss drops it
+        bool migrated = true;
+        if (!savedLayer.isEmpty()) {
+            currentLayer = savedLayer;
+            saveCurrentLayer();
+            migrated = PersistenceService::flush();
+        }
+        if (migrated) {
+            LittleFS.remove(LEGACY_LAYER_PATH);
+        } else {
+            USBSerial.println("Failed to store migrated layer, keeping legacy file");
+        }
+    }
+    
+    if (savedLayer.isEmpty()) {
         // Default to the first available layer if none is specified
         std::vector<String> layers = getAvailableLayers();
         if (!layers.empty()) {
@@ -1038,46 +1075,16 @@ bool KeyHandler::loadCurrentLayer() {
         return true;
     }
     
-    File file = LittleFS.open("/config/current_layer.json", "r");
-    if (!file) {
-        USBSerial.println("Failed to open current_layer.json file");
-        return false;
-    }
-    
-    DynamicJsonDocument doc(1024);
-    DeserializationError error = deserializeJson(doc, file);
-    file.close();
-    
-    if (error) {
-        USBSerial.printf("Failed to parse layer file: %s\n", error.c_str());
-        return false;
-    }
-    
-    String savedLayer = doc["currentLayer"].as<String>();
-    if (savedLayer.isEmpty()) {
-        USBSerial.println("No layer specified in file");
-        return false;
-    }
-    
     USBSerial.printf("Loaded saved layer name: %s\n", savedLayer.c_str());
     
     // Only switch if the layer is available, otherwise we'll keep the default
     // until the configurations are loaded
     currentLayer = savedLayer;
+    saveCurrentLayer();
     USBSerial.printf("Set current layer to: %s\n", currentLayer.c_str());
     return true;
 }
 
-void KeyHandler::setCpuFrequencyMhz(uint8_t mhz) {
-    // Implementation of setCpuFrequencyMhz function
-}
-
-void KeyHandler::performHighPowerTask() {
-    setCpuFrequencyMhz(240);
-    // Perform intensive task
-    setCpuFrequencyMhz(80);
-}
-
 bool KeyHandler::assignMacroToButton(const String& buttonId, const String& macroId) {
     // Find the component in the componentPositions vector
     for (size_t i = 0; i < componentPositions.size(); i++) {
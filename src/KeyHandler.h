@@ -64,10 +64,6 @@ public:
     bool isLayerAvailable(const String& layerName) const;
     std::vector<String> getAvailableLayers() const;
     
-    // Add these function declarations:
-    void setCpuFrequencyMhz(uint8_t mhz);
-    void performHighPowerTask();
-    
     bool assignMacroToButton(const String& buttonId, const String& macroId);
     
     // Add getKeyConfig method
@@ -113,6 +109,7 @@ private:
         uint8_t row;
         uint8_t col;
         String id;
+        int8_t encoderIndex = -1;   // Encoder whose button this is (encoder-1 -> 0), or -1
         bool operator<(const ComponentPosition& other) const {
             if (row != other.row) return row < other.row;
             return col < other.col;
@@ -136,7 +133,4 @@ void initializeKeyHandler();
 void updateKeyHandler();
 void cleanupKeyHandler();
 
-// For LED sync (defined elsewhere)
-void syncLEDsWithButtons(const char* buttonId, bool pressed);
-
 #endif // KEY_HANDLER_H
\ No newline at end of file
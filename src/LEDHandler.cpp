@@ -2,6 +2,11 @@
 
 #include "LEDHandler.h"
 #include "ModuleSetup.h"
+#include "MetricsRegistry.h"
+#include "PersistenceService.h"
+#include "EventBus.h"
+#include "SpanTrace.h"
+#include "MemoryPolicy.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <algorithm> // For std::min
@@ -25,6 +30,10 @@ uint8_t numLEDs = 0;
 // Button-LED mapping
 std::map<String, ButtonLEDMapping> buttonLEDMap;
 
+// Key presses from the event bus
+static int keyEventSubscription = -1;
+static const uint16_t KEY_EVENT_QUEUE_DEPTH = 32;
+
 // Animation variables
 bool animationActive = false;
 uint8_t animationMode = 0;
@@ -43,6 +52,8 @@ bool lowPowerMode = false;
 static String readJsonFile(const char* filePath);
 
 void initializeLED(uint8_t numLEDsToInit, uint8_t ledPin, uint8_t brightness) {
+    keyEventSubscription = EventBus::subscribe("leds", EVENT_KEY, KEY_EVENT_QUEUE_DEPTH);
+    
     try {
         #ifdef ENABLE_POWER_MONITORING
         // Setup ADC for voltage monitoring (Pin 34 - ADC1 Channel 6)
@@ -67,7 +78,7 @@ void initializeLED(uint8_t numLEDsToInit, uint8_t ledPin, uint8_t brightness) {
                 createDefaultLEDConfig();
             } else {
                 // Parse LED configuration
-                DynamicJsonDocument doc(8192);
+                PsramJsonDocument doc(8192);
                 DeserializationError error = deserializeJson(doc, ledJson);
                 
                 if (error) {
@@ -291,7 +302,7 @@ String createDefaultLEDConfig() {
 }
 
 bool saveDefaultLEDConfig() {
-    DynamicJsonDocument doc(16384);
+    PsramJsonDocument doc(16384);
     
     // Create the basic structure
     doc["leds"]["pin"] = DEFAULT_LED_PIN;
@@ -620,84 +631,25 @@ uint32_t wheel(byte wheelPos) {
     return strip->Color(wheelPos * 3, 255 - wheelPos * 3, 0);
 }
 
-// Improved button-LED synchronization
+// Button-LED synchronization; updateLEDs() pushes the result in one frame
 void syncLEDsWithButtons(const char* buttonId, bool pressed) {
-    // Add debug output to track button events
-    USBSerial.printf("Button %s %s\n", buttonId, pressed ? "PRESSED" : "RELEASED");
-    
     auto it = buttonLEDMap.find(buttonId);
     if (it != buttonLEDMap.end()) {
-        const ButtonLEDMapping& mapping = it->second;
-        
-        try {
-            // Update all LEDs assigned to this button
-            for (uint8_t index : mapping.ledIndices) {
-                if (index >= numLEDs) {
-                    USBSerial.printf("Error: Invalid LED index %d for button %s\n", index, buttonId);
-                    continue;
-                }
-                
-                if (pressed) {
-                    // Button pressed - use pressed color
-                    USBSerial.printf("  Setting LED %d to pressed color (%d,%d,%d)\n", 
-                                   index, 
-                                   ledConfigs[index].pressedR, 
-                                   ledConfigs[index].pressedG, 
-                                   ledConfigs[index].pressedB);
-                    
-                    setLEDColorWithBrightness(index,
-                        ledConfigs[index].pressedR,
-                        ledConfigs[index].pressedG,
-                        ledConfigs[index].pressedB,
-                        ledConfigs[index].brightness,
-                        true);
-                } else {
-                    // Button released - restore default color
-                    USBSerial.printf("  Setting LED %d to default color (%d,%d,%d)\n", 
-                                   index, 
-                                   ledConfigs[index].r, 
-                                   ledConfigs[index].g, 
-                                   ledConfigs[index].b);
-                    
-                    setLEDColorWithBrightness(index,
-                        ledConfigs[index].r,
-                        ledConfigs[index].g,
-                        ledConfigs[index].b,
-                        ledConfigs[index].brightness,
-                        false);
-                }
-                
-                ledConfigs[index].isActive = pressed;
+        // Update all LEDs assigned to this button
+        for (uint8_t index : it->second.ledIndices) {
+            if (index >= numLEDs) {
+                USBSerial.printf("Error: Invalid LED index %d for button %s\n", index, buttonId);
+                continue;
             }
-        } catch (const std::exception& e) {
-            USBSerial.printf("Error in syncLEDsWithButtons: %s\n", e.what());
+            ledConfigs[index].isActive = pressed;
+            ledConfigs[index].needsUpdate = true;
         }
-    } else {
-        // If no explicit mapping exists, try to derive the LED index from button ID
-        if (strncmp(buttonId, "button-", 7) == 0) {
-            int buttonNum = atoi(buttonId + 7) - 1; // Convert to 0-based index
-            
-            if (buttonNum >= 0 && buttonNum < numLEDs) {
-                // Use pressed colors for pressed, default colors for released
-                if (pressed) {
-                    USBSerial.printf("  Setting fallback LED %d to pressed color\n", buttonNum);
-                    setLEDColorWithBrightness(buttonNum, 
-                        ledConfigs[buttonNum].pressedR,
-                        ledConfigs[buttonNum].pressedG,
-                        ledConfigs[buttonNum].pressedB,
-                        ledConfigs[buttonNum].brightness,
-                        true);
-                } else {
-                    USBSerial.printf("  Setting fallback LED %d to default color\n", buttonNum);
-                    setLEDColorWithBrightness(buttonNum,
-                        ledConfigs[buttonNum].r,
-                        ledConfigs[buttonNum].g,
-                        ledConfigs[buttonNum].b,
-                        ledConfigs[buttonNum].brightness,
-                        false);
-                }
-                ledConfigs[buttonNum].isActive = pressed;
-            }
+    } else if (strncmp(buttonId, "button-", 7) == 0) {
+        // If no explicit mapping exists, derive the LED index from the button ID
+        int buttonNum = atoi(buttonId + 7) - 1; // Convert to 0-based index
+        if (buttonNum >= 0 && buttonNum < numLEDs) {
+            ledConfigs[buttonNum].isActive = pressed;
+            ledConfigs[buttonNum].needsUpdate = true;
         }
     }
 }
@@ -788,7 +740,7 @@ bool updateLEDConfigFromJson(const String& json) {
     size_t bufferSize = estimateJsonBufferSize(json, 1.5);
     USBSerial.printf("[updateLEDConfigFromJson] Estimated buffer size: %d bytes\n", bufferSize);
     
-    DynamicJsonDocument doc(bufferSize);
+    PsramJsonDocument doc(bufferSize);
     DeserializationError error = deserializeJson(doc, json);
     
     // Debug after parsing
@@ -806,7 +758,7 @@ bool updateLEDConfigFromJson(const String& json) {
             // If we can measure and allocate the required size, retry
             if (requiredSize > 0 && requiredSize <= ESP.getFreeHeap() / 2) {
                 USBSerial.printf("[updateLEDConfigFromJson] Retrying with estimated size: %u bytes\n", requiredSize);
-                DynamicJsonDocument retryDoc(requiredSize);
+                PsramJsonDocument retryDoc(requiredSize);
                 error = deserializeJson(retryDoc, json);
                 
                 if (!error) {
@@ -1070,6 +1022,12 @@ void cleanupLED() {
 void updateLEDs() {
     if (!strip) return;
     
+    // Apply key presses queued since the last frame
+    BusEvent event;
+    while (EventBus::poll(keyEventSubscription, event)) {
+        syncLEDsWithButtons(event.text, event.value != 0);
+    }
+    
     static unsigned long lastUpdate = 0;
     const unsigned long updateInterval = 16; // ~60fps max update rate
     unsigned long currentTime = millis();
@@ -1083,6 +1041,9 @@ void updateLEDs() {
     if (currentTime - lastUpdate < updateInterval) return;
     lastUpdate = currentTime;
     
+    MetricTimer frameTimer(metricLedFrameTime);
+    SpanScope frameSpan(SPAN_LED_SHOW);
+    
     // Update animations if active
     if (animationActive) {
         updateAnimation();
@@ -1184,6 +1145,9 @@ void checkPowerStatus() {
 
 // Handle low power situations
 void handleLowPower() {
+    // Earliest warning we get: the brownout detector resets without one
+    PersistenceService::flush();
+    
     // Reduce brightness to minimum safe level
     uint8_t emergencyBrightness = 20;
     strip->setBrightness(emergencyBrightness);
@@ -1260,6 +1224,13 @@ bool saveLEDConfig() {
     }
 }
 
+// Save the LED configuration once changes have settled
+void scheduleLEDConfigSave() {
+    static int writer = PersistenceService::registerWriter("leds", saveLEDConfig);
+    if (!strip) return;
+    PersistenceService::markDirty(writer);
+}
+
 // Function to update a single LED's color based on its configuration
 void updateLED(uint8_t index) {
     if (!strip || index >= numLEDs) {
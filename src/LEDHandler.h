@@ -96,6 +96,7 @@ void updateLEDs();
 String getLEDConfigJson();
 bool updateLEDConfigFromJson(const String& json);
 bool saveLEDConfig();
+void scheduleLEDConfigSave();
 String createDefaultLEDConfig();
 bool saveDefaultLEDConfig();
 void cleanupLED();
@@ -4,6 +4,12 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include "HIDHandler.h"
+#include "EventBus.h"
+#include "MetricsRegistry.h"
+#include "BinaryLog.h"
+#include "PowerManager.h"
+#include "SpanTrace.h"
+#include "MemoryPolicy.h"
 #include <USB.h>
 #include <USBHID.h>
 #include <USBHIDMouse.h>
@@ -44,7 +50,9 @@ void MacroHandler::ensureMacroDirectoryExists() {
 bool MacroHandler::loadMacros() {
     USBSerial.println("Loading macros from filesystem...");
     
-    macros.clear();
+    // Parse into a new map without the lock, so the hid task keeps running
+    // the current macro while the files are read
+    std::map<String, Macro> loaded;
     
     // Ensure the macros directory exists
     ensureMacroDirectoryExists();
@@ -83,8 +91,10 @@ bool MacroHandler::loadMacros() {
         file.close();
         
         // Parse the macro JSON
-        DynamicJsonDocument doc(8192);
+        PsramJsonDocument doc(8192);
+        SPAN_BEGIN(SPAN_JSON_PARSE, macroJson.length());
         DeserializationError error = deserializeJson(doc, macroJson);
+        SPAN_END(SPAN_JSON_PARSE);
         
         if (error) {
             USBSerial.print("Failed to parse macro JSON: ");
@@ -96,8 +106,8 @@ bool MacroHandler::loadMacros() {
         // Create a macro from the JSON
         Macro macro;
         if (parseMacroFromJson(doc.as<JsonObject>(), macro)) {
-            // Add to the macros map
-            macros[macro.id] = macro;
+            // Add to the new map
+            loaded[macro.id] = macro;
             loadedCount++;
             USBSerial.print("Loaded macro: ");
             USBSerial.println(macro.id);
@@ -114,12 +124,30 @@ bool MacroHandler::loadMacros() {
     USBSerial.print(loadedCount);
     USBSerial.println(" macros");
     
+    {
+        std::lock_guard<std::mutex> step(stepMutex);
+        std::lock_guard<std::mutex> lock(macroMutex);
+        stopExecution();
+        macros.swap(loaded);
+    }
+    // The previous macros, now out of reach of update()
+    clearMacros(loaded);
+    
     return true;
 }
 
+void MacroHandler::clearMacros(std::map<String, Macro>& entries) {
+    for (auto& entry : entries) {
+        for (auto& cmd : entry.second.commands) {
+            cleanupMacroCommand(cmd);
+        }
+    }
+    entries.clear();
+}
+
 bool MacroHandler::saveMacro(const Macro& macro) {
     // Convert to JSON
-    DynamicJsonDocument macroDoc(16384);
+    PsramJsonDocument macroDoc(16384);
     
     // Fill in the JSON document
     macroDoc["id"] = macro.id;
@@ -277,6 +305,11 @@ bool MacroHandler::saveMacro(const Macro& macro) {
     macroFile.close();
     
     // Update the macros map
+    std::lock_guard<std::mutex> step(stepMutex);
+    std::lock_guard<std::mutex> lock(macroMutex);
+    if (executing && currentMacro->id == macro.id) {
+        stopExecution();
+    }
     macros[macro.id] = macro;
     
     return true;
@@ -390,7 +423,7 @@ bool MacroHandler::parseMacroFromJson(const JsonObject& macroObj, Macro& macro)
             
             String textStr = cmdObj["text"].as<String>();
             cmd.data.typeText.length = textStr.length();
-            cmd.data.typeText.text = (char*)malloc(cmd.data.typeText.length + 1);
+            cmd.data.typeText.text = (char*)MemoryPolicy::allocate(ALLOC_CACHE, cmd.data.typeText.length + 1);
             if (cmd.data.typeText.text) {
                 strcpy(cmd.data.typeText.text, textStr.c_str());
             } else {
@@ -407,7 +440,7 @@ bool MacroHandler::parseMacroFromJson(const JsonObject& macroObj, Macro& macro)
             }
             
             String macroIdStr = cmdObj["macro_id"].as<String>();
-            cmd.data.executeMacro.macroId = (char*)malloc(macroIdStr.length() + 1);
+            cmd.data.executeMacro.macroId = (char*)MemoryPolicy::allocate(ALLOC_CACHE, macroIdStr.length() + 1);
             if (cmd.data.executeMacro.macroId) {
                 strcpy(cmd.data.executeMacro.macroId, macroIdStr.c_str());
             } else {
@@ -533,7 +566,7 @@ void MacroHandler::cleanupMacroCommand(MacroCommand& command) {
     switch (command.type) {
         case MACRO_CMD_TYPE_TEXT:
             if (command.data.typeText.text) {
-                free(command.data.typeText.text);
+                MemoryPolicy::release(command.data.typeText.text);
                 command.data.typeText.text = nullptr;
                 command.data.typeText.length = 0;
             }
@@ -541,7 +574,7 @@ void MacroHandler::cleanupMacroCommand(MacroCommand& command) {
             
         case MACRO_CMD_EXECUTE_MACRO:
             if (command.data.executeMacro.macroId) {
-                free(command.data.executeMacro.macroId);
+                MemoryPolicy::release(command.data.executeMacro.macroId);
                 command.data.executeMacro.macroId = nullptr;
             }
             break;
@@ -553,174 +586,196 @@ void MacroHandler::cleanupMacroCommand(MacroCommand& command) {
 }
 
 bool MacroHandler::executeMacro(const String& macroId) {
-    // Check if macro exists
-    auto it = macros.find(macroId);
-    if (it == macros.end()) {
-        USBSerial.printf("Macro not found: %s\n", macroId.c_str());
+    // If we're already executing a macro, we can't nest them in this simplified version
+    if (executing) {
+        BLOG_WARN("Already executing a macro, can't start another\n");
         return false;
     }
     
-    // If we're already executing a macro, we can't nest them in this simplified version
-    if (executing) {
-        USBSerial.println("Already executing a macro, can't start another");
+    // Called from the keyboard task, which must not wait out a step or a
+    // save that is stopping execution
+    std::unique_lock<std::mutex> step(stepMutex, std::try_to_lock);
+    if (!step.owns_lock() || executing) {
+        BLOG_WARN("Macro handler busy, ignoring macro: %s\n", macroId.c_str());
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(macroMutex);
+    
+    // Check if macro exists
+    auto it = macros.find(macroId);
+    if (it == macros.end()) {
+        BLOG_WARN("Macro not found: %s\n", macroId.c_str());
         return false;
     }
     
     // Start executing the new macro
-    currentMacro = it->second;
+    currentMacro = &it->second;
     currentCommandIndex = 0;
     executing = true;
     lastExecTime = millis();
     delayUntil = 0;
     
-    USBSerial.printf("Starting execution of macro: %s\n", macroId.c_str());
-    USBSerial.printf("Macro contains %d commands\n", currentMacro.commands.size());
+    EventBus::publish(EVENT_MACRO, EventBus::hashId(macroId), 1, 0, macroId.c_str());
+    
+    BLOG_INFO("Starting execution of macro: %s (%d commands)\n", macroId.c_str(),
+              (int)currentMacro->commands.size());
     return true;
 }
 
+void MacroHandler::stopExecution() {
+    if (!executing) {
+        return;
+    }
+    
+    executing = false;
+    delayUntil = 0;
+    EventBus::publish(EVENT_MACRO, EventBus::hashId(currentMacro->id), 0, 0, currentMacro->id.c_str());
+    currentMacro = nullptr;
+    
+    if (hidHandler) {
+        hidHandler->sendEmptyKeyboardReport();
+        hidHandler->sendEmptyConsumerReport();
+    }
+    BLOG_INFO("Macro execution stopped\n");
+}
+
 void MacroHandler::executeCommand(const MacroCommand& cmd) {
-    USBSerial.printf("Executing command type: %d\n", cmd.type);
+    BLOG_DEBUG("Executing command type: %d\n", cmd.type);
     
     switch (cmd.type) {
         case MACRO_CMD_KEY_PRESS: {
             if (hidHandler) {
-                USBSerial.println("Executing key press command");
-                USBSerial.print("Report: ");
-                for (int i = 0; i < 8; i++) {
-                    USBSerial.printf("0x%02X ", cmd.data.keyPress.report[i]);
-                }
-                USBSerial.println();
+                BLOG_DEBUG("Executing key press command\n");
+                BLOG_DEBUG("Report: 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X\n",
+                           cmd.data.keyPress.report[0], cmd.data.keyPress.report[1], cmd.data.keyPress.report[2],
+                           cmd.data.keyPress.report[3], cmd.data.keyPress.report[4], cmd.data.keyPress.report[5],
+                           cmd.data.keyPress.report[6], cmd.data.keyPress.report[7]);
                 
                 hidHandler->sendKeyboardReport(cmd.data.keyPress.report);
                 delay(50); // Small delay to ensure keypress is registered
                 hidHandler->sendEmptyKeyboardReport();
             } else {
-                USBSerial.println("Error: HID handler not available");
+                BLOG_ERROR("Error: HID handler not available\n");
             }
             break;
         }
             
         case MACRO_CMD_KEY_DOWN: {
             if (hidHandler) {
-                USBSerial.println("Executing key down command");
-                USBSerial.print("Report: ");
-                for (int i = 0; i < 8; i++) {
-                    USBSerial.printf("0x%02X ", cmd.data.keyPress.report[i]);
-                }
-                USBSerial.println();
+                BLOG_DEBUG("Executing key down command\n");
+                BLOG_DEBUG("Report: 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X\n",
+                           cmd.data.keyPress.report[0], cmd.data.keyPress.report[1], cmd.data.keyPress.report[2],
+                           cmd.data.keyPress.report[3], cmd.data.keyPress.report[4], cmd.data.keyPress.report[5],
+                           cmd.data.keyPress.report[6], cmd.data.keyPress.report[7]);
                 
                 hidHandler->sendKeyboardReport(cmd.data.keyPress.report);
             } else {
-                USBSerial.println("Error: HID handler not available");
+                BLOG_ERROR("Error: HID handler not available\n");
             }
             break;
         }
             
         case MACRO_CMD_KEY_UP: {
             if (hidHandler) {
-                USBSerial.println("Executing key up command");
+                BLOG_DEBUG("Executing key up command\n");
                 hidHandler->sendEmptyKeyboardReport();
             } else {
-                USBSerial.println("Error: HID handler not available");
+                BLOG_ERROR("Error: HID handler not available\n");
             }
             break;
         }
             
         case MACRO_CMD_CONSUMER_PRESS: {
             if (hidHandler) {
-                USBSerial.println("Executing consumer control command");
-                USBSerial.print("Report: ");
-                for (int i = 0; i < 4; i++) {
-                    USBSerial.printf("0x%02X ", cmd.data.consumerPress.report[i]);
-                }
-                USBSerial.println();
+                BLOG_DEBUG("Executing consumer control command\n");
+                BLOG_DEBUG("Report: 0x%02X 0x%02X 0x%02X 0x%02X\n",
+                           cmd.data.consumerPress.report[0], cmd.data.consumerPress.report[1],
+                           cmd.data.consumerPress.report[2], cmd.data.consumerPress.report[3]);
                 
                 hidHandler->sendConsumerReport(cmd.data.consumerPress.report);
                 delay(50); // Small delay to ensure press is registered
                 hidHandler->sendEmptyConsumerReport();
             } else {
-                USBSerial.println("Error: HID handler not available");
+                BLOG_ERROR("Error: HID handler not available\n");
             }
             break;
         }
             
         case MACRO_CMD_DELAY: {
-            USBSerial.printf("Executing delay: %d ms\n", cmd.data.delay.milliseconds);
+            BLOG_DEBUG("Executing delay: %d ms\n", cmd.data.delay.milliseconds);
             delayUntil = millis() + cmd.data.delay.milliseconds;
             break;
         }
             
         case MACRO_CMD_TYPE_TEXT: {
             if (cmd.data.typeText.text) {
-                USBSerial.printf("Typing text: %s\n", cmd.data.typeText.text);
-                USBSerial.printf("Text length: %d\n", cmd.data.typeText.length);
+                BLOG_DEBUG("Typing text: %s\n", cmd.data.typeText.text);
+                BLOG_TRACE("Text length: %d\n", cmd.data.typeText.length);
                 
                 // Type each character
                 const char* text = cmd.data.typeText.text;
                 for (size_t i = 0; i < cmd.data.typeText.length; i++) {
                     char c = text[i];
-                    USBSerial.printf("Processing character: '%c' (ASCII: %d)\n", c, (int)c);
+                    BLOG_TRACE("Processing character: '%c' (ASCII: %d)\n", c, (int)c);
                     
                     // Convert character to keypress and send
                     uint8_t report[8] = {0};
                     
                     if (c >= 'a' && c <= 'z') {
                         report[2] = 4 + (c - 'a'); // USB HID code for a-z is 4-29
-                        USBSerial.printf("Lowercase letter, HID code: %d\n", report[2]);
+                        BLOG_TRACE("Lowercase letter, HID code: %d\n", report[2]);
                     } else if (c >= 'A' && c <= 'Z') {
                         report[0] = 0x02; // Left shift modifier
                         report[2] = 4 + (c - 'A'); // USB HID code for a-z is 4-29
-                        USBSerial.printf("Uppercase letter, HID code: %d with shift\n", report[2]);
+                        BLOG_TRACE("Uppercase letter, HID code: %d with shift\n", report[2]);
                     } else if (c >= '1' && c <= '9') {
                         report[2] = 30 + (c - '1'); // USB HID code for 1-9 is 30-38
-                        USBSerial.printf("Number 1-9, HID code: %d\n", report[2]);
+                        BLOG_TRACE("Number 1-9, HID code: %d\n", report[2]);
                     } else if (c == '0') {
                         report[2] = 39; // USB HID code for 0 is 39
-                        USBSerial.printf("Zero, HID code: %d\n", report[2]);
+                        BLOG_TRACE("Zero, HID code: %d\n", report[2]);
                     } else if (c == ' ') {
                         report[2] = 44; // USB HID code for space is 44
-                        USBSerial.printf("Space, HID code: %d\n", report[2]);
+                        BLOG_TRACE("Space, HID code: %d\n", report[2]);
                     } else if (c == ',') {
                         report[0] = 0x02; // Left shift modifier
                         report[2] = 54; // USB HID code for comma is 54
-                        USBSerial.printf("Comma, HID code: %d with shift\n", report[2]);
+                        BLOG_TRACE("Comma, HID code: %d with shift\n", report[2]);
                     } else if (c == '.') {
                         report[2] = 55; // USB HID code for period is 55
-                        USBSerial.printf("Period, HID code: %d\n", report[2]);
+                        BLOG_TRACE("Period, HID code: %d\n", report[2]);
                     } else if (c == '!') {
                         report[0] = 0x02; // Left shift modifier
                         report[2] = 30; // USB HID code for 1 is 30
-                        USBSerial.printf("Exclamation mark, HID code: %d with shift\n", report[2]);
+                        BLOG_TRACE("Exclamation mark, HID code: %d with shift\n", report[2]);
                     } else {
-                        USBSerial.printf("Unsupported character: '%c'\n", c);
+                        BLOG_WARN("Unsupported character: '%c'\n", c);
                     }
                     
                     if (report[2] != 0 && hidHandler) {
-                        USBSerial.print("Sending report: ");
-                        for (int j = 0; j < 8; j++) {
-                            USBSerial.printf("0x%02X ", report[j]);
-                        }
-                        USBSerial.println();
+                        BLOG_TRACE("Sending report: 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X 0x%02X\n",
+                                   report[0], report[1], report[2], report[3], report[4], report[5], report[6], report[7]);
                         
                         hidHandler->sendKeyboardReport(report);
                         delay(10); // Small delay between keypresses
                         hidHandler->sendEmptyKeyboardReport();
                         delay(5);
                     } else if (report[2] == 0) {
-                        USBSerial.println("No valid HID code for this character");
+                        BLOG_WARN("No valid HID code for this character\n");
                     } else {
-                        USBSerial.println("Error: HID handler not available");
+                        BLOG_ERROR("Error: HID handler not available\n");
                     }
                 }
             } else {
-                USBSerial.println("Error: Text is null");
+                BLOG_ERROR("Error: Text is null\n");
             }
             break;
         }
             
         case MACRO_CMD_EXECUTE_MACRO: {
             if (cmd.data.executeMacro.macroId) {
-                USBSerial.printf("Ignoring nested macro execution in simplified version: %s\n", 
+                BLOG_WARN("Ignoring nested macro execution in simplified version: %s\n", 
                           cmd.data.executeMacro.macroId);
                 // We don't support nested macros in this simplified version
             }
@@ -728,10 +783,10 @@ void MacroHandler::executeCommand(const MacroCommand& cmd) {
         }
             
         case MACRO_CMD_MOUSE_MOVE: {
-            USBSerial.printf("Moving mouse: x=%d, y=%d, speed=%d\n", 
-                          cmd.data.mouseMove.x, 
-                          cmd.data.mouseMove.y,
-                          cmd.data.mouseMove.speed);
+            BLOG_DEBUG("Moving mouse: x=%d, y=%d, speed=%d\n", 
+                       cmd.data.mouseMove.x, 
+                       cmd.data.mouseMove.y,
+                       cmd.data.mouseMove.speed);
                           
             // Apply the movement with the specified speed
             int speed = cmd.data.mouseMove.speed;
@@ -762,9 +817,9 @@ void MacroHandler::executeCommand(const MacroCommand& cmd) {
         }
             
         case MACRO_CMD_MOUSE_CLICK: {
-            USBSerial.printf("Mouse click: button=%d, clicks=%d\n", 
-                          cmd.data.mouseClick.button, 
-                          cmd.data.mouseClick.clicks);
+            BLOG_DEBUG("Mouse click: button=%d, clicks=%d\n", 
+                       cmd.data.mouseClick.button, 
+                       cmd.data.mouseClick.clicks);
                           
             // Execute single or multiple clicks
             uint8_t button = cmd.data.mouseClick.button;
@@ -780,7 +835,7 @@ void MacroHandler::executeCommand(const MacroCommand& cmd) {
         }
             
         case MACRO_CMD_MOUSE_SCROLL: {
-            USBSerial.printf("Mouse scroll: amount=%d\n", cmd.data.mouseScroll.amount);
+            BLOG_DEBUG("Mouse scroll: amount=%d\n", cmd.data.mouseScroll.amount);
             
             // Scroll the specified amount - USBHIDMouse uses move(x, y, wheel)
             // where wheel is the scroll amount
@@ -789,7 +844,7 @@ void MacroHandler::executeCommand(const MacroCommand& cmd) {
         }
             
         case MACRO_CMD_REPEAT_START: {
-            USBSerial.printf("Starting repeat block: count=%d\n", cmd.data.repeatStart.count);
+            BLOG_DEBUG("Starting repeat block: count=%d\n", cmd.data.repeatStart.count);
             // Handle repeat start
             inRepeat = true;
             repeatCount = cmd.data.repeatStart.count;
@@ -799,12 +854,12 @@ void MacroHandler::executeCommand(const MacroCommand& cmd) {
         }
             
         case MACRO_CMD_REPEAT_END: {
-            USBSerial.println("End of repeat block");
+            BLOG_DEBUG("End of repeat block\n");
             if (inRepeat && currentRepeatCount < repeatCount - 1) {
                 // Jump back to the repeat start command
                 currentRepeatCount++;
-                USBSerial.printf("Repeating block: iteration %d/%d\n", 
-                              currentRepeatCount + 1, repeatCount);
+                BLOG_DEBUG("Repeating block: iteration %d/%d\n", 
+                           currentRepeatCount + 1, repeatCount);
                 currentCommandIndex = repeatStartIndex;
             } else {
                 // Reset repeat state
@@ -821,37 +876,46 @@ void MacroHandler::executeCommand(const MacroCommand& cmd) {
             uint32_t maxTime = cmd.data.randomDelay.maxTime;
             uint32_t randomDelay = random(minTime, maxTime + 1);
             
-            USBSerial.printf("Random delay: %d ms (range: %d-%d ms)\n", 
-                          randomDelay, minTime, maxTime);
+            BLOG_DEBUG("Random delay: %d ms (range: %d-%d ms)\n", 
+                       randomDelay, minTime, maxTime);
                           
             delayUntil = millis() + randomDelay;
             break;
         }
             
         default: {
-            USBSerial.printf("Unknown command type: %d\n", cmd.type);
+            BLOG_WARN("Unknown command type: %d\n", cmd.type);
             break;
         }
     }
 }
 
 bool MacroHandler::deleteMacro(const String& macroId) {
-    // Check if macro exists
-    auto it = macros.find(macroId);
-    if (it == macros.end()) {
-        USBSerial.printf("Macro not found: %s\n", macroId.c_str());
-        return false;
-    }
-    
-    // Free any dynamically allocated memory in the macro
-    for (auto& cmd : it->second.commands) {
-        // Use the helper function to clean up allocated memory
-        cleanupMacroCommand(cmd);
+    {
+        std::lock_guard<std::mutex> step(stepMutex);
+        std::lock_guard<std::mutex> lock(macroMutex);
+        
+        // Check if macro exists
+        auto it = macros.find(macroId);
+        if (it == macros.end()) {
+            USBSerial.printf("Macro not found: %s\n", macroId.c_str());
+            return false;
+        }
+        
+        if (executing && currentMacro == &it->second) {
+            stopExecution();
+        }
+        
+        // Free any dynamically allocated memory in the macro
+        for (auto& cmd : it->second.commands) {
+            // Use the helper function to clean up allocated memory
+            cleanupMacroCommand(cmd);
+        }
+        
+        // Remove from the map
+        macros.erase(it);
     }
     
-    // Remove from the map
-    macros.erase(it);
-    
     // Delete the file
     String macroPath = getMacroFilePath(macroId);
     if (LittleFS.exists(macroPath)) {
@@ -865,6 +929,8 @@ bool MacroHandler::deleteMacro(const String& macroId) {
 }
 
 bool MacroHandler::getMacro(const String& macroId, Macro& macro) {
+    std::lock_guard<std::mutex> lock(macroMutex);
+    
     // Check if macro exists
     auto it = macros.find(macroId);
     if (it == macros.end()) {
@@ -882,6 +948,12 @@ void MacroHandler::update() {
         return;
     }
     
+    std::lock_guard<std::mutex> step(stepMutex);
+    // Stopped by a save, delete or reload since the check above
+    if (!executing) {
+        return;
+    }
+    
     uint32_t currentTime = millis();
     
     // If we're in a delay, wait for it to complete
@@ -890,30 +962,42 @@ void MacroHandler::update() {
             return; // Still waiting
         }
         // Delay completed
-        USBSerial.printf("Delay completed at %lu ms\n", currentTime);
+        BLOG_DEBUG("Delay completed at %lu ms\n", (unsigned long)currentTime);
         delayUntil = 0;
     }
     
-    // Check if we've reached the end of the macro
-    if (currentCommandIndex >= currentMacro.commands.size()) {
-        // Macro complete
-        executing = false;
-        USBSerial.println("Macro execution complete");
-        return;
-    }
+    PowerLock usbLock(POWER_LOCK_USB);
     
-    // Execute the current command
-    USBSerial.printf("Executing command %d of %d\n", 
-                     currentCommandIndex + 1, 
-                     currentMacro.commands.size());
-    
-    const MacroCommand& cmd = currentMacro.commands[currentCommandIndex];
+    // Copy the command out so the HID sends and delays below run without
+    // macroMutex; its text buffers stay valid while stepMutex is held
+    MacroCommand cmd;
+    {
+        std::lock_guard<std::mutex> lock(macroMutex);
+        
+        // Check if we've reached the end of the macro
+        if (currentCommandIndex >= currentMacro->commands.size()) {
+            // Macro complete
+            executing = false;
+            EventBus::publish(EVENT_MACRO, EventBus::hashId(currentMacro->id), 0, 0, currentMacro->id.c_str());
+            currentMacro = nullptr;
+            BLOG_INFO("Macro execution complete\n");
+            return;
+        }
+        
+        // Execute the current command
+        BLOG_DEBUG("Executing command %d of %d\n", 
+                   (int)currentCommandIndex + 1, 
+                   (int)currentMacro->commands.size());
+        
+        cmd = currentMacro->commands[currentCommandIndex];
+    }
     executeCommand(cmd);
+    metricMacroSteps.inc();
     
     // If not in a delay, move to the next command
     if (delayUntil == 0) {
         currentCommandIndex++;
-        USBSerial.printf("Moving to next command: %d\n", currentCommandIndex);
+        BLOG_TRACE("Moving to next command: %d\n", (int)currentCommandIndex);
     }
     
     lastExecTime = currentTime;
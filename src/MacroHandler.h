@@ -6,7 +6,9 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <atomic>
 #include <functional>
+#include <mutex>
 #include <FS.h>
 #include <LittleFS.h>
 #include "HIDHandler.h"
@@ -95,10 +97,21 @@ private:
     // Map to store all loaded macros, keyed by their IDs
     std::map<String, Macro> macros;
     
-    // Currently executing macro (if any)
-    bool executing = false;
+    // Guards macros; held only for map lookups and updates, never across
+    // HID sends or delays
+    std::mutex macroMutex;
+    
+    // Guards the execution state below. update() holds it for a whole step,
+    // so saves, deletes and reloads (web server task) take it before
+    // macroMutex to stop the macro and free command buffers safely
+    std::mutex stepMutex;
+    
+    // Currently executing macro (if any); read by update() before it locks
+    std::atomic<bool> executing{false};
     size_t currentCommandIndex = 0;
-    Macro currentMacro;
+    // Points into macros rather than copying the macro each time one starts;
+    // stopExecution() drops it before that entry is replaced or erased
+    const Macro* currentMacro = nullptr;
     uint32_t lastExecTime = 0;
     uint32_t delayUntil = 0;
     
@@ -124,6 +137,13 @@ private:
     // Helper function to clean up dynamically allocated memory in commands
     void cleanupMacroCommand(MacroCommand& command);
     
+    // Abandon the running macro and release anything it held down.
+    // Call with stepMutex held
+    void stopExecution();
+    
+    // Free the commands' buffers of every macro in the map
+    void clearMacros(std::map<String, Macro>& entries);
+    
 public:
     MacroHandler();
     
@@ -0,0 +1,223 @@
+#include "MemoryPolicy.h"
+#include "MetricsRegistry.h"
+#include <USBCDC.h>
+#include <esp_heap_caps.h>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+MemoryPolicy::ClassStats MemoryPolicy::_classes[ALLOC_CLASS_COUNT];
+MemoryPolicy::Sample* MemoryPolicy::_history = nullptr;
+uint32_t MemoryPolicy::_samples = 0;
+uint32_t MemoryPolicy::_lastSampleMs = 0;
+portMUX_TYPE MemoryPolicy::_mux = portMUX_INITIALIZER_UNLOCKED;
+String MemoryPolicy::_lastError = "";
+
+// Constants
+static const char* CLASS_NAMES[ALLOC_CLASS_COUNT] = {
+    "dma", "internal", "json", "image", "cache"
+};
+static const char* HEAP_NAMES[HEAP_COUNT] = {
+    "internal", "dma", "psram"
+};
+static const uint32_t HEAP_CAPS[HEAP_COUNT] = {
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_DMA,
+    MALLOC_CAP_SPIRAM
+};
+
+// Preferred heap per class; 0 where there is no fallback
+static const uint32_t CLASS_CAPS[ALLOC_CLASS_COUNT] = {
+    MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT
+};
+static const uint32_t CLASS_FALLBACK_CAPS[ALLOC_CLASS_COUNT] = {
+    0,
+    0,
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+    MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT
+};
+
+void MemoryPolicy::begin() {
+    if (_history == nullptr) {
+        _history = (Sample*)allocate(ALLOC_CACHE, MEMORY_HISTORY_SIZE * sizeof(Sample));
+        if (_history == nullptr) {
+            _lastError = "No memory for the heap history";
+            USBSerial.println("MemoryPolicy: " + _lastError);
+        }
+    }
+
+#ifdef BOARD_HAS_PSRAM
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM) == 0) {
+        USBSerial.println("MemoryPolicy: PSRAM not found; PSRAM classes fall back to internal RAM");
+    }
+#endif
+
+    sample();
+}
+
+void* MemoryPolicy::allocate(AllocClass cls, size_t size) {
+    return place(cls, nullptr, size);
+}
+
+void* MemoryPolicy::reallocate(AllocClass cls, void* ptr, size_t size) {
+    return place(cls, ptr, size);
+}
+
+void MemoryPolicy::release(void* ptr) {
+    heap_caps_free(ptr);
+}
+
+void* MemoryPolicy::place(AllocClass cls, void* ptr, size_t size) {
+    if (cls >= ALLOC_CLASS_COUNT) {
+        return nullptr;
+    }
+
+    // heap_caps_realloc moves the block when it is not in a heap with the
+    // requested caps, so a growing buffer ends up where its class belongs
+    void* result = ptr != nullptr ? heap_caps_realloc(ptr, size, CLASS_CAPS[cls])
+                                  : heap_caps_malloc(size, CLASS_CAPS[cls]);
+    bool fallback = false;
+    if (result == nullptr && CLASS_FALLBACK_CAPS[cls] != 0) {
+        result = ptr != nullptr ? heap_caps_realloc(ptr, size, CLASS_FALLBACK_CAPS[cls])
+                                : heap_caps_malloc(size, CLASS_FALLBACK_CAPS[cls]);
+        fallback = result != nullptr;
+    }
+
+    count(cls, size, fallback, result == nullptr);
+    return result;
+}
+
+void MemoryPolicy::count(AllocClass cls, size_t size, bool fallback, bool failed) {
+    portENTER_CRITICAL(&_mux);
+    ClassStats& stats = _classes[cls];
+    stats.allocations++;
+    if (fallback) stats.fallbacks++;
+    if (failed) stats.failures++;
+    if (size > stats.largestRequest) stats.largestRequest = size;
+    portEXIT_CRITICAL(&_mux);
+
+    if (fallback) metricAllocFallbacks.inc();
+    if (failed) metricAllocFailures.inc();
+}
+
+MemoryPolicy::HeapState MemoryPolicy::readHeap(HeapId heap) {
+    HeapState state;
+    state.freeBytes = heap_caps_get_free_size(HEAP_CAPS[heap]);
+    state.largestFreeBlock = heap_caps_get_largest_free_block(HEAP_CAPS[heap]);
+    return state;
+}
+
+void MemoryPolicy::loop() {
+    if (millis() - _lastSampleMs >= MEMORY_SAMPLE_INTERVAL_MS) {
+        sample();
+    }
+}
+
+void MemoryPolicy::sample() {
+    _lastSampleMs = millis();
+    if (_history == nullptr) return;
+
+    Sample& entry = _history[_samples % MEMORY_HISTORY_SIZE];
+    entry.timestampMs = _lastSampleMs;
+    for (int i = 0; i < HEAP_COUNT; i++) {
+        entry.heaps[i] = readHeap((HeapId)i);
+    }
+    _samples++;
+}
+
+void MemoryPolicy::getStatus(JsonObject status) {
+    JsonArray heaps = status.createNestedArray("heaps");
+    for (int i = 0; i < HEAP_COUNT; i++) {
+        HeapState state = readHeap((HeapId)i);
+        JsonObject obj = heaps.createNestedObject();
+        obj["name"] = HEAP_NAMES[i];
+        obj["total"] = heap_caps_get_total_size(HEAP_CAPS[i]);
+        obj["free"] = state.freeBytes;
+        obj["min_free"] = heap_caps_get_minimum_free_size(HEAP_CAPS[i]);
+        obj["largest_free_block"] = state.largestFreeBlock;
+        obj["fragmentation_pct"] = fragmentation(state.freeBytes, state.largestFreeBlock);
+    }
+
+    ClassStats classes[ALLOC_CLASS_COUNT];
+    portENTER_CRITICAL(&_mux);
+    memcpy(classes, _classes, sizeof(classes));
+    portEXIT_CRITICAL(&_mux);
+
+    JsonArray classArray = status.createNestedArray("classes");
+    for (int i = 0; i < ALLOC_CLASS_COUNT; i++) {
+        JsonObject obj = classArray.createNestedObject();
+        obj["name"] = CLASS_NAMES[i];
+        obj["placement"] = CLASS_FALLBACK_CAPS[i] != 0 ? "psram" : "internal";
+        obj["allocations"] = classes[i].allocations;
+        obj["fallbacks"] = classes[i].fallbacks;
+        obj["failures"] = classes[i].failures;
+        obj["largest_request"] = classes[i].largestRequest;
+    }
+
+    // loop() may be writing a sample while the web server reads the ring;
+    // a sample torn by that race is one odd history point
+    status["sample_interval_ms"] = MEMORY_SAMPLE_INTERVAL_MS;
+    JsonArray history = status.createNestedArray("history");
+    if (_history == nullptr) return;
+    uint32_t samples = _samples;
+    uint32_t count = samples < MEMORY_HISTORY_SIZE ? samples : MEMORY_HISTORY_SIZE;
+    for (uint32_t n = 0; n < count; n++) {
+        const Sample& entry = _history[(samples - count + n) % MEMORY_HISTORY_SIZE];
+        JsonObject obj = history.createNestedObject();
+        obj["time_ms"] = entry.timestampMs;
+        for (int i = 0; i < HEAP_COUNT; i++) {
+            // [free, largest free block, fragmentation %] per heap
+            JsonArray heap = obj.createNestedArray(HEAP_NAMES[i]);
+            heap.add(entry.heaps[i].freeBytes);
+            heap.add(entry.heaps[i].largestFreeBlock);
+            heap.add(fragmentation(entry.heaps[i].freeBytes, entry.heaps[i].largestFreeBlock));
+        }
+    }
+}
+
+// ===== BodyBuffer =====
+
+bool BodyBuffer::begin(size_t total) {
+    clear();
+    _data = (char*)MemoryPolicy::allocate(ALLOC_JSON, total + 1);
+    if (_data == nullptr) {
+        _failed = true;
+        return false;
+    }
+    _capacity = total + 1;
+    _data[0] = '\0';
+    return true;
+}
+
+bool BodyBuffer::append(const uint8_t* data, size_t len) {
+    if (_failed) {
+        return false;
+    }
+    if (_length + len + 1 > _capacity) {
+        char* grown = (char*)MemoryPolicy::reallocate(ALLOC_JSON, _data, _length + len + 1);
+        if (grown == nullptr) {
+            clear();
+            _failed = true;
+            return false;
+        }
+        _data = grown;
+        _capacity = _length + len + 1;
+    }
+    memcpy(_data + _length, data, len);
+    _length += len;
+    _data[_length] = '\0';
+    return true;
+}
+
+void BodyBuffer::clear() {
+    MemoryPolicy::release(_data);
+    _data = nullptr;
+    _length = 0;
+    _capacity = 0;
+    _failed = false;
+}
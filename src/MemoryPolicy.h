@@ -0,0 +1,142 @@
+#ifndef MEMORY_POLICY_H
+#define MEMORY_POLICY_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Placement of large buffers by what they are for.
+//
+// Internal RAM is the only memory WiFi, the SPI/USB DMA engines and ISRs can
+// use, and a few long-lived 16-32 KB blocks are enough to split it so that
+// the WiFi driver can no longer get a contiguous buffer. Each allocation
+// class below has a fixed placement: DMA and ISR buffers stay internal,
+// everything bulky goes to PSRAM and only falls back to internal RAM (and is
+// counted as a fallback) when PSRAM is missing or full.
+//
+// Heap state is sampled into a history ring every MEMORY_SAMPLE_INTERVAL_MS
+// so fragmentation can be followed over time rather than read once.
+
+#ifndef MEMORY_SAMPLE_INTERVAL_MS
+#define MEMORY_SAMPLE_INTERVAL_MS 10000
+#endif
+
+// Samples kept; at the default interval, the last ten minutes
+#ifndef MEMORY_HISTORY_SIZE
+#define MEMORY_HISTORY_SIZE 60
+#endif
+
+enum AllocClass {
+    ALLOC_DMA,        // Peripheral DMA and ISR buffers: internal, DMA-capable
+    ALLOC_INTERNAL,   // Buffers touched with the flash cache disabled: internal
+    ALLOC_JSON,       // JSON documents and request bodies: PSRAM first
+    ALLOC_IMAGE,      // Display backgrounds and image data: PSRAM first
+    ALLOC_CACHE,      // Macro and config caches, history rings: PSRAM first
+    ALLOC_CLASS_COUNT
+};
+
+enum HeapId {
+    HEAP_INTERNAL,
+    HEAP_DMA,
+    HEAP_PSRAM,
+    HEAP_COUNT
+};
+
+class MemoryPolicy {
+public:
+    struct HeapState {
+        uint32_t freeBytes;
+        uint32_t largestFreeBlock;
+    };
+
+    // Allocate the history ring and take the first sample
+    static void begin();
+
+    // Placement per AllocClass; nullptr when no allowed heap has room
+    static void* allocate(AllocClass cls, size_t size);
+    static void* reallocate(AllocClass cls, void* ptr, size_t size);
+    static void release(void* ptr);
+
+    // Sample every MEMORY_SAMPLE_INTERVAL_MS; run from loop()
+    static void loop();
+    static void sample();
+
+    static HeapState readHeap(HeapId heap);
+
+    // Share of free memory not usable as one block, 0-100
+    static uint8_t fragmentation(uint32_t freeBytes, uint32_t largestFreeBlock) {
+        if (freeBytes == 0) return 0;
+        return (uint8_t)(100 - (uint64_t)largestFreeBlock * 100 / freeBytes);
+    }
+
+    // Per-class counters, current heaps and the sample history, oldest first
+    static void getStatus(JsonObject status);
+
+    static String getLastError() { return _lastError; }
+
+private:
+    struct ClassStats {
+        uint32_t allocations;
+        uint32_t fallbacks;     // Placed in internal RAM instead of PSRAM
+        uint32_t failures;
+        uint32_t largestRequest;
+    };
+
+    struct Sample {
+        uint32_t timestampMs;
+        HeapState heaps[HEAP_COUNT];
+    };
+
+    static void* place(AllocClass cls, void* ptr, size_t size);
+    static void count(AllocClass cls, size_t size, bool fallback, bool failed);
+
+    static ClassStats _classes[ALLOC_CLASS_COUNT];
+    static Sample* _history;
+    static uint32_t _samples;
+    static uint32_t _lastSampleMs;
+    static portMUX_TYPE _mux;
+    static String _lastError;
+};
+
+// ArduinoJson allocator for the ALLOC_JSON class
+struct PsramJsonAllocator {
+    void* allocate(size_t size) { return MemoryPolicy::allocate(ALLOC_JSON, size); }
+    void deallocate(void* ptr) { MemoryPolicy::release(ptr); }
+    void* reallocate(void* ptr, size_t size) { return MemoryPolicy::reallocate(ALLOC_JSON, ptr, size); }
+};
+
+// For documents of 8 KB and up; small short-lived ones stay DynamicJsonDocument
+typedef BasicJsonDocument<PsramJsonAllocator> PsramJsonDocument;
+
+// A request body gathered across AsyncWebServer chunks, sized once from the
+// request's total length in the ALLOC_JSON class. Replaces String bodies that
+// grew a chunk at a time and then kept their capacity in internal RAM.
+class BodyBuffer {
+public:
+    BodyBuffer() : _data(nullptr), _length(0), _capacity(0), _failed(false) {}
+    ~BodyBuffer() { clear(); }
+
+    // Start a body of total bytes, dropping the previous one
+    bool begin(size_t total);
+    // Append a chunk, growing past total if the client sent more. Once an
+    // allocation fails the body is dropped and ok() stays false until begin()
+    bool append(const uint8_t* data, size_t len);
+    // Free the buffer
+    void clear();
+
+    bool ok() const { return !_failed; }
+
+    // Always NUL-terminated
+    const char* c_str() const { return _data != nullptr ? _data : ""; }
+    size_t length() const { return _length; }
+
+private:
+    BodyBuffer(const BodyBuffer&);
+    BodyBuffer& operator=(const BodyBuffer&);
+
+    char* _data;
+    size_t _length;
+    size_t _capacity;
+    bool _failed;
+};
+
+#endif // MEMORY_POLICY_H
@@ -0,0 +1,189 @@
+#include "MetricsRegistry.h"
+#include "EventBus.h"
+#include "MemoryPolicy.h"
+#include "TaskManager.h"
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+
+// Static member initialization
+Metric* MetricsRegistry::_head = nullptr;
+
+// Latency buckets in microseconds
+const uint32_t METRIC_BUCKETS_US[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000 };
+const size_t METRIC_BUCKETS_US_COUNT = sizeof(METRIC_BUCKETS_US) / sizeof(METRIC_BUCKETS_US[0]);
+
+// Built-in metrics
+MetricHistogram metricScanDuration("macropad_scan_duration_us", "Key matrix scan duration", METRIC_BUCKETS_US, METRIC_BUCKETS_US_COUNT);
+MetricCounter metricKeyEvents("macropad_key_events_total", "Debounced key press and release events");
+MetricCounter metricHidReportsSent("macropad_hid_reports_sent_total", "HID reports accepted by the USB stack");
+MetricCounter metricHidReportsDropped("macropad_hid_reports_dropped_total", "HID reports not delivered (not mounted, busy or rejected)");
+MetricGauge metricHidQueueDepth("macropad_hid_queue_depth", "Pending reports in the HID report queue");
+MetricCounter metricMacroSteps("macropad_macro_steps_total", "Macro commands executed");
+MetricCounter metricEncoderSteps("macropad_encoder_steps_total", "Encoder rotation steps acted on");
+MetricHistogram metricLedFrameTime("macropad_led_frame_us", "LED frame update time", METRIC_BUCKETS_US, METRIC_BUCKETS_US_COUNT);
+MetricCounter metricDisplayFlushBytes("macropad_display_flush_bytes_total", "Bytes of pixel data pushed to the display");
+MetricHistogram metricLoopTime("macropad_loop_time_us", "Arduino loop() iteration time", METRIC_BUCKETS_US, METRIC_BUCKETS_US_COUNT);
+MetricGauge metricFreeHeap("macropad_heap_free_bytes", "Free internal heap");
+MetricGauge metricFreePsram("macropad_psram_free_bytes", "Free PSRAM");
+MetricGauge metricLargestFreeBlock("macropad_heap_largest_free_block_bytes", "Largest allocatable internal heap block");
+MetricGauge metricMinFreeHeap("macropad_heap_min_free_bytes", "Lowest free internal heap since boot");
+MetricGauge metricHeapFragmentation("macropad_heap_fragmentation_percent", "Free internal heap not usable as one block");
+MetricGauge metricPsramLargestFreeBlock("macropad_psram_largest_free_block_bytes", "Largest allocatable PSRAM block");
+MetricGauge metricPsramFragmentation("macropad_psram_fragmentation_percent", "Free PSRAM not usable as one block");
+MetricCounter metricAllocFallbacks("macropad_alloc_fallbacks_total", "PSRAM-class allocations placed in internal RAM");
+MetricCounter metricAllocFailures("macropad_alloc_failures_total", "Allocations that found no heap with room");
+MetricCounter metricBusEventsDropped("macropad_event_bus_dropped_total", "Events dropped because a subscriber queue was full");
+
+Metric::Metric(const char* name, const char* help, Type type)
+    : _name(name), _help(help), _type(type), _next(MetricsRegistry::_head) {
+    // Static construction runs single-threaded before setup()
+    MetricsRegistry::_head = this;
+}
+
+MetricHistogram::MetricHistogram(const char* name, const char* help, const uint32_t* bounds, size_t boundCount)
+    : Metric(name, help, HISTOGRAM), _bounds(bounds),
+      _boundCount(boundCount > MAX_BUCKETS ? MAX_BUCKETS : boundCount), _count(0), _sum(0) {
+    for (size_t i = 0; i <= MAX_BUCKETS; i++) {
+        _buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void MetricHistogram::observe(uint32_t v) {
+    size_t i = 0;
+    while (i < _boundCount && v > _bounds[i]) {
+        i++;
+    }
+    _buckets[i].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(v, std::memory_order_relaxed);
+}
+
+// Runs in the publishing input task, so it only bumps counters
+static void countInputEvent(const BusEvent& event) {
+    if (event.topic == EVENT_KEY) {
+        metricKeyEvents.inc();
+    } else {
+        metricEncoderSteps.inc();
+    }
+}
+
+void MetricsRegistry::begin() {
+    EventBus::subscribe("metrics", EVENT_KEY | EVENT_ENCODER, countInputEvent);
+}
+
+Metric* MetricsRegistry::first() {
+    return _head;
+}
+
+void MetricsRegistry::sampleSystemGauges() {
+    MemoryPolicy::HeapState internal = MemoryPolicy::readHeap(HEAP_INTERNAL);
+    metricFreeHeap.set(internal.freeBytes);
+    metricLargestFreeBlock.set(internal.largestFreeBlock);
+    metricMinFreeHeap.set(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    metricHeapFragmentation.set(MemoryPolicy::fragmentation(internal.freeBytes, internal.largestFreeBlock));
+#ifdef BOARD_HAS_PSRAM
+    MemoryPolicy::HeapState psram = MemoryPolicy::readHeap(HEAP_PSRAM);
+    metricFreePsram.set(psram.freeBytes);
+    metricPsramLargestFreeBlock.set(psram.largestFreeBlock);
+    metricPsramFragmentation.set(MemoryPolicy::fragmentation(psram.freeBytes, psram.largestFreeBlock));
+#endif
+}
+
+String MetricsRegistry::renderPrometheus() {
+    sampleSystemGauges();
+
+    String out;
+    out.reserve(4096);
+    char line[160];
+
+    for (Metric* m = _head; m != nullptr; m = m->next()) {
+        snprintf(line, sizeof(line), "# HELP %s %s\n", m->name(), m->help());
+        out += line;
+
+        switch (m->type()) {
+            case Metric::COUNTER: {
+                MetricCounter* c = static_cast<MetricCounter*>(m);
+                snprintf(line, sizeof(line), "# TYPE %s counter\n%s %u\n", m->name(), m->name(), c->value());
+                out += line;
+                break;
+            }
+            case Metric::GAUGE: {
+                MetricGauge* g = static_cast<MetricGauge*>(m);
+                snprintf(line, sizeof(line), "# TYPE %s gauge\n%s %d\n", m->name(), m->name(), g->value());
+                out += line;
+                break;
+            }
+            case Metric::HISTOGRAM: {
+                MetricHistogram* h = static_cast<MetricHistogram*>(m);
+                snprintf(line, sizeof(line), "# TYPE %s histogram\n", m->name());
+                out += line;
+
+                uint32_t cumulative = 0;
+                for (size_t i = 0; i < h->bucketCount(); i++) {
+                    cumulative += h->bucket(i);
+                    snprintf(line, sizeof(line), "%s_bucket{le=\"%u\"} %u\n", m->name(), h->bound(i), cumulative);
+                    out += line;
+                }
+                cumulative += h->bucket(h->bucketCount());
+                snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %u\n%s_sum %u\n%s_count %u\n",
+                         m->name(), cumulative, m->name(), h->sum(), m->name(), h->count());
+                out += line;
+                break;
+            }
+        }
+    }
+
+    // Stack high-water marks are labelled per task, so they are rendered here
+    out += "# HELP macropad_task_stack_free_bytes Minimum free stack seen per task\n";
+    out += "# TYPE macropad_task_stack_free_bytes gauge\n";
+    for (int i = 0; i < TASK_COUNT; i++) {
+        TaskHandle_t handle = TaskManager::getHandle((ManagedTask)i);
+        if (handle == nullptr) continue;
+        snprintf(line, sizeof(line), "macropad_task_stack_free_bytes{task=\"%s\"} %u\n",
+                 TaskManager::getConfig((ManagedTask)i).name, uxTaskGetStackHighWaterMark(handle));
+        out += line;
+    }
+
+    return out;
+}
+
+String MetricsRegistry::renderJson() {
+    sampleSystemGauges();
+
+    DynamicJsonDocument doc(4096);
+    doc["type"] = "metrics";
+    JsonObject data = doc.createNestedObject("data");
+
+    for (Metric* m = _head; m != nullptr; m = m->next()) {
+        switch (m->type()) {
+            case Metric::COUNTER:
+                data[m->name()] = static_cast<MetricCounter*>(m)->value();
+                break;
+            case Metric::GAUGE:
+                data[m->name()] = static_cast<MetricGauge*>(m)->value();
+                break;
+            case Metric::HISTOGRAM: {
+                MetricHistogram* h = static_cast<MetricHistogram*>(m);
+                JsonObject obj = data.createNestedObject(m->name());
+                obj["count"] = h->count();
+                obj["sum"] = h->sum();
+                JsonArray buckets = obj.createNestedArray("buckets");
+                for (size_t i = 0; i <= h->bucketCount(); i++) {
+                    buckets.add(h->bucket(i));
+                }
+                break;
+            }
+        }
+    }
+
+    JsonObject stacks = data.createNestedObject("macropad_task_stack_free_bytes");
+    for (int i = 0; i < TASK_COUNT; i++) {
+        TaskHandle_t handle = TaskManager::getHandle((ManagedTask)i);
+        if (handle == nullptr) continue;
+        stacks[TaskManager::getConfig((ManagedTask)i).name] = uxTaskGetStackHighWaterMark(handle);
+    }
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
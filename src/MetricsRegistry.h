@@ -0,0 +1,138 @@
+#ifndef METRICS_REGISTRY_H
+#define METRICS_REGISTRY_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Metric instances register themselves at static-init time into an intrusive
+// list, so the hot paths only ever touch a relaxed atomic.
+class Metric {
+public:
+    enum Type {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    Metric(const char* name, const char* help, Type type);
+
+    const char* name() const { return _name; }
+    const char* help() const { return _help; }
+    Type type() const { return _type; }
+    Metric* next() const { return _next; }
+
+private:
+    const char* _name;
+    const char* _help;
+    Type _type;
+    Metric* _next;
+};
+
+// Monotonic counter
+class MetricCounter : public Metric {
+public:
+    MetricCounter(const char* name, const char* help) : Metric(name, help, COUNTER), _value(0) {}
+
+    void inc(uint32_t n = 1) { _value.fetch_add(n, std::memory_order_relaxed); }
+    uint32_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> _value;
+};
+
+// Point-in-time value
+class MetricGauge : public Metric {
+public:
+    MetricGauge(const char* name, const char* help) : Metric(name, help, GAUGE), _value(0) {}
+
+    void set(int32_t v) { _value.store(v, std::memory_order_relaxed); }
+    void add(int32_t n) { _value.fetch_add(n, std::memory_order_relaxed); }
+    int32_t value() const { return _value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int32_t> _value;
+};
+
+// Fixed-bucket histogram; bounds are inclusive upper limits, ascending
+class MetricHistogram : public Metric {
+public:
+    static const size_t MAX_BUCKETS = 12;
+
+    MetricHistogram(const char* name, const char* help, const uint32_t* bounds, size_t boundCount);
+
+    void observe(uint32_t v);
+
+    size_t bucketCount() const { return _boundCount; }
+    uint32_t bound(size_t i) const { return _bounds[i]; }
+    uint32_t bucket(size_t i) const { return _buckets[i].load(std::memory_order_relaxed); }
+    uint32_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint32_t sum() const { return _sum.load(std::memory_order_relaxed); }
+
+private:
+    const uint32_t* _bounds;
+    size_t _boundCount;
+    std::atomic<uint32_t> _buckets[MAX_BUCKETS + 1];  // Last bucket is +Inf
+    std::atomic<uint32_t> _count;
+    std::atomic<uint32_t> _sum;
+};
+
+// Records elapsed microseconds into a histogram when it goes out of scope
+class MetricTimer {
+public:
+    explicit MetricTimer(MetricHistogram& histogram) : _histogram(histogram), _start(micros()) {}
+    ~MetricTimer() { _histogram.observe(micros() - _start); }
+
+private:
+    MetricHistogram& _histogram;
+    uint32_t _start;
+};
+
+class MetricsRegistry {
+public:
+    // Count key and encoder events published on the event bus
+    static void begin();
+
+    // Refresh sampled gauges (heap, PSRAM, stack high-water marks)
+    static void sampleSystemGauges();
+
+    // Render all metrics in Prometheus text exposition format
+    static String renderPrometheus();
+
+    // Render all metrics as a compact JSON object
+    static String renderJson();
+
+    // Head of the registered metric list
+    static Metric* first();
+
+private:
+    friend class Metric;
+    static Metric* _head;
+};
+
+// Latency buckets in microseconds
+extern const uint32_t METRIC_BUCKETS_US[];
+extern const size_t METRIC_BUCKETS_US_COUNT;
+
+// Built-in metrics
+extern MetricHistogram metricScanDuration;
+extern MetricCounter metricKeyEvents;
+extern MetricCounter metricHidReportsSent;
+extern MetricCounter metricHidReportsDropped;
+extern MetricGauge metricHidQueueDepth;
+extern MetricCounter metricMacroSteps;
+extern MetricCounter metricEncoderSteps;
+extern MetricHistogram metricLedFrameTime;
+extern MetricCounter metricDisplayFlushBytes;
+extern MetricHistogram metricLoopTime;
+extern MetricGauge metricFreeHeap;
+extern MetricGauge metricFreePsram;
+extern MetricGauge metricLargestFreeBlock;
+extern MetricGauge metricMinFreeHeap;
+extern MetricGauge metricHeapFragmentation;
+extern MetricGauge metricPsramLargestFreeBlock;
+extern MetricGauge metricPsramFragmentation;
+extern MetricCounter metricAllocFallbacks;
+extern MetricCounter metricAllocFailures;
+extern MetricCounter metricBusEventsDropped;
+
+#endif // METRICS_REGISTRY_H
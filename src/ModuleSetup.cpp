@@ -3,6 +3,8 @@
 #include "FileSystemUtils.h"
 #include "LEDHandler.h"
 #include "JsonUtils.h"
+#include "SpanTrace.h"
+#include "MemoryPolicy.h"
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <USB.h>
@@ -63,7 +65,7 @@ bool processComponentsJson(const String& jsonStr) {
     size_t bufferSize = estimateJsonBufferSize(jsonStr);
     
     // Create document with calculated size
-    DynamicJsonDocument doc(bufferSize);
+    PsramJsonDocument doc(bufferSize);
     DeserializationError error = deserializeJson(doc, jsonStr);
     
     // Debug memory after allocation
@@ -97,7 +99,7 @@ bool parseActionsJson(const String& jsonStr) {
     size_t bufferSize = estimateJsonBufferSize(jsonStr, 1.8);
     
     // Create document with calculated size
-    DynamicJsonDocument doc(bufferSize);
+    PsramJsonDocument doc(bufferSize);
     DeserializationError error = deserializeJson(doc, jsonStr);
     
     // Debug memory after allocation
@@ -138,12 +140,13 @@ bool writeJsonFile(const char* filePath, const String& content) {
         return false;
     }
     
+    SpanScope writeSpan(SPAN_FLASH_WRITE, content.length());
     return FileSystemUtils::writeFile(filePath, content);
 }
 
 // Count components of a specific type
 uint8_t countComponentsByType(const String& componentsJson, const char* componentType) {
-    DynamicJsonDocument doc(8192);
+    PsramJsonDocument doc(8192);
     DeserializationError error = deserializeJson(doc, componentsJson);
     
     if (error) {
@@ -305,7 +308,7 @@ void initializeModuleInfo() {
     moduleInfo.hasDisplay = countComponentsByType(moduleInfo.componentsJson, "display") > 0;
     
     // Count LEDs
-    DynamicJsonDocument ledsDoc(8192);
+    PsramJsonDocument ledsDoc(8192);
     DeserializationError error = deserializeJson(ledsDoc, moduleInfo.ledsJson);
     if (!error) {
         JsonArray leds = ledsDoc["leds"]["config"].as<JsonArray>();
@@ -351,8 +354,8 @@ void initializeModuleInfo() {
 bool mergeConfigFiles() {
     // Parse individual configuration files
     DynamicJsonDocument infoDoc(4096);
-    DynamicJsonDocument componentsDoc(8192);
-    DynamicJsonDocument ledsDoc(8192);
+    PsramJsonDocument componentsDoc(8192);
+    PsramJsonDocument ledsDoc(8192);
     
     DeserializationError infoError = deserializeJson(infoDoc, moduleInfo.infoJson);
     DeserializationError componentsError = deserializeJson(componentsDoc, moduleInfo.componentsJson);
@@ -364,7 +367,7 @@ bool mergeConfigFiles() {
     }
     
     // Create merged configuration document
-    DynamicJsonDocument configDoc(16384);
+    PsramJsonDocument configDoc(16384);
     
     // Set ID as the ESP32's MAC address
     configDoc["id"] = moduleInfo.macAddress;
@@ -482,7 +485,7 @@ bool loadModuleConfiguration() {
         return false;
     }
     
-    DynamicJsonDocument doc(16384);
+    PsramJsonDocument doc(16384);
     DeserializationError error = deserializeJson(doc, configJson);
     
     if (error) {
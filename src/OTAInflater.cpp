@@ -0,0 +1,212 @@
+#include "OTAInflater.h"
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <algorithm>
+#if __has_include(<esp32s3/rom/miniz.h>)
+#include <esp32s3/rom/miniz.h>
+#else
+#include <rom/miniz.h>
+#endif
+
+// Static member initialization
+OTAStreamSink OTAInflater::_sink = nullptr;
+void* OTAInflater::_decompressor = nullptr;
+uint8_t* OTAInflater::_window = nullptr;
+size_t OTAInflater::_windowOffset = 0;
+uint8_t* OTAInflater::_header = nullptr;
+size_t OTAInflater::_headerLength = 0;
+size_t OTAInflater::_outputSize = 0;
+uint32_t OTAInflater::_crc = 0;
+uint8_t OTAInflater::_tail[8] = {};
+size_t OTAInflater::_inputSize = 0;
+OTAInflater::State OTAInflater::_state = OTAInflater::STATE_ERROR;
+String OTAInflater::_lastError = "";
+
+// Constants
+static const size_t MAX_HEADER_SIZE = 512;  // Fixed fields plus file name/comment
+static const uint8_t GZIP_FHCRC = 0x02;
+static const uint8_t GZIP_FEXTRA = 0x04;
+static const uint8_t GZIP_FNAME = 0x08;
+static const uint8_t GZIP_FCOMMENT = 0x10;
+
+static uint32_t readLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool OTAInflater::begin(OTAStreamSink sink) {
+    end();
+    _sink = sink;
+
+    // The decompressor's tables are hit on every symbol, so keep them internal
+    _decompressor = heap_caps_malloc(sizeof(tinfl_decompressor), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    _window = (uint8_t*)heap_caps_malloc(TINFL_LZ_DICT_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (_window == nullptr) {
+        _window = (uint8_t*)heap_caps_malloc(TINFL_LZ_DICT_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    _header = (uint8_t*)malloc(MAX_HEADER_SIZE);
+    if (_sink == nullptr || _decompressor == nullptr || _window == nullptr || _header == nullptr) {
+        end();
+        _lastError = "Not enough memory to decompress update";
+        return false;
+    }
+
+    tinfl_init((tinfl_decompressor*)_decompressor);
+    _windowOffset = 0;
+    _headerLength = 0;
+    _outputSize = 0;
+    _crc = 0;
+    memset(_tail, 0, sizeof(_tail));
+    _inputSize = 0;
+    _state = STATE_HEADER;
+    _lastError = "";
+    return true;
+}
+
+bool OTAInflater::write(const uint8_t* data, size_t length) {
+    if (_state == STATE_ERROR) return false;
+    if (length == 0) return true;
+
+    // The gzip trailer is the last 8 bytes of the stream; track them here
+    // instead of relying on where the inflater stops reading
+    if (length >= sizeof(_tail)) {
+        memcpy(_tail, data + length - sizeof(_tail), sizeof(_tail));
+    } else {
+        memmove(_tail, _tail + length, sizeof(_tail) - length);
+        memcpy(_tail + sizeof(_tail) - length, data, length);
+    }
+    _inputSize += length;
+
+    if (_state == STATE_HEADER) {
+        size_t n = std::min(length, MAX_HEADER_SIZE - _headerLength);
+        memcpy(_header + _headerLength, data, n);
+        _headerLength += n;
+        data += n;
+        length -= n;
+
+        int headerSize = parseHeader();
+        if (headerSize < 0) {
+            return fail("Not a gzip image");
+        }
+        if (headerSize == 0) {
+            return _headerLength < MAX_HEADER_SIZE ? true : fail("gzip header too long");
+        }
+
+        // Whatever followed the header is already deflate data
+        _state = STATE_INFLATE;
+        if (!inflate(_header + headerSize, _headerLength - headerSize)) {
+            return false;
+        }
+    }
+
+    if (_state == STATE_INFLATE) {
+        return inflate(data, length);
+    }
+
+    // STATE_DONE: only the trailer remains
+    return true;
+}
+
+bool OTAInflater::finish() {
+    if (_state != STATE_DONE) {
+        return fail(_state == STATE_ERROR ? _lastError : "Compressed image is truncated");
+    }
+
+    if (_inputSize < sizeof(_tail) || readLE32(_tail) != _crc) {
+        return fail("gzip CRC mismatch");
+    }
+    if (readLE32(_tail + 4) != (uint32_t)_outputSize) {
+        return fail("gzip length mismatch");
+    }
+    return true;
+}
+
+void OTAInflater::end() {
+    if (_decompressor != nullptr) {
+        heap_caps_free(_decompressor);
+        _decompressor = nullptr;
+    }
+    if (_window != nullptr) {
+        heap_caps_free(_window);
+        _window = nullptr;
+    }
+    if (_header != nullptr) {
+        free(_header);
+        _header = nullptr;
+    }
+}
+
+int OTAInflater::parseHeader() {
+    // Fixed part: magic, method (8 = deflate), flags, mtime, xfl, os
+    if (_headerLength < 10) {
+        return (_headerLength >= 1 && _header[0] != 0x1f) || (_headerLength >= 2 && _header[1] != 0x8b) ? -1 : 0;
+    }
+    if (_header[0] != 0x1f || _header[1] != 0x8b || _header[2] != 8) {
+        return -1;
+    }
+
+    uint8_t flags = _header[3];
+    size_t pos = 10;
+
+    if (flags & GZIP_FEXTRA) {
+        if (_headerLength < pos + 2) return 0;
+        pos += 2 + (_header[pos] | (_header[pos + 1] << 8));
+    }
+    if (flags & GZIP_FNAME) {
+        while (pos < _headerLength && _header[pos] != 0) pos++;
+        if (pos++ >= _headerLength) return 0;
+    }
+    if (flags & GZIP_FCOMMENT) {
+        while (pos < _headerLength && _header[pos] != 0) pos++;
+        if (pos++ >= _headerLength) return 0;
+    }
+    if (flags & GZIP_FHCRC) {
+        pos += 2;
+    }
+
+    return pos <= _headerLength ? (int)pos : 0;
+}
+
+bool OTAInflater::inflate(const uint8_t* data, size_t length) {
+    tinfl_decompressor* decompressor = (tinfl_decompressor*)_decompressor;
+
+    while (true) {
+        size_t inBytes = length;
+        size_t outBytes = TINFL_LZ_DICT_SIZE - _windowOffset;
+        tinfl_status status = tinfl_decompress(decompressor, data, &inBytes, _window, _window + _windowOffset,
+                                               &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+        data += inBytes;
+        length -= inBytes;
+
+        // Output lands in the circular window; forward it before it is reused
+        if (outBytes > 0) {
+            if (!emit(_window + _windowOffset, outBytes)) {
+                return false;
+            }
+            _windowOffset = (_windowOffset + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            return fail("Corrupt compressed image");
+        }
+        if (status == TINFL_STATUS_DONE) {
+            _state = STATE_DONE;
+            return true;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            return true;
+        }
+        // TINFL_STATUS_HAS_MORE_OUTPUT: the window filled up, go round again
+    }
+}
+
+bool OTAInflater::emit(const uint8_t* data, size_t length) {
+    _crc = esp_rom_crc32_le(_crc, data, length);
+    _outputSize += length;
+    return _sink(data, length) ? true : fail("Failed to write inflated data");
+}
+
+bool OTAInflater::fail(const String& error) {
+    _lastError = error;
+    _state = STATE_ERROR;
+    return false;
+}
@@ -0,0 +1,56 @@
+#ifndef OTA_INFLATER_H
+#define OTA_INFLATER_H
+
+#include <Arduino.h>
+#include "OTAPipeline.h"
+
+// Streams a gzip-compressed firmware image through the ROM inflater
+// (miniz tinfl) into the next stage. RAM use is fixed: the 32 KB deflate
+// window and the decompressor state, whatever the image size.
+class OTAInflater {
+public:
+    // Allocate the inflater; output goes to sink
+    static bool begin(OTAStreamSink sink);
+
+    // Inflate compressed bytes and pass the output on
+    static bool write(const uint8_t* data, size_t length);
+
+    // Check the stream ended and its gzip CRC-32 and length
+    static bool finish();
+
+    // Release all buffers
+    static void end();
+
+    // Uncompressed bytes produced so far
+    static size_t getOutputSize() { return _outputSize; }
+
+    static String getLastError() { return _lastError; }
+
+private:
+    enum State {
+        STATE_HEADER,
+        STATE_INFLATE,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    static int parseHeader();
+    static bool inflate(const uint8_t* data, size_t length);
+    static bool emit(const uint8_t* data, size_t length);
+    static bool fail(const String& error);
+
+    static OTAStreamSink _sink;
+    static void* _decompressor;
+    static uint8_t* _window;
+    static size_t _windowOffset;
+    static uint8_t* _header;
+    static size_t _headerLength;
+    static size_t _outputSize;
+    static uint32_t _crc;
+    static uint8_t _tail[8];
+    static size_t _inputSize;
+    static State _state;
+    static String _lastError;
+};
+
+#endif // OTA_INFLATER_H
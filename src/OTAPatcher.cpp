@@ -0,0 +1,259 @@
+#include "OTAPatcher.h"
+#include <algorithm>
+
+// Static member initialization
+OTASourceReader OTAPatcher::_source = nullptr;
+size_t OTAPatcher::_sourceCapacity = 0;
+OTAStreamSink OTAPatcher::_sink = nullptr;
+uint8_t* OTAPatcher::_cache = nullptr;
+size_t OTAPatcher::_cacheOffset = 0;
+size_t OTAPatcher::_cacheLength = 0;
+uint8_t* OTAPatcher::_output = nullptr;
+uint8_t OTAPatcher::_field[44] = {};
+size_t OTAPatcher::_fieldLength = 0;
+size_t OTAPatcher::_sourceSize = 0;
+size_t OTAPatcher::_targetSize = 0;
+size_t OTAPatcher::_sourceOffset = 0;
+size_t OTAPatcher::_remaining = 0;
+size_t OTAPatcher::_outputSize = 0;
+bool OTAPatcher::_sourceMismatch = false;
+OTAPatcher::State OTAPatcher::_state = OTAPatcher::STATE_ERROR;
+String OTAPatcher::_lastError = "";
+
+// Constants
+static const size_t HEADER_SIZE = 44;
+static const uint8_t OP_END = 0;
+static const uint8_t OP_ADD = 1;     // u32 source offset, u32 length
+static const uint8_t OP_INSERT = 2;  // u32 length
+
+static uint32_t readLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool OTAPatcher::begin(OTASourceReader source, size_t sourceCapacity, OTAStreamSink sink) {
+    end();
+    _source = source;
+    _sourceCapacity = sourceCapacity;
+    _sink = sink;
+    _sourceMismatch = false;
+    _lastError = "";
+
+    _cache = (uint8_t*)malloc(OTA_PATCH_SOURCE_CACHE);
+    _output = (uint8_t*)malloc(OTA_PATCH_OUTPUT_SIZE);
+    if (_source == nullptr || _sink == nullptr || _cache == nullptr || _output == nullptr) {
+        end();
+        _lastError = "Not enough memory to apply patch";
+        return false;
+    }
+
+    _cacheOffset = 0;
+    _cacheLength = 0;
+    _fieldLength = 0;
+    _sourceSize = 0;
+    _targetSize = 0;
+    _sourceOffset = 0;
+    _remaining = 0;
+    _outputSize = 0;
+    _state = STATE_HEADER;
+    return true;
+}
+
+bool OTAPatcher::write(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        switch (_state) {
+            case STATE_HEADER: {
+                size_t n = std::min(length, HEADER_SIZE - _fieldLength);
+                memcpy(_field + _fieldLength, data, n);
+                _fieldLength += n;
+                data += n;
+                length -= n;
+                if (_fieldLength < HEADER_SIZE) {
+                    return true;
+                }
+
+                if (memcmp(_field, "MPD1", 4) != 0) {
+                    return fail("Not a delta patch");
+                }
+                _sourceSize = readLE32(_field + 4);
+                _targetSize = readLE32(_field + 40);
+                if (!verifySource()) {
+                    return false;
+                }
+                _fieldLength = 0;
+                _state = STATE_OP;
+                break;
+            }
+
+            case STATE_OP: {
+                // The op byte decides how many operand bytes follow
+                if (_fieldLength == 0) {
+                    _field[_fieldLength++] = *data++;
+                    length--;
+                }
+                size_t need = _field[0] == OP_ADD ? 9 : _field[0] == OP_INSERT ? 5 : 1;
+                size_t n = std::min(length, need - _fieldLength);
+                memcpy(_field + _fieldLength, data, n);
+                _fieldLength += n;
+                data += n;
+                length -= n;
+                if (_fieldLength == need && !startOp()) {
+                    return false;
+                }
+                break;
+            }
+
+            case STATE_ADD: {
+                size_t n = std::min(length, _remaining);
+                if (!addDiff(data, n)) {
+                    return false;
+                }
+                data += n;
+                length -= n;
+                _remaining -= n;
+                if (_remaining == 0) _state = STATE_OP;
+                break;
+            }
+
+            case STATE_INSERT: {
+                size_t n = std::min(length, _remaining);
+                if (!emit(data, n)) {
+                    return false;
+                }
+                data += n;
+                length -= n;
+                _remaining -= n;
+                if (_remaining == 0) _state = STATE_OP;
+                break;
+            }
+
+            case STATE_DONE:
+                return fail("Data after end of patch");
+
+            case STATE_ERROR:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool OTAPatcher::finish() {
+    if (_state == STATE_ERROR) {
+        return false;
+    }
+    if (_state != STATE_DONE) {
+        return fail("Patch is truncated");
+    }
+    if (_outputSize != _targetSize) {
+        return fail("Patched image has the wrong size");
+    }
+    return true;
+}
+
+void OTAPatcher::end() {
+    if (_cache != nullptr) {
+        free(_cache);
+        _cache = nullptr;
+    }
+    if (_output != nullptr) {
+        free(_output);
+        _output = nullptr;
+    }
+}
+
+bool OTAPatcher::verifySource() {
+    // A patch only makes sense against the exact image it was built from
+    if (_sourceSize == 0 || _sourceSize > _sourceCapacity) {
+        _sourceMismatch = true;
+        return fail("Patch was made for different firmware");
+    }
+
+    SHA256Hasher hasher;
+    hasher.begin();
+    for (size_t offset = 0; offset < _sourceSize; offset += OTA_PATCH_SOURCE_CACHE) {
+        size_t n = std::min((size_t)OTA_PATCH_SOURCE_CACHE, _sourceSize - offset);
+        if (!_source(offset, _cache, n)) {
+            return fail("Failed to read running firmware");
+        }
+        hasher.add(_cache, n);
+    }
+    hasher.calculate();
+    _cacheLength = 0;
+
+    if (memcmp(hasher.getBytes(), _field + 8, SHA256Hasher::DIGEST_SIZE) != 0) {
+        _sourceMismatch = true;
+        return fail("Patch was made for different firmware");
+    }
+    return true;
+}
+
+bool OTAPatcher::startOp() {
+    uint8_t op = _field[0];
+    _fieldLength = 0;
+
+    if (op == OP_END) {
+        _state = STATE_DONE;
+        return true;
+    }
+
+    if (op == OP_ADD) {
+        _sourceOffset = readLE32(_field + 1);
+        _remaining = readLE32(_field + 5);
+        if (_remaining > _sourceSize || _sourceOffset > _sourceSize - _remaining) {
+            return fail("Patch reads past the source image");
+        }
+        _state = STATE_ADD;
+    } else if (op == OP_INSERT) {
+        _remaining = readLE32(_field + 1);
+        _state = STATE_INSERT;
+    } else {
+        return fail("Unknown patch operation " + String(op));
+    }
+
+    if (_remaining > _targetSize - _outputSize) {
+        return fail("Patch writes past the target image");
+    }
+    if (_remaining == 0) {
+        _state = STATE_OP;
+    }
+    return true;
+}
+
+bool OTAPatcher::addDiff(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        // Slide the source window forward; ops mostly read sequentially
+        if (_sourceOffset < _cacheOffset || _sourceOffset >= _cacheOffset + _cacheLength) {
+            _cacheOffset = _sourceOffset;
+            _cacheLength = std::min((size_t)OTA_PATCH_SOURCE_CACHE, _sourceSize - _sourceOffset);
+            if (!_source(_cacheOffset, _cache, _cacheLength)) {
+                _cacheLength = 0;
+                return fail("Failed to read running firmware");
+            }
+        }
+
+        const uint8_t* source = _cache + (_sourceOffset - _cacheOffset);
+        size_t n = std::min(length, _cacheOffset + _cacheLength - _sourceOffset);
+        n = std::min(n, (size_t)OTA_PATCH_OUTPUT_SIZE);
+        for (size_t i = 0; i < n; i++) {
+            _output[i] = (uint8_t)(source[i] + data[i]);
+        }
+        if (!emit(_output, n)) {
+            return false;
+        }
+
+        _sourceOffset += n;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool OTAPatcher::emit(const uint8_t* data, size_t length) {
+    _outputSize += length;
+    return _sink(data, length) ? true : fail("Failed to write patched data");
+}
+
+bool OTAPatcher::fail(const String& error) {
+    _lastError = error;
+    _state = STATE_ERROR;
+    return false;
+}
@@ -0,0 +1,87 @@
+#ifndef OTA_PATCHER_H
+#define OTA_PATCHER_H
+
+#include <Arduino.h>
+#include "OTAPipeline.h"
+#include "SHA256Hasher.h"
+
+// Source window and output staging sizes
+#ifndef OTA_PATCH_SOURCE_CACHE
+#define OTA_PATCH_SOURCE_CACHE 4096
+#endif
+#ifndef OTA_PATCH_OUTPUT_SIZE
+#define OTA_PATCH_OUTPUT_SIZE 4096
+#endif
+
+// Reads `length` bytes of the source image (the running partition on the
+// device, an image file on the host)
+typedef bool (*OTASourceReader)(size_t offset, uint8_t* buffer, size_t length);
+
+// Applies a delta patch (format "MPD1", see scripts/make_delta.py) against
+// the running firmware as the patch streams in. Output goes to the next
+// stage. RAM use is two small fixed buffers regardless of image size.
+//
+// Patch layout (little-endian):
+//   header  "MPD1", u32 source size, u8[32] source SHA-256, u32 target size
+//   ops     u8 1, u32 source offset, u32 length, length diff bytes
+//             (target byte = source byte + diff byte, mod 256)
+//           u8 2, u32 length, length literal bytes
+//           u8 0 (end)
+class OTAPatcher {
+public:
+    // Start applying a patch; sourceCapacity bounds the readable source
+    static bool begin(OTASourceReader source, size_t sourceCapacity, OTAStreamSink sink);
+
+    // Feed patch bytes
+    static bool write(const uint8_t* data, size_t length);
+
+    // Check the patch ended and produced the announced size
+    static bool finish();
+
+    // Release all buffers
+    static void end();
+
+    // True when the patch was made against different firmware
+    static bool isSourceMismatch() { return _sourceMismatch; }
+
+    // Patched bytes produced so far
+    static size_t getOutputSize() { return _outputSize; }
+
+    static String getLastError() { return _lastError; }
+
+private:
+    enum State {
+        STATE_HEADER,
+        STATE_OP,
+        STATE_ADD,
+        STATE_INSERT,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    static bool verifySource();
+    static bool startOp();
+    static bool addDiff(const uint8_t* data, size_t length);
+    static bool emit(const uint8_t* data, size_t length);
+    static bool fail(const String& error);
+
+    static OTASourceReader _source;
+    static size_t _sourceCapacity;
+    static OTAStreamSink _sink;
+    static uint8_t* _cache;
+    static size_t _cacheOffset;
+    static size_t _cacheLength;
+    static uint8_t* _output;
+    static uint8_t _field[44];
+    static size_t _fieldLength;
+    static size_t _sourceSize;
+    static size_t _targetSize;
+    static size_t _sourceOffset;
+    static size_t _remaining;
+    static size_t _outputSize;
+    static bool _sourceMismatch;
+    static State _state;
+    static String _lastError;
+};
+
+#endif // OTA_PATCHER_H
@@ -0,0 +1,291 @@
+#include "OTAPipeline.h"
+#include "TaskManager.h"
+#include <Update.h>
+#include <USBCDC.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+QueueHandle_t OTAPipeline::_freeQueue = nullptr;
+QueueHandle_t OTAPipeline::_filledQueue = nullptr;
+SemaphoreHandle_t OTAPipeline::_doneSemaphore = nullptr;
+uint8_t* OTAPipeline::_buffers[OTA_PIPELINE_BUFFERS] = {};
+size_t OTAPipeline::_bufferSize = 0;
+uint8_t OTAPipeline::_bufferCount = 0;
+uint8_t* OTAPipeline::_writeBuffer = nullptr;
+size_t OTAPipeline::_writeCapacity = 0;
+size_t OTAPipeline::_writeFill = 0;
+bool OTAPipeline::_psram = false;
+OTAHashFunction OTAPipeline::_hash = nullptr;
+volatile bool OTAPipeline::_active = false;
+volatile bool OTAPipeline::_failed = false;
+volatile size_t OTAPipeline::_bytesWritten = 0;
+uint64_t OTAPipeline::_startUs = 0;
+uint64_t OTAPipeline::_endUs = 0;
+uint64_t OTAPipeline::_readerWaitUs = 0;
+uint64_t OTAPipeline::_hashUs = 0;
+volatile uint64_t OTAPipeline::_writerIdleUs = 0;
+volatile uint64_t OTAPipeline::_flashUs = 0;
+String OTAPipeline::_lastError = "";
+
+// Constants
+static const uint8_t INTERNAL_BUFFERS = 2;        // Double buffering when PSRAM is missing
+static const size_t INTERNAL_BUFFER_SIZE = 4096;  // One flash sector
+static const uint32_t WRITER_STACK_SIZE = 4096;
+static const TickType_t ACQUIRE_POLL_TICKS = pdMS_TO_TICKS(100);
+
+bool OTAPipeline::begin(OTAHashFunction hash) {
+    if (_active) {
+        _lastError = "Pipeline already running";
+        return false;
+    }
+
+    _hash = hash;
+    _failed = false;
+    _bytesWritten = 0;
+    _readerWaitUs = 0;
+    _hashUs = 0;
+    _writerIdleUs = 0;
+    _flashUs = 0;
+    _lastError = "";
+    _writeBuffer = nullptr;
+    _writeFill = 0;
+
+    // Prefer PSRAM so the pool does not compete with the WiFi stack
+    _bufferCount = 0;
+    _bufferSize = OTA_PIPELINE_BUFFER_SIZE;
+    _psram = true;
+    for (uint8_t i = 0; i < OTA_PIPELINE_BUFFERS; i++) {
+        _buffers[i] = (uint8_t*)heap_caps_malloc(_bufferSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (_buffers[i] == nullptr) break;
+        _bufferCount++;
+    }
+    if (_bufferCount < 2) {
+        for (uint8_t i = 0; i < _bufferCount; i++) {
+            heap_caps_free(_buffers[i]);
+            _buffers[i] = nullptr;
+        }
+        _bufferCount = 0;
+        _bufferSize = INTERNAL_BUFFER_SIZE;
+        _psram = false;
+        for (uint8_t i = 0; i < INTERNAL_BUFFERS && i < OTA_PIPELINE_BUFFERS; i++) {
+            _buffers[i] = (uint8_t*)heap_caps_malloc(_bufferSize, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (_buffers[i] == nullptr) break;
+            _bufferCount++;
+        }
+    }
+    if (_bufferCount < 2) {
+        _lastError = "Not enough memory for update buffers";
+        release();
+        return false;
+    }
+
+    // The filled queue has room for the end-of-stream marker on top of every buffer
+    _freeQueue = xQueueCreate(_bufferCount, sizeof(uint8_t*));
+    _filledQueue = xQueueCreate(_bufferCount + 1, sizeof(Block));
+    _doneSemaphore = xSemaphoreCreateBinary();
+    if (_freeQueue == nullptr || _filledQueue == nullptr || _doneSemaphore == nullptr) {
+        _lastError = "Failed to create update queues";
+        release();
+        return false;
+    }
+    for (uint8_t i = 0; i < _bufferCount; i++) {
+        xQueueSend(_freeQueue, &_buffers[i], 0);
+    }
+
+    _startUs = esp_timer_get_time();
+    _endUs = 0;
+
+    // Flash writes stall both cores' caches regardless of placement; pinning
+    // next to the network stack keeps the input core's latency untouched
+    if (xTaskCreatePinnedToCore(writerTask, "ota_writer", WRITER_STACK_SIZE, nullptr,
+                                OTA_WRITER_PRIORITY, nullptr, NETWORK_TASK_CORE) != pdPASS) {
+        _lastError = "Failed to start update writer";
+        release();
+        return false;
+    }
+
+    _active = true;
+    USBSerial.printf("OTA pipeline: %u x %u byte buffers in %s\n",
+                     _bufferCount, (unsigned)_bufferSize, _psram ? "PSRAM" : "internal RAM");
+    return true;
+}
+
+uint8_t* OTAPipeline::acquire(size_t& capacity) {
+    capacity = 0;
+    if (!_active) return nullptr;
+
+    uint64_t waitStart = esp_timer_get_time();
+    uint8_t* buffer = nullptr;
+    while (!_failed) {
+        if (xQueueReceive(_freeQueue, &buffer, ACQUIRE_POLL_TICKS) == pdTRUE) {
+            break;
+        }
+    }
+    _readerWaitUs += esp_timer_get_time() - waitStart;
+
+    if (_failed) {
+        // Hand the buffer back so finish()/abort() can account for it
+        if (buffer != nullptr) xQueueSend(_freeQueue, &buffer, 0);
+        return nullptr;
+    }
+
+    capacity = _bufferSize;
+    return buffer;
+}
+
+bool OTAPipeline::submit(uint8_t* buffer, size_t length) {
+    if (!_active || buffer == nullptr) return false;
+
+    // Hash here, on the reader, while the writer is busy with the previous buffer
+    if (_hash != nullptr && length > 0) {
+        uint64_t hashStart = esp_timer_get_time();
+        _hash(buffer, length);
+        _hashUs += esp_timer_get_time() - hashStart;
+    }
+
+    Block block = { buffer, length };
+    xQueueSend(_filledQueue, &block, portMAX_DELAY);
+    return !_failed;
+}
+
+bool OTAPipeline::write(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        if (_writeBuffer == nullptr) {
+            _writeBuffer = acquire(_writeCapacity);
+            if (_writeBuffer == nullptr) return false;
+            _writeFill = 0;
+        }
+
+        size_t n = std::min(length, _writeCapacity - _writeFill);
+        memcpy(_writeBuffer + _writeFill, data, n);
+        _writeFill += n;
+        data += n;
+        length -= n;
+
+        if (_writeFill == _writeCapacity) {
+            uint8_t* full = _writeBuffer;
+            _writeBuffer = nullptr;
+            if (!submit(full, _writeFill)) return false;
+        }
+    }
+    return true;
+}
+
+bool OTAPipeline::finish() {
+    if (!_active) return false;
+
+    if (_writeBuffer != nullptr) {
+        uint8_t* partial = _writeBuffer;
+        _writeBuffer = nullptr;
+        if (_writeFill > 0) {
+            submit(partial, _writeFill);
+        } else {
+            xQueueSend(_freeQueue, &partial, 0);
+        }
+    }
+
+    Block endOfStream = { nullptr, 0 };
+    xQueueSend(_filledQueue, &endOfStream, portMAX_DELAY);
+    xSemaphoreTake(_doneSemaphore, portMAX_DELAY);
+    _endUs = esp_timer_get_time();
+
+    bool ok = !_failed;
+    release();
+
+    Stats stats = getStats();
+    USBSerial.printf("OTA pipeline: %u bytes in %u ms (%u B/s), reader wait %u ms, writer idle %u ms, flash %u ms, hash %u ms\n",
+                     stats.bytesWritten, stats.elapsedMs, stats.bytesPerSecond, stats.readerWaitMs,
+                     stats.writerIdleMs, stats.flashMs, stats.hashMs);
+    return ok;
+}
+
+void OTAPipeline::abort() {
+    if (!_active) {
+        release();
+        return;
+    }
+
+    // The writer drains the remaining buffers without flashing them
+    _failed = true;
+    Block endOfStream = { nullptr, 0 };
+    xQueueSend(_filledQueue, &endOfStream, portMAX_DELAY);
+    xSemaphoreTake(_doneSemaphore, portMAX_DELAY);
+    _endUs = esp_timer_get_time();
+    release();
+}
+
+OTAPipeline::Stats OTAPipeline::getStats() {
+    Stats stats;
+    uint64_t endUs = _endUs != 0 ? _endUs : (_active ? esp_timer_get_time() : _startUs);
+    uint64_t elapsedUs = endUs > _startUs ? endUs - _startUs : 0;
+
+    stats.bytesWritten = _bytesWritten;
+    stats.elapsedMs = (uint32_t)(elapsedUs / 1000);
+    stats.readerWaitMs = (uint32_t)(_readerWaitUs / 1000);
+    stats.writerIdleMs = (uint32_t)(_writerIdleUs / 1000);
+    stats.flashMs = (uint32_t)(_flashUs / 1000);
+    stats.hashMs = (uint32_t)(_hashUs / 1000);
+    stats.bytesPerSecond = elapsedUs > 0 ? (uint32_t)((uint64_t)_bytesWritten * 1000000ULL / elapsedUs) : 0;
+    stats.buffers = _bufferCount;
+    stats.bufferSize = _bufferSize;
+    stats.psram = _psram;
+    return stats;
+}
+
+void OTAPipeline::writerTask(void* param) {
+    Block block;
+    while (true) {
+        uint64_t waitStart = esp_timer_get_time();
+        xQueueReceive(_filledQueue, &block, portMAX_DELAY);
+        _writerIdleUs += esp_timer_get_time() - waitStart;
+
+        if (block.data == nullptr) {
+            break;
+        }
+
+        if (!_failed) {
+            uint64_t writeStart = esp_timer_get_time();
+            size_t written = Update.write(block.data, block.length);
+            _flashUs += esp_timer_get_time() - writeStart;
+
+            if (written != block.length) {
+                _lastError = "Write error: " + String(Update.getError());
+                _failed = true;
+            } else {
+                _bytesWritten += written;
+            }
+        }
+
+        xQueueSend(_freeQueue, &block.data, portMAX_DELAY);
+    }
+
+    xSemaphoreGive(_doneSemaphore);
+    vTaskDelete(NULL);
+}
+
+void OTAPipeline::release() {
+    for (uint8_t i = 0; i < OTA_PIPELINE_BUFFERS; i++) {
+        if (_buffers[i] != nullptr) {
+            heap_caps_free(_buffers[i]);
+            _buffers[i] = nullptr;
+        }
+    }
+    if (_freeQueue != nullptr) {
+        vQueueDelete(_freeQueue);
+        _freeQueue = nullptr;
+    }
+    if (_filledQueue != nullptr) {
+        vQueueDelete(_filledQueue);
+        _filledQueue = nullptr;
+    }
+    if (_doneSemaphore != nullptr) {
+        vSemaphoreDelete(_doneSemaphore);
+        _doneSemaphore = nullptr;
+    }
+    _writeBuffer = nullptr;
+    _active = false;
+}
@@ -0,0 +1,111 @@
+#ifndef OTA_PIPELINE_H
+#define OTA_PIPELINE_H
+
+#include <Arduino.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+// Buffer pool: large buffers amortise the per-call cost of Update.write and
+// give the writer whole flash sectors; PSRAM is used when available
+#ifndef OTA_PIPELINE_BUFFERS
+#define OTA_PIPELINE_BUFFERS 4
+#endif
+#ifndef OTA_PIPELINE_BUFFER_SIZE
+#define OTA_PIPELINE_BUFFER_SIZE (16 * 1024)
+#endif
+#ifndef OTA_WRITER_PRIORITY
+#define OTA_WRITER_PRIORITY 2
+#endif
+
+// Hash function run on each buffer in the reader before it is queued
+typedef void (*OTAHashFunction)(const uint8_t* data, size_t length);
+
+// Consumer of a decoding stage's output (OTAPipeline::write or the next stage)
+typedef bool (*OTAStreamSink)(const uint8_t* data, size_t length);
+
+// Two-stage firmware write pipeline. The caller (the network reader) fills
+// buffers and hashes them while a pinned writer task flashes the previous
+// ones with Update.write, so download, hashing and flash erase/program
+// overlap instead of running back to back.
+class OTAPipeline {
+public:
+    // Timing of the last transfer
+    struct Stats {
+        uint32_t bytesWritten;
+        uint32_t elapsedMs;       // begin() to finish()
+        uint32_t readerWaitMs;    // Reader waiting for a free buffer (flash-bound)
+        uint32_t writerIdleMs;    // Writer waiting for a filled buffer (network-bound)
+        uint32_t flashMs;         // Time spent in Update.write
+        uint32_t hashMs;          // Time spent in the hash function
+        uint32_t bytesPerSecond;
+        uint8_t buffers;
+        uint32_t bufferSize;
+        bool psram;
+    };
+
+    // Allocate the buffers and start the writer; Update.begin() must already
+    // have succeeded
+    static bool begin(OTAHashFunction hash);
+
+    // Get an empty buffer; blocks while every buffer is in flight.
+    // Returns nullptr if the writer has failed.
+    static uint8_t* acquire(size_t& capacity);
+
+    // Hash a filled buffer and hand it to the writer
+    static bool submit(uint8_t* buffer, size_t length);
+
+    // Copy data into pipeline buffers, submitting each one as it fills. For
+    // stages that produce output in their own memory (inflate, patch).
+    static bool write(const uint8_t* data, size_t length);
+
+    // Flush the buffer started by write(), wait for the writer to flash
+    // everything and release the pipeline
+    static bool finish();
+
+    // Stop the writer and release the pipeline without waiting for the data
+    static void abort();
+
+    // Bytes handed to Update.write so far
+    static size_t getBytesWritten() { return _bytesWritten; }
+
+    // Whether a transfer is running
+    static bool isActive() { return _active; }
+
+    // Stats of the current or last transfer
+    static Stats getStats();
+
+    static String getLastError() { return _lastError; }
+
+private:
+    struct Block {
+        uint8_t* data;
+        size_t length;
+    };
+
+    static void writerTask(void* param);
+    static void release();
+
+    static QueueHandle_t _freeQueue;
+    static QueueHandle_t _filledQueue;
+    static SemaphoreHandle_t _doneSemaphore;
+    static uint8_t* _buffers[OTA_PIPELINE_BUFFERS];
+    static size_t _bufferSize;
+    static uint8_t _bufferCount;
+    static uint8_t* _writeBuffer;
+    static size_t _writeCapacity;
+    static size_t _writeFill;
+    static bool _psram;
+    static OTAHashFunction _hash;
+    static volatile bool _active;
+    static volatile bool _failed;
+    static volatile size_t _bytesWritten;
+    static uint64_t _startUs;
+    static uint64_t _endUs;
+    static uint64_t _readerWaitUs;
+    static uint64_t _hashUs;
+    static volatile uint64_t _writerIdleUs;
+    static volatile uint64_t _flashUs;
+    static String _lastError;
+};
+
+#endif // OTA_PIPELINE_H
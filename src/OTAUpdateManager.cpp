@@ -4,6 +4,21 @@
 #include <Update.h>
 #include <esp_ota_ops.h>
 #include <esp_partition.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <mbedtls/pk.h>
+#include "OTAPipeline.h"
+#include "OTAInflater.h"
+#include "OTAPatcher.h"
+#include "PartitionVerifier.h"
+#include "ConfigSnapshot.h"
+#include "PowerManager.h"
+
+// Public key that release digests are signed with. When present, unsigned
+// or badly signed images are refused.
+#if __has_include("ota_signing_key.h")
+#include "ota_signing_key.h"
+#endif
 
 // Static member initialization
 const char* OTAUpdateManager::GITHUB_API_URL = "https://api.github.com";
@@ -14,13 +29,32 @@ bool OTAUpdateManager::_updateAvailable = false;
 String OTAUpdateManager::_availableVersion = "";
 String OTAUpdateManager::_releaseNotes = "";
 String OTAUpdateManager::_firmwareUrl = "";
+String OTAUpdateManager::_expectedSha256 = "";
+String OTAUpdateManager::_expectedSha256Url = "";
 String OTAUpdateManager::_lastError = "";
 OTAUpdateManager::UpdateState OTAUpdateManager::_updateState = OTAUpdateManager::IDLE;
 int OTAUpdateManager::_updateProgress = 0;
 bool OTAUpdateManager::_recoveryMode = false;
-MD5Builder OTAUpdateManager::_md5Builder;
+SHA256Hasher OTAUpdateManager::_sha256;
+bool OTAUpdateManager::_stageCompressed = false;
+bool OTAUpdateManager::_stageDelta = false;
+unsigned long OTAUpdateManager::_lastReportTime = 0;
+int OTAUpdateManager::_lastReportedPercent = -1;
+bool OTAUpdateManager::_uploadActive = false;
+size_t OTAUpdateManager::_uploadTotal = 0;
+size_t OTAUpdateManager::_uploadReceived = 0;
+unsigned long OTAUpdateManager::_uploadLastWrite = 0;
+uint8_t OTAUpdateManager::_uploadDigest[SHA256Hasher::DIGEST_SIZE] = {};
+OTAStreamSink OTAUpdateManager::_uploadSink = nullptr;
+UpdateProgressCallback OTAUpdateManager::_uploadCallback = nullptr;
 Preferences OTAUpdateManager::_prefs;
 
+// Constants
+const unsigned long OTAUpdateManager::PROGRESS_REPORT_INTERVAL_MS = 250;
+const unsigned long OTAUpdateManager::DOWNLOAD_STALL_TIMEOUT_MS = 15000;
+const size_t OTAUpdateManager::MAX_SIGNATURE_SIZE = 160;
+const size_t OTAUpdateManager::STAGE_BUFFER_SIZE = 4096;
+
 void OTAUpdateManager::begin() {
     _updateStatus = "Ready";
     _updateState = IDLE;
@@ -43,10 +77,20 @@ void OTAUpdateManager::begin() {
         }
     }
     
-    // Register update progress callback
-    Update.onProgress([](size_t progress, size_t total) {
-        updateProgress(progress, total);
-    });
+    // First boot of a new image: check what was flashed against its digest
+    if (_prefs.getBool("update_verify", false)) {
+        _prefs.putBool("update_verify", false);
+        if (!verifyUpdate("")) {
+            Serial.println("Installed image failed verification: " + _lastError);
+            _prefs.putBool("update_failed", true);
+            if (!rollbackFirmware()) {
+                enterRecoveryMode();
+            }
+        }
+    }
+    
+    // Progress is reported by the reader in performUpdate(); Update's own
+    // callback would fire from the flash writer task
 }
 
 bool OTAUpdateManager::checkForUpdates() {
@@ -141,8 +185,35 @@ bool OTAUpdateManager::performUpdate(const String& url, UpdateProgressCallback c
         return false;
     }
 
+    // Resolve the digest (and signature) before anything touches flash
+    uint8_t expectedDigest[SHA256Hasher::DIGEST_SIZE];
+    bool haveDigest = resolveExpectedDigest(url, expectedDigest);
+#ifdef OTA_SIGNING_KEY_PEM
+    if (!haveDigest) {
+        _lastError = "No SHA-256 digest published for signed update";
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+    uint8_t signature[MAX_SIGNATURE_SIZE];
+    size_t signatureLength = 0;
+    int sigCode = fetchMetadata(metadataUrl(url) + ".sig", signature, sizeof(signature), signatureLength);
+    if (sigCode != HTTP_CODE_OK || !verifySignature(expectedDigest, signature, signatureLength)) {
+        _lastError = sigCode != HTTP_CODE_OK ? "Missing update signature (HTTP " + String(sigCode) + ")"
+                                             : "Invalid update signature";
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+#else
+    if (!haveDigest) {
+        Serial.println("WARNING: no SHA-256 published for " + url + ", installing unverified");
+    }
+#endif
+
     HTTPClient http;
     http.begin(url);
+    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);  // GitHub assets redirect to their CDN
     
     int httpCode = http.GET();
     if (httpCode != HTTP_CODE_OK) {
@@ -162,11 +233,13 @@ bool OTAUpdateManager::performUpdate(const String& url, UpdateProgressCallback c
         return false;
     }
     
-    // Start MD5 calculation
-    _md5Builder.begin();
+    // Hashed in the reader as the image streams through the pipeline
+    _sha256.begin();
     
-    // Check if enough space is available
-    if (!Update.begin(contentLength)) {
+    // Check if enough space is available; inflated and patched images only
+    // know their size at the end
+    bool staged = isStagedName(url);
+    if (!Update.begin(staged ? UPDATE_SIZE_UNKNOWN : contentLength)) {
         _lastError = "Not enough space for update";
         _updateStatus = _lastError;
         setUpdateState(FAILED);
@@ -174,72 +247,373 @@ bool OTAUpdateManager::performUpdate(const String& url, UpdateProgressCallback c
         return false;
     }
     
+    // The flash writer runs in its own task; this task only reads and hashes
+    if (!OTAPipeline::begin(hashChunk)) {
+        _lastError = OTAPipeline::getLastError();
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        Update.abort();
+        http.end();
+        return false;
+    }
+    
+    OTAStreamSink sink = nullptr;
+    uint8_t* stage = nullptr;
+    bool stagesOpen = openStages(url, sink);
+    if (stagesOpen && staged) {
+        stage = (uint8_t*)heap_caps_malloc(STAGE_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (stage == nullptr) {
+            stage = (uint8_t*)heap_caps_malloc(STAGE_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (stage == nullptr) {
+            closeStages(false);
+            _lastError = "Not enough memory for update stages";
+        }
+    }
+    if (!stagesOpen || (staged && stage == nullptr)) {
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        OTAPipeline::abort();
+        Update.abort();
+        http.end();
+        return false;
+    }
+    
     setUpdateState(INSTALLING);
     _updateStatus = "Installing firmware...";
     
     WiFiClient* stream = http.getStreamPtr();
-    size_t written = 0;
-    uint8_t buff[1024] = { 0 };
+    size_t received = 0;
+    uint8_t* buffer = nullptr;
+    size_t capacity = 0;
+    size_t filled = 0;
+    unsigned long lastDataTime = millis();
+    resetProgress();
     
-    while (http.connected() && (written < contentLength)) {
+    while (received < (size_t)contentLength) {
+        if (!staged && buffer == nullptr) {
+            buffer = OTAPipeline::acquire(capacity);
+            if (buffer == nullptr) break;  // Writer failed
+            filled = 0;
+        }
+        
         size_t size = stream->available();
+        if (size == 0) {
+            if (!http.connected() || millis() - lastDataTime > DOWNLOAD_STALL_TIMEOUT_MS) break;
+            vTaskDelay(1);  // Nothing buffered yet; yield to the network stack
+            continue;
+        }
+        lastDataTime = millis();
         
-        if (size) {
-            size_t c = stream->readBytes(buff, ((size > sizeof(buff)) ? sizeof(buff) : size));
-            
-            // Update MD5 checksum
-            _md5Builder.add(buff, c);
-            
-            // Write data to flash
-            size_t w = Update.write(buff, c);
-            if (w != c) {
-                _lastError = "Write error";
-                _updateStatus = _lastError;
-                setUpdateState(FAILED);
-                http.end();
-                return false;
-            }
-            
-            written += c;
-            
-            // Update progress
-            _updateProgress = (written * 100) / contentLength;
-            _updateStatus = "Installing: " + String(_updateProgress) + "%";
+        if (staged) {
+            // The stages fill and submit pipeline buffers themselves
+            size_t want = std::min(size, STAGE_BUFFER_SIZE);
+            want = std::min(want, (size_t)contentLength - received);
+            size_t c = stream->readBytes(stage, want);
+            received += c;
+            if (!sink(stage, c)) break;
+        } else {
+            // Fill whole buffers so the writer sees sector-sized blocks
+            size_t want = std::min(size, capacity - filled);
+            want = std::min(want, (size_t)contentLength - received);
+            size_t c = stream->readBytes(buffer + filled, want);
+            filled += c;
+            received += c;
             
-            // Call the progress callback if provided
-            if (callback != nullptr) {
-                callback(written, contentLength, _updateProgress);
+            if (filled == capacity || received == (size_t)contentLength) {
+                bool accepted = OTAPipeline::submit(buffer, filled);
+                buffer = nullptr;
+                if (!accepted) break;
             }
         }
         
-        delay(1); // Small delay to prevent watchdog timeouts
+        // Throttled: the callback is a full display redraw
+        reportProgress(received, contentLength, callback, false);
     }
     
     http.end();
+    if (stage != nullptr) {
+        heap_caps_free(stage);
+    }
+    
+    bool complete = received == (size_t)contentLength;
+    String streamError = closeStages(complete);
+    if (streamError.isEmpty() && !complete) {
+        streamError = "Download interrupted";
+    }
     
-    // Finalize MD5 calculation
-    _md5Builder.calculate();
-    String md5 = _md5Builder.toString();
+    if (streamError.length() > 0) {
+        OTAPipeline::abort();
+        Update.abort();
+        
+        // Running something other than the patch's base (a local build, a
+        // rollback); nothing has been flashed yet, so take the full image
+        if (_stageDelta && OTAPatcher::isSourceMismatch()) {
+            String fullUrl = metadataUrl(url);
+            Serial.println("Delta does not match running firmware, downloading " + fullUrl);
+            if (_expectedSha256Url == url) {
+                _expectedSha256Url = fullUrl;
+            }
+            return performUpdate(fullUrl, callback);
+        }
+        
+        _lastError = streamError;
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+    
+    size_t imageSize = stagedImageSize(received);
+    if (staged) {
+        Serial.printf("%u byte download became a %u byte image\n", (unsigned)received, (unsigned)imageSize);
+    }
+    
+    if (!OTAPipeline::finish()) {
+        Update.abort();
+        _lastError = OTAPipeline::getLastError();
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+    
+    // Final report always goes out
+    reportProgress(received, contentLength, callback, true);
+    
+    if (!installImage(haveDigest ? expectedDigest : nullptr, imageSize, staged)) {
+        return false;
+    }
+    
+    _updateStatus = "Update successful, restarting...";
+    _prefs.end();
+    delay(1000);
+    ESP.restart();
+    return true;
+}
+
+bool OTAUpdateManager::isBusy() {
+    // A client that vanished mid-upload must not block updates forever
+    if (_uploadActive && millis() - _uploadLastWrite > DOWNLOAD_STALL_TIMEOUT_MS) {
+        abortUpload("Upload stalled");
+    }
+    return _uploadActive || _updateState == DOWNLOADING || _updateState == INSTALLING ||
+           _updateState == VERIFYING;
+}
+
+bool OTAUpdateManager::beginUpload(const String& name, size_t total, const String& sha256Hex,
+                                   const String& signatureHex, UpdateProgressCallback callback) {
+    if (isBusy()) {
+        _lastError = "Update already in progress";
+        return false;
+    }
+    
+    // Nothing else vouches for a pushed image, so its digest is required
+    if (!SHA256Hasher::parseHex(sha256Hex, _uploadDigest)) {
+        _lastError = "Upload needs the image's SHA-256 (sha256=<hex>)";
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+#ifdef OTA_SIGNING_KEY_PEM
+    uint8_t signature[MAX_SIGNATURE_SIZE];
+    size_t signatureLength = decodeHex(signatureHex, signature, sizeof(signature));
+    if (!verifySignature(_uploadDigest, signature, signatureLength)) {
+        _lastError = signatureLength == 0 ? "Missing update signature (sig=<hex>)" : "Invalid update signature";
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+#endif
+    
+    _prefs.putString("current_version", VersionManager::getVersionString());
+    _prefs.putString("update_version", "");
+    _prefs.putBool("update_in_progress", true);
+    
+    _uploadActive = true;
+    PowerManager::setHeld(POWER_LOCK_OTA, true);
+    _uploadTotal = total;
+    _uploadReceived = 0;
+    _uploadLastWrite = millis();
+    _uploadCallback = callback;
+    _updateProgress = 0;
+    setUpdateState(INSTALLING);
+    _updateStatus = "Receiving firmware...";
+    _sha256.begin();
+    resetProgress();
+    
+    // The size is not checked up front: a multipart body only announces its
+    // total, and .gz or patch uploads only know theirs at the end
+    if (!Update.begin(UPDATE_SIZE_UNKNOWN)) {
+        abortUpload("Not enough space for update");
+        return false;
+    }
+    if (!OTAPipeline::begin(hashChunk)) {
+        abortUpload(OTAPipeline::getLastError());
+        return false;
+    }
+    if (!openStages(name, _uploadSink)) {
+        abortUpload(_lastError);
+        return false;
+    }
+    
+    Serial.printf("Receiving firmware upload %s (%u bytes)\n", name.c_str(), (unsigned)total);
+    return true;
+}
+
+bool OTAUpdateManager::writeUpload(const uint8_t* data, size_t length) {
+    if (!_uploadActive) return false;
+    
+    _uploadLastWrite = millis();
+    if (!_uploadSink(data, length)) {
+        abortUpload("");
+        return false;
+    }
+    _uploadReceived += length;
+    reportProgress(_uploadReceived, _uploadTotal, _uploadCallback, false);
+    return true;
+}
+
+bool OTAUpdateManager::finishUpload() {
+    if (!_uploadActive) {
+        if (_lastError.isEmpty()) _lastError = "No upload in progress";
+        return false;
+    }
+    
+    String streamError = closeStages(true);
+    if (streamError.length() > 0) {
+        abortUpload(streamError);
+        return false;
+    }
+    _uploadActive = false;
+    PowerManager::setHeld(POWER_LOCK_OTA, false);
+    
+    size_t imageSize = stagedImageSize(_uploadReceived);
+    if (!OTAPipeline::finish()) {
+        Update.abort();
+        _prefs.putBool("update_in_progress", false);
+        _lastError = OTAPipeline::getLastError();
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+    reportProgress(_uploadReceived, _uploadTotal, _uploadCallback, true);
+    
+    if (!installImage(_uploadDigest, imageSize, true)) {
+        return false;
+    }
+    _updateStatus = "Upload installed, restarting...";
+    return true;
+}
+
+void OTAUpdateManager::abortUpload(const String& reason) {
+    if (!_uploadActive) return;
+    _uploadActive = false;
+    PowerManager::setHeld(POWER_LOCK_OTA, false);
     
-    // Store MD5 for verification after reboot
-    _prefs.putString("update_md5", md5);
+    // A failed write downstream explains the errors it caused upstream
+    String stageError = closeStages(false);
+    OTAPipeline::abort();
+    Update.abort();
     
+    // Nothing was made bootable; the running image stays as it was
+    _prefs.putBool("update_in_progress", false);
+    _lastError = reason.length() > 0 ? reason : stageError.length() > 0 ? stageError : "Upload interrupted";
+    _updateStatus = _lastError;
+    setUpdateState(FAILED);
+    Serial.println("Firmware upload aborted: " + _lastError);
+}
+
+bool OTAUpdateManager::isUploadActive() {
+    return _uploadActive;
+}
+
+bool OTAUpdateManager::isStagedName(const String& name) {
+    String plain = name.endsWith(".gz") ? name.substring(0, name.length() - 3) : name;
+    return plain != name || (plain.endsWith(".patch") && plain.lastIndexOf(".from-") > 0);
+}
+
+bool OTAUpdateManager::openStages(const String& name, OTAStreamSink& sink) {
+    // A .gz image is inflated on the fly and a ".from-<version>.patch" is
+    // applied against the running firmware. The chain is built back to
+    // front: download -> inflate -> patch -> pipeline
+    _stageCompressed = name.endsWith(".gz");
+    String plain = _stageCompressed ? name.substring(0, name.length() - 3) : name;
+    _stageDelta = plain.endsWith(".patch") && plain.lastIndexOf(".from-") > 0;
+    sink = OTAPipeline::write;
+    
+    if (_stageDelta) {
+        const esp_partition_t* running = esp_ota_get_running_partition();
+        if (running == nullptr || !OTAPatcher::begin(readRunningPartition, running->size, sink)) {
+            _lastError = running == nullptr ? "Running partition not found" : OTAPatcher::getLastError();
+            closeStages(false);
+            return false;
+        }
+        sink = OTAPatcher::write;
+    }
+    if (_stageCompressed) {
+        if (!OTAInflater::begin(sink)) {
+            _lastError = OTAInflater::getLastError();
+            closeStages(false);
+            return false;
+        }
+        sink = OTAInflater::write;
+    }
+    return true;
+}
+
+String OTAUpdateManager::closeStages(bool complete) {
+    // A write error downstream surfaces in every earlier stage; report the root cause
+    String error;
+    if (!complete) {
+        error = OTAPipeline::getLastError();
+        if (error.isEmpty() && _stageDelta) error = OTAPatcher::getLastError();
+        if (error.isEmpty() && _stageCompressed) error = OTAInflater::getLastError();
+    } else if (_stageCompressed && !OTAInflater::finish()) {
+        error = OTAInflater::getLastError();
+    } else if (_stageDelta && !OTAPatcher::finish()) {
+        error = OTAPatcher::getLastError();
+    }
+    
+    if (_stageDelta) {
+        OTAPatcher::end();
+    }
+    if (_stageCompressed) {
+        OTAInflater::end();
+    }
+    return error;
+}
+
+size_t OTAUpdateManager::stagedImageSize(size_t received) {
+    if (_stageDelta) return OTAPatcher::getOutputSize();
+    if (_stageCompressed) return OTAInflater::getOutputSize();
+    return received;
+}
+
+bool OTAUpdateManager::installImage(const uint8_t* expectedDigest, size_t imageSize, bool sizeUnknown) {
     setUpdateState(VERIFYING);
     _updateStatus = "Verifying update...";
     
-    if (Update.end()) {
-        _updateStatus = "Update successful, restarting...";
-        setUpdateState(COMPLETE);
-        
-        // Clear the update_failed flag before restarting
-        _prefs.putBool("update_failed", false);
+    // Reject a mismatching image before Update.end() can make it bootable
+    _sha256.calculate();
+    if (expectedDigest != nullptr && memcmp(_sha256.getBytes(), expectedDigest, SHA256Hasher::DIGEST_SIZE) != 0) {
+        Update.abort();
         _prefs.putBool("update_in_progress", false);
-        _prefs.end();
-        
-        delay(1000);
-        ESP.restart();
-        return true;
-    } else {
+        _lastError = "SHA-256 mismatch: got " + _sha256.toString();
+        _updateStatus = _lastError;
+        setUpdateState(FAILED);
+        return false;
+    }
+    
+    // Keep the configs this firmware ran with, so a rollback can take them back
+    String target = _prefs.getString("update_version", "");
+    String reason = target.isEmpty() ? "before update" : "before update to " + target;
+    int snapshot = ConfigSnapshot::take(reason);
+    if (snapshot < 0) {
+        Serial.println("Config snapshot failed: " + ConfigSnapshot::getLastError());
+    }
+    _prefs.putInt("config_snapshot", snapshot);
+    
+    // With an unknown size Update has reserved the whole slot
+    if (!Update.end(sizeUnknown)) {
         _lastError = "Update failed: " + String(Update.getError());
         _updateStatus = _lastError;
         setUpdateState(FAILED);
@@ -248,6 +622,63 @@ bool OTAUpdateManager::performUpdate(const String& url, UpdateProgressCallback c
         _prefs.putBool("update_failed", true);
         return false;
     }
+    
+    // Re-checked against the flash contents on first boot. Only written once
+    // the image is bootable: after a failed end() the old image would fail
+    // this check and roll back onto the half-written slot
+    _prefs.putString("update_sha256", _sha256.toString());
+    _prefs.putUInt("update_size", (uint32_t)imageSize);
+    _prefs.putBool("update_verify", true);
+    
+    setUpdateState(COMPLETE);
+    
+    // Clear the update_failed flag before restarting
+    _prefs.putBool("update_failed", false);
+    _prefs.putBool("update_in_progress", false);
+    return true;
+}
+
+void OTAUpdateManager::resetProgress() {
+    _lastReportTime = 0;
+    _lastReportedPercent = -1;
+}
+
+void OTAUpdateManager::reportProgress(size_t done, size_t total, UpdateProgressCallback callback, bool final) {
+    // 100% only once the image is complete; a multipart total includes the
+    // form overhead
+    int percent = final ? 100 : total > 0 ? (int)std::min((uint64_t)99, (uint64_t)done * 100 / total) : 0;
+    unsigned long now = millis();
+    if (!final && (percent == _lastReportedPercent || now - _lastReportTime < PROGRESS_REPORT_INTERVAL_MS)) {
+        return;
+    }
+    _lastReportedPercent = percent;
+    _lastReportTime = now;
+    _updateProgress = percent;
+    _updateStatus = "Installing: " + String(percent) + "%";
+    if (callback != nullptr) {
+        callback(done, final ? done : total, percent);
+    }
+}
+
+size_t OTAUpdateManager::decodeHex(const String& hex, uint8_t* out, size_t capacity) {
+    String trimmed = hex;
+    trimmed.trim();
+    size_t length = trimmed.length() / 2;
+    if (trimmed.length() % 2 != 0 || length > capacity) return 0;
+    
+    for (size_t i = 0; i < length; i++) {
+        uint8_t value = 0;
+        for (size_t j = 0; j < 2; j++) {
+            char c = trimmed[i * 2 + j];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return 0;
+        }
+        out[i] = value;
+    }
+    return length;
 }
 
 String OTAUpdateManager::getUpdateStatus() {
@@ -302,6 +733,8 @@ bool OTAUpdateManager::parseGitHubRelease(const String& json) {
 
     // Find the firmware binary asset
     bool foundBinary = false;
+    String binaryName;
+    String binaryDigest;
     JsonArray assets = doc["assets"];
     for (JsonObject asset : assets) {
         if (!asset.containsKey("name") || !asset.containsKey("browser_download_url")) {
@@ -311,12 +744,38 @@ bool OTAUpdateManager::parseGitHubRelease(const String& json) {
         String name = asset["name"].as<String>();
         if (name.endsWith(".bin")) {
             _firmwareUrl = asset["browser_download_url"].as<String>();
+            binaryName = name;
             foundBinary = true;
-            Serial.println("Found firmware binary: " + name);
-            Serial.println("Download URL: " + _firmwareUrl);
+            
+            // GitHub publishes "sha256:<hex>" for uploaded assets; otherwise
+            // performUpdate() looks for a "<name>.sha256" asset
+            String digest = asset["digest"] | "";
+            binaryDigest = digest.startsWith("sha256:") ? digest.substring(7) : "";
             break;
         }
     }
+    
+    // Prefer a delta against the running version, then "<name>.gz"; both
+    // are verified against the full image's digest
+    if (foundBinary) {
+        String patchName = binaryName + ".from-" + VersionManager::getVersionString() + ".patch";
+        const String preferred[] = { patchName + ".gz", patchName, binaryName + ".gz" };
+        bool foundPreferred = false;
+        for (const String& candidate : preferred) {
+            for (JsonObject asset : assets) {
+                if (asset["name"].as<String>() == candidate && asset.containsKey("browser_download_url")) {
+                    _firmwareUrl = asset["browser_download_url"].as<String>();
+                    binaryName = candidate;
+                    foundPreferred = true;
+                    break;
+                }
+            }
+            if (foundPreferred) break;
+        }
+        setExpectedDigest(_firmwareUrl, binaryDigest);
+        Serial.println("Found firmware binary: " + binaryName);
+        Serial.println("Download URL: " + _firmwareUrl);
+    }
 
     if (!foundBinary) {
         _lastError = "No firmware binary found in release";
@@ -327,35 +786,141 @@ bool OTAUpdateManager::parseGitHubRelease(const String& json) {
     return true;
 }
 
-void OTAUpdateManager::updateProgress(size_t current, size_t total) {
-    int progress = (current * 100) / total;
-    _updateProgress = progress;
-    _updateStatus = "Updating: " + String(progress) + "%";
+void OTAUpdateManager::hashChunk(const uint8_t* data, size_t length) {
+    _sha256.add(data, length);
 }
 
-bool OTAUpdateManager::verifyUpdate(const String& md5Hash) {
+bool OTAUpdateManager::readRunningPartition(size_t offset, uint8_t* buffer, size_t length) {
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    return running != nullptr && esp_partition_read(running, offset, buffer, length) == ESP_OK;
+}
+
+bool OTAUpdateManager::verifyUpdate(const String& sha256Hash) {
     _updateStatus = "Verifying firmware integrity...";
     
-    // Compare stored MD5 with provided hash
-    String storedMD5 = _prefs.getString("update_md5", "");
+    // Default to the digest recorded when the image was installed
+    uint8_t expected[SHA256Hasher::DIGEST_SIZE];
+    String expectedHex = sha256Hash.isEmpty() ? _prefs.getString("update_sha256", "") : sha256Hash;
+    if (!SHA256Hasher::parseHex(expectedHex, expected)) {
+        _lastError = "No SHA-256 digest to verify against";
+        return false;
+    }
+    
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    size_t imageSize = _prefs.getUInt("update_size", 0);
+    if (running == nullptr || imageSize == 0 || imageSize > running->size) {
+        _lastError = "Unknown installed image size";
+        return false;
+    }
     
-    if (storedMD5.isEmpty()) {
-        _lastError = "No stored MD5 hash found";
+    // Hash what is actually in flash rather than what was downloaded
+    SHA256Hasher hasher;
+    if (!PartitionVerifier::hashPartition(running, imageSize, hasher)) {
+        _lastError = PartitionVerifier::getLastError();
         return false;
     }
     
-    if (storedMD5.equals(md5Hash)) {
+    if (memcmp(hasher.getBytes(), expected, SHA256Hasher::DIGEST_SIZE) == 0) {
         _updateStatus = "Firmware integrity verified";
         return true;
     } else {
-        _lastError = "MD5 verification failed";
+        _lastError = "SHA-256 verification failed";
         _updateStatus = _lastError;
         return false;
     }
 }
 
+void OTAUpdateManager::setExpectedDigest(const String& url, const String& sha256Hex) {
+    _expectedSha256Url = url;
+    _expectedSha256 = sha256Hex;
+}
+
+bool OTAUpdateManager::resolveExpectedDigest(const String& url, uint8_t digest[SHA256Hasher::DIGEST_SIZE]) {
+    // Digest supplied with the release metadata or the request
+    if (url == _expectedSha256Url && SHA256Hasher::parseHex(_expectedSha256, digest)) {
+        return true;
+    }
+    
+    // Otherwise look for "<image>.sha256" next to the image (sha256sum format)
+    uint8_t text[128];
+    size_t length = 0;
+    if (fetchMetadata(metadataUrl(url) + ".sha256", text, sizeof(text) - 1, length) != HTTP_CODE_OK) {
+        return false;
+    }
+    text[length] = '\0';
+    return SHA256Hasher::parseHex(String((const char*)text), digest);
+}
+
+String OTAUpdateManager::metadataUrl(const String& url) {
+    // Digests and signatures describe the flashed image, so compressed and
+    // delta downloads share them with the full image:
+    // "<image>.from-<version>.patch.gz" -> "<image>"
+    String base = url.endsWith(".gz") ? url.substring(0, url.length() - 3) : url;
+    int from = base.lastIndexOf(".from-");
+    if (base.endsWith(".patch") && from > 0) {
+        base = base.substring(0, from);
+    }
+    return base;
+}
+
+int OTAUpdateManager::fetchMetadata(const String& url, uint8_t* buffer, size_t capacity, size_t& length) {
+    length = 0;
+    
+    HTTPClient http;
+    http.begin(url);
+    http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+    http.addHeader("User-Agent", "ESP32-ModularMacropad");
+    
+    int httpCode = http.GET();
+    if (httpCode != HTTP_CODE_OK) {
+        http.end();
+        return httpCode;
+    }
+    
+    int size = http.getSize();
+    if (size > (int)capacity) {
+        http.end();
+        return HTTPC_ERROR_TOO_LESS_RAM;
+    }
+    
+    WiFiClient* stream = http.getStreamPtr();
+    unsigned long start = millis();
+    while (length < capacity && (size < 0 || length < (size_t)size) && millis() - start < 5000) {
+        if (stream->available()) {
+            length += stream->readBytes(buffer + length, capacity - length);
+        } else if (!http.connected()) {
+            break;
+        } else {
+            vTaskDelay(1);
+        }
+    }
+    
+    http.end();
+    return httpCode;
+}
+
+bool OTAUpdateManager::verifySignature(const uint8_t* digest, const uint8_t* signature, size_t length) {
+#ifdef OTA_SIGNING_KEY_PEM
+    mbedtls_pk_context key;
+    mbedtls_pk_init(&key);
+    
+    // The PEM length passed to mbedtls includes the terminating NUL
+    int ret = mbedtls_pk_parse_public_key(&key, (const unsigned char*)OTA_SIGNING_KEY_PEM,
+                                          strlen(OTA_SIGNING_KEY_PEM) + 1);
+    if (ret == 0) {
+        ret = mbedtls_pk_verify(&key, MBEDTLS_MD_SHA256, digest, SHA256Hasher::DIGEST_SIZE, signature, length);
+    }
+    mbedtls_pk_free(&key);
+    return ret == 0;
+#else
+    return false;
+#endif
+}
+
 void OTAUpdateManager::setUpdateState(UpdateState state) {
     _updateState = state;
+    PowerManager::setHeld(POWER_LOCK_OTA, _uploadActive ||
+                          state == DOWNLOADING || state == INSTALLING || state == VERIFYING);
     
     switch (state) {
         case IDLE:
@@ -417,6 +982,13 @@ bool OTAUpdateManager::rollbackFirmware() {
         return false;
     }
     
+    // Bring back the configs the previous firmware was using
+    int snapshot = _prefs.getInt("config_snapshot", -1);
+    if (snapshot >= 0 && !ConfigSnapshot::restore(snapshot)) {
+        Serial.println("Config restore failed: " + ConfigSnapshot::getLastError());
+    }
+    _prefs.remove("config_snapshot");
+    
     _updateStatus = "Rollback successful, restarting...";
     delay(1000);
     ESP.restart();
@@ -444,39 +1016,6 @@ int OTAUpdateManager::getUpdateProgress() {
     return _updateProgress;
 }
 
-String OTAUpdateManager::calculateMD5(const String& firmwareUrl) {
-    _updateStatus = "Calculating MD5 checksum...";
-    
-    HTTPClient http;
-    http.begin(firmwareUrl);
-    
-    int httpCode = http.GET();
-    if (httpCode != HTTP_CODE_OK) {
-        _lastError = "Failed to download firmware for MD5 calculation";
-        return "";
-    }
-    
-    _md5Builder.begin();
-    
-    WiFiClient* stream = http.getStreamPtr();
-    uint8_t buf[1024];
-    
-    while (http.connected()) {
-        size_t size = stream->available();
-        if (size) {
-            int c = stream->readBytes(buf, ((size > sizeof(buf)) ? sizeof(buf) : size));
-            _md5Builder.add(buf, c);
-        } else {
-            break;
-        }
-    }
-    
-    http.end();
-    
-    _md5Builder.calculate();
-    return _md5Builder.toString();
-}
-
 bool OTAUpdateManager::validateCertificate(const String& url) {
     // Implement certificate validation for HTTPS
     // For simplicity, we're returning true, but in a production environment
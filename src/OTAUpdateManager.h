@@ -6,8 +6,8 @@
 #include <Update.h>
 #include <ArduinoJson.h>
 #include "VersionManager.h"
-#include <ESP32-targz.h>  // For handling compressed updates
-#include <MD5Builder.h>   // For update validation
+#include "SHA256Hasher.h" // For update validation
+#include "OTAPipeline.h"
 #include <Preferences.h>  // For storing update state
 
 // Update progress callback function pointer
@@ -39,6 +39,24 @@ public:
     // Perform update with progress callback
     static bool performUpdate(const String& url, UpdateProgressCallback callback);
     
+    // True while a download or upload is running
+    static bool isBusy();
+    
+    // Push update (POST /api/firmware/upload): the caller streams the image
+    // in. name picks the stages like a URL does (.gz, .from-<v>.patch);
+    // total is only used for progress. The digest is required, and with a
+    // signing key the signature (hex) too.
+    static bool beginUpload(const String& name, size_t total, const String& sha256Hex,
+                            const String& signatureHex, UpdateProgressCallback callback);
+    static bool writeUpload(const uint8_t* data, size_t length);
+    
+    // Verify and make the image bootable; restarting is up to the caller
+    static bool finishUpload();
+    
+    // Drop the upload; the running image is untouched
+    static void abortUpload(const String& reason);
+    static bool isUploadActive();
+    
     // Get update status
     static String getUpdateStatus();
     
@@ -57,8 +75,12 @@ public:
     // Get firmware URL
     static String getFirmwareUrl();
     
-    // Verify update integrity
-    static bool verifyUpdate(const String& md5Hash);
+    // Verify the installed image against a SHA-256 digest (defaults to the
+    // digest recorded at install time)
+    static bool verifyUpdate(const String& sha256Hash);
+    
+    // Set the SHA-256 an image URL is expected to have
+    static void setExpectedDigest(const String& url, const String& sha256Hex);
     
     // Set update state
     static void setUpdateState(UpdateState state);
@@ -93,19 +115,56 @@ private:
     static String _availableVersion;
     static String _releaseNotes;
     static String _firmwareUrl;
+    static String _expectedSha256;
+    static String _expectedSha256Url;
     static String _lastError;
     static UpdateState _updateState;
     static int _updateProgress;
     static bool _recoveryMode;
-    static MD5Builder _md5Builder;
+    static SHA256Hasher _sha256;
     static Preferences _prefs;
     
+    // Decoding stages of the current update
+    static bool _stageCompressed;
+    static bool _stageDelta;
+    
+    // Progress throttling
+    static unsigned long _lastReportTime;
+    static int _lastReportedPercent;
+    
+    // Push upload session
+    static bool _uploadActive;
+    static size_t _uploadTotal;
+    static size_t _uploadReceived;
+    static unsigned long _uploadLastWrite;
+    static uint8_t _uploadDigest[SHA256Hasher::DIGEST_SIZE];
+    static OTAStreamSink _uploadSink;
+    static UpdateProgressCallback _uploadCallback;
+    
+    // Download tuning
+    static const unsigned long PROGRESS_REPORT_INTERVAL_MS;
+    static const unsigned long DOWNLOAD_STALL_TIMEOUT_MS;
+    static const size_t MAX_SIGNATURE_SIZE;
+    static const size_t STAGE_BUFFER_SIZE;
+    
     // Helper methods
     static bool parseGitHubRelease(const String& json);
-    static void updateProgress(size_t current, size_t total);
+    static void hashChunk(const uint8_t* data, size_t length);
+    static bool readRunningPartition(size_t offset, uint8_t* buffer, size_t length);
+    static bool isStagedName(const String& name);
+    static bool openStages(const String& name, OTAStreamSink& sink);
+    static String closeStages(bool complete);
+    static size_t stagedImageSize(size_t received);
+    static bool installImage(const uint8_t* expectedDigest, size_t imageSize, bool sizeUnknown);
+    static void resetProgress();
+    static void reportProgress(size_t done, size_t total, UpdateProgressCallback callback, bool final);
+    static size_t decodeHex(const String& hex, uint8_t* out, size_t capacity);
     static bool saveUpdateMetadata();
     static bool loadUpdateMetadata();
-    static String calculateMD5(const String& firmwareUrl);
+    static bool resolveExpectedDigest(const String& url, uint8_t digest[SHA256Hasher::DIGEST_SIZE]);
+    static String metadataUrl(const String& url);
+    static int fetchMetadata(const String& url, uint8_t* buffer, size_t capacity, size_t& length);
+    static bool verifySignature(const uint8_t* digest, const uint8_t* signature, size_t length);
     static bool validateCertificate(const String& url);
 };
 
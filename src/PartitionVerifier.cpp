@@ -1,8 +1,35 @@
 #include "PartitionVerifier.h"
+#include <Preferences.h>
+#include <esp_image_format.h>
+#include <esp_idf_version.h>
+#include <algorithm>
+
+// The mapping API moved from spi_flash to esp_partition in IDF 5
+#if ESP_IDF_VERSION_MAJOR >= 5
+typedef esp_partition_mmap_handle_t partition_mmap_handle_t;
+#define PARTITION_MMAP_DATA ESP_PARTITION_MMAP_DATA
+#define partition_munmap esp_partition_munmap
+#else
+typedef spi_flash_mmap_handle_t partition_mmap_handle_t;
+#define PARTITION_MMAP_DATA SPI_FLASH_MMAP_DATA
+#define partition_munmap spi_flash_munmap
+#endif
 
 // Static member initialization
 String PartitionVerifier::_lastError = "";
 
+// Constants
+const size_t PartitionVerifier::MMAP_WINDOW_SIZE = 64 * 1024;  // One MMU page
+static const char* DIGEST_CACHE_NAMESPACE = "partverify";
+
+// Verified image digest, stored under the partition label and valid for
+// as long as the partition holds the same build
+struct DigestCacheEntry {
+    uint8_t elfSha256[32];
+    uint32_t imageLength;
+    uint8_t digest[SHA256Hasher::DIGEST_SIZE];
+};
+
 bool PartitionVerifier::verifyBootloaderPartition() {
     // Get the bootloader partition
     const esp_partition_t* bootloader = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
@@ -85,49 +112,77 @@ String PartitionVerifier::calculatePartitionHash(const esp_partition_t* partitio
         return "";
     }
     
-    // Create a buffer for reading - reduced from 32KB to 8KB to save memory
-    const size_t bufSize = 8192; // 8KB chunks
-    uint8_t* buf = (uint8_t*)malloc(bufSize);
-    
-    if (!buf) {
-        _lastError = "Failed to allocate memory for hash calculation";
-        return "";
+    uint8_t digest[SHA256Hasher::DIGEST_SIZE];
+    return getImageDigest(partition, digest) ? SHA256Hasher::toHex(digest) : "";
+}
+
+bool PartitionVerifier::hashPartition(const esp_partition_t* partition, size_t length, SHA256Hasher& hasher) {
+    if (partition == NULL || length > partition->size) {
+        _lastError = "Invalid partition range";
+        return false;
     }
     
-    // Initialize the MD5 builder
-    MD5Builder md5Builder;
-    md5Builder.begin();
-    
-    // Read and process the partition in chunks
-    size_t remaining = partition->size;
-    size_t offset = 0;
+    // Feed the SHA engine straight from the flash cache; no read buffer
+    hasher.begin();
+    for (size_t offset = 0; offset < length; offset += MMAP_WINDOW_SIZE) {
+        size_t size = std::min(MMAP_WINDOW_SIZE, length - offset);
+        const void* data = NULL;
+        partition_mmap_handle_t handle;
+        if (esp_partition_mmap(partition, offset, size, PARTITION_MMAP_DATA, &data, &handle) != ESP_OK) {
+            _lastError = "Failed to map partition data";
+            return false;
+        }
+        hasher.add((const uint8_t*)data, size);
+        partition_munmap(handle);
+    }
+    hasher.calculate();
+    return true;
+}
+
+bool PartitionVerifier::getImageLength(const esp_partition_t* partition, size_t& length, bool& hashAppended) {
+    if (partition == NULL) {
+        _lastError = "Partition is NULL";
+        return false;
+    }
     
-    // Only hash first 1MB of the partition to speed up process
-    size_t maxBytesToHash = 1024 * 1024; // 1MB
-    if (remaining > maxBytesToHash) {
-        remaining = maxBytesToHash;
+    esp_image_header_t header;
+    if (esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK) {
+        _lastError = "Failed to read image header";
+        return false;
+    }
+    if (header.magic != ESP_IMAGE_HEADER_MAGIC || header.segment_count > ESP_IMAGE_MAX_SEGMENTS) {
+        _lastError = "No app image in partition";
+        return false;
     }
     
-    while (remaining > 0) {
-        size_t toRead = (remaining < bufSize) ? remaining : bufSize;
-        
-        if (esp_partition_read(partition, offset, buf, toRead) != ESP_OK) {
-            _lastError = "Failed to read partition data";
-            free(buf);
-            return "";
+    // Walk the segment headers; only 8 bytes each are read
+    size_t pos = sizeof(header);
+    for (uint8_t i = 0; i < header.segment_count; i++) {
+        esp_image_segment_header_t segment;
+        if (esp_partition_read(partition, pos, &segment, sizeof(segment)) != ESP_OK) {
+            _lastError = "Failed to read segment header";
+            return false;
+        }
+        pos += sizeof(segment) + segment.data_len;
+        if (pos > partition->size) {
+            _lastError = "Image segments run past the partition";
+            return false;
         }
-        
-        md5Builder.add(buf, toRead);
-        
-        offset += toRead;
-        remaining -= toRead;
     }
     
-    free(buf);
+    // Checksum byte, padded to 16 bytes, then the optional SHA-256
+    pos = (pos + 16) & ~(size_t)15;
+    hashAppended = header.hash_appended == 1;
+    if (hashAppended) {
+        pos += SHA256Hasher::DIGEST_SIZE;
+    }
+    if (pos > partition->size) {
+        _lastError = "Image runs past the partition";
+        return false;
+    }
     
-    // Calculate and return the MD5 hash
-    md5Builder.calculate();
-    return md5Builder.toString();
+    length = pos;
+    return true;
 }
 
 bool PartitionVerifier::verifyPartitionIntegrity(const esp_partition_t* partition) {
@@ -142,9 +197,8 @@ bool PartitionVerifier::verifyPartitionIntegrity(const esp_partition_t* partitio
         return false;
     }
     
-    // Check CRC
-    if (!checkPartitionCRC(partition)) {
-        _lastError = "Partition CRC verification failed";
+    // Check the image against its appended SHA-256
+    if (!checkImageDigest(partition)) {
         return false;
     }
     
@@ -164,8 +218,13 @@ String PartitionVerifier::getPartitionInfo(const esp_partition_t* partition) {
     info += "  Label: " + String(partition->label) + "\n";
     info += "  Encrypted: " + String(partition->encrypted ? "Yes" : "No") + "\n";
     
-    // Add hash
-    info += "  MD5: " + calculatePartitionHash(partition) + "\n";
+    // Add image size and hash
+    size_t imageLength = 0;
+    bool hashAppended = false;
+    if (getImageLength(partition, imageLength, hashAppended)) {
+        info += "  Image: " + String(imageLength) + " bytes\n";
+    }
+    info += "  SHA-256: " + calculatePartitionHash(partition) + "\n";
     
     return info;
 }
@@ -222,16 +281,64 @@ bool PartitionVerifier::checkPartitionMagicBytes(const esp_partition_t* partitio
     return true;
 }
 
-bool PartitionVerifier::checkPartitionCRC(const esp_partition_t* partition) {
-    if (partition == NULL) {
-        _lastError = "Partition is NULL";
+bool PartitionVerifier::checkImageDigest(const esp_partition_t* partition) {
+    uint8_t digest[SHA256Hasher::DIGEST_SIZE];
+    return getImageDigest(partition, digest);
+}
+
+bool PartitionVerifier::getImageDigest(const esp_partition_t* partition, uint8_t digest[SHA256Hasher::DIGEST_SIZE]) {
+    // The build's ELF SHA-256 from the app descriptor keys the cache, so a
+    // new image in the slot is always hashed again
+    size_t length = 0;
+    bool hashAppended = false;
+    if (!getImageLength(partition, length, hashAppended)) {
         return false;
     }
     
-    // ESP32 images have their CRC in the image header
-    // For simplicity, we'll just return true here
-    // In a real implementation, you would read the header, extract the CRC, 
-    // and then verify it against the calculated CRC of the partition data
+    esp_app_desc_t app;
+    bool haveApp = esp_ota_get_partition_description(partition, &app) == ESP_OK;
+    
+    Preferences prefs;
+    if (haveApp && prefs.begin(DIGEST_CACHE_NAMESPACE, true)) {
+        DigestCacheEntry entry;
+        bool hit = prefs.getBytes(partition->label, &entry, sizeof(entry)) == sizeof(entry) &&
+                   memcmp(entry.elfSha256, app.app_elf_sha256, sizeof(entry.elfSha256)) == 0 &&
+                   entry.imageLength == length;
+        prefs.end();
+        if (hit) {
+            memcpy(digest, entry.digest, SHA256Hasher::DIGEST_SIZE);
+            return true;
+        }
+    }
     
+    // With an appended digest, everything before it must hash to it
+    size_t hashedLength = hashAppended ? length - SHA256Hasher::DIGEST_SIZE : length;
+    SHA256Hasher hasher;
+    if (!hashPartition(partition, hashedLength, hasher)) {
+        return false;
+    }
+    if (hashAppended) {
+        uint8_t appended[SHA256Hasher::DIGEST_SIZE];
+        if (esp_partition_read(partition, hashedLength, appended, sizeof(appended)) != ESP_OK) {
+            _lastError = "Failed to read image digest";
+            return false;
+        }
+        if (memcmp(appended, hasher.getBytes(), sizeof(appended)) != 0) {
+            _lastError = "Image SHA-256 does not match its appended digest";
+            return false;
+        }
+    }
+    memcpy(digest, hasher.getBytes(), SHA256Hasher::DIGEST_SIZE);
+    
+    // Only good results are cached: a slot that is still being written is
+    // checked again next time
+    if (haveApp && prefs.begin(DIGEST_CACHE_NAMESPACE, false)) {
+        DigestCacheEntry entry;
+        memcpy(entry.elfSha256, app.app_elf_sha256, sizeof(entry.elfSha256));
+        entry.imageLength = (uint32_t)length;
+        memcpy(entry.digest, digest, SHA256Hasher::DIGEST_SIZE);
+        prefs.putBytes(partition->label, &entry, sizeof(entry));
+        prefs.end();
+    }
     return true;
-} 
\ No newline at end of file
+}
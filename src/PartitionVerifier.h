@@ -4,7 +4,7 @@
 #include <Arduino.h>
 #include <esp_ota_ops.h>
 #include <esp_partition.h>
-#include <MD5Builder.h>
+#include "SHA256Hasher.h"
 
 class PartitionVerifier {
 public:
@@ -20,9 +20,17 @@ public:
     // Check if rollback is possible
     static bool isRollbackPossible();
     
-    // Calculate partition hash
+    // SHA-256 of the app image in the partition (hex, empty on error).
+    // Covers the image's own length, not the whole slot, and matches the
+    // digest esptool appends to the image. Cached in NVS per build.
     static String calculatePartitionHash(const esp_partition_t* partition);
     
+    // Hash the first `length` bytes of a partition through flash mappings
+    static bool hashPartition(const esp_partition_t* partition, size_t length, SHA256Hasher& hasher);
+    
+    // Length of the app image in the partition, from its segment table
+    static bool getImageLength(const esp_partition_t* partition, size_t& length, bool& hashAppended);
+    
     // Verify partition data integrity
     static bool verifyPartitionIntegrity(const esp_partition_t* partition);
     
@@ -45,9 +53,13 @@ private:
     // Error message
     static String _lastError;
     
+    // Mapping window for hashing
+    static const size_t MMAP_WINDOW_SIZE;
+    
     // Helper methods
     static bool checkPartitionMagicBytes(const esp_partition_t* partition);
-    static bool checkPartitionCRC(const esp_partition_t* partition);
+    static bool checkImageDigest(const esp_partition_t* partition);
+    static bool getImageDigest(const esp_partition_t* partition, uint8_t digest[SHA256Hasher::DIGEST_SIZE]);
 };
 
 #endif // PARTITION_VERIFIER_H 
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "PersistenceService.h"
+#include <USBCDC.h>
+#include <string.h>
+#include "SpanTrace.h"
+
+#ifdef HOST_BUILD
+#define RTC_NOINIT_ATTR
+#else
+#include <esp_attr.h>
+#include <esp_system.h>
+#endif
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+PersistenceService::Writer PersistenceService::_writers[PersistenceService::MAX_WRITERS];
+int PersistenceService::_writerCount = 0;
+volatile int PersistenceService::_pending = 0;
+volatile uint32_t PersistenceService::_lastActivity = 0;
+portMUX_TYPE PersistenceService::_writerMux = portMUX_INITIALIZER_UNLOCKED;
+int PersistenceService::_hotStateWriter = -1;
+std::map<String, PersistenceService::HotValue> PersistenceService::_hotValues;
+std::mutex PersistenceService::_hotMutex;
+Preferences PersistenceService::_prefs;
+bool PersistenceService::_prefsOpen = false;
+String PersistenceService::_lastError = "";
+
+// Constants
+static const char* STATE_NAMESPACE = "state";
+static const uint32_t HOT_STATE_DELAY_MS = 3000;
+static const uint32_t RTC_MAGIC = 0x50525443;  // "PRTC"
+
+// Left alone by the startup code, so it survives software resets, panics and
+// watchdog resets; the checksum catches the garbage found after a power-on
+struct RtcState {
+    uint32_t magic;
+    uint32_t values[RTC_SLOT_COUNT];
+    uint32_t checksum;
+};
+RTC_NOINIT_ATTR static RtcState rtcState;
+
+void PersistenceService::begin() {
+    if (!_prefsOpen) {
+        _prefsOpen = _prefs.begin(STATE_NAMESPACE, false);
+    }
+    _hotStateWriter = registerWriter("state", writeHotState, HOT_STATE_DELAY_MS);
+    _lastActivity = millis();
+
+#ifndef HOST_BUILD
+    // esp_restart() runs this before resetting, so ESP.restart() from any
+    // handler keeps pending state
+    static bool shutdownRegistered = false;
+    if (!shutdownRegistered) {
+        shutdownRegistered = esp_register_shutdown_handler(shutdownHandler) == ESP_OK;
+    }
+#endif
+}
+
+void PersistenceService::loop() {
+    if (_pending == 0) return;
+
+    uint32_t now = millis();
+    bool idle = now - _lastActivity >= PERSIST_IDLE_MS;
+
+    for (int i = 0; i < _writerCount; i++) {
+        portENTER_CRITICAL(&_writerMux);
+        const Writer& writer = _writers[i];
+        bool due = writer.dirty &&
+                   ((idle && now - writer.lastDirty >= writer.delayMs) ||
+                    now - writer.firstDirty >= PERSIST_MAX_DEFER_MS);
+        portEXIT_CRITICAL(&_writerMux);
+
+        if (due) {
+            runWriter(i);
+        }
+    }
+}
+
+bool PersistenceService::flush() {
+    bool ok = true;
+    for (int i = 0; i < _writerCount; i++) {
+        if (!runWriter(i)) ok = false;
+    }
+    return ok;
+}
+
+void PersistenceService::clear() {
+    portENTER_CRITICAL(&_writerMux);
+    for (int i = 0; i < _writerCount; i++) {
+        _writers[i].dirty = false;
+    }
+    _pending = 0;
+    portEXIT_CRITICAL(&_writerMux);
+
+    std::lock_guard<std::mutex> lock(_hotMutex);
+    _hotValues.clear();
+    if (_prefsOpen) {
+        _prefs.clear();
+    }
+}
+
+int PersistenceService::registerWriter(const char* name, PersistWriter writer, uint32_t delayMs) {
+    for (int i = 0; i < _writerCount; i++) {
+        if (strcmp(_writers[i].name, name) == 0) {
+            _writers[i].write = writer;
+            _writers[i].delayMs = delayMs;
+            return i;
+        }
+    }
+    if (_writerCount >= MAX_WRITERS || writer == nullptr) {
+        _lastError = String("Cannot register writer ") + name;
+        USBSerial.printf("PersistenceService: %s\n", _lastError.c_str());
+        return -1;
+    }
+
+    Writer& entry = _writers[_writerCount];
+    memset(&entry, 0, sizeof(entry));
+    entry.name = name;
+    entry.write = writer;
+    entry.delayMs = delayMs;
+    return _writerCount++;
+}
+
+void PersistenceService::markDirty(int handle) {
+    if (handle < 0 || handle >= _writerCount) return;
+
+    uint32_t now = millis();
+    portENTER_CRITICAL(&_writerMux);
+    Writer& writer = _writers[handle];
+    if (!writer.dirty) {
+        writer.dirty = true;
+        writer.firstDirty = now;
+        _pending = _pending + 1;
+    }
+    writer.lastDirty = now;
+    writer.marks++;
+    portEXIT_CRITICAL(&_writerMux);
+}
+
+bool PersistenceService::runWriter(int handle) {
+    // Clear first: a change made while the writer runs marks it dirty again
+    portENTER_CRITICAL(&_writerMux);
+    Writer& writer = _writers[handle];
+    bool wasDirty = writer.dirty;
+    if (wasDirty) {
+        writer.dirty = false;
+        _pending = _pending - 1;
+    }
+    portEXIT_CRITICAL(&_writerMux);
+
+    if (!wasDirty) return true;
+
+    SPAN_BEGIN(SPAN_FLASH_WRITE, 0);
+    bool written = writer.write();
+    SPAN_END(SPAN_FLASH_WRITE);
+    if (written) {
+        writer.writes++;
+        return true;
+    }
+
+    // Retry after another delay rather than on every loop()
+    writer.failures++;
+    _lastError = String("Writing ") + writer.name + " failed";
+    USBSerial.printf("PersistenceService: %s\n", _lastError.c_str());
+    uint32_t now = millis();
+    portENTER_CRITICAL(&_writerMux);
+    if (!writer.dirty) {
+        writer.dirty = true;
+        _pending = _pending + 1;
+    }
+    writer.firstDirty = now;
+    writer.lastDirty = now;
+    portEXIT_CRITICAL(&_writerMux);
+    return false;
+}
+
+void PersistenceService::shutdownHandler() {
+    if (_pending > 0) {
+        flush();
+    }
+}
+
+// ===== Hot state =====
+
+void PersistenceService::loadHotValue(const char* key, bool isInt) {
+    // Called with _hotMutex held
+    if (_hotValues.find(key) != _hotValues.end()) return;
+
+    HotValue entry;
+    entry.isInt = isInt;
+    entry.dirty = false;
+    if (_prefsOpen && _prefs.isKey(key)) {
+        entry.value = isInt ? String((long)_prefs.getInt(key, 0)) : _prefs.getString(key);
+    }
+    _hotValues[key] = entry;
+}
+
+String PersistenceService::getString(const char* key, const String& defaultValue) {
+    std::lock_guard<std::mutex> lock(_hotMutex);
+    loadHotValue(key, false);
+    const String& value = _hotValues[key].value;
+    return value.isEmpty() ? defaultValue : value;
+}
+
+void PersistenceService::putString(const char* key, const String& value) {
+    {
+        std::lock_guard<std::mutex> lock(_hotMutex);
+        loadHotValue(key, false);
+        HotValue& entry = _hotValues[key];
+        if (entry.value == value) return;
+        entry.value = value;
+        entry.dirty = true;
+    }
+    markDirty(_hotStateWriter);
+}
+
+int32_t PersistenceService::getInt(const char* key, int32_t defaultValue) {
+    std::lock_guard<std::mutex> lock(_hotMutex);
+    loadHotValue(key, true);
+    const String& value = _hotValues[key].value;
+    return value.isEmpty() ? defaultValue : (int32_t)value.toInt();
+}
+
+void PersistenceService::putInt(const char* key, int32_t value) {
+    String text((long)value);
+    {
+        std::lock_guard<std::mutex> lock(_hotMutex);
+        loadHotValue(key, true);
+        HotValue& entry = _hotValues[key];
+        if (entry.value == text) return;
+        entry.value = text;
+        entry.dirty = true;
+    }
+    markDirty(_hotStateWriter);
+}
+
+bool PersistenceService::writeHotState() {
+    if (!_prefsOpen) return false;
+
+    // Copy out the changes so puts from the input tasks never wait on NVS
+    std::map<String, HotValue> changed;
+    {
+        std::lock_guard<std::mutex> lock(_hotMutex);
+        for (auto& entry : _hotValues) {
+            if (!entry.second.dirty) continue;
+            changed[entry.first] = entry.second;
+            entry.second.dirty = false;
+        }
+    }
+
+    bool ok = true;
+    for (const auto& entry : changed) {
+        const HotValue& value = entry.second;
+        size_t written = value.isInt ? _prefs.putInt(entry.first.c_str(), (int32_t)value.value.toInt())
+                                     : _prefs.putString(entry.first.c_str(), value.value);
+        if (written == 0 && !value.value.isEmpty()) {
+            std::lock_guard<std::mutex> lock(_hotMutex);
+            _hotValues[entry.first].dirty = true;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// ===== RTC memory =====
+
+uint32_t PersistenceService::rtcChecksum() {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ rtcState.magic) * 16777619u;
+    for (int i = 0; i < RTC_SLOT_COUNT; i++) {
+        hash = (hash ^ rtcState.values[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool PersistenceService::rtcValid() {
+    return rtcState.magic == RTC_MAGIC && rtcState.checksum == rtcChecksum();
+}
+
+uint32_t PersistenceService::getRtc(RtcSlot slot) {
+    if (slot >= RTC_SLOT_COUNT || !rtcValid()) return 0;
+    return rtcState.values[slot];
+}
+
+void PersistenceService::setRtc(RtcSlot slot, uint32_t value) {
+    if (slot >= RTC_SLOT_COUNT) return;
+    if (!rtcValid()) {
+        memset(&rtcState, 0, sizeof(rtcState));
+        rtcState.magic = RTC_MAGIC;
+    }
+    rtcState.values[slot] = value;
+    rtcState.checksum = rtcChecksum();
+}
+
+void PersistenceService::getStatus(JsonObject status) {
+    uint32_t now = millis();
+    status["pending"] = _pending;
+    status["idle_ms"] = now - _lastActivity;
+    status["delay_ms"] = PERSIST_DEFAULT_DELAY_MS;
+    status["idle_flush_ms"] = PERSIST_IDLE_MS;
+    status["max_defer_ms"] = PERSIST_MAX_DEFER_MS;
+
+    JsonArray writers = status.createNestedArray("writers");
+    for (int i = 0; i < _writerCount; i++) {
+        portENTER_CRITICAL(&_writerMux);
+        Writer writer = _writers[i];
+        portEXIT_CRITICAL(&_writerMux);
+
+        JsonObject entry = writers.createNestedObject();
+        entry["name"] = writer.name;
+        entry["dirty"] = writer.dirty;
+        entry["waiting_ms"] = writer.dirty ? now - writer.firstDirty : 0;
+        entry["marks"] = writer.marks;
+        entry["writes"] = writer.writes;
+        entry["failures"] = writer.failures;
+    }
+}
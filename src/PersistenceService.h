@@ -0,0 +1,124 @@
+#ifndef PERSISTENCE_SERVICE_H
+#define PERSISTENCE_SERVICE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <map>
+#include <mutex>
+
+// Write-behind persistence for runtime state. Callers change state in RAM and
+// mark it dirty; the service coalesces the writes and flushes them from loop()
+// once input has been quiet for a while, so nothing on the input path waits
+// for flash. Pending writes are also flushed on restart (shutdown handler),
+// on a low-voltage warning and on request (POST /api/state/flush).
+//
+// Hot values (current layer, ...) live in the NVS namespace "state" instead
+// of JSON files; counters that only need to survive a reset live in RTC
+// memory and never touch flash. Every delay can be overridden with a -D
+// build flag.
+
+// Default wait after the last change before a dirty writer is flushed
+#ifndef PERSIST_DEFAULT_DELAY_MS
+#define PERSIST_DEFAULT_DELAY_MS 5000
+#endif
+// Input must have been quiet this long before flushing
+#ifndef PERSIST_IDLE_MS
+#define PERSIST_IDLE_MS 2000
+#endif
+// Flush anyway once a change has waited this long
+#ifndef PERSIST_MAX_DEFER_MS
+#define PERSIST_MAX_DEFER_MS 60000
+#endif
+
+// Writes the owner's state to flash; returns false to retry later
+typedef bool (*PersistWriter)();
+
+// Values kept in RTC memory (survive resets, cleared on power loss)
+enum RtcSlot {
+    RTC_SLOT_BOOT_COUNT,
+    RTC_SLOT_LAST_BOOT_TIME,
+    RTC_SLOT_COUNT
+};
+
+class PersistenceService {
+public:
+    // Register the hot-state writer and the shutdown flush
+    static void begin();
+
+    // Flush writers whose delay has passed; call from loop()
+    static void loop();
+
+    // Write everything pending now; false if any writer failed
+    static bool flush();
+
+    // Drop pending writes and erase the hot state (factory reset)
+    static void clear();
+
+    // Register a writer (re-registering a name returns the same handle)
+    static int registerWriter(const char* name, PersistWriter writer,
+                              uint32_t delayMs = PERSIST_DEFAULT_DELAY_MS);
+
+    // Schedule a writer; cheap and safe from any task
+    static void markDirty(int handle);
+
+    // Record user input; flushes wait until input has been quiet
+    static void noteActivity() { _lastActivity = millis(); }
+
+    // Hot state in NVS, cached in RAM; puts are written behind
+    static String getString(const char* key, const String& defaultValue = String());
+    static void putString(const char* key, const String& value);
+    static int32_t getInt(const char* key, int32_t defaultValue = 0);
+    static void putInt(const char* key, int32_t value);
+
+    // RTC memory values, zero after a power-on
+    static uint32_t getRtc(RtcSlot slot);
+    static void setRtc(RtcSlot slot, uint32_t value);
+
+    // Pending writers and write counts
+    static void getStatus(JsonObject status);
+
+    static String getLastError() { return _lastError; }
+
+private:
+    static const int MAX_WRITERS = 8;
+
+    struct Writer {
+        const char* name;
+        PersistWriter write;
+        uint32_t delayMs;
+        bool dirty;
+        uint32_t firstDirty;   // Oldest unflushed change
+        uint32_t lastDirty;    // Newest unflushed change
+        uint32_t marks;        // markDirty() calls since boot
+        uint32_t writes;       // Successful writes since boot
+        uint32_t failures;
+    };
+
+    struct HotValue {
+        String value;
+        bool isInt;
+        bool dirty;
+    };
+
+    static bool runWriter(int handle);
+    static bool writeHotState();
+    static void loadHotValue(const char* key, bool isInt);
+    static bool rtcValid();
+    static uint32_t rtcChecksum();
+    static void shutdownHandler();
+
+    static Writer _writers[MAX_WRITERS];
+    static int _writerCount;
+    static volatile int _pending;
+    static volatile uint32_t _lastActivity;
+    static portMUX_TYPE _writerMux;
+    static int _hotStateWriter;
+    static std::map<String, HotValue> _hotValues;
+    static std::mutex _hotMutex;
+    static Preferences _prefs;
+    static bool _prefsOpen;
+    static String _lastError;
+};
+
+#endif // PERSISTENCE_SERVICE_H
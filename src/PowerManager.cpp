@@ -0,0 +1,206 @@
+#include "PowerManager.h"
+#include <USBCDC.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+
+#ifndef HOST_BUILD
+#include <esp_idf_version.h>
+#include <esp_pm.h>
+#endif
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+bool PowerManager::_configured = false;
+bool PowerManager::_lightSleep = false;
+bool PowerManager::_held[POWER_LOCK_COUNT] = { false };
+PowerManager::LockStats PowerManager::_stats[POWER_LOCK_COUNT];
+int8_t PowerManager::_usbBusActive = -1;
+int8_t PowerManager::_wifiLowLatency = -1;
+uint64_t PowerManager::_startUs = 0;
+portMUX_TYPE PowerManager::_statsMux = portMUX_INITIALIZER_UNLOCKED;
+String PowerManager::_lastError = "";
+
+// Constants
+static const char* LOCK_NAMES[POWER_LOCK_COUNT] = { "scan", "usb", "display", "ota" };
+
+#ifndef HOST_BUILD
+// One CPU_FREQ_MAX lock per reason, so esp_pm_dump_locks() shows who holds
+// the CPU up, and the lock that keeps light sleep off while USB is in use
+static esp_pm_lock_handle_t cpuLocks[POWER_LOCK_COUNT] = { nullptr };
+static esp_pm_lock_handle_t usbBusLock = nullptr;
+#endif
+
+bool PowerManager::begin() {
+    _startUs = esp_timer_get_time();
+
+#ifdef HOST_BUILD
+    _lastError = "Power management is not available on the host";
+    return false;
+#else
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        if (cpuLocks[i] == nullptr &&
+            esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, LOCK_NAMES[i], &cpuLocks[i]) != ESP_OK) {
+            cpuLocks[i] = nullptr;
+        }
+    }
+    if (usbBusLock == nullptr &&
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "usb_bus", &usbBusLock) != ESP_OK) {
+        usbBusLock = nullptr;
+    }
+
+    // No light sleep until HIDHandler has seen the bus
+    if (_usbBusActive < 0) {
+        _usbBusActive = 1;
+        if (usbBusLock) esp_pm_lock_acquire(usbBusLock);
+    }
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t config;
+#else
+    esp_pm_config_esp32s3_t config;
+#endif
+    config.max_freq_mhz = POWER_MAX_MHZ;
+    config.min_freq_mhz = POWER_MIN_MHZ;
+    config.light_sleep_enable = POWER_LIGHT_SLEEP != 0;
+
+    esp_err_t err = esp_pm_configure(&config);
+    if (err == ESP_ERR_NOT_SUPPORTED && config.light_sleep_enable) {
+        // The framework was built without tickless idle; scale the frequency only
+        config.light_sleep_enable = false;
+        err = esp_pm_configure(&config);
+    }
+    if (err != ESP_OK) {
+        _lastError = String("esp_pm_configure failed: ") + esp_err_to_name(err);
+        USBSerial.printf("PowerManager: %s\n", _lastError.c_str());
+        return false;
+    }
+
+    _configured = true;
+    _lightSleep = config.light_sleep_enable;
+    USBSerial.printf("PowerManager: %d-%d MHz, light sleep %s\n",
+                     POWER_MIN_MHZ, POWER_MAX_MHZ, _lightSleep ? "enabled" : "unavailable");
+    return true;
+#endif
+}
+
+void PowerManager::acquire(PowerLockReason reason) {
+    if (reason >= POWER_LOCK_COUNT) return;
+
+#ifndef HOST_BUILD
+    if (cpuLocks[reason]) esp_pm_lock_acquire(cpuLocks[reason]);
+#endif
+
+    uint64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&_statsMux);
+    LockStats& stats = _stats[reason];
+    if (stats.depth++ == 0) {
+        stats.acquisitions++;
+        stats.heldSinceUs = now;
+    }
+    portEXIT_CRITICAL(&_statsMux);
+}
+
+void PowerManager::release(PowerLockReason reason) {
+    if (reason >= POWER_LOCK_COUNT) return;
+
+    uint64_t now = esp_timer_get_time();
+    bool wasHeld = false;
+    portENTER_CRITICAL(&_statsMux);
+    LockStats& stats = _stats[reason];
+    if (stats.depth > 0) {
+        wasHeld = true;
+        if (--stats.depth == 0) {
+            stats.heldUs += now - stats.heldSinceUs;
+        }
+    }
+    portEXIT_CRITICAL(&_statsMux);
+
+#ifndef HOST_BUILD
+    if (wasHeld && cpuLocks[reason]) esp_pm_lock_release(cpuLocks[reason]);
+#else
+    (void)wasHeld;
+#endif
+}
+
+void PowerManager::setHeld(PowerLockReason reason, bool held) {
+    if (reason >= POWER_LOCK_COUNT) return;
+
+    portENTER_CRITICAL(&_statsMux);
+    bool changed = _held[reason] != held;
+    _held[reason] = held;
+    portEXIT_CRITICAL(&_statsMux);
+
+    if (!changed) return;
+    if (held) {
+        acquire(reason);
+    } else {
+        release(reason);
+    }
+}
+
+void PowerManager::setUsbBusActive(bool active) {
+    // Only the hid task reports the bus, so no lock is needed
+    int8_t state = active ? 1 : 0;
+    if (_usbBusActive == state) return;
+    bool wasActive = _usbBusActive != 0;
+    _usbBusActive = state;
+
+#ifndef HOST_BUILD
+    if (usbBusLock == nullptr || wasActive == active) return;
+    if (active) {
+        esp_pm_lock_acquire(usbBusLock);
+    } else {
+        esp_pm_lock_release(usbBusLock);
+    }
+#else
+    (void)wasActive;
+#endif
+}
+
+void PowerManager::setWifiLowLatency(bool lowLatency) {
+    int8_t state = lowLatency ? 1 : 0;
+    if (_wifiLowLatency == state) return;
+    _wifiLowLatency = state;
+
+    // Modem sleep delays incoming packets by up to a DTIM interval, which a
+    // live WebSocket session would notice; plain REST calls do not
+    if (!WiFi.setSleep(!lowLatency)) {
+        USBSerial.printf("PowerManager: could not %s WiFi modem sleep\n", lowLatency ? "disable" : "enable");
+    }
+}
+
+void PowerManager::getStatus(JsonObject status) {
+    uint64_t now = esp_timer_get_time();
+    uint64_t windowUs = now - _startUs;
+
+    status["configured"] = _configured;
+    status["min_mhz"] = POWER_MIN_MHZ;
+    status["max_mhz"] = POWER_MAX_MHZ;
+#ifndef HOST_BUILD
+    status["cpu_mhz"] = getCpuFrequencyMhz();
+#endif
+    status["light_sleep"] = _lightSleep;
+    status["usb_bus_active"] = _usbBusActive != 0;
+    status["light_sleep_allowed"] = _lightSleep && _usbBusActive == 0;
+    status["wifi_modem_sleep"] = _wifiLowLatency == 0;
+    status["window_ms"] = (uint32_t)(windowUs / 1000);
+    if (_lastError.length() > 0) {
+        status["error"] = _lastError;
+    }
+
+    JsonArray locks = status.createNestedArray("locks");
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        portENTER_CRITICAL(&_statsMux);
+        LockStats stats = _stats[i];
+        portEXIT_CRITICAL(&_statsMux);
+
+        uint64_t heldUs = stats.heldUs + (stats.depth > 0 ? now - stats.heldSinceUs : 0);
+        JsonObject entry = locks.createNestedObject();
+        entry["name"] = LOCK_NAMES[i];
+        entry["held"] = stats.depth > 0;
+        entry["acquisitions"] = stats.acquisitions;
+        entry["held_ms"] = (uint32_t)(heldUs / 1000);
+        entry["held_pct"] = windowUs > 0 ? (float)(heldUs * 1000 / windowUs) / 10.0f : 0.0f;
+    }
+}
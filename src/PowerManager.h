@@ -0,0 +1,106 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// CPU frequency scaling, automatic light sleep and WiFi modem sleep.
+//
+// ESP-IDF power management runs the CPU at POWER_MIN_MHZ whenever nothing
+// holds a power lock, and lets the idle task enter light sleep until the next
+// task wakes up. Work whose latency matters holds a lock for as long as it
+// runs: matrix scans and encoder polls, HID report delivery, display flushes
+// and OTA. Task periods do not change, so keystroke latency does not either;
+// check it with macropad_scan_duration_us and the task wake-up latency in
+// GET /api/tasks.
+//
+// Light sleep stops the USB PHY, so it is only allowed while no USB host is
+// using the bus (unplugged or suspended). WiFi uses modem sleep while no
+// WebSocket client is connected.
+//
+// Without CONFIG_PM_ENABLE in the framework the CPU stays at its boot
+// frequency and the locks only keep their statistics. Light sleep also needs
+// CONFIG_FREERTOS_USE_TICKLESS_IDLE; without it only the frequency scales.
+
+// Frequency range; 80 MHz keeps APB, and with it USB and the timers, at speed
+#ifndef POWER_MAX_MHZ
+#define POWER_MAX_MHZ 240
+#endif
+#ifndef POWER_MIN_MHZ
+#define POWER_MIN_MHZ 80
+#endif
+// Set to 0 to scale the frequency without ever entering light sleep
+#ifndef POWER_LIGHT_SLEEP
+#define POWER_LIGHT_SLEEP 1
+#endif
+
+// Why the CPU is held at full speed
+enum PowerLockReason {
+    POWER_LOCK_SCAN,      // Key matrix scan and encoder poll
+    POWER_LOCK_USB,       // HID report delivery and macro steps
+    POWER_LOCK_DISPLAY,   // Display flush
+    POWER_LOCK_OTA,       // Firmware download, upload and install
+    POWER_LOCK_COUNT
+};
+
+class PowerManager {
+public:
+    // Configure power management; false if the framework does not support it
+    static bool begin();
+
+    // Hold / drop full CPU speed; nests, and is safe from any task
+    static void acquire(PowerLockReason reason);
+    static void release(PowerLockReason reason);
+
+    // Hold or drop one long-lived lock (OTA); repeated calls are ignored
+    static void setHeld(PowerLockReason reason, bool held);
+
+    // Whether a USB host is using the bus; light sleep waits until it is not
+    static void setUsbBusActive(bool active);
+
+    // Keep WiFi fully awake (a WebSocket client is watching) or let the modem sleep
+    static void setWifiLowLatency(bool lowLatency);
+
+    // Mode, lock counts and time held, per reason
+    static void getStatus(JsonObject status);
+
+    static String getLastError() { return _lastError; }
+
+private:
+    struct LockStats {
+        uint32_t depth;          // Current holders
+        uint32_t acquisitions;   // Times the lock went from free to held
+        uint64_t heldUs;         // Time held, excluding the current hold
+        uint64_t heldSinceUs;    // Start of the current hold
+    };
+
+    static bool _configured;
+    static bool _lightSleep;
+    static bool _held[POWER_LOCK_COUNT];
+    static LockStats _stats[POWER_LOCK_COUNT];
+    static int8_t _usbBusActive;     // -1 until the first report
+    static int8_t _wifiLowLatency;   // -1 until the first report
+    static uint64_t _startUs;
+    static portMUX_TYPE _statsMux;
+    static String _lastError;
+};
+
+// Holds full CPU speed for a scope, optionally only when `engage` is true
+class PowerLock {
+public:
+    explicit PowerLock(PowerLockReason reason, bool engage = true) : _reason(reason), _engaged(engage) {
+        if (_engaged) PowerManager::acquire(_reason);
+    }
+    ~PowerLock() {
+        if (_engaged) PowerManager::release(_reason);
+    }
+
+private:
+    PowerLock(const PowerLock&);
+    PowerLock& operator=(const PowerLock&);
+
+    PowerLockReason _reason;
+    bool _engaged;
+};
+
+#endif // POWER_MANAGER_H
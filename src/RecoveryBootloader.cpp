@@ -1,6 +1,7 @@
 #include "RecoveryBootloader.h"
 #include "OTAUpdateManager.h"
 #include "ConfigManager.h"
+#include "PersistenceService.h"
 #include <LittleFS.h>
 
 // Static member initialization
@@ -12,6 +13,12 @@ void RecoveryBootloader::begin() {
     // Initialize preferences
     _prefs.begin("recovery", false);
     
+    // Boot counting moved to RTC memory; drop the NVS keys older firmware wrote
+    if (_prefs.isKey("boot_count")) {
+        _prefs.remove("boot_count");
+        _prefs.remove("last_boot_time");
+    }
+    
     // Increment boot count to detect boot loops
     incrementBootCount();
     
@@ -96,6 +103,9 @@ bool RecoveryBootloader::performFactoryReset() {
     otaPrefs.clear();
     otaPrefs.end();
     
+    // Runtime state (current layer, ...) and anything still waiting to be written
+    PersistenceService::clear();
+    
     // Remove all config files - simplified to reduce code size
     if (LittleFS.begin()) {
         if (LittleFS.exists("/config")) {
@@ -193,29 +203,31 @@ bool RecoveryBootloader::isInBootLoop() {
 }
 
 void RecoveryBootloader::resetBootCount() {
-    _prefs.putInt("boot_count", 0);
-    _prefs.putULong("last_boot_time", millis());
+    PersistenceService::setRtc(RTC_SLOT_BOOT_COUNT, 0);
+    PersistenceService::setRtc(RTC_SLOT_LAST_BOOT_TIME, millis());
 }
 
+// Boot count and time live in RTC memory: they survive the resets of a boot
+// loop without an NVS write on every boot, and a power cycle starts afresh
 void RecoveryBootloader::incrementBootCount() {
     int bootCount = getBootCount();
     bootCount++;
-    _prefs.putInt("boot_count", bootCount);
+    PersistenceService::setRtc(RTC_SLOT_BOOT_COUNT, bootCount);
     
     // Update last boot time
     setLastBootTime(millis());
 }
 
 int RecoveryBootloader::getBootCount() {
-    return _prefs.getInt("boot_count", 0);
+    return (int)PersistenceService::getRtc(RTC_SLOT_BOOT_COUNT);
 }
 
 unsigned long RecoveryBootloader::getLastBootTime() {
-    return _prefs.getULong("last_boot_time", 0);
+    return PersistenceService::getRtc(RTC_SLOT_LAST_BOOT_TIME);
 }
 
 void RecoveryBootloader::setLastBootTime(unsigned long time) {
-    _prefs.putULong("last_boot_time", time);
+    PersistenceService::setRtc(RTC_SLOT_LAST_BOOT_TIME, time);
 }
 
 String RecoveryBootloader::getStatusMessage() {
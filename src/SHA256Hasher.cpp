@@ -0,0 +1,72 @@
+#include "SHA256Hasher.h"
+#include <mbedtls/version.h>
+
+// mbedtls 2.x (Arduino core 2.x) names the int-returning calls *_ret
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+#define sha256_starts mbedtls_sha256_starts_ret
+#define sha256_update mbedtls_sha256_update_ret
+#define sha256_finish mbedtls_sha256_finish_ret
+#else
+#define sha256_starts mbedtls_sha256_starts
+#define sha256_update mbedtls_sha256_update
+#define sha256_finish mbedtls_sha256_finish
+#endif
+
+SHA256Hasher::SHA256Hasher() {
+    mbedtls_sha256_init(&_context);
+    memset(_digest, 0, sizeof(_digest));
+}
+
+SHA256Hasher::~SHA256Hasher() {
+    mbedtls_sha256_free(&_context);
+}
+
+void SHA256Hasher::begin() {
+    mbedtls_sha256_free(&_context);
+    mbedtls_sha256_init(&_context);
+    sha256_starts(&_context, 0);
+    memset(_digest, 0, sizeof(_digest));
+}
+
+void SHA256Hasher::add(const uint8_t* data, size_t length) {
+    if (data == nullptr || length == 0) return;
+    sha256_update(&_context, data, length);
+}
+
+void SHA256Hasher::calculate() {
+    sha256_finish(&_context, _digest);
+}
+
+String SHA256Hasher::toHex(const uint8_t digest[DIGEST_SIZE]) {
+    static const char hexDigits[] = "0123456789abcdef";
+    char hex[DIGEST_SIZE * 2 + 1];
+    for (size_t i = 0; i < DIGEST_SIZE; i++) {
+        hex[i * 2] = hexDigits[digest[i] >> 4];
+        hex[i * 2 + 1] = hexDigits[digest[i] & 0x0F];
+    }
+    hex[DIGEST_SIZE * 2] = '\0';
+    return String(hex);
+}
+
+bool SHA256Hasher::parseHex(const String& hex, uint8_t out[DIGEST_SIZE]) {
+    String trimmed = hex;
+    trimmed.trim();
+    if (trimmed.length() < DIGEST_SIZE * 2) return false;
+
+    for (size_t i = 0; i < DIGEST_SIZE; i++) {
+        uint8_t value = 0;
+        for (size_t j = 0; j < 2; j++) {
+            char c = trimmed[i * 2 + j];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+            else return false;
+        }
+        out[i] = value;
+    }
+
+    // Allow "<digest>  <filename>" as written by sha256sum
+    return trimmed.length() == DIGEST_SIZE * 2 || trimmed[DIGEST_SIZE * 2] == ' ' ||
+           trimmed[DIGEST_SIZE * 2] == '\t';
+}
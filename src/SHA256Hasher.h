@@ -0,0 +1,46 @@
+#ifndef SHA256_HASHER_H
+#define SHA256_HASHER_H
+
+#include <Arduino.h>
+#include <mbedtls/sha256.h>
+
+// Incremental SHA-256 with the same shape as MD5Builder. Runs on the S3's
+// SHA accelerator through mbedtls (CONFIG_MBEDTLS_HARDWARE_SHA), falling
+// back to software while another context holds the engine.
+class SHA256Hasher {
+public:
+    static const size_t DIGEST_SIZE = 32;
+
+    SHA256Hasher();
+    ~SHA256Hasher();
+
+    // Start a new digest
+    void begin();
+
+    // Hash more data
+    void add(const uint8_t* data, size_t length);
+
+    // Finish the digest; the result is then available from the getters
+    void calculate();
+
+    // Raw digest
+    const uint8_t* getBytes() const { return _digest; }
+
+    // Lowercase hex digest
+    String toString() const { return toHex(_digest); }
+
+    // Lowercase hex of any digest
+    static String toHex(const uint8_t digest[DIGEST_SIZE]);
+
+    // Parse a hex digest (any case, surrounding whitespace ignored)
+    static bool parseHex(const String& hex, uint8_t out[DIGEST_SIZE]);
+
+private:
+    SHA256Hasher(const SHA256Hasher&);
+    SHA256Hasher& operator=(const SHA256Hasher&);
+
+    mbedtls_sha256_context _context;
+    uint8_t _digest[DIGEST_SIZE];
+};
+
+#endif // SHA256_HASHER_H
@@ -0,0 +1,283 @@
+#include "SpanTrace.h"
+#include <USBCDC.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+SpanTrace::Ring SpanTrace::_rings[SPAN_CORES];
+std::atomic<bool> SpanTrace::_recording(false);
+bool SpanTrace::_freezeOnOverrun = false;
+SpanTrace::TaskName SpanTrace::_taskNames[MAX_TASK_NAMES];
+uint8_t SpanTrace::_taskNameCount = 0;
+portMUX_TYPE SpanTrace::_mux = portMUX_INITIALIZER_UNLOCKED;
+String SpanTrace::_lastError = "";
+
+// Constants
+static const char* SPAN_NAMES[SPAN_COUNT] = {
+    "scan", "debounce", "dispatch", "hid_send", "led_show", "display_flush", "json_parse", "flash_write", "overrun"
+};
+static const char* SPAN_CATEGORIES[SPAN_COUNT] = {
+    "input", "input", "input", "usb", "ui", "ui", "config", "storage", "watchdog"
+};
+// Name of the argument in the trace viewer; nullptr if the span has none
+static const char* SPAN_ARGS[SPAN_COUNT] = {
+    nullptr, "key", "key", "report_id", nullptr, "pixels", "bytes", "bytes", "stage"
+};
+
+bool SpanTrace::begin() {
+    for (int core = 0; core < SPAN_CORES; core++) {
+        Ring& ring = _rings[core];
+        if (ring.records != nullptr) continue;
+
+        // Internal RAM only gets an eighth, enough for the last few hundred ms
+        ring.capacity = SPAN_RING_RECORDS;
+        ring.records = (Record*)heap_caps_malloc(ring.capacity * sizeof(Record), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (ring.records == nullptr) {
+            ring.capacity = SPAN_RING_RECORDS / 8;
+            ring.records = (Record*)heap_caps_malloc(ring.capacity * sizeof(Record), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        }
+        if (ring.records == nullptr) {
+            ring.capacity = 0;
+            _lastError = "No memory for the span rings";
+            USBSerial.println("SpanTrace: " + _lastError);
+            return false;
+        }
+    }
+
+    start();
+    return true;
+}
+
+void SpanTrace::record(SpanId span, char phase, uint32_t arg) {
+    BaseType_t core = xPortGetCoreID();
+    if (core < 0 || core >= SPAN_CORES) return;
+    Ring& ring = _rings[core];
+    if (ring.records == nullptr) return;
+
+    // Tasks on the same core may preempt each other; each takes its own slot
+    uint32_t slot = ring.head.fetch_add(1, std::memory_order_relaxed);
+    Record& entry = ring.records[slot % ring.capacity];
+    entry.timestampUs = (uint32_t)esp_timer_get_time();
+    entry.task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+    entry.arg = arg;
+    entry.span = (uint8_t)span;
+    entry.phase = phase;
+    entry.reserved = 0;
+}
+
+void SpanTrace::nameCurrentTask(const char* name) {
+    uint32_t task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < _taskNameCount; i++) {
+        if (_taskNames[i].task == task) {
+            _taskNames[i].name = name;
+            portEXIT_CRITICAL(&_mux);
+            return;
+        }
+    }
+    if (_taskNameCount < MAX_TASK_NAMES) {
+        _taskNames[_taskNameCount].task = task;
+        _taskNames[_taskNameCount].name = name;
+        _taskNameCount++;
+    }
+    portEXIT_CRITICAL(&_mux);
+}
+
+const char* SpanTrace::taskName(uint32_t task) {
+    const char* name = nullptr;
+    portENTER_CRITICAL(&_mux);
+    for (uint8_t i = 0; i < _taskNameCount; i++) {
+        if (_taskNames[i].task == task) {
+            name = _taskNames[i].name;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&_mux);
+    return name;
+}
+
+void SpanTrace::start() {
+    _recording.store(false, std::memory_order_relaxed);
+    for (int core = 0; core < SPAN_CORES; core++) {
+        _rings[core].head.store(0, std::memory_order_relaxed);
+    }
+    _recording.store(_rings[0].records != nullptr, std::memory_order_relaxed);
+}
+
+void SpanTrace::stop() {
+    _recording.store(false, std::memory_order_relaxed);
+}
+
+void SpanTrace::getStatus(JsonObject status) {
+    status["recording"] = isRecording();
+    status["freeze_on_overrun"] = _freezeOnOverrun;
+    status["enabled"] = SPAN_TRACE != 0;
+    if (_lastError.length() > 0) {
+        status["error"] = _lastError;
+    }
+
+    JsonArray cores = status.createNestedArray("cores");
+    for (int core = 0; core < SPAN_CORES; core++) {
+        const Ring& ring = _rings[core];
+        uint32_t head = ring.head.load(std::memory_order_relaxed);
+        JsonObject obj = cores.createNestedObject();
+        obj["capacity"] = ring.capacity;
+        obj["records"] = head < ring.capacity ? head : ring.capacity;
+        obj["written"] = head;
+    }
+}
+
+// ===== Export =====
+
+SpanTrace::Exporter::Exporter()
+    : _part(HEADER), _core(0), _index(0), _baseUs(0), _needComma(false), _lineLength(0), _lineOffset(0) {
+    // Writers that are mid-record finish within a few instructions; a
+    // record torn by that race shows up as one odd event, not a crash
+    SpanTrace::stop();
+
+    bool haveBase = false;
+    for (int core = 0; core < SPAN_CORES; core++) {
+        const Ring& ring = _rings[core];
+        uint32_t head = ring.head.load(std::memory_order_relaxed);
+        _count[core] = head < ring.capacity ? head : ring.capacity;
+        _first[core] = head - _count[core];
+        _threadCount[core] = 0;
+
+        for (uint32_t n = 0; n < _count[core]; n++) {
+            const Record& entry = ring.records[(_first[core] + n) % ring.capacity];
+
+            // Timestamps are relative to the oldest record on either core
+            if (!haveBase || (int32_t)(entry.timestampUs - _baseUs) < 0) {
+                _baseUs = entry.timestampUs;
+                haveBase = true;
+            }
+
+            bool known = false;
+            for (uint8_t t = 0; t < _threadCount[core]; t++) {
+                if (_threads[core][t] == entry.task) {
+                    known = true;
+                    break;
+                }
+            }
+            if (!known && _threadCount[core] < MAX_THREADS) {
+                _threads[core][_threadCount[core]++] = entry.task;
+            }
+        }
+    }
+}
+
+size_t SpanTrace::Exporter::read(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (_lineOffset >= _lineLength) {
+            if (!renderNext()) break;
+        }
+        size_t n = _lineLength - _lineOffset;
+        if (n > maxLen - written) n = maxLen - written;
+        memcpy(buffer + written, _line + _lineOffset, n);
+        _lineOffset += n;
+        written += n;
+    }
+    return written;
+}
+
+bool SpanTrace::Exporter::renderNext() {
+    _lineOffset = 0;
+    _lineLength = 0;
+    const char* comma = _needComma ? "," : "";
+    int length = -1;
+
+    while (length < 0) {
+        switch (_part) {
+            case HEADER:
+                length = snprintf(_line, sizeof(_line), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+                _part = PROCESS_NAMES;
+                comma = "";
+                break;
+
+            case PROCESS_NAMES:
+                if (_core >= SPAN_CORES) {
+                    _part = THREAD_NAMES;
+                    _core = 0;
+                    _index = 0;
+                    continue;
+                }
+                length = snprintf(_line, sizeof(_line),
+                                  "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"Core %u\"}}",
+                                  comma, _core, _core);
+                _core++;
+                break;
+
+            case THREAD_NAMES: {
+                if (_core >= SPAN_CORES) {
+                    _part = EVENTS;
+                    _core = 0;
+                    _index = 0;
+                    continue;
+                }
+                if (_index >= _threadCount[_core]) {
+                    _core++;
+                    _index = 0;
+                    continue;
+                }
+                uint32_t task = _threads[_core][_index++];
+                const char* name = taskName(task);
+                char fallback[20];
+                if (name == nullptr) {
+                    snprintf(fallback, sizeof(fallback), "task %08x", (unsigned)task);
+                    name = fallback;
+                }
+                length = snprintf(_line, sizeof(_line),
+                                  "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                                  comma, _core, (unsigned)task, name);
+                break;
+            }
+
+            case EVENTS: {
+                if (_core >= SPAN_CORES) {
+                    _part = FOOTER;
+                    continue;
+                }
+                if (_index >= _count[_core]) {
+                    _core++;
+                    _index = 0;
+                    continue;
+                }
+                const Ring& ring = _rings[_core];
+                Record entry = ring.records[(_first[_core] + _index++) % ring.capacity];
+                if (entry.span >= SPAN_COUNT) continue;
+
+                int32_t ts = (int32_t)(entry.timestampUs - _baseUs);
+                if (ts < 0) ts = 0;
+                length = snprintf(_line, sizeof(_line),
+                                  "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%ld,\"pid\":%u,\"tid\":%u",
+                                  comma, SPAN_NAMES[entry.span], SPAN_CATEGORIES[entry.span], entry.phase,
+                                  (long)ts, _core, (unsigned)entry.task);
+                if (entry.phase == 'i') {
+                    length += snprintf(_line + length, sizeof(_line) - length, ",\"s\":\"t\"");
+                }
+                if (entry.phase != 'E' && SPAN_ARGS[entry.span] != nullptr) {
+                    length += snprintf(_line + length, sizeof(_line) - length, ",\"args\":{\"%s\":%u}",
+                                       SPAN_ARGS[entry.span], (unsigned)entry.arg);
+                }
+                length += snprintf(_line + length, sizeof(_line) - length, "}");
+                break;
+            }
+
+            case FOOTER:
+                length = snprintf(_line, sizeof(_line), "\n]}\n");
+                _part = DONE;
+                break;
+
+            case DONE:
+                return false;
+        }
+    }
+
+    _needComma = _part != PROCESS_NAMES || _core > 0;
+    _lineLength = (size_t)length < sizeof(_line) ? (size_t)length : sizeof(_line) - 1;
+    return true;
+}
@@ -0,0 +1,164 @@
+#ifndef SPAN_TRACE_H
+#define SPAN_TRACE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+// Span instrumentation exported as a Chrome Trace Event timeline.
+//
+// SPAN_BEGIN/SPAN_END (or a SpanScope) append a 16-byte record to the ring
+// of the core they run on, so the two cores never share a slot. Timestamps
+// come from esp_timer rather than the CPU cycle counter: the cycle counter is
+// per core and its rate follows the DFS frequency (see PowerManager), so it
+// can neither order events across cores nor be turned back into time.
+//
+// Recording runs from boot as a flight recorder. An export stops it and
+// renders both rings as trace JSON, one process per core and one thread per
+// task, for ui.perfetto.dev or chrome://tracing; start() clears the rings
+// and records again. Build with -DSPAN_TRACE=0 to compile the spans out.
+
+#ifndef SPAN_TRACE
+#define SPAN_TRACE 1
+#endif
+
+// Records per core, in PSRAM when there is some
+#ifndef SPAN_RING_RECORDS
+#define SPAN_RING_RECORDS 4096
+#endif
+
+#define SPAN_CORES 2
+
+// Instrumented spans
+enum SpanId {
+    SPAN_SCAN,            // Key matrix scan
+    SPAN_DEBOUNCE,        // Accepting a key state change; arg: key index
+    SPAN_DISPATCH,        // Key action; arg: key index
+    SPAN_HID_SEND,        // Report handed to TinyUSB; arg: report ID
+    SPAN_LED_SHOW,        // LED frame
+    SPAN_DISPLAY_FLUSH,   // Pixels pushed to the display; arg: pixels
+    SPAN_JSON_PARSE,      // deserializeJson(); arg: input bytes
+    SPAN_FLASH_WRITE,     // Filesystem or NVS write; arg: bytes
+    SPAN_OVERRUN,         // Instant: a stage overran its budget; arg: WatchdogStage
+    SPAN_COUNT
+};
+
+class SpanTrace {
+public:
+    struct Record {
+        uint32_t timestampUs;   // Low 32 bits of esp_timer_get_time()
+        uint32_t task;          // Writer's task handle
+        uint32_t arg;
+        uint8_t span;
+        char phase;             // 'B', 'E' or 'i'
+        uint16_t reserved;
+    };
+
+    // Streams one trace as JSON; recording stays stopped until start()
+    class Exporter {
+    public:
+        Exporter();
+
+        // Fill up to maxLen bytes; 0 once the trace is complete
+        size_t read(uint8_t* buffer, size_t maxLen);
+
+    private:
+        static const uint8_t MAX_THREADS = 16;
+
+        enum Part { HEADER, PROCESS_NAMES, THREAD_NAMES, EVENTS, FOOTER, DONE };
+
+        bool renderNext();
+
+        Part _part;
+        uint8_t _core;
+        uint32_t _index;
+        uint32_t _first[SPAN_CORES];   // Sequence number of the oldest record
+        uint32_t _count[SPAN_CORES];
+        uint32_t _threads[SPAN_CORES][MAX_THREADS];
+        uint8_t _threadCount[SPAN_CORES];
+        uint32_t _baseUs;
+        bool _needComma;
+        char _line[224];
+        size_t _lineLength;
+        size_t _lineOffset;
+    };
+
+    // Allocate the per-core rings and start recording
+    static bool begin();
+
+    // Append a record to the calling core's ring; use the macros
+    static void record(SpanId span, char phase, uint32_t arg);
+    static bool isRecording() { return _recording.load(std::memory_order_relaxed); }
+
+    // Name the calling task in exported traces
+    static void nameCurrentTask(const char* name);
+
+    // Clear the rings and record / stop recording
+    static void start();
+    static void stop();
+
+    // Stop recording when a stage overruns its budget (see BudgetWatchdog),
+    // so the stall stays in the rings until someone exports it
+    static void setFreezeOnOverrun(bool freeze) { _freezeOnOverrun = freeze; }
+    static bool getFreezeOnOverrun() { return _freezeOnOverrun; }
+
+    // Recording state and ring fill per core
+    static void getStatus(JsonObject status);
+
+    static String getLastError() { return _lastError; }
+
+private:
+    struct Ring {
+        Record* records;
+        uint32_t capacity;
+        std::atomic<uint32_t> head;   // Records written since start()
+    };
+
+    struct TaskName {
+        uint32_t task;
+        const char* name;
+    };
+
+    static const uint8_t MAX_TASK_NAMES = 16;
+
+    static const char* taskName(uint32_t task);
+
+    static Ring _rings[SPAN_CORES];
+    static std::atomic<bool> _recording;
+    static bool _freezeOnOverrun;
+    static TaskName _taskNames[MAX_TASK_NAMES];
+    static uint8_t _taskNameCount;
+    static portMUX_TYPE _mux;
+    static String _lastError;
+};
+
+#if SPAN_TRACE
+#define SPAN_BEGIN(span, arg) \
+    do { if (SpanTrace::isRecording()) SpanTrace::record((span), 'B', (uint32_t)(arg)); } while (0)
+#define SPAN_END(span) \
+    do { if (SpanTrace::isRecording()) SpanTrace::record((span), 'E', 0); } while (0)
+#define SPAN_INSTANT(span, arg) \
+    do { if (SpanTrace::isRecording()) SpanTrace::record((span), 'i', (uint32_t)(arg)); } while (0)
+#else
+#define SPAN_BEGIN(span, arg) do { } while (0)
+#define SPAN_END(span) do { } while (0)
+#define SPAN_INSTANT(span, arg) do { } while (0)
+#endif
+
+// Records a span for the rest of the scope
+class SpanScope {
+public:
+    explicit SpanScope(SpanId span, uint32_t arg = 0) : _span(span) {
+        SPAN_BEGIN(_span, arg);
+        (void)arg;
+    }
+    ~SpanScope() { SPAN_END(_span); }
+
+private:
+    SpanScope(const SpanScope&);
+    SpanScope& operator=(const SpanScope&);
+
+    SpanId _span;
+};
+
+#endif // SPAN_TRACE_H
@@ -0,0 +1,403 @@
+#include "StorageBenchmark.h"
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include "FileSystemUtils.h"
+#include "VersionManager.h"
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+volatile bool StorageBenchmark::_running = false;
+uint32_t StorageBenchmark::_seed = 0;
+uint8_t* StorageBenchmark::_buffer = nullptr;
+String StorageBenchmark::_results = "";
+String StorageBenchmark::_lastError = "";
+
+// Constants
+const size_t StorageBenchmark::RESULTS_DOCUMENT_SIZE = 4096;
+
+// Bumped whenever a parameter below changes; results of different suite
+// versions are not comparable
+static const int SUITE_VERSION = 1;
+
+static const char* BENCH_DIR = "/.bench";
+static const size_t MIN_FREE_BYTES = 256 * 1024;
+static const uint32_t RANDOM_SEED = 0x2545F491;
+
+static const size_t BLOCK_SIZES[] = {128, 512, 2048, 8192};
+static const size_t MAX_BLOCK_SIZE = 8192;
+static const size_t OPEN_CLOSE_ITERATIONS = 100;
+static const size_t SMALL_FILE_COUNT = 64;
+static const size_t SMALL_FILE_SIZE = 128;
+static const size_t SEQUENTIAL_BYTES = 64 * 1024;
+static const size_t RANDOM_FILE_BYTES = 64 * 1024;
+static const size_t RANDOM_OPS = 64;
+static const size_t RANDOM_MAX_BLOCK_SIZE = 2048;
+static const size_t ENUMERATE_COUNTS[] = {16, 64, 128};
+static const size_t MACRO_FILE_SIZE = 256;     // A typical /macros entry
+static const size_t FRAGMENT_FILES = 32;
+static const size_t FRAGMENT_FILE_SIZE = 4096;
+static const size_t FRAGMENT_WRITE_BYTES = 64 * 1024;
+
+bool StorageBenchmark::start() {
+    if (_running) {
+        return fail("Benchmark already running");
+    }
+    _running = true;
+
+    // A few seconds of flash work; kept off the web server and loop tasks
+    BaseType_t created = xTaskCreate([](void* parameter) {
+        DynamicJsonDocument doc(RESULTS_DOCUMENT_SIZE);
+        if (!run(doc.to<JsonObject>())) {
+            doc.clear();
+            doc["error"] = _lastError;
+        }
+        String results;
+        serializeJson(doc, results);
+        _results = results;
+        USBSerial.printf("StorageBenchmark: %s\n", results.c_str());
+        _running = false;
+        vTaskDelete(NULL);
+    }, "storage_bench", 8192, NULL, 1, NULL);
+
+    if (created != pdPASS) {
+        _running = false;
+        return fail("Failed to start benchmark task");
+    }
+    return true;
+}
+
+bool StorageBenchmark::run(JsonObject results) {
+    size_t total = LittleFS.totalBytes();
+    size_t used = LittleFS.usedBytes();
+    if (total - used < MIN_FREE_BYTES) {
+        return fail("Need " + String(MIN_FREE_BYTES / 1024) + " KB free, have " + String((total - used) / 1024));
+    }
+
+    _buffer = (uint8_t*)malloc(MAX_BLOCK_SIZE);
+    if (!_buffer) {
+        return fail("Failed to allocate buffer");
+    }
+    // Period 128 divides every block size, so each block starts the same
+    for (size_t i = 0; i < MAX_BLOCK_SIZE; i++) {
+        _buffer[i] = (uint8_t)((i & 127) * 2 + 1);
+    }
+
+    FileSystemUtils::removeTree(BENCH_DIR);
+    FileSystemUtils::createDirPath(BENCH_DIR);
+    _seed = RANDOM_SEED;
+    unsigned long start = millis();
+
+    results["suite"] = SUITE_VERSION;
+    results["firmware"] = VersionManager::getVersionString();
+#ifdef HOST_BUILD
+    results["platform"] = "host";
+#else
+    results["platform"] = CONFIG_IDF_TARGET;
+#endif
+    JsonObject fs = results.createNestedObject("fs");
+    fs["total"] = total;
+    fs["used"] = used;
+
+    bool ok = benchOpenClose(results.createNestedObject("open_close")) &&
+              benchSmallFiles(results.createNestedObject("small_files")) &&
+              benchSequential(results.createNestedArray("sequential")) &&
+              benchRandom(results.createNestedArray("random")) &&
+              benchEnumerate(results.createNestedArray("enumerate")) &&
+              benchFragmentation(results.createNestedObject("fragmentation"));
+
+    FileSystemUtils::removeTree(BENCH_DIR);
+    free(_buffer);
+    _buffer = nullptr;
+    results["duration_ms"] = millis() - start;
+    return ok;
+}
+
+bool StorageBenchmark::benchOpenClose(JsonObject results) {
+    String path = String(BENCH_DIR) + "/open.txt";
+    if (!writePattern(path, SMALL_FILE_SIZE, SMALL_FILE_SIZE, nullptr)) {
+        return false;
+    }
+
+    uint32_t openTotal = 0;
+    uint32_t openMax = 0;
+    uint32_t closeTotal = 0;
+    for (size_t i = 0; i < OPEN_CLOSE_ITERATIONS; i++) {
+        uint32_t t0 = micros();
+        File file = LittleFS.open(path, "r");
+        uint32_t t1 = micros();
+        if (!file) {
+            return fail("Failed to open " + path);
+        }
+        file.close();
+        uint32_t t2 = micros();
+
+        openTotal += t1 - t0;
+        openMax = max(openMax, t1 - t0);
+        closeTotal += t2 - t1;
+    }
+
+    results["iterations"] = OPEN_CLOSE_ITERATIONS;
+    results["open_us"] = openTotal / OPEN_CLOSE_ITERATIONS;
+    results["open_max_us"] = openMax;
+    results["close_us"] = closeTotal / OPEN_CLOSE_ITERATIONS;
+    LittleFS.remove(path);
+    return true;
+}
+
+bool StorageBenchmark::benchSmallFiles(JsonObject results) {
+    String dir = String(BENCH_DIR) + "/small";
+    LittleFS.mkdir(dir);
+
+    uint32_t createTotal = 0;
+    for (size_t i = 0; i < SMALL_FILE_COUNT; i++) {
+        uint32_t elapsed;
+        if (!writePattern(dir + "/f" + String(i) + ".json", SMALL_FILE_SIZE, SMALL_FILE_SIZE, &elapsed)) {
+            return false;
+        }
+        createTotal += elapsed;
+    }
+
+    uint32_t start = micros();
+    for (size_t i = 0; i < SMALL_FILE_COUNT; i++) {
+        LittleFS.remove(dir + "/f" + String(i) + ".json");
+    }
+    uint32_t deleteTotal = micros() - start;
+    LittleFS.rmdir(dir);
+
+    results["count"] = SMALL_FILE_COUNT;
+    results["size"] = SMALL_FILE_SIZE;
+    results["create_us"] = createTotal / SMALL_FILE_COUNT;
+    results["delete_us"] = deleteTotal / SMALL_FILE_COUNT;
+    return true;
+}
+
+bool StorageBenchmark::benchSequential(JsonArray results) {
+    String path = String(BENCH_DIR) + "/seq.bin";
+    for (size_t blockSize : BLOCK_SIZES) {
+        uint32_t writeUs;
+        if (!writePattern(path, SEQUENTIAL_BYTES, blockSize, &writeUs)) {
+            return false;
+        }
+
+        uint32_t start = micros();
+        File file = LittleFS.open(path, "r");
+        if (!file) {
+            return fail("Failed to open " + path);
+        }
+        size_t bytesRead = 0;
+        bool verified = true;
+        size_t n;
+        while ((n = file.read(_buffer, blockSize)) > 0) {
+            bytesRead += n;
+        }
+        file.close();
+        uint32_t readUs = micros() - start;
+
+        // The last block read is still in the buffer; it must match the pattern
+        for (size_t i = 0; i < blockSize && verified; i++) {
+            verified = _buffer[i] == (uint8_t)((i & 127) * 2 + 1);
+        }
+        LittleFS.remove(path);
+
+        JsonObject entry = results.createNestedObject();
+        entry["block"] = blockSize;
+        entry["bytes"] = SEQUENTIAL_BYTES;
+        entry["write_kbps"] = kbPerSecond(SEQUENTIAL_BYTES, writeUs);
+        entry["read_kbps"] = kbPerSecond(bytesRead, readUs);
+        entry["verified"] = verified && bytesRead == SEQUENTIAL_BYTES;
+        if (!verified || bytesRead != SEQUENTIAL_BYTES) {
+            return fail("Read back " + String(bytesRead) + " bytes that do not match what was written");
+        }
+        yield();
+    }
+    return true;
+}
+
+bool StorageBenchmark::benchRandom(JsonArray results) {
+    String path = String(BENCH_DIR) + "/random.bin";
+    if (!writePattern(path, RANDOM_FILE_BYTES, 4096, nullptr)) {
+        return false;
+    }
+
+    for (size_t blockSize : BLOCK_SIZES) {
+        if (blockSize > RANDOM_MAX_BLOCK_SIZE) break;
+        size_t blocks = RANDOM_FILE_BYTES / blockSize;
+
+        File file = LittleFS.open(path, "r+");
+        if (!file) {
+            return fail("Failed to open " + path);
+        }
+
+        uint32_t start = micros();
+        for (size_t i = 0; i < RANDOM_OPS; i++) {
+            file.seek((nextRandom() % blocks) * blockSize);
+            file.read(_buffer, blockSize);
+        }
+        uint32_t readUs = micros() - start;
+
+        // Writes are not durable until flushed; the flush is part of the cost
+        start = micros();
+        for (size_t i = 0; i < RANDOM_OPS; i++) {
+            file.seek((nextRandom() % blocks) * blockSize);
+            file.write(_buffer, blockSize);
+        }
+        file.flush();
+        uint32_t writeUs = micros() - start;
+        file.close();
+
+        JsonObject entry = results.createNestedObject();
+        entry["block"] = blockSize;
+        entry["ops"] = RANDOM_OPS;
+        entry["read_us"] = readUs / RANDOM_OPS;
+        entry["write_us"] = writeUs / RANDOM_OPS;
+        yield();
+    }
+
+    LittleFS.remove(path);
+    return true;
+}
+
+bool StorageBenchmark::benchEnumerate(JsonArray results) {
+    // Grown in steps, listing at each size
+    String dir = String(BENCH_DIR) + "/macros";
+    LittleFS.mkdir(dir);
+    size_t created = 0;
+    for (size_t count : ENUMERATE_COUNTS) {
+        for (; created < count; created++) {
+            if (!writePattern(dir + "/macro-" + String(created) + ".json", MACRO_FILE_SIZE, MACRO_FILE_SIZE,
+                              nullptr)) {
+                return false;
+            }
+        }
+
+        size_t files;
+        uint32_t elapsed;
+        if (!listDirectory(dir.c_str(), &files, &elapsed)) {
+            return false;
+        }
+        JsonObject entry = results.createNestedObject();
+        entry["files"] = files;
+        entry["list_us"] = elapsed;
+        entry["per_file_us"] = files > 0 ? elapsed / files : 0;
+        yield();
+    }
+    FileSystemUtils::removeTree(dir.c_str());
+
+    // The real directory, for reference; its size differs between devices
+    size_t files;
+    uint32_t elapsed;
+    if (listDirectory("/macros", &files, &elapsed)) {
+        JsonObject entry = results.createNestedObject();
+        entry["dir"] = "/macros";
+        entry["files"] = files;
+        entry["list_us"] = elapsed;
+        entry["per_file_us"] = files > 0 ? elapsed / files : 0;
+    }
+    return true;
+}
+
+bool StorageBenchmark::benchFragmentation(JsonObject results) {
+    String path = String(BENCH_DIR) + "/large.bin";
+    uint32_t cleanUs;
+    if (!writePattern(path, FRAGMENT_WRITE_BYTES, 4096, &cleanUs)) {
+        return false;
+    }
+    LittleFS.remove(path);
+
+    // Leave holes: every other file of a run of small ones is removed
+    String dir = String(BENCH_DIR) + "/frag";
+    LittleFS.mkdir(dir);
+    for (size_t i = 0; i < FRAGMENT_FILES; i++) {
+        if (!writePattern(dir + "/" + String(i) + ".bin", FRAGMENT_FILE_SIZE, FRAGMENT_FILE_SIZE, nullptr)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < FRAGMENT_FILES; i += 2) {
+        LittleFS.remove(dir + "/" + String(i) + ".bin");
+    }
+
+    uint32_t fragmentedUs;
+    if (!writePattern(path, FRAGMENT_WRITE_BYTES, 4096, &fragmentedUs)) {
+        return false;
+    }
+    LittleFS.remove(path);
+    FileSystemUtils::removeTree(dir.c_str());
+
+    float clean = kbPerSecond(FRAGMENT_WRITE_BYTES, cleanUs);
+    float fragmented = kbPerSecond(FRAGMENT_WRITE_BYTES, fragmentedUs);
+    results["bytes"] = FRAGMENT_WRITE_BYTES;
+    results["clean_kbps"] = clean;
+    results["fragmented_kbps"] = fragmented;
+    results["ratio"] = clean > 0 ? fragmented / clean : 0;
+    return true;
+}
+
+bool StorageBenchmark::writePattern(const String& path, size_t size, size_t blockSize, uint32_t* elapsedUs) {
+    uint32_t start = micros();
+    File file = LittleFS.open(path, "w");
+    if (!file) {
+        return fail("Failed to create " + path);
+    }
+    size_t written = 0;
+    while (written < size) {
+        size_t n = min(blockSize, size - written);
+        if (file.write(_buffer, n) != n) {
+            file.close();
+            return fail("Failed to write " + path + " (filesystem full?)");
+        }
+        written += n;
+    }
+    file.close();
+    if (elapsedUs) {
+        *elapsedUs = micros() - start;
+    }
+    return true;
+}
+
+bool StorageBenchmark::listDirectory(const char* dir, size_t* files, uint32_t* elapsedUs) {
+    uint32_t start = micros();
+    File root = LittleFS.open(dir, "r");
+    if (!root || !root.isDirectory()) {
+        return false;
+    }
+
+    // Name and size of each entry, as the macro list does
+    size_t count = 0;
+    File child = root.openNextFile();
+    while (child) {
+        String name = child.name();
+        if (child.size() > 0 || name.length() > 0) {
+            count++;
+        }
+        child.close();
+        child = root.openNextFile();
+    }
+    root.close();
+
+    *elapsedUs = micros() - start;
+    *files = count;
+    return true;
+}
+
+float StorageBenchmark::kbPerSecond(size_t bytes, uint32_t elapsedUs) {
+    if (elapsedUs == 0) {
+        return 0;
+    }
+    // Whole KB/s are enough to compare and keep the JSON short
+    return roundf(bytes * 1000000.0f / elapsedUs / 1024.0f);
+}
+
+uint32_t StorageBenchmark::nextRandom() {
+    // xorshift32: the same offsets on every run and platform
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return _seed;
+}
+
+bool StorageBenchmark::fail(const String& error) {
+    _lastError = error;
+    USBSerial.printf("StorageBenchmark: %s\n", error.c_str());
+    return false;
+}
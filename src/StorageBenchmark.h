@@ -0,0 +1,53 @@
+#ifndef STORAGE_BENCHMARK_H
+#define STORAGE_BENCHMARK_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// LittleFS benchmark and health suite. Every run uses the same file sizes,
+// counts and random seed, so results from different firmware versions (or
+// from the host build against a filesystem image) can be compared with
+// scripts/storage_bench.py.
+//
+// Measures open/close latency, small-file create and delete, sequential and
+// random access across block sizes, directory listing at the sizes /macros
+// grows to, and how much a fragmented free space slows down a large write.
+// All work happens in /.bench, which is removed afterwards.
+class StorageBenchmark {
+public:
+    // Run the whole suite (a few seconds on the device) and fill results
+    static bool run(JsonObject results);
+
+    // Run the suite in its own task; the JSON is kept for getResults()
+    static bool start();
+
+    static bool isRunning() { return _running; }
+
+    // JSON of the last run, empty if none has finished
+    static String getResults() { return _results; }
+    static String getLastError() { return _lastError; }
+
+    // Room for the results of one run
+    static const size_t RESULTS_DOCUMENT_SIZE;
+
+private:
+    static bool benchOpenClose(JsonObject results);
+    static bool benchSmallFiles(JsonObject results);
+    static bool benchSequential(JsonArray results);
+    static bool benchRandom(JsonArray results);
+    static bool benchEnumerate(JsonArray results);
+    static bool benchFragmentation(JsonObject results);
+    static bool writePattern(const String& path, size_t size, size_t blockSize, uint32_t* elapsedUs);
+    static bool listDirectory(const char* dir, size_t* files, uint32_t* elapsedUs);
+    static float kbPerSecond(size_t bytes, uint32_t elapsedUs);
+    static uint32_t nextRandom();
+    static bool fail(const String& error);
+
+    static volatile bool _running;
+    static uint32_t _seed;
+    static uint8_t* _buffer;
+    static String _results;
+    static String _lastError;
+};
+
+#endif // STORAGE_BENCHMARK_H
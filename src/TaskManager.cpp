@@ -0,0 +1,200 @@
+#include "TaskManager.h"
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <USBCDC.h>
+#include <esp_timer.h>
+#include "SpanTrace.h"
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+TaskManager::TaskConfig TaskManager::_configs[TASK_COUNT] = {
+    { "keyboard_task", INPUT_TASK_CORE,   KEYBOARD_TASK_PRIORITY, 10, 4096 },
+    { "encoder_task",  INPUT_TASK_CORE,   ENCODER_TASK_PRIORITY,  10, 4096 },
+    { "hid_task",      INPUT_TASK_CORE,   HID_TASK_PRIORITY,      5,  4096 },
+    { "network_task",  NETWORK_TASK_CORE, NETWORK_TASK_PRIORITY,  10, 6144 },
+    { "ui_task",       NETWORK_TASK_CORE, UI_TASK_PRIORITY,       20, 8192 }
+};
+TaskHandle_t TaskManager::_handles[TASK_COUNT] = { nullptr };
+TaskWorkFunction TaskManager::_work[TASK_COUNT] = { nullptr };
+TaskManager::TaskStats TaskManager::_stats[TASK_COUNT];
+uint64_t TaskManager::_statsResetUs = 0;
+String TaskManager::_lastError = "";
+
+// Constants
+const uint32_t TaskManager::LATE_WAKEUP_US = 1000;
+
+void TaskManager::begin() {
+    loadConfig();
+    resetStats();
+}
+
+void TaskManager::loadConfig() {
+    if (!LittleFS.exists(TASK_CONFIG_PATH)) {
+        return;
+    }
+
+    File file = LittleFS.open(TASK_CONFIG_PATH, "r");
+    if (!file) {
+        return;
+    }
+
+    DynamicJsonDocument doc(1024);
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+
+    if (error) {
+        USBSerial.printf("Failed to parse %s: %s\n", TASK_CONFIG_PATH, error.c_str());
+        return;
+    }
+
+    // {"hid_task": {"priority": 4, "core": 1, "period_ms": 5}, ...}
+    for (int i = 0; i < TASK_COUNT; i++) {
+        JsonObject entry = doc[_configs[i].name];
+        if (entry.isNull()) continue;
+
+        _configs[i].priority = entry["priority"] | (int)_configs[i].priority;
+        _configs[i].core = entry["core"] | (int)_configs[i].core;
+        _configs[i].periodMs = entry["period_ms"] | _configs[i].periodMs;
+
+        if (_configs[i].priority >= configMAX_PRIORITIES) {
+            _configs[i].priority = configMAX_PRIORITIES - 1;
+        }
+        if (_configs[i].core > 1) {
+            _configs[i].core = 1;
+        }
+        if (_configs[i].periodMs == 0) {
+            _configs[i].periodMs = 1;
+        }
+    }
+}
+
+bool TaskManager::startTask(ManagedTask task, TaskWorkFunction work) {
+    if (task >= TASK_COUNT || work == nullptr) {
+        _lastError = "Invalid task";
+        return false;
+    }
+    if (_handles[task] != nullptr) {
+        _lastError = String(_configs[task].name) + " already running";
+        return false;
+    }
+
+    _work[task] = work;
+    const TaskConfig& config = _configs[task];
+
+    BaseType_t result = xTaskCreatePinnedToCore(taskTrampoline, config.name, config.stackSize,
+                                                (void*)(intptr_t)task, config.priority,
+                                                &_handles[task], config.core);
+    if (result != pdPASS) {
+        _lastError = String("Failed to create ") + config.name;
+        USBSerial.println(_lastError);
+        return false;
+    }
+
+    USBSerial.printf("Started %s on core %d (priority %d, period %u ms)\n",
+                  config.name, config.core, config.priority, config.periodMs);
+    return true;
+}
+
+void TaskManager::taskTrampoline(void* param) {
+    ManagedTask task = (ManagedTask)(intptr_t)param;
+    const TaskConfig& config = _configs[task];
+    TaskStats& stats = _stats[task];
+    const TickType_t period = pdMS_TO_TICKS(config.periodMs) > 0 ? pdMS_TO_TICKS(config.periodMs) : 1;
+    const uint64_t periodUs = (uint64_t)period * portTICK_PERIOD_MS * 1000;
+    SpanTrace::nameCurrentTask(config.name);
+
+    TickType_t lastWake = xTaskGetTickCount();
+    uint64_t expectedUs = esp_timer_get_time();
+
+    while (true) {
+        // Scheduling latency: how late we woke compared to the fixed schedule
+        uint64_t startUs = esp_timer_get_time();
+        uint32_t latencyUs = startUs > expectedUs ? (uint32_t)(startUs - expectedUs) : 0;
+
+        _work[task]();
+
+        uint32_t busyUs = (uint32_t)(esp_timer_get_time() - startUs);
+
+        stats.iterations++;
+        stats.busyUs += busyUs;
+        stats.totalLatencyUs += latencyUs;
+        if (latencyUs > stats.maxLatencyUs) stats.maxLatencyUs = latencyUs;
+        if (latencyUs > LATE_WAKEUP_US) stats.lateWakeups++;
+        if (busyUs > stats.maxBusyUs) stats.maxBusyUs = busyUs;
+
+        // Fixed-rate schedule; if the work overran, resynchronise instead of bursting
+        TickType_t now = xTaskGetTickCount();
+        if ((TickType_t)(now - lastWake) >= period) {
+            lastWake = now;
+            expectedUs = esp_timer_get_time() + periodUs;
+            vTaskDelay(period);
+        } else {
+            expectedUs += periodUs;
+            vTaskDelayUntil(&lastWake, period);
+        }
+    }
+}
+
+String TaskManager::getStatsJson() {
+    DynamicJsonDocument doc(3072);
+    uint64_t windowUs = esp_timer_get_time() - _statsResetUs;
+    doc["window_ms"] = (uint32_t)(windowUs / 1000);
+
+    JsonArray tasks = doc.createNestedArray("tasks");
+    for (int i = 0; i < TASK_COUNT; i++) {
+        const TaskConfig& config = _configs[i];
+        JsonObject obj = tasks.createNestedObject();
+        obj["name"] = config.name;
+        obj["core"] = config.core;
+        obj["priority"] = config.priority;
+        obj["period_ms"] = config.periodMs;
+        obj["running"] = _handles[i] != nullptr;
+
+        if (_handles[i] == nullptr) continue;
+
+        uint32_t iterations = _stats[i].iterations;
+        uint64_t busyUs = _stats[i].busyUs;
+        obj["iterations"] = iterations;
+        obj["cpu_percent"] = windowUs > 0 ? (float)busyUs * 100.0f / (float)windowUs : 0.0f;
+        obj["max_busy_us"] = _stats[i].maxBusyUs;
+        obj["avg_latency_us"] = iterations > 0 ? (uint32_t)(_stats[i].totalLatencyUs / iterations) : 0;
+        obj["max_latency_us"] = _stats[i].maxLatencyUs;
+        obj["late_wakeups"] = _stats[i].lateWakeups;
+        obj["stack_free"] = uxTaskGetStackHighWaterMark(_handles[i]);
+    }
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+    // Scheduler-wide view, including framework tasks (async_tcp, wifi, loopTask)
+    UBaseType_t count = uxTaskGetNumberOfTasks();
+    TaskStatus_t* status = (TaskStatus_t*)malloc(count * sizeof(TaskStatus_t));
+    if (status != nullptr) {
+        uint32_t totalRunTime = 0;
+        count = uxTaskGetSystemState(status, count, &totalRunTime);
+        JsonArray all = doc.createNestedArray("system");
+        for (UBaseType_t i = 0; i < count && totalRunTime > 0; i++) {
+            JsonObject obj = all.createNestedObject();
+            obj["name"] = status[i].pcTaskName;
+            obj["priority"] = status[i].uxCurrentPriority;
+            obj["cpu_percent"] = (float)status[i].ulRunTimeCounter * 100.0f / (float)totalRunTime;
+        }
+        free(status);
+    }
+#endif
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+void TaskManager::resetStats() {
+    for (int i = 0; i < TASK_COUNT; i++) {
+        _stats[i].iterations = 0;
+        _stats[i].busyUs = 0;
+        _stats[i].totalLatencyUs = 0;
+        _stats[i].maxLatencyUs = 0;
+        _stats[i].lateWakeups = 0;
+        _stats[i].maxBusyUs = 0;
+    }
+    _statsResetUs = esp_timer_get_time();
+}
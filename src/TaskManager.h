@@ -0,0 +1,102 @@
+#ifndef TASK_MANAGER_H
+#define TASK_MANAGER_H
+
+#include <Arduino.h>
+
+// Task topology: the input pipeline and HID run on the application core at
+// high priority; networking, display and LEDs run on the protocol core next
+// to the WiFi stack. Every value can be overridden with a -D build flag or
+// at boot from /config/tasks.json.
+#ifndef INPUT_TASK_CORE
+#define INPUT_TASK_CORE 1
+#endif
+#ifndef NETWORK_TASK_CORE
+#define NETWORK_TASK_CORE 0
+#endif
+
+#ifndef KEYBOARD_TASK_PRIORITY
+#define KEYBOARD_TASK_PRIORITY 5
+#endif
+#ifndef ENCODER_TASK_PRIORITY
+#define ENCODER_TASK_PRIORITY 5
+#endif
+#ifndef HID_TASK_PRIORITY
+#define HID_TASK_PRIORITY 4
+#endif
+#ifndef NETWORK_TASK_PRIORITY
+#define NETWORK_TASK_PRIORITY 2
+#endif
+#ifndef UI_TASK_PRIORITY
+#define UI_TASK_PRIORITY 1
+#endif
+
+#define TASK_CONFIG_PATH "/config/tasks.json"
+
+// Managed tasks
+enum ManagedTask {
+    TASK_KEYBOARD,
+    TASK_ENCODER,
+    TASK_HID,
+    TASK_NETWORK,
+    TASK_UI,
+    TASK_COUNT
+};
+
+// Work function run once per task period
+typedef void (*TaskWorkFunction)();
+
+class TaskManager {
+public:
+    // Per-task placement and timing
+    struct TaskConfig {
+        const char* name;
+        uint8_t core;
+        UBaseType_t priority;
+        uint32_t periodMs;
+        uint32_t stackSize;
+    };
+
+    // Per-task instrumentation
+    struct TaskStats {
+        uint32_t iterations;
+        uint64_t busyUs;           // Time spent inside the work function
+        uint64_t totalLatencyUs;   // Sum of wake-up delays past the scheduled time
+        uint32_t maxLatencyUs;
+        uint32_t lateWakeups;      // Wake-ups more than LATE_WAKEUP_US past schedule
+        uint32_t maxBusyUs;
+    };
+
+    // Load priorities from TASK_CONFIG_PATH (defaults come from build flags)
+    static void begin();
+
+    // Start a periodic, pinned, instrumented task
+    static bool startTask(ManagedTask task, TaskWorkFunction work);
+
+    // Get task statistics as JSON (CPU share is relative to the last reset)
+    static String getStatsJson();
+
+    // Reset statistics
+    static void resetStats();
+
+    // Configuration accessors
+    static const TaskConfig& getConfig(ManagedTask task) { return _configs[task]; }
+    static TaskHandle_t getHandle(ManagedTask task) { return _handles[task]; }
+
+    // Get last error message
+    static String getLastError() { return _lastError; }
+
+private:
+    static void taskTrampoline(void* param);
+    static void loadConfig();
+
+    static TaskConfig _configs[TASK_COUNT];
+    static TaskHandle_t _handles[TASK_COUNT];
+    static TaskWorkFunction _work[TASK_COUNT];
+    static TaskStats _stats[TASK_COUNT];
+    static uint64_t _statsResetUs;
+    static String _lastError;
+
+    static const uint32_t LATE_WAKEUP_US;
+};
+
+#endif // TASK_MANAGER_H
@@ -0,0 +1,226 @@
+#include "WebSocketSendQueue.h"
+#include <ArduinoJson.h>
+#include <USBCDC.h>
+
+extern USBCDC USBSerial;
+
+// Static member initialization
+std::map<uint32_t, WebSocketSendQueue::ClientQueue> WebSocketSendQueue::_clients;
+std::mutex WebSocketSendQueue::_mutex;
+uint32_t WebSocketSendQueue::_retiredDrops = 0;
+
+// Constants
+const size_t WebSocketSendQueue::MAX_QUEUED_MESSAGES = 16;
+const size_t WebSocketSendQueue::MAX_QUEUED_BYTES = 16 * 1024;
+const size_t WebSocketSendQueue::SATURATION_HIGH_WATER = 12;
+const size_t WebSocketSendQueue::SATURATION_LOW_WATER = 4;
+const uint32_t WebSocketSendQueue::DEGRADE_AFTER_MS = 2000;
+const uint32_t WebSocketSendQueue::DROP_AFTER_MS = 10000;
+
+void WebSocketSendQueue::addClient(AsyncWebSocketClient* client) {
+    if (client == nullptr) return;
+    std::lock_guard<std::mutex> lock(_mutex);
+    _clients[client->id()] = ClientQueue();
+}
+
+void WebSocketSendQueue::removeClient(uint32_t clientId) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _clients.find(clientId);
+    if (it != _clients.end()) {
+        _retiredDrops += it->second.drops;
+        _clients.erase(it);
+    }
+}
+
+bool WebSocketSendQueue::enqueueLocked(ClientQueue& queue, const String& message, const char* coalesceKey) {
+    if (queue.state == CLIENT_DROPPED) {
+        return false;
+    }
+
+    // Replace a superseded state message in place
+    if (coalesceKey != nullptr) {
+        for (auto& queued : queue.messages) {
+            if (queued.coalesceKey == coalesceKey) {
+                queue.queuedBytes = queue.queuedBytes - queued.payload.length() + message.length();
+                queued.payload = message;
+                queue.coalesced++;
+                return true;
+            }
+        }
+    } else if (queue.state == CLIENT_DEGRADED) {
+        // Degraded clients only receive coalesced state
+        queue.drops++;
+        return false;
+    }
+
+    // Make room by dropping the oldest messages
+    while (!queue.messages.empty() &&
+           (queue.messages.size() >= MAX_QUEUED_MESSAGES ||
+            queue.queuedBytes + message.length() > MAX_QUEUED_BYTES)) {
+        queue.queuedBytes -= queue.messages.front().payload.length();
+        queue.messages.pop_front();
+        queue.drops++;
+    }
+
+    QueuedMessage queued;
+    queued.payload = message;
+    if (coalesceKey != nullptr) {
+        queued.coalesceKey = coalesceKey;
+    }
+    queue.queuedBytes += message.length();
+    queue.messages.push_back(queued);
+
+    if (queue.messages.size() > queue.peakDepth) {
+        queue.peakDepth = queue.messages.size();
+    }
+    return true;
+}
+
+bool WebSocketSendQueue::send(uint32_t clientId, const String& message, const char* coalesceKey) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _clients.find(clientId);
+    if (it == _clients.end()) {
+        return false;
+    }
+    return enqueueLocked(it->second, message, coalesceKey);
+}
+
+void WebSocketSendQueue::broadcast(const String& message, const char* coalesceKey, uint32_t topic) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& entry : _clients) {
+        if (entry.second.topics & topic) {
+            enqueueLocked(entry.second, message, coalesceKey);
+        }
+    }
+}
+
+void WebSocketSendQueue::subscribe(uint32_t clientId, uint32_t topics) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _clients.find(clientId);
+    if (it != _clients.end()) {
+        it->second.topics |= topics;
+    }
+}
+
+void WebSocketSendQueue::unsubscribe(uint32_t clientId, uint32_t topics) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _clients.find(clientId);
+    if (it != _clients.end()) {
+        it->second.topics &= ~topics;
+    }
+}
+
+bool WebSocketSendQueue::hasSubscribers(uint32_t topic) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& entry : _clients) {
+        if (entry.second.topics & topic) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void WebSocketSendQueue::process(AsyncWebSocket& ws) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t now = millis();
+
+    for (auto it = _clients.begin(); it != _clients.end(); ) {
+        uint32_t clientId = it->first;
+        ClientQueue& queue = it->second;
+
+        AsyncWebSocketClient* client = ws.client(clientId);
+        if (client == nullptr || client->status() != WS_CONNECTED) {
+            _retiredDrops += queue.drops;
+            it = _clients.erase(it);
+            continue;
+        }
+
+        // Hand messages to AsyncTCP only while it has room for them
+        while (!queue.messages.empty() && client->canSend()) {
+            QueuedMessage& front = queue.messages.front();
+            client->text(front.payload);
+            queue.bytesSent += front.payload.length();
+            queue.messagesSent++;
+            queue.queuedBytes -= front.payload.length();
+            queue.messages.pop_front();
+        }
+
+        // Track saturation with hysteresis
+        size_t depth = queue.messages.size();
+        if (depth >= SATURATION_HIGH_WATER) {
+            if (queue.saturatedSince == 0) {
+                queue.saturatedSince = now;
+            }
+        } else if (depth <= SATURATION_LOW_WATER) {
+            queue.saturatedSince = 0;
+            if (queue.state == CLIENT_DEGRADED) {
+                queue.state = CLIENT_OK;
+                USBSerial.printf("WebSocket client #%u recovered\n", clientId);
+            }
+        }
+
+        if (queue.saturatedSince != 0) {
+            uint32_t saturatedFor = now - queue.saturatedSince;
+            if (saturatedFor > DROP_AFTER_MS && queue.state != CLIENT_DROPPED) {
+                USBSerial.printf("WebSocket client #%u saturated for %u ms, closing\n", clientId, saturatedFor);
+                queue.state = CLIENT_DROPPED;
+                queue.drops += queue.messages.size();
+                queue.messages.clear();
+                queue.queuedBytes = 0;
+                client->close();
+            } else if (saturatedFor > DEGRADE_AFTER_MS && queue.state == CLIENT_OK) {
+                USBSerial.printf("WebSocket client #%u saturated, downgrading to state-only\n", clientId);
+                queue.state = CLIENT_DEGRADED;
+            }
+        }
+
+        ++it;
+    }
+}
+
+String WebSocketSendQueue::getMetricsJson() {
+    DynamicJsonDocument doc(2048);
+    JsonArray clients = doc.createNestedArray("clients");
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto& entry : _clients) {
+            const ClientQueue& queue = entry.second;
+            JsonObject obj = clients.createNestedObject();
+            obj["id"] = entry.first;
+            obj["state"] = queue.state == CLIENT_OK ? "ok" :
+                           queue.state == CLIENT_DEGRADED ? "degraded" : "dropped";
+            obj["topics"] = queue.topics;
+            obj["queue_depth"] = queue.messages.size();
+            obj["queued_bytes"] = queue.queuedBytes;
+            obj["peak_depth"] = queue.peakDepth;
+            obj["bytes_sent"] = queue.bytesSent;
+            obj["messages_sent"] = queue.messagesSent;
+            obj["drops"] = queue.drops;
+            obj["coalesced"] = queue.coalesced;
+        }
+        doc["retired_drops"] = _retiredDrops;
+    }
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+}
+
+size_t WebSocketSendQueue::getTotalQueueDepth() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t total = 0;
+    for (const auto& entry : _clients) {
+        total += entry.second.messages.size();
+    }
+    return total;
+}
+
+uint32_t WebSocketSendQueue::getTotalDrops() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    uint32_t total = _retiredDrops;
+    for (const auto& entry : _clients) {
+        total += entry.second.drops;
+    }
+    return total;
+}
@@ -0,0 +1,89 @@
+#ifndef WEBSOCKET_SEND_QUEUE_H
+#define WEBSOCKET_SEND_QUEUE_H
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include <deque>
+#include <map>
+#include <mutex>
+
+// Broadcast topics a client can subscribe to (bitmask)
+enum WebSocketTopic : uint32_t {
+    WS_TOPIC_STATUS   = 1 << 0,  // Periodic status broadcast (default on)
+    WS_TOPIC_METRICS  = 1 << 1,  // Metrics snapshots
+    WS_TOPIC_FIRMWARE = 1 << 2   // Firmware update progress
+};
+
+// Bounded per-client outbound queues for WebSocket text messages.
+// Messages are only handed to AsyncTCP while the client can accept them;
+// state messages sharing a coalesce key replace each other in the queue.
+class WebSocketSendQueue {
+public:
+    // Client health, based on how long its queue has stayed saturated
+    enum ClientState {
+        CLIENT_OK,
+        CLIENT_DEGRADED,   // Only coalesced state messages are queued
+        CLIENT_DROPPED     // Closed for staying saturated
+    };
+
+    // Track a newly connected / disconnected client
+    static void addClient(AsyncWebSocketClient* client);
+    static void removeClient(uint32_t clientId);
+
+    // Queue a message for one client; coalesceKey replaces an older queued message with the same key
+    static bool send(uint32_t clientId, const String& message, const char* coalesceKey = nullptr);
+
+    // Queue a message for every client subscribed to topic
+    static void broadcast(const String& message, const char* coalesceKey = nullptr, uint32_t topic = WS_TOPIC_STATUS);
+
+    // Topic subscriptions
+    static void subscribe(uint32_t clientId, uint32_t topics);
+    static void unsubscribe(uint32_t clientId, uint32_t topics);
+    static bool hasSubscribers(uint32_t topic);
+
+    // Push queued messages and enforce saturation policy
+    static void process(AsyncWebSocket& ws);
+
+    // Per-client metrics as JSON
+    static String getMetricsJson();
+
+    // Aggregate accessors
+    static size_t getTotalQueueDepth();
+    static uint32_t getTotalDrops();
+
+private:
+    struct QueuedMessage {
+        String payload;
+        String coalesceKey;
+    };
+
+    struct ClientQueue {
+        std::deque<QueuedMessage> messages;
+        size_t queuedBytes = 0;
+        ClientState state = CLIENT_OK;
+        uint32_t topics = WS_TOPIC_STATUS;
+        uint32_t saturatedSince = 0;
+        uint32_t bytesSent = 0;
+        uint32_t messagesSent = 0;
+        uint32_t drops = 0;
+        uint32_t coalesced = 0;
+        size_t peakDepth = 0;
+    };
+
+    static bool enqueueLocked(ClientQueue& queue, const String& message, const char* coalesceKey);
+
+    static std::map<uint32_t, ClientQueue> _clients;
+    static std::mutex _mutex;
+    static uint32_t _retiredDrops;
+
+    // Limits
+    static const size_t MAX_QUEUED_MESSAGES;
+    static const size_t MAX_QUEUED_BYTES;
+    static const size_t SATURATION_HIGH_WATER;
+    static const size_t SATURATION_LOW_WATER;
+    static const uint32_t DEGRADE_AFTER_MS;
+    static const uint32_t DROP_AFTER_MS;
+};
+
+#endif // WEBSOCKET_SEND_QUEUE_H
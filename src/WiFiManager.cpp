@@ -6,11 +6,23 @@
 #include "MacroHandler.h"
 #include "LEDHandler.h"
 #include "DisplayHandler.h"
+#include "InputEventStream.h"
+#include "EventBus.h"
+#include "WebSocketSendQueue.h"
+#include "TaskManager.h"
+#include "MetricsRegistry.h"
+#include "ConfigSnapshot.h"
+#include "PersistenceService.h"
+#include "PowerManager.h"
+#include "BudgetWatchdog.h"
+#include "SpanTrace.h"
+#include "MemoryPolicy.h"
 #include <ESPAsyncWebServer.h>
 #include <AsyncTCP.h>
 #include <ArduinoJson.h>
 #include <WiFi.h>
 #include <LittleFS.h>
+#include <memory>
 #include <ESPmDNS.h>
 #include "config.h"
 #include <USBCDC.h>
@@ -32,10 +44,13 @@ AsyncWebServer WiFiManager::_server(80);
 AsyncWebSocket WiFiManager::_ws("/ws");
 bool WiFiManager::_isConnected = false;
 uint32_t WiFiManager::_lastStatusBroadcast = 0;
+uint32_t WiFiManager::_lastMetricsBroadcast = 0;
 uint32_t WiFiManager::_connectAttemptStart = 0;
+int WiFiManager::_statusSubscription = -1;
 
 // Constants
 const uint32_t WiFiManager::STATUS_BROADCAST_INTERVAL = 5000; // Increased from original value
+const uint32_t WiFiManager::METRICS_BROADCAST_INTERVAL = 1000;
 const uint32_t WiFiManager::CONNECT_TIMEOUT = 30000; // 30 seconds
 
 void WiFiManager::begin() {
@@ -44,6 +59,7 @@ void WiFiManager::begin() {
     
     // Setup WiFi
     setupWiFi();
+    publishWiFiState();
     
     // Setup WebSocket
     setupWebSocket();
@@ -85,7 +101,6 @@ void WiFiManager::setupWiFi() {
         // Configure WiFi for better scanning
         WiFi.setAutoReconnect(true);
         WiFi.setAutoConnect(true);
-        WiFi.setSleep(false); // Disable WiFi sleep for better performance
         
         // Now connect to the configured WiFi network
         USBSerial.printf("Connecting to WiFi: %s\n", _ssid.c_str());
@@ -129,6 +144,12 @@ void WiFiManager::setupWebSocket() {
     _ws.onEvent(onWsEvent);
     _server.addHandler(&_ws);
     
+    // Live input stream is served over the same socket
+    InputEventStream::begin();
+    
+    // Push a status message as soon as layer, macro, USB or WiFi state changes
+    _statusSubscription = EventBus::subscribe("ws_status", EVENT_STATE_TOPICS, 16);
+    
     USBSerial.println("WebSocket server initialized");
 }
 
@@ -264,7 +285,7 @@ void WiFiManager::setupWebServer() {
             String json = String((char*)data, len);
             bool success = updateLEDConfigFromJson(json);
             if (success) {
-                saveLEDConfig();
+                scheduleLEDConfigSave();
                 // Reload LED configuration
                 USBSerial.println("LED configuration reloaded");
                 // Use the global function to initialize/reload LEDs
@@ -444,6 +465,76 @@ void WiFiManager::setupWebServer() {
         request->send(200, "application/json", output);
     });
     
+    // Prometheus-style metrics
+    _server.on("/api/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "text/plain; version=0.0.4", MetricsRegistry::renderPrometheus());
+    });
+    
+    // Per-client WebSocket send queue metrics
+    _server.on("/api/websocket/clients", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "application/json", WebSocketSendQueue::getMetricsJson());
+    });
+    
+    // Task placement, CPU share and scheduling latency
+    _server.on("/api/tasks", HTTP_GET, [](AsyncWebServerRequest *request) {
+        request->send(200, "application/json", TaskManager::getStatsJson());
+    });
+    
+    // Reset task statistics
+    _server.on("/api/tasks/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+        TaskManager::resetStats();
+        request->send(200, "application/json", "{\"status\":\"success\"}");
+    });
+    
+    // Stage budgets and the most recent overruns
+    _server.on("/api/budgets", HTTP_GET, [](AsyncWebServerRequest *request) {
+        PsramJsonDocument doc(8192);
+        BudgetWatchdog::getStatus(doc.to<JsonObject>());
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    // Reset stage statistics and clear the overrun ring
+    _server.on("/api/budgets/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+        BudgetWatchdog::reset();
+        request->send(200, "application/json", "{\"status\":\"success\"}");
+    });
+    
+    // Clear the span rings and record; ?freeze_on_overrun=1 stops at the next budget overrun
+    _server.on("/api/trace/start", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (request->hasParam("freeze_on_overrun")) {
+            SpanTrace::setFreezeOnOverrun(request->getParam("freeze_on_overrun")->value() == "1");
+        }
+        SpanTrace::start();
+        DynamicJsonDocument doc(512);
+        SpanTrace::getStatus(doc.to<JsonObject>());
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    // Stop recording without exporting
+    _server.on("/api/trace/stop", HTTP_POST, [](AsyncWebServerRequest *request) {
+        SpanTrace::stop();
+        DynamicJsonDocument doc(512);
+        SpanTrace::getStatus(doc.to<JsonObject>());
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+    
+    // Chrome trace of both cores, streamed as it is rendered (tens to hundreds of KB)
+    _server.on("/api/trace", HTTP_GET, [](AsyncWebServerRequest *request) {
+        std::shared_ptr<SpanTrace::Exporter> exporter(new SpanTrace::Exporter());
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [exporter](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                return exporter->read(buffer, maxLen);
+            });
+        response->addHeader("Content-Disposition", "attachment; filename=\"macropad-trace.json\"");
+        request->send(response);
+    });
+    
     // Reset to defaults
     _server.on("/api/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
         resetToDefaults();
@@ -468,7 +559,7 @@ void WiFiManager::setupWebServer() {
         },
         NULL,
         [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            static String accumulatedData = "";
+            static BodyBuffer accumulatedData;
             
             // Add CORS headers
             AsyncWebServerResponse *response = request->beginResponse(200);
@@ -488,28 +579,36 @@ void WiFiManager::setupWebServer() {
             USBSerial.println();
 
             // Accumulate the data
-            accumulatedData += String((char*)data, len);
+            if (index == 0) {
+                accumulatedData.begin(total);
+            }
+            if (!accumulatedData.append(data, len)) {
+                if (index + len >= total) {
+                    request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Out of memory for request body\"}");
+                }
+                return;
+            }
 
             // If this is the last chunk, process the complete data
             if (index + len >= total) {
                 USBSerial.println("Processing complete data:");
-                USBSerial.println(accumulatedData);
+                USBSerial.println(accumulatedData.c_str());
 
                 // Validate that we received valid JSON
-                DynamicJsonDocument doc(16384);
-                DeserializationError error = deserializeJson(doc, accumulatedData);
+                PsramJsonDocument doc(16384);
+                DeserializationError error = deserializeJson(doc, accumulatedData.c_str(), accumulatedData.length());
                 
                 if (error) {
                     String errorMsg = "{\"status\":\"error\",\"message\":\"Invalid JSON format\",\"details\":\"" + String(error.c_str()) + "\"}";
                     USBSerial.println("JSON parsing error: " + String(error.c_str()));
                     request->send(400, "application/json", errorMsg);
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
 
                 if (!LittleFS.exists("/config/components.json")) {
                     request->send(404, "application/json", "{\"status\":\"error\",\"message\":\"Components config file not found\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
 
@@ -517,7 +616,7 @@ void WiFiManager::setupWebServer() {
                 File file = LittleFS.open("/config/components.json", "w");
                 if (!file) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to open components config file for writing\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
 
@@ -532,7 +631,7 @@ void WiFiManager::setupWebServer() {
                 if (file.print(jsonString) != jsonString.length()) {
                     file.close();
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to write components config to file\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
 
@@ -542,7 +641,7 @@ void WiFiManager::setupWebServer() {
                 File verifyFile = LittleFS.open("/config/components.json", "r");
                 if (!verifyFile) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to verify written config file\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
 
@@ -554,18 +653,18 @@ void WiFiManager::setupWebServer() {
                 USBSerial.println(verifyContent);
 
                 // Parse the verification content
-                DynamicJsonDocument verifyDoc(16384);
+                PsramJsonDocument verifyDoc(16384);
                 DeserializationError verifyError = deserializeJson(verifyDoc, verifyContent);
                 
                 if (verifyError) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Config file verification failed\",\"details\":\"" + String(verifyError.c_str()) + "\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
 
                 // Success response with verification
                 request->send(200, "application/json", "{\"status\":\"success\",\"message\":\"Components config updated successfully\",\"verified\":true}");
-                accumulatedData = ""; // Reset for next request
+                accumulatedData.clear(); // Reset for next request
 
                 // Reload the configuration
                 if (keyHandler) {
@@ -591,7 +690,7 @@ void WiFiManager::setupWebServer() {
     
     // Get macros list
     _server.on("/api/macros", HTTP_GET, [](AsyncWebServerRequest *request) {
-        DynamicJsonDocument doc(32768);  // Increased from 4096 to 32768 (32KB)
+        PsramJsonDocument doc(32768);  // Increased from 4096 to 32768 (32KB)
         JsonArray macroArray = doc.createNestedArray("macros");
         
         if (macroHandler) {
@@ -647,7 +746,7 @@ void WiFiManager::setupWebServer() {
         },
         NULL,
         [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            static String accumulatedData = "";
+            static BodyBuffer accumulatedData;
             
             // Add CORS headers
             AsyncWebServerResponse *response = request->beginResponse(200);
@@ -662,19 +761,27 @@ void WiFiManager::setupWebServer() {
             }
 
             // Accumulate the data
-            accumulatedData += String((char*)data, len);
+            if (index == 0) {
+                accumulatedData.begin(total);
+            }
+            if (!accumulatedData.append(data, len)) {
+                if (index + len >= total) {
+                    request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Out of memory for request body\"}");
+                }
+                return;
+            }
 
             // If this is the last chunk, process the complete data
             if (index + len >= total) {
                 // Validate that we received valid JSON
-                DynamicJsonDocument doc(16384);
-                DeserializationError error = deserializeJson(doc, accumulatedData);
+                PsramJsonDocument doc(16384);
+                DeserializationError error = deserializeJson(doc, accumulatedData.c_str(), accumulatedData.length());
                 
                 if (error) {
                     String errorMsg = "{\"status\":\"error\",\"message\":\"Invalid JSON format\",\"details\":\"" + String(error.c_str()) + "\"}";
                     USBSerial.println("JSON parsing error: " + String(error.c_str()));
                     request->send(400, "application/json", errorMsg);
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
 
@@ -706,7 +813,7 @@ void WiFiManager::setupWebServer() {
                     request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid macro format - missing 'macros' key\"}");
                 }
                 
-                accumulatedData = ""; // Reset for next request
+                accumulatedData.clear(); // Reset for next request
             }
         }
     );
@@ -720,7 +827,7 @@ void WiFiManager::setupWebServer() {
         if (macroHandler) {
             Macro macro;
             if (macroHandler->getMacro(macroId, macro)) {
-                DynamicJsonDocument doc(8192);
+                PsramJsonDocument doc(8192);
                 JsonObject macroObj = doc.to<JsonObject>();
                 
                 macroObj["id"] = macro.id;
@@ -801,7 +908,7 @@ void WiFiManager::setupWebServer() {
         },
         NULL,
         [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            DynamicJsonDocument doc(8192);
+            PsramJsonDocument doc(8192);
             DeserializationError error = deserializeJson(doc, (const char*)data, len);
             
             if (error) {
@@ -983,7 +1090,7 @@ void WiFiManager::setupWebServer() {
         String content = file.readString();
         file.close();
         
-        DynamicJsonDocument doc(16384);
+        PsramJsonDocument doc(16384);
         DeserializationError error = deserializeJson(doc, content);
         
         if (error) {
@@ -1046,7 +1153,7 @@ void WiFiManager::setupWebServer() {
         },
         NULL,
         [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            static String accumulatedData = "";
+            static BodyBuffer accumulatedData;
             String componentId = request->pathArg(0);
             
             // Add CORS headers
@@ -1062,27 +1169,35 @@ void WiFiManager::setupWebServer() {
             }
             
             // Accumulate the data
-            accumulatedData += String((char*)data, len);
+            if (index == 0) {
+                accumulatedData.begin(total);
+            }
+            if (!accumulatedData.append(data, len)) {
+                if (index + len >= total) {
+                    request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Out of memory for request body\"}");
+                }
+                return;
+            }
             
             // If this is the last chunk, process the complete data
             if (index + len >= total) {
                 USBSerial.println("Processing component action update for: " + componentId);
-                USBSerial.println("Data: " + accumulatedData);
+                USBSerial.println(String("Data: ") + accumulatedData.c_str());
                 
                 // Validate that we received valid JSON
                 DynamicJsonDocument actionDoc(1024);
-                DeserializationError error = deserializeJson(actionDoc, accumulatedData);
+                DeserializationError error = deserializeJson(actionDoc, accumulatedData.c_str(), accumulatedData.length());
                 
                 if (error) {
                     String errorMsg = "{\"status\":\"error\",\"message\":\"Invalid JSON format\",\"details\":\"" + String(error.c_str()) + "\"}";
                     request->send(400, "application/json", errorMsg);
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
                 if (!LittleFS.exists("/config/components.json")) {
                     request->send(404, "application/json", "{\"status\":\"error\",\"message\":\"Components config file not found\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1090,19 +1205,19 @@ void WiFiManager::setupWebServer() {
                 File file = LittleFS.open("/config/components.json", "r");
                 if (!file) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to open components config file\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
                 String content = file.readString();
                 file.close();
                 
-                DynamicJsonDocument doc(16384);
+                PsramJsonDocument doc(16384);
                 DeserializationError docError = deserializeJson(doc, content);
                 
                 if (docError) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to parse components config\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1129,7 +1244,7 @@ void WiFiManager::setupWebServer() {
                 
                 if (!found) {
                     request->send(404, "application/json", "{\"status\":\"error\",\"message\":\"Component not found\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1137,7 +1252,7 @@ void WiFiManager::setupWebServer() {
                 File writeFile = LittleFS.open("/config/components.json", "w");
                 if (!writeFile) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to open components config file for writing\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1147,7 +1262,7 @@ void WiFiManager::setupWebServer() {
                 if (writeFile.print(jsonOutput) != jsonOutput.length()) {
                     writeFile.close();
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to write components config\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1161,7 +1276,7 @@ void WiFiManager::setupWebServer() {
                 }
                 
                 request->send(200, "application/json", "{\"status\":\"success\",\"message\":\"Component action updated successfully\"}");
-                accumulatedData = ""; // Reset for next request
+                accumulatedData.clear(); // Reset for next request
             }
         }
     );
@@ -1173,7 +1288,7 @@ void WiFiManager::setupWebServer() {
         },
         NULL,
         [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            static String accumulatedData = "";
+            static BodyBuffer accumulatedData;
             String componentId = request->pathArg(0);
             
             // Add CORS headers
@@ -1189,27 +1304,35 @@ void WiFiManager::setupWebServer() {
             }
             
             // Accumulate the data
-            accumulatedData += String((char*)data, len);
+            if (index == 0) {
+                accumulatedData.begin(total);
+            }
+            if (!accumulatedData.append(data, len)) {
+                if (index + len >= total) {
+                    request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Out of memory for request body\"}");
+                }
+                return;
+            }
             
             // If this is the last chunk, process the complete data
             if (index + len >= total) {
                 USBSerial.println("Processing encoder actions update for: " + componentId);
-                USBSerial.println("Data: " + accumulatedData);
+                USBSerial.println(String("Data: ") + accumulatedData.c_str());
                 
                 // Validate that we received valid JSON
                 DynamicJsonDocument actionsDoc(2048);
-                DeserializationError error = deserializeJson(actionsDoc, accumulatedData);
+                DeserializationError error = deserializeJson(actionsDoc, accumulatedData.c_str(), accumulatedData.length());
                 
                 if (error) {
                     String errorMsg = "{\"status\":\"error\",\"message\":\"Invalid JSON format\",\"details\":\"" + String(error.c_str()) + "\"}";
                     request->send(400, "application/json", errorMsg);
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
                 if (!LittleFS.exists("/config/components.json")) {
                     request->send(404, "application/json", "{\"status\":\"error\",\"message\":\"Components config file not found\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1217,19 +1340,19 @@ void WiFiManager::setupWebServer() {
                 File file = LittleFS.open("/config/components.json", "r");
                 if (!file) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to open components config file\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
                 String content = file.readString();
                 file.close();
                 
-                DynamicJsonDocument doc(16384);
+                PsramJsonDocument doc(16384);
                 DeserializationError docError = deserializeJson(doc, content);
                 
                 if (docError) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to parse components config\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1259,7 +1382,7 @@ void WiFiManager::setupWebServer() {
                 
                 if (!found) {
                     request->send(404, "application/json", "{\"status\":\"error\",\"message\":\"Encoder component not found\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1267,7 +1390,7 @@ void WiFiManager::setupWebServer() {
                 File writeFile = LittleFS.open("/config/components.json", "w");
                 if (!writeFile) {
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to open components config file for writing\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1277,7 +1400,7 @@ void WiFiManager::setupWebServer() {
                 if (writeFile.print(jsonOutput) != jsonOutput.length()) {
                     writeFile.close();
                     request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Failed to write components config\"}");
-                    accumulatedData = ""; // Reset for next request
+                    accumulatedData.clear(); // Reset for next request
                     return;
                 }
                 
@@ -1291,7 +1414,7 @@ void WiFiManager::setupWebServer() {
                 }
                 
                 request->send(200, "application/json", "{\"status\":\"success\",\"message\":\"Encoder actions updated successfully\"}");
-                accumulatedData = ""; // Reset for next request
+                accumulatedData.clear(); // Reset for next request
             }
         }
     );
@@ -1359,6 +1482,11 @@ void WiFiManager::setupWebServer() {
                 return;
             }
             
+            // The overwritten config stays restorable from its snapshot
+            if (ConfigSnapshot::take("before restoring " + configName + " defaults") < 0) {
+                USBSerial.println("Config snapshot failed: " + ConfigSnapshot::getLastError());
+            }
+            
             // Read default file
             File srcFile = LittleFS.open(defaultFilePath, "r");
             if (!srcFile) {
@@ -1465,6 +1593,8 @@ void WiFiManager::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client
         USBSerial.printf("WebSocket client #%u connected from %s\n", 
                       client->id(), client->remoteIP().toString().c_str());
         
+        WebSocketSendQueue::addClient(client);
+        
         // Send initial state
         DynamicJsonDocument doc(4096);
         doc["type"] = "init";
@@ -1476,10 +1606,12 @@ void WiFiManager::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client
         
         String message;
         serializeJson(doc, message);
-        client->text(message);
+        WebSocketSendQueue::send(client->id(), message, "init");
     } else if (type == WS_EVT_DISCONNECT) {
         // Client disconnected
         USBSerial.printf("WebSocket client #%u disconnected\n", client->id());
+        InputEventStream::unsubscribe(client->id());
+        WebSocketSendQueue::removeClient(client->id());
     } else if (type == WS_EVT_DATA) {
         // Data received
         AwsFrameInfo* info = (AwsFrameInfo*)arg;
@@ -1505,13 +1637,14 @@ void WiFiManager::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client
                     setLEDColor(index, r, g, b);
                     
                     // Send confirmation
-                    client->text("{\"status\":\"ok\",\"command\":\"update_led\"}");
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"ok\",\"command\":\"update_led\"}");
                 } else if (command == "save_config") {
-                    // Save current configuration
-                    bool success = saveLEDConfig();
+                    // Explicit save: write it and anything else pending now
+                    scheduleLEDConfigSave();
+                    bool success = PersistenceService::flush();
                     
                     // Send confirmation
-                    client->text("{\"status\":\"" + String(success ? "ok" : "error") + 
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"" + String(success ? "ok" : "error") + 
                               "\",\"command\":\"save_config\"}");
                 } else if (command == "assign_macro") {
                     // Handle macro assignment
@@ -1523,16 +1656,36 @@ void WiFiManager::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client
                         bool success = keyHandler->assignMacroToButton(buttonId, macroId);
                         
                         // Send confirmation
-                        client->text("{\"status\":\"" + String(success ? "ok" : "error") + 
+                        WebSocketSendQueue::send(client->id(), "{\"status\":\"" + String(success ? "ok" : "error") + 
                                   "\",\"command\":\"assign_macro\",\"buttonId\":\"" + buttonId + 
                                   "\",\"macroId\":\"" + macroId + "\"}");
                     } else {
-                        client->text("{\"status\":\"error\",\"command\":\"assign_macro\",\"error\":\"KeyHandler not initialized\"}");
+                        WebSocketSendQueue::send(client->id(), "{\"status\":\"error\",\"command\":\"assign_macro\",\"error\":\"KeyHandler not initialized\"}");
                     }
+                } else if (command == "subscribe_input") {
+                    // Start streaming input events as binary frames
+                    bool success = InputEventStream::subscribe(client);
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"" + String(success ? "ok" : "error") + 
+                              "\",\"command\":\"subscribe_input\"}");
+                } else if (command == "unsubscribe_input") {
+                    InputEventStream::unsubscribe(client->id());
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"ok\",\"command\":\"unsubscribe_input\"}");
+                } else if (command == "subscribe_metrics") {
+                    WebSocketSendQueue::subscribe(client->id(), WS_TOPIC_METRICS);
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"ok\",\"command\":\"subscribe_metrics\"}");
+                } else if (command == "unsubscribe_metrics") {
+                    WebSocketSendQueue::unsubscribe(client->id(), WS_TOPIC_METRICS);
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"ok\",\"command\":\"unsubscribe_metrics\"}");
+                } else if (command == "subscribe_firmware") {
+                    WebSocketSendQueue::subscribe(client->id(), WS_TOPIC_FIRMWARE);
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"ok\",\"command\":\"subscribe_firmware\"}");
+                } else if (command == "unsubscribe_firmware") {
+                    WebSocketSendQueue::unsubscribe(client->id(), WS_TOPIC_FIRMWARE);
+                    WebSocketSendQueue::send(client->id(), "{\"status\":\"ok\",\"command\":\"unsubscribe_firmware\"}");
                 } else if (command == "get_all_configs") {
                     // Send all configurations
                     // Use a smaller document size and more efficient JSON handling
-                    DynamicJsonDocument configDoc(8192); // Reduced from 16384
+                    PsramJsonDocument configDoc(8192); // Reduced from 16384
                     
                     // Get module info
                     JsonObject moduleObj = configDoc.createNestedObject("module");
@@ -1664,13 +1817,11 @@ void WiFiManager::onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client
                     // Send in chunks if too large
                     if (message.length() > 4096) {
                         USBSerial.println("Large message, sending in chunks...");
-                        // Send first part
-                        client->text(message.substring(0, 4096));
-                        delay(10); // Small delay to allow processing
-                        // Send second part
-                        client->text(message.substring(4096));
+                        // Queue both parts; the send queue paces them
+                        WebSocketSendQueue::send(client->id(), message.substring(0, 4096));
+                        WebSocketSendQueue::send(client->id(), message.substring(4096));
                     } else {
-                        client->text(message);
+                        WebSocketSendQueue::send(client->id(), message, "all_configs");
                     }
                 }
                 // Additional commands can be added here
@@ -1688,8 +1839,8 @@ void WiFiManager::update() {
             USBSerial.print("IP address: ");
             USBSerial.println(WiFi.localIP());
             
-            // Broadcast connection status
-            broadcastStatus();
+            // Status subscribers, including the broadcast below, hear about it from the bus
+            publishWiFiState();
         } else {
             // Check if connection attempt timed out
             if (millis() - _connectAttemptStart > CONNECT_TIMEOUT) {
@@ -1702,16 +1853,43 @@ void WiFiManager::update() {
                 _connectAttemptStart = millis();
             }
         }
+    } else if (!_apMode && WiFi.status() != WL_CONNECTED) {
+        _isConnected = false;
+        _connectAttemptStart = millis();
+        USBSerial.println("WiFi connection lost");
+        publishWiFiState();
     }
     
-    // Periodic status broadcast
-    if (millis() - _lastStatusBroadcast > STATUS_BROADCAST_INTERVAL) {
+    // Status broadcast on state changes, and periodically as a heartbeat
+    bool stateChanged = false;
+    BusEvent event;
+    while (EventBus::poll(_statusSubscription, event)) {
+        stateChanged = true;
+    }
+    if (stateChanged || millis() - _lastStatusBroadcast > STATUS_BROADCAST_INTERVAL) {
         broadcastStatus();
         _lastStatusBroadcast = millis();
     }
     
+    // Metrics snapshots for subscribed clients
+    if (millis() - _lastMetricsBroadcast > METRICS_BROADCAST_INTERVAL) {
+        _lastMetricsBroadcast = millis();
+        if (WebSocketSendQueue::hasSubscribers(WS_TOPIC_METRICS)) {
+            WebSocketSendQueue::broadcast(MetricsRegistry::renderJson(), "metrics", WS_TOPIC_METRICS);
+        }
+    }
+    
+    // Flush batched input events to subscribers
+    InputEventStream::process(_ws);
+    
+    // Push queued outbound messages to clients that can take them
+    WebSocketSendQueue::process(_ws);
+    
     // Clean up disconnected clients
     _ws.cleanupClients();
+    
+    // Modem sleep only while nobody is watching the live stream
+    PowerManager::setWifiLowLatency(_ws.count() > 0);
 }
 
 void WiFiManager::broadcastStatus() {
@@ -1737,9 +1915,12 @@ void WiFiManager::broadcastStatus() {
             doc["data"]["macro_running"] = false;
         }
         
+        BusEvent usb;
+        doc["data"]["usb_mounted"] = EventBus::getLatest(EVENT_USB, usb) && usb.value != 0;
+        
         String message;
         serializeJson(doc, message);
-        _ws.textAll(message);
+        WebSocketSendQueue::broadcast(message, "status");
     }
 }
 
@@ -1822,6 +2003,13 @@ bool WiFiManager::isConnected() {
     return _isConnected;
 }
 
+void WiFiManager::publishWiFiState() {
+    IPAddress ip = getLocalIP();
+    uint32_t address = ip[0] | (ip[1] << 8) | (ip[2] << 16) | ((uint32_t)ip[3] << 24);
+    uint8_t flags = (_isConnected ? EVENT_WIFI_CONNECTED : 0) | (_apMode ? EVENT_WIFI_AP_MODE : 0);
+    EventBus::publish(EVENT_WIFI, 0, (int32_t)address, flags, _ssid.c_str());
+}
+
 IPAddress WiFiManager::getLocalIP() {
     if (_apMode) {
         return WiFi.softAPIP();
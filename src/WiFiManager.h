@@ -55,14 +55,20 @@ private:
     // State variables
     static bool _isConnected;
     static uint32_t _lastStatusBroadcast;
+    static uint32_t _lastMetricsBroadcast;
     static uint32_t _connectAttemptStart;
+    static int _statusSubscription;
     
     // Constants
     static const uint32_t STATUS_BROADCAST_INTERVAL;
+    static const uint32_t METRICS_BROADCAST_INTERVAL;
     static const uint32_t CONNECT_TIMEOUT;
     
     // File serving methods
     static void setupFileRoutes();
+    
+    // Announce connection state and address on the event bus
+    static void publishWiFiState();
 };
 
 #endif // WIFI_MANAGER_H 
\ No newline at end of file
@@ -5,8 +5,17 @@
 #include <algorithm>
 #include <WiFi.h>
 #include "OTAUpdateManager.h"
+#include "OTAPipeline.h"
 #include "VersionManager.h"
 #include "UpdateProgressDisplay.h"
+#include "WebSocketSendQueue.h"
+#include "FileSync.h"
+#include "ConfigSnapshot.h"
+#include "StorageBenchmark.h"
+#include "PersistenceService.h"
+#include "EventBus.h"
+#include "PowerManager.h"
+#include "MemoryPolicy.h"
 #include "ConfigManager.h"
 #include "KeyHandler.h"
 #include "LEDHandler.h"
@@ -20,6 +29,9 @@ extern bool updateLEDConfigFromJson(const String& json); // Access to LED config
 // Define a smaller document size for safer memory usage
 const size_t JSON_DOCUMENT_SIZE = 8192;
 
+// Room for about 70 manifest entries
+const size_t FILE_MANIFEST_DOCUMENT_SIZE = 12288;
+
 // Generalized handler to serve any JSON config file
 void handleGetConfigFile(AsyncWebServerRequest *request, const char* filePath, bool allowFailover = true) {
   // First check if the file exists directly in the requested path
@@ -140,7 +152,7 @@ void handleGetLedsConfig(AsyncWebServerRequest *request) {
     // Create an empty LED config file with default structure
     USBSerial.println("No leds.json found, creating empty one");
     
-    DynamicJsonDocument doc(JSON_DOCUMENT_SIZE);
+    PsramJsonDocument doc(JSON_DOCUMENT_SIZE);
     doc["leds"] = JsonObject();
     doc["leds"]["mode"] = "static";
     
@@ -166,7 +178,7 @@ void handleGetLedsConfig(AsyncWebServerRequest *request) {
 }
 
 void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-  static String accumulatedData = "";
+  static BodyBuffer accumulatedData;
   
   // Add CORS headers
   AsyncWebServerResponse *response = request->beginResponse(200);
@@ -182,10 +194,15 @@ void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t
 
   // Accumulate the data
   if (index == 0) {
-    accumulatedData = ""; // Reset for new request
+    accumulatedData.begin(total); // Reset for new request
     USBSerial.println("\n===== [LED CONFIG] Starting new LED config update =====");
   }
-  accumulatedData += String((char*)data, len);
+  if (!accumulatedData.append(data, len)) {
+    if (index + len >= total) {
+      request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Out of memory for request body\"}");
+    }
+    return;
+  }
   USBSerial.printf("[LED CONFIG] Accumulated %d/%d bytes of data\n", index + len, total);
   
   // Only process the complete data in the last chunk
@@ -204,15 +221,15 @@ void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t
     if (!LittleFS.mkdir("/config")) {
       USBSerial.println("[LED CONFIG] ERROR: Failed to create config directory");
       request->send(500, "application/json", "{\"error\":\"Failed to create config directory\"}");
-      accumulatedData = ""; // Reset for next request
+      accumulatedData.clear(); // Reset for next request
       return;
     }
   }
 
   // Parse the JSON data
   USBSerial.println("[LED CONFIG] Parsing JSON data");
-  DynamicJsonDocument doc(JSON_DOCUMENT_SIZE);
-  DeserializationError error = deserializeJson(doc, accumulatedData);
+  PsramJsonDocument doc(JSON_DOCUMENT_SIZE);
+  DeserializationError error = deserializeJson(doc, accumulatedData.c_str(), accumulatedData.length());
   if (error) {
     USBSerial.printf("[LED CONFIG] ERROR: Invalid JSON in LED config: %s\n", error.c_str());
     
@@ -222,7 +239,7 @@ void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t
     errorMsg += "\"}";
     
     request->send(400, "application/json", errorMsg);
-    accumulatedData = ""; // Reset for next request
+    accumulatedData.clear(); // Reset for next request
     return;
   }
   USBSerial.println("[LED CONFIG] JSON parsing successful");
@@ -251,7 +268,7 @@ void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t
   if (!file) {
     USBSerial.println("[LED CONFIG] ERROR: Failed to open LEDs config file for writing");
     request->send(500, "application/json", "{\"error\":\"Failed to open LEDs config for writing\"}");
-    accumulatedData = ""; // Reset for next request
+    accumulatedData.clear(); // Reset for next request
     return;
   }
 
@@ -263,7 +280,7 @@ void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t
   if (serializedSize == 0) {
     USBSerial.println("[LED CONFIG] ERROR: Failed to write LED config - serialized size is 0");
     request->send(500, "application/json", "{\"error\":\"Failed to write LEDs config\"}");
-    accumulatedData = ""; // Reset for next request
+    accumulatedData.clear(); // Reset for next request
     return;
   }
 
@@ -286,7 +303,7 @@ void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t
   
   // IMPORTANT: Apply the new configuration to the in-memory LED state
   USBSerial.println("[LED CONFIG] Applying configuration to in-memory state via updateLEDConfigFromJson()");
-  bool configApplied = updateLEDConfigFromJson(accumulatedData);
+  bool configApplied = updateLEDConfigFromJson(String(accumulatedData.c_str()));
   if (configApplied) {
     USBSerial.println("[LED CONFIG] Successfully applied LED configuration to in-memory state");
   } else {
@@ -322,7 +339,7 @@ void handlePostLedsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t
   USBSerial.println("[LED CONFIG] LED configuration update complete\n");
   
   request->send(200, "application/json", "{\"message\":\"LEDs config updated successfully\"}");
-  accumulatedData = ""; // Reset for next request
+  accumulatedData.clear(); // Reset for next request
 }
 
 void handleGetInfoConfig(AsyncWebServerRequest *request) {
@@ -341,7 +358,7 @@ void handleGetExampleConfig(AsyncWebServerRequest *request) {
 }
 
 void handlePostActionsConfig(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-  static String accumulatedData = "";
+  static BodyBuffer accumulatedData;
   
   // Add CORS headers for when pre-flight check is done
   AsyncWebServerResponse *response = request->beginResponse(200);
@@ -357,10 +374,15 @@ void handlePostActionsConfig(AsyncWebServerRequest *request, uint8_t *data, size
   
   // Accumulate the data
   if (index == 0) {
-    accumulatedData = ""; // Reset for new request
+    accumulatedData.begin(total); // Reset for new request
     USBSerial.println("\n===== [ACTIONS CONFIG] Starting new actions config update =====");
   }
-  accumulatedData += String((char*)data, len);
+  if (!accumulatedData.append(data, len)) {
+    if (index + len >= total) {
+      request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Out of memory for request body\"}");
+    }
+    return;
+  }
   USBSerial.printf("[ACTIONS CONFIG] Accumulated %d/%d bytes of data\n", index + len, total);
   
   // Only process the complete data in the last chunk
@@ -379,19 +401,19 @@ void handlePostActionsConfig(AsyncWebServerRequest *request, uint8_t *data, size
     if (!LittleFS.mkdir("/config")) {
       USBSerial.println("[ACTIONS CONFIG] ERROR: Failed to create config directory");
       request->send(500, "application/json", "{\"error\":\"Failed to create config directory\"}");
-      accumulatedData = ""; // Reset for next request
+      accumulatedData.clear(); // Reset for next request
       return;
     }
   }
   
   // Validate JSON data
   USBSerial.println("[ACTIONS CONFIG] Parsing JSON data");
-  DynamicJsonDocument doc(JSON_DOCUMENT_SIZE);
-  DeserializationError error = deserializeJson(doc, accumulatedData);
+  PsramJsonDocument doc(JSON_DOCUMENT_SIZE);
+  DeserializationError error = deserializeJson(doc, accumulatedData.c_str(), accumulatedData.length());
   if (error) {
     USBSerial.printf("[ACTIONS CONFIG] ERROR: Failed to parse actions JSON: %s\n", error.c_str());
     request->send(400, "application/json", "{\"error\":\"Invalid JSON format in request\"}");
-    accumulatedData = ""; // Reset for next request
+    accumulatedData.clear(); // Reset for next request
     return;
   }
   USBSerial.println("[ACTIONS CONFIG] JSON parsing successful");
@@ -413,19 +435,19 @@ void handlePostActionsConfig(AsyncWebServerRequest *request, uint8_t *data, size
   if (!file) {
     USBSerial.println("[ACTIONS CONFIG] ERROR: Failed to open actions config file for writing");
     request->send(500, "application/json", "{\"error\":\"Failed to open actions config for writing\"}");
-    accumulatedData = ""; // Reset for next request
+    accumulatedData.clear(); // Reset for next request
     return;
   }
   
   USBSerial.println("[ACTIONS CONFIG] Writing config to file");
-  size_t bytesWritten = file.print(accumulatedData);
+  size_t bytesWritten = file.write((const uint8_t*)accumulatedData.c_str(), accumulatedData.length());
   file.close();
   
   if (bytesWritten != accumulatedData.length()) {
     USBSerial.printf("[ACTIONS CONFIG] ERROR: Incomplete write - wrote %d of %d bytes\n", 
                     bytesWritten, accumulatedData.length());
     request->send(500, "application/json", "{\"error\":\"Failed to write complete actions config\"}");
-    accumulatedData = ""; // Reset for next request
+    accumulatedData.clear(); // Reset for next request
     return;
   }
   
@@ -494,7 +516,7 @@ void handlePostActionsConfig(AsyncWebServerRequest *request, uint8_t *data, size
   USBSerial.println("[ACTIONS CONFIG] Actions configuration update complete\n");
   
   request->send(200, "application/json", "{\"message\":\"Actions config updated successfully\"}");
-  accumulatedData = ""; // Reset for next request
+  accumulatedData.clear(); // Reset for next request
 }
 
 void handleGetWiFiConfig(AsyncWebServerRequest *request) {
@@ -606,6 +628,22 @@ void handleGetUpdateStatus(AsyncWebServerRequest *request) {
     doc["error"] = OTAUpdateManager::getLastError();
   }
   
+  // Throughput of the current or last download
+  OTAPipeline::Stats stats = OTAPipeline::getStats();
+  if (stats.bufferSize > 0) {
+    JsonObject transfer = doc.createNestedObject("transfer");
+    transfer["bytes"] = stats.bytesWritten;
+    transfer["elapsed_ms"] = stats.elapsedMs;
+    transfer["bytes_per_sec"] = stats.bytesPerSecond;
+    transfer["reader_wait_ms"] = stats.readerWaitMs;
+    transfer["writer_idle_ms"] = stats.writerIdleMs;
+    transfer["flash_ms"] = stats.flashMs;
+    transfer["hash_ms"] = stats.hashMs;
+    transfer["buffers"] = stats.buffers;
+    transfer["buffer_size"] = stats.bufferSize;
+    transfer["psram"] = stats.psram;
+  }
+  
   String response;
   serializeJson(doc, response);
   
@@ -613,17 +651,48 @@ void handleGetUpdateStatus(AsyncWebServerRequest *request) {
   request->send(200, "application/json", response);
 }
 
+// Update progress for WebSocket clients subscribed to the firmware topic.
+// Shares a coalesce key, so a slow client only ever sees the latest state.
+void broadcastFirmwareProgress(size_t current, size_t total, int percentage) {
+  if (!WebSocketSendQueue::hasSubscribers(WS_TOPIC_FIRMWARE)) return;
+  
+  StaticJsonDocument<384> doc;
+  doc["type"] = "firmware";
+  doc["state"] = static_cast<int>(OTAUpdateManager::getUpdateState());
+  doc["status"] = OTAUpdateManager::getUpdateStatus();
+  doc["progress"] = percentage;
+  doc["bytes"] = current;
+  doc["total"] = total;
+  
+  String message;
+  serializeJson(doc, message);
+  WebSocketSendQueue::broadcast(message, "firmware", WS_TOPIC_FIRMWARE);
+}
+
 void handlePerformUpdate(AsyncWebServerRequest *request) {
   USBSerial.println("API: Requested /api/firmware/update");
   
-  // Check if update is available
-  if (!OTAUpdateManager::isUpdateAvailable()) {
-    request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"No update available\"}");
+  if (OTAUpdateManager::isBusy()) {
+    request->send(409, "application/json", "{\"status\":\"error\",\"message\":\"Update already in progress\"}");
     return;
   }
   
-  // Get the firmware URL
-  String firmwareUrl = OTAUpdateManager::getFirmwareUrl();
+  // An explicit ?url= installs from another server (e.g. a local test server)
+  String firmwareUrl;
+  if (request->hasParam("url")) {
+    firmwareUrl = request->getParam("url")->value();
+    String sha256 = request->hasParam("sha256") ? request->getParam("sha256")->value() : "";
+    OTAUpdateManager::setExpectedDigest(firmwareUrl, sha256);
+  } else {
+    // Check if update is available
+    if (!OTAUpdateManager::isUpdateAvailable()) {
+      request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"No update available\"}");
+      return;
+    }
+    
+    // Get the firmware URL
+    firmwareUrl = OTAUpdateManager::getFirmwareUrl();
+  }
   if (firmwareUrl.isEmpty()) {
     request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"No firmware URL available\"}");
     return;
@@ -634,7 +703,8 @@ void handlePerformUpdate(AsyncWebServerRequest *request) {
   
   // Schedule the update to be performed after sending the response
   // This is done because the update process will restart the device
-  static String pendingUpdateUrl = firmwareUrl;
+  static String pendingUpdateUrl;
+  pendingUpdateUrl = firmwareUrl;
   USBSerial.println("Scheduling firmware update to: " + pendingUpdateUrl);
   
   // Use a task to perform the update after the response is sent
@@ -650,16 +720,397 @@ void handlePerformUpdate(AsyncWebServerRequest *request) {
     // Set up a progress callback for display updates
     auto progressCallback = [](size_t current, size_t total, int percentage) {
       UpdateProgressDisplay::updateProgress(current, total, percentage);
+      broadcastFirmwareProgress(current, total, percentage);
     };
     
-    // Perform the update
+    // Perform the update; it only returns on failure
     OTAUpdateManager::performUpdate(*updateUrl, progressCallback);
+    broadcastFirmwareProgress(0, 0, OTAUpdateManager::getUpdateProgress());
     
     // This task should delete itself when done
     vTaskDelete(NULL);
   }, "update_task", 8192, &pendingUpdateUrl, 1, NULL);
 }
 
+// POST /api/firmware/upload streams a pushed image into flash as it
+// arrives, either as the raw body or as a multipart file field. Nothing is
+// buffered beyond the OTA pipeline, and the image must come with its
+// SHA-256 (?sha256=). Only one upload runs at a time.
+static AsyncWebServerRequest* uploadRequest = nullptr;
+
+static void receiveFirmwareChunk(AsyncWebServerRequest *request, const String& name, size_t index,
+                                 uint8_t *data, size_t len, size_t total) {
+  if (index == 0) {
+    // isBusy() aborts a stalled upload; its request is gone with it
+    bool busy = OTAUpdateManager::isBusy();
+    if (uploadRequest != nullptr && !OTAUpdateManager::isUploadActive()) {
+      uploadRequest = nullptr;
+    }
+    if (uploadRequest != nullptr || busy) return;  // Answered with 409
+    
+    String sha256 = request->hasParam("sha256") ? request->getParam("sha256")->value() : "";
+    String signature = request->hasParam("sig") ? request->getParam("sig")->value() : "";
+    if (!OTAUpdateManager::beginUpload(name, total, sha256, signature, broadcastFirmwareProgress)) {
+      broadcastFirmwareProgress(0, total, 0);
+      return;
+    }
+    uploadRequest = request;
+    
+    // A client that drops mid-upload never reaches handleFirmwareUpload()
+    request->onDisconnect([request]() {
+      if (uploadRequest != request) return;
+      uploadRequest = nullptr;
+      OTAUpdateManager::abortUpload("Client disconnected");
+    });
+  }
+  
+  if (request != uploadRequest) return;
+  if (!OTAUpdateManager::writeUpload(data, len)) {
+    uploadRequest = nullptr;
+    broadcastFirmwareProgress(index, total, OTAUpdateManager::getUpdateProgress());
+  }
+}
+
+void handleFirmwareUploadBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  String name = request->hasParam("name") ? request->getParam("name")->value() : "firmware.bin";
+  receiveFirmwareChunk(request, name, index, data, len, total);
+}
+
+void handleFirmwareUploadFile(AsyncWebServerRequest *request, const String& filename, size_t index,
+                              uint8_t *data, size_t len, bool final) {
+  // The form's total includes boundaries and headers; close enough for progress
+  receiveFirmwareChunk(request, filename, index, data, len, request->contentLength());
+}
+
+void handleFirmwareUpload(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested /api/firmware/upload");
+  
+  if (request != uploadRequest) {
+    // Never started, or failed while streaming
+    bool busy = OTAUpdateManager::isBusy();
+    StaticJsonDocument<256> doc;
+    doc["status"] = "error";
+    doc["message"] = busy ? "Update already in progress"
+                   : request->contentLength() == 0 ? "No firmware in request"
+                   : OTAUpdateManager::getLastError();
+    String response;
+    serializeJson(doc, response);
+    request->send(busy ? 409 : 400, "application/json", response);
+    return;
+  }
+  
+  uploadRequest = nullptr;
+  bool installed = OTAUpdateManager::finishUpload();
+  broadcastFirmwareProgress(0, 0, OTAUpdateManager::getUpdateProgress());
+  
+  StaticJsonDocument<256> doc;
+  doc["status"] = installed ? "ok" : "error";
+  doc["message"] = installed ? OTAUpdateManager::getUpdateStatus() : OTAUpdateManager::getLastError();
+  String response;
+  serializeJson(doc, response);
+  request->send(installed ? 200 : 400, "application/json", response);
+  if (!installed) return;
+  
+  // Restart once the response is on its way; first boot re-verifies the
+  // image and rolls back on failure like a pulled update
+  xTaskCreate([](void* parameter) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP.restart();
+    vTaskDelete(NULL);
+  }, "upload_restart", 4096, NULL, 1, NULL);
+}
+
+// ===== FILE SYNC =====
+// Incremental LittleFS updates (see FileSync.h and scripts/fs_sync.py):
+// the host posts its manifest for a directory, uploads the files the
+// device reports as needed, then commits to swap the directory in.
+
+static void sendFileSyncError(AsyncWebServerRequest *request, int code = 400) {
+  StaticJsonDocument<256> doc;
+  doc["status"] = "error";
+  doc["message"] = FileSync::getLastError();
+  String response;
+  serializeJson(doc, response);
+  request->send(code, "application/json", response);
+}
+
+void handleGetFileManifest(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested /api/fs/manifest");
+  
+  String dir = request->hasParam("dir") ? request->getParam("dir")->value() : "/web";
+  PsramJsonDocument doc(FILE_MANIFEST_DOCUMENT_SIZE);
+  doc["dir"] = dir;
+  if (!FileSync::buildManifest(dir, doc.createNestedArray("files"))) {
+    sendFileSyncError(request);
+    return;
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+void handleFileSyncBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  static BodyBuffer accumulatedData;
+  
+  if (index == 0) {
+    accumulatedData.begin(total);
+  }
+  if (!accumulatedData.append(data, len)) {
+    if (index + len >= total) {
+      request->send(500, "application/json", "{\"status\":\"error\",\"message\":\"Out of memory for request body\"}");
+    }
+    return;
+  }
+  if (index + len < total) {
+    return;
+  }
+  
+  String dir = request->hasParam("dir") ? request->getParam("dir")->value() : "/web";
+  PsramJsonDocument manifest(accumulatedData.length() * 2 + 1024);
+  DeserializationError error = deserializeJson(manifest, accumulatedData.c_str(), accumulatedData.length());
+  accumulatedData.clear();
+  if (error) {
+    request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid JSON format in request\"}");
+    return;
+  }
+  
+  bool busy = FileSync::isBusy();
+  PsramJsonDocument doc(manifest.memoryUsage() + 256);
+  doc["status"] = "ok";
+  doc["dir"] = dir;
+  if (!FileSync::beginSync(dir, manifest["files"], doc.createNestedArray("needed"))) {
+    sendFileSyncError(request, busy ? 409 : 400);
+    return;
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+void handleFileSync(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested /api/fs/sync");
+  
+  // Answered from the body handler once the manifest is complete
+  if (request->contentLength() == 0) {
+    request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"No manifest in request\"}");
+  }
+}
+
+static AsyncWebServerRequest* syncFileRequest = nullptr;
+
+void handleFileSyncFileBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (index == 0) {
+    String path = request->hasParam("path") ? request->getParam("path")->value() : "";
+    if (!FileSync::beginFile(path)) return;
+    syncFileRequest = request;
+    
+    // A client that drops mid-file never reaches handleFileSyncFile(); the
+    // short file fails its check and the session stays open for a retry
+    request->onDisconnect([request]() {
+      if (syncFileRequest != request) return;
+      syncFileRequest = nullptr;
+      if (FileSync::isFileOpen()) FileSync::finishFile();
+    });
+  }
+  if (request == syncFileRequest) {
+    FileSync::writeFile(data, len);
+  }
+}
+
+void handleFileSyncFile(AsyncWebServerRequest *request) {
+  bool stored;
+  if (request == syncFileRequest) {
+    syncFileRequest = nullptr;
+    stored = FileSync::finishFile();
+  } else {
+    // An empty file has no body chunks; anything else failed to start
+    String path = request->hasParam("path") ? request->getParam("path")->value() : "";
+    stored = request->contentLength() == 0 && FileSync::beginFile(path) && FileSync::finishFile();
+  }
+  
+  if (!stored) {
+    sendFileSyncError(request);
+    return;
+  }
+  request->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+void handleFileSyncCommit(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested /api/fs/commit");
+  
+  if (!FileSync::commit()) {
+    sendFileSyncError(request);
+    return;
+  }
+  request->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+void handleFileSyncAbort(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested /api/fs/abort");
+  
+  FileSync::abort();
+  request->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// ===== CONFIG SNAPSHOTS =====
+// Deduplicated copies of /config and /macros (see ConfigSnapshot.h). One is
+// taken before every firmware install and restored by a firmware rollback.
+
+static void sendSnapshotError(AsyncWebServerRequest *request, int code = 500) {
+  StaticJsonDocument<256> doc;
+  doc["status"] = "error";
+  doc["message"] = ConfigSnapshot::getLastError();
+  String response;
+  serializeJson(doc, response);
+  request->send(code, "application/json", response);
+}
+
+void handleGetConfigSnapshots(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested /api/config/snapshots");
+  
+  DynamicJsonDocument doc(2048);
+  if (!ConfigSnapshot::list(doc.createNestedArray("snapshots"))) {
+    sendSnapshotError(request);
+    return;
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+void handleTakeConfigSnapshot(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested snapshot of configs");
+  
+  int id = ConfigSnapshot::take("manual");
+  if (id < 0) {
+    sendSnapshotError(request);
+    return;
+  }
+  
+  StaticJsonDocument<128> doc;
+  doc["status"] = "ok";
+  doc["id"] = id;
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+void handleRestoreConfigSnapshot(AsyncWebServerRequest *request) {
+  if (!request->hasParam("id")) {
+    request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"Missing id parameter\"}");
+    return;
+  }
+  
+  int id = request->getParam("id")->value().toInt();
+  USBSerial.printf("API: Requested restore of config snapshot %d\n", id);
+  if (!ConfigSnapshot::restore(id)) {
+    sendSnapshotError(request);
+    return;
+  }
+  request->send(200, "application/json", "{\"status\":\"ok\",\"message\":\"Configs restored, restarting...\"}");
+  
+  // Every handler reloads its config on the way back up
+  xTaskCreate([](void* parameter) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP.restart();
+    vTaskDelete(NULL);
+  }, "snapshot_restart", 4096, NULL, 1, NULL);
+}
+
+// ===== STORAGE BENCHMARK =====
+// The suite runs in its own task for a few seconds; POST starts it and GET
+// returns the last results (see StorageBenchmark.h, scripts/storage_bench.py).
+
+void handleGetStorageBenchmark(AsyncWebServerRequest *request) {
+  if (StorageBenchmark::isRunning()) {
+    request->send(202, "application/json", "{\"status\":\"running\"}");
+    return;
+  }
+  String results = StorageBenchmark::getResults();
+  if (results.isEmpty()) {
+    request->send(404, "application/json", "{\"status\":\"error\",\"message\":\"No benchmark has run\"}");
+    return;
+  }
+  request->send(200, "application/json", results);
+}
+
+void handleStartStorageBenchmark(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested storage benchmark");
+  
+  if (!StorageBenchmark::start()) {
+    StaticJsonDocument<256> doc;
+    doc["status"] = "error";
+    doc["message"] = StorageBenchmark::getLastError();
+    String response;
+    serializeJson(doc, response);
+    request->send(409, "application/json", response);
+    return;
+  }
+  request->send(202, "application/json", "{\"status\":\"started\"}");
+}
+
+// ===== RUNTIME STATE =====
+// Writes waiting in the persistence service (see PersistenceService.h).
+// Flush before pulling power if the last changes must survive.
+
+void handleGetStateStatus(AsyncWebServerRequest *request) {
+  DynamicJsonDocument doc(1024);
+  PersistenceService::getStatus(doc.to<JsonObject>());
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+void handleFlushState(AsyncWebServerRequest *request) {
+  USBSerial.println("API: Requested flush of runtime state");
+  
+  if (!PersistenceService::flush()) {
+    StaticJsonDocument<256> doc;
+    doc["status"] = "error";
+    doc["message"] = PersistenceService::getLastError();
+    String response;
+    serializeJson(doc, response);
+    request->send(500, "application/json", response);
+    return;
+  }
+  request->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// ===== EVENT BUS =====
+// Subscribers of the event bus (see EventBus.h) and how many events each
+// one has taken or lost.
+
+void handleGetEventBusStatus(AsyncWebServerRequest *request) {
+  DynamicJsonDocument doc(2048);
+  EventBus::getStatus(doc.to<JsonObject>());
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+// ===== POWER =====
+// Frequency scaling and sleep state, and how long each power lock has held
+// the CPU at full speed (see PowerManager.h).
+
+void handleGetPowerStatus(AsyncWebServerRequest *request) {
+  DynamicJsonDocument doc(1024);
+  PowerManager::getStatus(doc.to<JsonObject>());
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
+void handleGetMemoryStatus(AsyncWebServerRequest *request) {
+  PsramJsonDocument doc(16384);
+  MemoryPolicy::getStatus(doc.to<JsonObject>());
+  String response;
+  serializeJson(doc, response);
+  request->send(200, "application/json", response);
+}
+
 void setupConfigRoutes(AsyncWebServer *server) {
   // Log when this function is called
   USBSerial.println("INFO: Setting up API config routes");
@@ -809,7 +1260,7 @@ void setupConfigRoutes(AsyncWebServer *server) {
     USBSerial.println("API: Requested /api/debug/routes");
     
     // Create a JSON response with information about all API routes
-    DynamicJsonDocument doc(JSON_DOCUMENT_SIZE);
+    PsramJsonDocument doc(JSON_DOCUMENT_SIZE);
     doc["status"] = "ok";
     doc["message"] = "API route info";
     
@@ -937,10 +1388,13 @@ void setupConfigRoutes(AsyncWebServer *server) {
   server->on("/api/firmware/check", HTTP_GET, handleCheckForUpdates);
   server->on("/api/firmware/status", HTTP_GET, handleGetUpdateStatus);
   server->on("/api/firmware/update", HTTP_GET, handlePerformUpdate);
+  server->on("/api/firmware/upload", HTTP_POST, handleFirmwareUpload, handleFirmwareUploadFile,
+             handleFirmwareUploadBody);
   
   USBSerial.println("  - Registered /api/firmware/check (GET)");
   USBSerial.println("  - Registered /api/firmware/status (GET)");
   USBSerial.println("  - Registered /api/firmware/update (GET)");
+  USBSerial.println("  - Registered /api/firmware/upload (POST)");
   
   // CORS preflight handlers for OTA endpoints
   server->on("/api/firmware/check", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
@@ -967,5 +1421,88 @@ void setupConfigRoutes(AsyncWebServer *server) {
     request->send(response);
   });
   
+  server->on("/api/firmware/upload", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
+    AsyncWebServerResponse *response = request->beginResponse(200);
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->addHeader("Access-Control-Allow-Methods", "POST, OPTIONS");
+    response->addHeader("Access-Control-Allow-Headers", "Content-Type");
+    request->send(response);
+  });
+  
   USBSerial.println("  - Registered OTA update endpoints");
+  
+  // Register file sync endpoints
+  server->on("/api/fs/manifest", HTTP_GET, handleGetFileManifest);
+  server->on("/api/fs/sync", HTTP_POST, handleFileSync, NULL, handleFileSyncBody);
+  server->on("/api/fs/file", HTTP_POST, handleFileSyncFile, NULL, handleFileSyncFileBody);
+  server->on("/api/fs/commit", HTTP_POST, handleFileSyncCommit);
+  server->on("/api/fs/abort", HTTP_POST, handleFileSyncAbort);
+  
+  server->on("/api/fs/manifest", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
+    AsyncWebServerResponse *response = request->beginResponse(200);
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->addHeader("Access-Control-Allow-Methods", "GET, OPTIONS");
+    response->addHeader("Access-Control-Allow-Headers", "Content-Type");
+    request->send(response);
+  });
+  
+  USBSerial.println("  - Registered file sync endpoints");
+  
+  // Register config snapshot endpoints
+  server->on("/api/config/snapshots/restore", HTTP_POST, handleRestoreConfigSnapshot);
+  server->on("/api/config/snapshots", HTTP_GET, handleGetConfigSnapshots);
+  server->on("/api/config/snapshots", HTTP_POST, handleTakeConfigSnapshot);
+  
+  server->on("/api/config/snapshots", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
+    AsyncWebServerResponse *response = request->beginResponse(200);
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->addHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
+    response->addHeader("Access-Control-Allow-Headers", "Content-Type");
+    request->send(response);
+  });
+  
+  USBSerial.println("  - Registered config snapshot endpoints");
+  
+  // Register storage benchmark endpoints
+  server->on("/api/storage/benchmark", HTTP_GET, handleGetStorageBenchmark);
+  server->on("/api/storage/benchmark", HTTP_POST, handleStartStorageBenchmark);
+  
+  server->on("/api/storage/benchmark", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
+    AsyncWebServerResponse *response = request->beginResponse(200);
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->addHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
+    response->addHeader("Access-Control-Allow-Headers", "Content-Type");
+    request->send(response);
+  });
+  
+  USBSerial.println("  - Registered storage benchmark endpoints");
+  
+  // Register runtime state endpoints (flush first: "/api/state" also matches it)
+  server->on("/api/state/flush", HTTP_POST, handleFlushState);
+  server->on("/api/state", HTTP_GET, handleGetStateStatus);
+  
+  server->on("/api/state/flush", HTTP_OPTIONS, [](AsyncWebServerRequest *request) {
+    AsyncWebServerResponse *response = request->beginResponse(200);
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->addHeader("Access-Control-Allow-Methods", "POST, OPTIONS");
+    response->addHeader("Access-Control-Allow-Headers", "Content-Type");
+    request->send(response);
+  });
+  
+  USBSerial.println("  - Registered runtime state endpoints");
+  
+  // Register event bus status endpoint
+  server->on("/api/events", HTTP_GET, handleGetEventBusStatus);
+  
+  USBSerial.println("  - Registered event bus endpoint");
+  
+  // Register power management status endpoint
+  server->on("/api/power", HTTP_GET, handleGetPowerStatus);
+  
+  USBSerial.println("  - Registered power endpoint");
+  
+  // Heap placement and fragmentation
+  server->on("/api/memory", HTTP_GET, handleGetMemoryStatus);
+  
+  USBSerial.println("  - Registered memory endpoint");
 } 
\ No newline at end of file
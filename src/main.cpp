@@ -46,6 +46,11 @@ extern "C" {
 #include "WiFiManager.h"
 
 #include "FileSystemUtils.h"
+#include "FileSync.h"
+#include "ConfigSnapshot.h"
+#include "StorageBenchmark.h"
+#include "PersistenceService.h"
+#include "BinaryLog.h"
 
 #include "VersionManager.h"
 
@@ -53,6 +58,12 @@ extern "C" {
 #include "RecoveryBootloader.h"
 #include "PartitionVerifier.h"
 #include "UpdateProgressDisplay.h"
+#include "TaskManager.h"
+#include "PowerManager.h"
+#include "BudgetWatchdog.h"
+#include "SpanTrace.h"
+#include "MemoryPolicy.h"
+#include "MetricsRegistry.h"
 
 // Forward declarations
 void createWorkingActionsFile();
@@ -133,35 +144,6 @@ void testFilenames() {
     }
 }
 
-// Test for fragmentation by writing and deleting files
-void testFragmentation() {
-    USBSerial.println("Testing for fragmentation issues...");
-    
-    // Create a set of small files
-    for (int i = 0; i < 10; i++) {
-        String filename = "/frag_test_" + String(i) + ".txt";
-        String content = "";
-        // Write 1KB of data
-        for (int j = 0; j < 20; j++) {
-            content += "This is test data for fragmentation testing. Line " + String(j) + "\n";
-        }
-        
-        if (!FileSystemUtils::writeFile(filename.c_str(), content)) {
-            USBSerial.println("Failed to create test file - possible FRAGMENTATION ISSUE");
-            break;
-        }
-    }
-    
-    // Try a more comprehensive performance test
-    FileSystemUtils::testPerformance("/large_test.bin", 1024, 50);
-    
-    // Clean up test files
-    for (int i = 0; i < 10; i++) {
-        String filename = "/frag_test_" + String(i) + ".txt";
-        FileSystemUtils::deleteFileAndDirs(filename.c_str());
-    }
-}
-
 // Run diagnostics sequentially
 void runDiagnostics() {
     if (!diagnosticsEnabled || millis() - lastDiagnosticTime < 5000) {
@@ -190,8 +172,8 @@ void runDiagnostics() {
             break;
             
         case 3:
-            USBSerial.println("\n--- LITTLEFS DIAGNOSTICS: FRAGMENTATION TEST ---");
-            testFragmentation();
+            USBSerial.println("\n--- LITTLEFS DIAGNOSTICS: STORAGE BENCHMARK ---");
+            StorageBenchmark::start();
             currentTest++;
             break;
             
@@ -204,6 +186,53 @@ void runDiagnostics() {
     }
 }
 
+// Commands typed on the serial console, one per line
+void handleSerialCommands() {
+    if (!USBSerial.available()) {
+        return;
+    }
+    String command = USBSerial.readStringUntil('\n');
+    command.trim();
+    
+    if (command == "bench") {
+        // Results are printed as JSON when the run finishes
+        if (StorageBenchmark::start()) {
+            USBSerial.println("Storage benchmark started");
+        }
+    } else if (command == "log binary" || command == "log text") {
+        // Binary frames are for scripts/binlog_decode.py
+        BinaryLog::setBinaryOutput(command == "log binary");
+        USBSerial.printf("Log output: %s\n", command.substring(4).c_str());
+    } else if (command == "budgets") {
+        PsramJsonDocument doc(8192);
+        BudgetWatchdog::getStatus(doc.to<JsonObject>());
+        serializeJson(doc, USBSerial);
+        USBSerial.println();
+    } else if (command == "memory") {
+        PsramJsonDocument doc(16384);
+        MemoryPolicy::getStatus(doc.to<JsonObject>());
+        serializeJson(doc, USBSerial);
+        USBSerial.println();
+    } else if (command == "trace") {
+        // Chrome trace JSON; recording stays stopped until "trace start"
+        SpanTrace::Exporter exporter;
+        uint8_t buffer[256];
+        size_t n;
+        while ((n = exporter.read(buffer, sizeof(buffer))) > 0) {
+            USBSerial.write(buffer, n);
+        }
+    } else if (command == "trace start") {
+        SpanTrace::start();
+        USBSerial.println("Trace recording");
+    } else if (command == "trace stop") {
+        SpanTrace::stop();
+        USBSerial.println("Trace stopped");
+    } else if (command.length() > 0) {
+        USBSerial.printf("Unknown command: %s (commands: bench, budgets, log binary, log text, memory, trace, trace start, trace stop)\n",
+                         command.c_str());
+    }
+}
+
 // Flag to indicate if USB server should be initialized
 // IMPORTANT: Set this to false to disable USB server completely
 
@@ -357,12 +386,10 @@ void createWorkingActionsFile() {
     }
 }
 
-void keyboardTask(void *pvParameters) {
-    while (true) {
-        if (keyHandler) {
-            keyHandler->updateKeys();
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));  // Scan every 10ms (adjust as needed)
+void keyboardTask() {
+    if (keyHandler) {
+        StageTimer stage(STAGE_KEYS);
+        keyHandler->updateKeys();
     }
 }
 
@@ -456,7 +483,7 @@ void initializeEncoderHandler() {
         for (const Component& comp : components) {
             if (comp.type == "encoder") {
                 // Use a larger capacity for JSON parsing here
-                DynamicJsonDocument doc(8192);
+                PsramJsonDocument doc(8192);
                 DeserializationError error = deserializeJson(doc, componentsJson);
                 if (error) {
                     USBSerial.printf("Error parsing components JSON: %s\n", error.c_str());
@@ -520,13 +547,41 @@ void initializeEncoderHandler() {
     }
 }
 
-void encoderTask(void *pvParameters) {
-    while (true) {
-        if (encoderHandler) {
-            encoderHandler->updateEncoders();
-        }
-        vTaskDelay(pdMS_TO_TICKS(10));  // Adjust the delay as needed (here 10ms)
+void encoderTask() {
+    if (encoderHandler) {
+        StageTimer stage(STAGE_ENCODERS);
+        encoderHandler->updateEncoders();
+    }
+}
+
+// Macro execution and HID report delivery, next to the input tasks
+void hidTask() {
+    {
+        StageTimer stage(STAGE_MACROS);
+        updateMacroHandler();
     }
+    StageTimer stage(STAGE_HID);
+    updateHIDHandler();
+}
+
+// WebSocket/HTTP housekeeping, on the same core as the WiFi stack
+void networkTask() {
+    StageTimer stage(STAGE_NETWORK);
+    WiFiManager::update();
+}
+
+// LEDs and display, kept off the input core
+void uiTask() {
+    {
+        StageTimer stage(STAGE_UPDATE_PROGRESS);
+        UpdateProgressDisplay::process();
+    }
+    {
+        StageTimer stage(STAGE_LEDS);
+        updateLEDs();
+    }
+    StageTimer stage(STAGE_DISPLAY);
+    updateDisplay();
 }
 
 // Separate task for USB Server to avoid blocking the main functionality
@@ -882,6 +937,9 @@ void setup() {
     // Initialize the recovery bootloader first (before any other components)
     RecoveryBootloader::begin();
     
+    // Write-behind runtime state (current layer, LED tweaks); flushed from loop()
+    PersistenceService::begin();
+    
     // Check if we are in recovery mode
     if (RecoveryBootloader::shouldEnterRecoveryMode()) {
         // Recovery mode will be handled in the loop
@@ -891,6 +949,19 @@ void setup() {
     // Initialize USB in Serial mode
     USB.begin();
     USBSerial.begin();
+    
+    // Hot-path logging goes through the binary ring, drained in the background
+    BinaryLog::begin();
+    
+    // Heap history for fragmentation telemetry; large buffers below go through its classes
+    MemoryPolicy::begin();
+    
+    // Span rings for the trace timeline; recording starts here
+    SpanTrace::begin();
+    SpanTrace::nameCurrentTask("loopTask");
+    
+    // Key and encoder counters come from the event bus
+    MetricsRegistry::begin();
 
     // Wait a bit for Serial to initialize
     delay(8000);
@@ -920,6 +991,12 @@ void setup() {
     if (FileSystemUtils::begin(true)) {
         USBSerial.println("LittleFS filesystem is operational");
         
+        // Finish or roll back a web/config sync cut short by a reset
+        FileSync::begin();
+        
+        // Complete a config snapshot restore cut short by a reset
+        ConfigSnapshot::begin();
+        
         // Create only the necessary directories matching old firmware
         FileSystemUtils::createDirPath("/config");
         FileSystemUtils::createDirPath("/web");
@@ -1011,9 +1088,30 @@ void setup() {
         strip->show();
     }
     
-    // Create tasks for keyboard and encoder handling
-    xTaskCreate(keyboardTask, "keyboard_task", 4096, NULL, 2, NULL);
-    xTaskCreate(encoderTask, "encoder_task", 4096, NULL, 2, NULL);
+    // Scale the CPU down between scans; the tasks below hold it up while they work
+    PowerManager::begin();
+    
+    // Per-stage budgets for the task bodies below; overruns are reported from loop()
+    BudgetWatchdog::begin();
+    BudgetWatchdog::setOverrunHandler([](const BudgetWatchdog::Overrun&) {
+        // Keep the stall in the span rings until it is exported
+        if (SpanTrace::getFreezeOnOverrun() && SpanTrace::isRecording()) {
+            SpanTrace::stop();
+            USBSerial.println("Trace stopped on overrun; type 'trace' or GET /api/trace to export");
+        }
+    });
+    
+    // Create pinned tasks: input and HID on one core, networking and UI on the other
+    TaskManager::begin();
+    TaskManager::startTask(TASK_KEYBOARD, keyboardTask);
+    TaskManager::startTask(TASK_ENCODER, encoderTask);
+    
+    // In recovery mode loop() drives WiFi and the display itself
+    if (RecoveryBootloader::getBootloaderState() != RecoveryBootloader::RECOVERY_MODE) {
+        TaskManager::startTask(TASK_HID, hidTask);
+        TaskManager::startTask(TASK_NETWORK, networkTask);
+        TaskManager::startTask(TASK_UI, uiTask);
+    }
 
     // Initialize OTA Update Manager
     USBSerial.println("Initializing OTA Update Manager...");
@@ -1041,35 +1139,32 @@ void setup() {
 }
 
 void loop() {
+    uint32_t loopStart = micros();
+    
     // Check if in recovery mode
     if (RecoveryBootloader::getBootloaderState() == RecoveryBootloader::RECOVERY_MODE) {
         handleRecoveryMode();
         return;  // Skip normal loop processing in recovery mode
     }
     
-    // Update OTA progress display
-    UpdateProgressDisplay::process();
-    
-    // Update WiFi Manager
-    WiFiManager::update();
-
-    // Update LEDs
-    updateLEDs();
-    
-    // Update display
-    updateDisplay();
-    
-    // Update macro execution
-    updateMacroHandler();
-
-    // Update HID handler
-    updateHIDHandler();
+    // HID, macros, WiFi, LEDs and display run in their own pinned tasks (see TaskManager)
 
     // Run LittleFS diagnostics if enabled
     if (diagnosticsEnabled) {
         runDiagnostics();
     }
 
+    handleSerialCommands();
+
+    // Write out runtime state once input has been quiet for a while
+    PersistenceService::loop();
+
+    // Print stages that overran their budget since the last pass
+    BudgetWatchdog::poll();
+
+    // Record heap free/largest block into the history ring
+    MemoryPolicy::loop();
+
     // Minimal loop - print a heartbeat every 10 seconds
     static unsigned long lastPrint = 0;
     if (millis() - lastPrint > 10000) {
@@ -1101,6 +1196,9 @@ void loop() {
     
     // No need to call updateKeyHandler here - the task is handling it
     
+    metricLoopTime.observe(micros() - loopStart);
+    BudgetWatchdog::record(STAGE_LOOP, micros() - loopStart);
+    
     // Give other tasks time to run
     delay(20); // Increased delay to reduce update frequency
 }